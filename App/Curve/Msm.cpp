@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for the enclave's multi-scalar multiplication jobs:
+ * the windows of a job are split into parts run by one thread each, so a
+ * large MSM uses several TCS at once.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static void run_part(uint32_t job, int part, int parts, int* result)
+{
+    int ret = -1;
+    if (msm_job_run(global_eid, &ret, job, part, parts) != SGX_SUCCESS)
+        ret = -1;
+    *result = ret;
+}
+
+//按点数决定并行份数,建job时就要交给enclave
+static int msm_parts(int count, int threads)
+{
+    int parts = (count + MSM_PART_MIN - 1) / MSM_PART_MIN;
+    if (parts > threads)
+        parts = threads;
+    if (parts > SHARE_THREADS)
+        parts = SHARE_THREADS;
+    if (parts < 1)
+        parts = 1;
+    return parts;
+}
+
+//每个部分一个线程,全部跑完
+static int run_job(uint32_t job, int parts)
+{
+    vector<int> results(parts, -1);
+    vector<thread> workers;
+    for (int t = 1; t < parts; t++)
+        workers.push_back(thread(run_part, job, t, parts, &results[t]));
+    run_part(job, 0, parts, &results[0]);
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+    for (int t = 0; t < parts; t++)
+        if (results[t] != 0)
+            return -1;
+    return 0;
+}
+
+/* msm_compute:
+ *   result = sum scalars[i] * points[i] over secp256k1, points as x||y,
+ *   scalars 32-byte big-endian; infinity comes back as all zero. The
+ *   enclave reads both arrays in place while the job runs.
+ */
+int msm_compute(const uint8_t* points, const uint8_t* scalars, int count, uint8_t result[64])
+{
+    uint32_t job = 0;
+    int ret = -1;
+    int parts = msm_parts(count, SHARE_THREADS);
+    if (msm_job_begin(global_eid, &ret, points, scalars, count, parts, &job) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    ret = run_job(job, parts);
+    int end_ret = -1;
+    if (msm_job_end(global_eid, &end_ret, job, result) != SGX_SUCCESS || end_ret != 0)
+        ret = -1;
+    return ret;
+}
+
+/* msm_bench:
+ *   Time one MSM over count random points on up to 'threads' threads,
+ *   excluding the setup of the points.
+ */
+int msm_bench(int count, int threads, int64_t* usec)
+{
+    uint32_t job = 0;
+    int ret = -1;
+    if (count <= 0)
+        return -1;
+    int parts = msm_parts(count, threads);
+    //随机点和标量由enclave写进这里,job运行时原地读取
+    vector<uint8_t> points((size_t)count * 64), scalars((size_t)count * 32);
+    if (msm_bench_begin(global_eid, &ret, &points[0], &scalars[0], count, parts, &job) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ret = run_job(job, parts);
+    uint8_t result[64];
+    int end_ret = -1;
+    if (msm_job_end(global_eid, &end_ret, job, result) != SGX_SUCCESS || end_ret != 0)
+        ret = -1;
+    *usec = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+    return ret;
+}
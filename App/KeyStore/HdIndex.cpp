@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted index of HD children already in the key store.
+ *
+ * The record format has no room for a child's parent or path, so
+ * (parent_id, path, index) -> child key_id is kept here, in
+ * KEYSTORE_HD_FILE next to the snapshot, and loaded whole at open. It is
+ * only a hint: the enclave re-derives every child it is pointed at and
+ * checks the stored key before reusing it, so a stale or forged entry
+ * just means the child is derived and stored again. Entries are made
+ * durable before the children's WAL write; ids from a WAL write that
+ * never happened are skipped by the enclave's id window on restart and
+ * fail that check.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../server.h"
+
+typedef struct _hd_entry_t {
+    uint64_t parent_id;
+    uint32_t depth;
+    uint32_t index;
+    uint32_t path[HD_MAX_DEPTH];
+    uint64_t child_id;
+} hd_entry_t;
+
+static int hd_fd = -1;
+static uint64_t hd_entries = 0;
+static std::map<std::string, uint64_t> hd_map;
+static pthread_mutex_t hd_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//去掉child_id的部分作为查找键,路径补零
+static std::string entry_key(uint64_t parent_id, const uint32_t* path, int depth, uint32_t index)
+{
+    hd_entry_t e;
+    memset(&e, 0, sizeof(e));
+    e.parent_id = parent_id;
+    e.depth = (uint32_t)depth;
+    e.index = index;
+    if (depth > 0)
+        memcpy(e.path, path, (size_t)depth * sizeof(uint32_t));
+    return std::string((const char*)&e, offsetof(hd_entry_t, child_id));
+}
+
+/* hd_index_open:
+ *   Load every complete entry of KEYSTORE_HD_FILE; a torn last entry is
+ *   cut off.
+ */
+int hd_index_open(void)
+{
+    hd_fd = open(KEYSTORE_HD_FILE, O_RDWR | O_CREAT, 0600);
+    struct stat st;
+    if (hd_fd < 0 || fstat(hd_fd, &st) != 0)
+        return -1;
+
+    hd_entries = (uint64_t)st.st_size / sizeof(hd_entry_t);
+    std::vector<hd_entry_t> all(hd_entries);
+    size_t len = hd_entries * sizeof(hd_entry_t);
+    if (len > 0 && pread(hd_fd, &all[0], len, 0) != (ssize_t)len)
+        return -1;
+    if ((size_t)st.st_size != len && ftruncate(hd_fd, (off_t)len) != 0)
+        return -1;
+    for (uint64_t i = 0; i < hd_entries; i++)
+        if (all[i].depth <= HD_MAX_DEPTH)
+            hd_map[entry_key(all[i].parent_id, all[i].path, (int)all[i].depth, all[i].index)] = all[i].child_id;
+    return 0;
+}
+
+void hd_index_close(void)
+{
+    if (hd_fd >= 0)
+        close(hd_fd);
+    hd_fd = -1;
+    hd_entries = 0;
+    hd_map.clear();
+}
+
+/* hd_index_find:
+ *   key_ids[i] = the recorded child first+i of parent_id/path, 0 if none.
+ */
+void hd_index_find(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count, uint64_t* key_ids)
+{
+    pthread_mutex_lock(&hd_mutex);
+    for (int i = 0; i < count; i++)
+    {
+        std::map<std::string, uint64_t>::const_iterator it = hd_map.find(entry_key(parent_id, path, depth, first + (uint32_t)i));
+        key_ids[i] = it == hd_map.end() ? 0 : it->second;
+    }
+    pthread_mutex_unlock(&hd_mutex);
+}
+
+/* hd_index_add:
+ *   Record the children first+i with key_ids[i] != 0, one write and one
+ *   fdatasync.
+ */
+int hd_index_add(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count, const uint64_t* key_ids)
+{
+    std::vector<hd_entry_t> add;
+    for (int i = 0; i < count; i++)
+    {
+        if (key_ids[i] == 0)
+            continue;
+        hd_entry_t e;
+        memset(&e, 0, sizeof(e));
+        e.parent_id = parent_id;
+        e.depth = (uint32_t)depth;
+        e.index = first + (uint32_t)i;
+        if (depth > 0)
+            memcpy(e.path, path, (size_t)depth * sizeof(uint32_t));
+        e.child_id = key_ids[i];
+        add.push_back(e);
+    }
+    if (add.empty())
+        return 0;
+
+    int ret = -1;
+    pthread_mutex_lock(&hd_mutex);
+    size_t len = add.size() * sizeof(hd_entry_t);
+    off_t off = (off_t)(hd_entries * sizeof(hd_entry_t));
+    if (hd_fd >= 0 && pwrite(hd_fd, &add[0], len, off) == (ssize_t)len && fdatasync(hd_fd) == 0)
+    {
+        hd_entries += add.size();
+        for (size_t i = 0; i < add.size(); i++)
+            hd_map[entry_key(add[i].parent_id, add[i].path, (int)add[i].depth, add[i].index)] = add[i].child_id;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&hd_mutex);
+    return ret;
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted half of the sealed key store: owns the key, snapshot and WAL
+ * files, and the cold tier the enclave reads from. The snapshot is
+ * append-only and sorted by key_id (the enclave hands out increasing ids),
+ * so compaction is an append of the WAL followed by a header update that
+ * also carries the enclave's key id high-water mark. The WAL is mirrored in
+ * wal_tail, an array indexed by key_id from that mark, which the enclave
+ * fills on keygen and reads in place on lookup. Restart is an mmap plus a
+ * read of at most KEYSTORE_WAL_LIMIT records and one compaction to open a
+ * fresh id window; nothing is decrypted until it is looked up.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+typedef struct _snapshot_header_t {
+    char     magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t count;
+    keystore_mark_t mark;   /* written together with count */
+    uint8_t  pad[16];
+} snapshot_header_t;
+
+typedef struct _wal_header_t {
+    char     magic[8];
+    uint32_t record_size;
+    uint32_t reserved;
+} wal_header_t;
+
+static const char snap_magic[8] = {'S', 'G', 'X', 'S', 'N', 'A', 'P', '1'};
+static const char wal_magic[8] = {'S', 'G', 'X', 'S', 'W', 'A', 'L', '1'};
+
+static int snap_fd = -1;
+static int wal_fd = -1;
+static void* snap_map = NULL;
+static size_t snap_map_len = 0;
+static uint64_t snap_count = 0;
+static keystore_mark_t snap_mark;
+static uint64_t tail_base = 1;      /* key_id of wal_tail[0] */
+
+static keystore_record_t* wal_tail = NULL;
+static uint64_t wal_used = 0;       /* tail slots up to the highest filled one */
+static uint64_t wal_records = 0;    /* records in the WAL file */
+
+static int pwrite_all(int fd, const void* data, size_t n, off_t off)
+{
+    const char* ptr = (const char*)data;
+    while (n > 0)
+    {
+        ssize_t len = pwrite(fd, ptr, n, off);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ptr += len;
+        off += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, void* data, size_t n, off_t off)
+{
+    char* ptr = (char*)data;
+    while (n > 0)
+    {
+        ssize_t len = pread(fd, ptr, n, off);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (len == 0)
+            return -1;
+        ptr += len;
+        off += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+static int load_store_key(void)
+{
+    uint32_t sealed_size = 0;
+    int ret = -1;
+    if (ecall_keystore_sealed_size(global_eid, &sealed_size) != SGX_SUCCESS || sealed_size == 0)
+        return -1;
+
+    std::vector<uint8_t> sealed(sealed_size);
+    int fd = open(KEYSTORE_KEY_FILE, O_RDONLY);
+    if (fd >= 0)
+    {
+        if (pread_all(fd, &sealed[0], sealed_size, 0) == 0 &&
+            ecall_keystore_open(global_eid, &ret, &sealed[0], sealed_size) == SGX_SUCCESS && ret == 0)
+        {
+            close(fd);
+            return 0;
+        }
+        close(fd);
+        printf("keystore: cannot unseal %s\n", KEYSTORE_KEY_FILE);
+        return -1;
+    }
+
+    if (ecall_keystore_create(global_eid, &ret, &sealed[0], sealed_size) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    fd = open(KEYSTORE_KEY_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -1;
+    ret = pwrite_all(fd, &sealed[0], sealed_size, 0);
+    if (ret == 0)
+        ret = fsync(fd);
+    close(fd);
+    if (ret == 0)
+        ret = rename(KEYSTORE_KEY_FILE ".tmp", KEYSTORE_KEY_FILE);
+    return ret;
+}
+
+/* map the first snap_count records and re-point the enclave at them */
+static int map_snapshot(void)
+{
+    size_t len = sizeof(snapshot_header_t) + (size_t)snap_count * sizeof(keystore_record_t);
+    void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, snap_fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const keystore_record_t* records = (const keystore_record_t*)((char*)map + sizeof(snapshot_header_t));
+    int ret = -1;
+    if (ecall_keystore_attach(global_eid, &ret, records, snap_count, &snap_mark,
+            wal_tail, KEYSTORE_WAL_LIMIT) != SGX_SUCCESS || ret != 0)
+    {
+        munmap(map, len);
+        return -1;
+    }
+
+    if (snap_map)
+        munmap(snap_map, snap_map_len);
+    snap_map = map;
+    snap_map_len = len;
+    tail_base = snap_mark.next_id ? snap_mark.next_id : 1;
+    return 0;
+}
+
+static int open_snapshot(void)
+{
+    snapshot_header_t hdr;
+    struct stat st;
+
+    snap_fd = open(KEYSTORE_SNAP_FILE, O_RDWR | O_CREAT, 0600);
+    if (snap_fd < 0 || fstat(snap_fd, &st) != 0)
+        return -1;
+
+    if (st.st_size == 0)
+    {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, snap_magic, sizeof(hdr.magic));
+        hdr.record_size = sizeof(keystore_record_t);
+        if (pwrite_all(snap_fd, &hdr, sizeof(hdr), 0) != 0 || fsync(snap_fd) != 0)
+            return -1;
+        st.st_size = sizeof(hdr);
+    }
+
+    if (pread_all(snap_fd, &hdr, sizeof(hdr), 0) != 0 ||
+        memcmp(hdr.magic, snap_magic, sizeof(hdr.magic)) != 0 ||
+        hdr.record_size != sizeof(keystore_record_t))
+    {
+        printf("keystore: bad snapshot header in %s\n", KEYSTORE_SNAP_FILE);
+        return -1;
+    }
+
+    /* records past the header's count are an interrupted compaction; the WAL still has them */
+    uint64_t on_disk = ((uint64_t)st.st_size - sizeof(hdr)) / sizeof(keystore_record_t);
+    snap_count = hdr.count < on_disk ? hdr.count : on_disk;
+    snap_mark = hdr.mark;
+    tail_base = snap_mark.next_id ? snap_mark.next_id : 1;
+    return 0;
+}
+
+static int replay_wal(void)
+{
+    wal_header_t hdr;
+    struct stat st;
+
+    wal_fd = open(KEYSTORE_WAL_FILE, O_RDWR | O_CREAT, 0600);
+    if (wal_fd < 0 || fstat(wal_fd, &st) != 0)
+        return -1;
+
+    wal_records = 0;
+    wal_used = 0;
+    if ((size_t)st.st_size < sizeof(hdr))
+    {
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, wal_magic, sizeof(hdr.magic));
+        hdr.record_size = sizeof(keystore_record_t);
+        if (ftruncate(wal_fd, 0) != 0 || pwrite_all(wal_fd, &hdr, sizeof(hdr), 0) != 0 || fsync(wal_fd) != 0)
+            return -1;
+        return 0;
+    }
+
+    if (pread_all(wal_fd, &hdr, sizeof(hdr), 0) != 0 ||
+        memcmp(hdr.magic, wal_magic, sizeof(hdr.magic)) != 0 ||
+        hdr.record_size != sizeof(keystore_record_t))
+    {
+        printf("keystore: bad WAL header in %s\n", KEYSTORE_WAL_FILE);
+        return -1;
+    }
+
+    size_t count = ((size_t)st.st_size - sizeof(hdr)) / sizeof(keystore_record_t);
+    std::vector<keystore_record_t> records(count);
+    if (count && pread_all(wal_fd, &records[0], count * sizeof(keystore_record_t), sizeof(hdr)) != 0)
+        return -1;
+
+    /* drop a torn tail record */
+    if (ftruncate(wal_fd, (off_t)(sizeof(hdr) + count * sizeof(keystore_record_t))) != 0)
+        return -1;
+
+    /* a crash between compaction and WAL truncation leaves records already in the snapshot */
+    wal_records = count;
+    wal_used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (records[i].key_id < tail_base)
+            continue;
+        uint64_t slot = records[i].key_id - tail_base;
+        if (slot >= KEYSTORE_WAL_LIMIT)
+        {
+            printf("keystore: WAL record %lu out of range\n", (unsigned long)records[i].key_id);
+            return -1;
+        }
+        wal_tail[slot] = records[i];
+        if (slot + 1 > wal_used)
+            wal_used = slot + 1;
+    }
+    return 0;
+}
+
+/* keystore_compact:
+ *   Append the WAL to the snapshot, publish the new count and high-water
+ *   mark, then reset the WAL. The tail restarts at the mark.
+ */
+int keystore_compact(void)
+{
+    /* tail slots are already in key_id order; skip the holes of failed appends */
+    std::vector<keystore_record_t> records;
+    records.reserve(wal_used);
+    for (uint64_t i = 0; i < wal_used; i++)
+        if (wal_tail[i].key_id == tail_base + i)
+            records.push_back(wal_tail[i]);
+
+    snapshot_header_t hdr;
+    int ret = -1;
+    if (ecall_keystore_mark(global_eid, &ret, &hdr.mark) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    hdr.count = snap_count + records.size();
+    off_t off = (off_t)(sizeof(snapshot_header_t) + snap_count * sizeof(keystore_record_t));
+    if (!records.empty() &&
+        (pwrite_all(snap_fd, &records[0], records.size() * sizeof(keystore_record_t), off) != 0 ||
+         fdatasync(snap_fd) != 0))
+        return -1;
+
+    size_t hdr_len = offsetof(snapshot_header_t, pad) - offsetof(snapshot_header_t, count);
+    if (pwrite_all(snap_fd, &hdr.count, hdr_len, offsetof(snapshot_header_t, count)) != 0 ||
+        fdatasync(snap_fd) != 0)
+        return -1;
+
+    snap_count = hdr.count;
+    snap_mark = hdr.mark;
+    memset(wal_tail, 0, KEYSTORE_WAL_LIMIT * sizeof(keystore_record_t));
+    wal_used = 0;
+    if (map_snapshot() != 0)
+        return -1;
+
+    wal_records = 0;
+    if (ftruncate(wal_fd, sizeof(wal_header_t)) != 0 || fdatasync(wal_fd) != 0)
+        return -1;
+    return 0;
+}
+
+/* keystore_reserve:
+ *   Compact early if the tail cannot take 'count' more keys, so a batch
+ *   keygen never runs out of tail slots halfway through.
+ */
+int keystore_reserve(uint64_t count)
+{
+    if (count > KEYSTORE_WAL_LIMIT)
+        return -1;
+    if (wal_used + count > KEYSTORE_WAL_LIMIT)
+        return keystore_compact();
+    return 0;
+}
+
+/* keystore_append_batch:
+ *   Make freshly generated records durable before they are acknowledged,
+ *   one WAL write and one fdatasync for the whole batch. The enclave has
+ *   already placed them in their tail slots.
+ */
+int keystore_append_batch(const keystore_record_t* recs, uint64_t count)
+{
+    uint64_t top = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (recs[i].key_id < tail_base || recs[i].key_id - tail_base >= KEYSTORE_WAL_LIMIT)
+            return -1;
+        if (recs[i].key_id - tail_base + 1 > top)
+            top = recs[i].key_id - tail_base + 1;
+    }
+
+    off_t off = (off_t)(sizeof(wal_header_t) + wal_records * sizeof(keystore_record_t));
+    if (pwrite_all(wal_fd, recs, count * sizeof(*recs), off) != 0 || fdatasync(wal_fd) != 0)
+        return -1;
+    wal_records += count;
+    if (top > wal_used)
+        wal_used = top;
+
+    if (wal_used >= KEYSTORE_WAL_LIMIT)
+        return keystore_compact();
+    return 0;
+}
+
+int keystore_append(const keystore_record_t* rec)
+{
+    return keystore_append_batch(rec, 1);
+}
+
+/* keystore_lookup_pub:
+ *   Read a public key straight from the cold tier, no ecall. Records are
+ *   only remapped by keystore_compact, which runs on the same thread.
+ */
+int keystore_lookup_pub(uint64_t key_id, uint8_t pub[64])
+{
+    if (key_id >= tail_base)
+    {
+        uint64_t slot = key_id - tail_base;
+        if (slot >= wal_used || wal_tail[slot].key_id != key_id)
+            return -1;
+        memcpy(pub, wal_tail[slot].pub, sizeof(wal_tail[slot].pub));
+        return 0;
+    }
+
+    const keystore_record_t* records = (const keystore_record_t*)((char*)snap_map + sizeof(snapshot_header_t));
+    uint64_t lo = 0, hi = snap_count;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (records[mid].key_id == key_id)
+        {
+            memcpy(pub, records[mid].pub, sizeof(records[mid].pub));
+            return 0;
+        }
+        if (records[mid].key_id < key_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+int keystore_open(void)
+{
+    wal_tail = new keystore_record_t[KEYSTORE_WAL_LIMIT];
+    memset(wal_tail, 0, KEYSTORE_WAL_LIMIT * sizeof(keystore_record_t));
+
+    if (load_store_key() != 0 || open_snapshot() != 0 || replay_wal() != 0 || map_snapshot() != 0 ||
+        hd_index_open() != 0)
+    {
+        printf("keystore: recovery failed\n");
+        keystore_close();
+        return -1;
+    }
+
+    /* recent keys are the likeliest to be asked for; older ones fill in on demand */
+    for (uint64_t i = 0; i < wal_used; i++)
+        if (wal_tail[i].key_id == tail_base + i)
+            pubkey_cache_put(wal_tail[i].key_id, wal_tail[i].pub);
+
+    printf("keystore: %lu records in snapshot, %lu in WAL\n",
+        (unsigned long)snap_count, (unsigned long)wal_records);
+
+    /* the enclave skipped the rest of the id window; fold the WAL in and open a new one */
+    if (keystore_compact() != 0)
+    {
+        printf("keystore: recovery failed\n");
+        keystore_close();
+        return -1;
+    }
+    return 0;
+}
+
+void keystore_close(void)
+{
+    if (snap_map)
+        munmap(snap_map, snap_map_len);
+    snap_map = NULL;
+    snap_map_len = 0;
+    if (snap_fd >= 0)
+        close(snap_fd);
+    if (wal_fd >= 0)
+        close(wal_fd);
+    snap_fd = wal_fd = -1;
+    hd_index_close();
+    delete[] wal_tail;
+    wal_tail = NULL;
+    wal_used = wal_records = 0;
+}
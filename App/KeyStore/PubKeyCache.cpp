@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted keyID -> public key cache.
+ *
+ * Public keys are not secret, so "get public key" is answered here on the
+ * network thread without entering the enclave. The map is split into
+ * PUBKEY_CACHE_SHARDS independently locked shards so keygen workers and
+ * readers on other threads do not serialize on one lock. Misses fall back
+ * to the key store's cold tier (snapshot mmap / WAL tail), where the public
+ * key is stored in the clear. Each shard holds at most PUBKEY_SHARD_MAX
+ * keys; a full shard drops an arbitrary entry, which the next miss
+ * reloads from the cold tier.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include <unordered_map>
+
+#include "../server.h"
+
+#define PUBKEY_CACHE_SHARDS 64
+#define PUBKEY_SHARD_MAX    (PUBKEY_CACHE_SIZE / PUBKEY_CACHE_SHARDS)
+
+typedef struct _pubkey_t {
+    uint8_t pub[64];
+} pubkey_t;
+
+typedef struct _pubkey_shard_t {
+    pthread_rwlock_t lock;
+    std::unordered_map<uint64_t, pubkey_t> map;
+} pubkey_shard_t;
+
+static pubkey_shard_t shards[PUBKEY_CACHE_SHARDS];
+static pthread_once_t shards_once = PTHREAD_ONCE_INIT;
+
+static void init_shards(void)
+{
+    for (int i = 0; i < PUBKEY_CACHE_SHARDS; i++)
+        pthread_rwlock_init(&shards[i].lock, NULL);
+}
+
+static pubkey_shard_t* shard_of(uint64_t key_id)
+{
+    pthread_once(&shards_once, init_shards);
+    return &shards[((key_id * 0x9E3779B97F4A7C15ULL) >> 32) % PUBKEY_CACHE_SHARDS];
+}
+
+void pubkey_cache_put(uint64_t key_id, const uint8_t pub[64])
+{
+    pubkey_shard_t* shard = shard_of(key_id);
+    pubkey_t value;
+    memcpy(value.pub, pub, sizeof(value.pub));
+
+    pthread_rwlock_wrlock(&shard->lock);
+    if (shard->map.size() >= PUBKEY_SHARD_MAX && shard->map.find(key_id) == shard->map.end())
+        shard->map.erase(shard->map.begin());
+    shard->map[key_id] = value;
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+/* pubkey_cache_get:
+ *   Returns 0 and fills pub on a hit, consulting the key store on a miss.
+ */
+int pubkey_cache_get(uint64_t key_id, uint8_t pub[64])
+{
+    pubkey_shard_t* shard = shard_of(key_id);
+    int found = 0;
+
+    pthread_rwlock_rdlock(&shard->lock);
+    std::unordered_map<uint64_t, pubkey_t>::const_iterator it = shard->map.find(key_id);
+    if (it != shard->map.end())
+    {
+        memcpy(pub, it->second.pub, sizeof(it->second.pub));
+        found = 1;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    if (found)
+        return 0;
+
+    if (keystore_lookup_pub(key_id, pub) != 0)
+        return -1;
+    pubkey_cache_put(key_id, pub);
+    return 0;
+}
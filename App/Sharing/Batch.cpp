@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for bulk provisioning: one ecall generates a batch of
+ * independent k-of-n keys, their shares go to one file, the Merkle tree
+ * committing them to another and their records to one WAL write.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+//整块写入并落盘
+static int write_file(const char* path, const void* data, size_t len)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -1;
+    int ret = write(fd, data, len) == (ssize_t)len && fdatasync(fd) == 0 ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+/* keygen_batch:
+ *   Generate 'batch' k-of-n keys, write their shares key by key to
+ *   BATCH_FILE_FMT(first key_id) and the Merkle tree over them to
+ *   MERKLE_FILE_FMT(first key_id), and make the records durable. root
+ *   receives the tree's root.
+ */
+int keygen_batch(int batch, int piece_k, int piece_n, keystore_record_t* recs, uint8_t root[32], char* path, size_t pathlen)
+{
+    if (batch < 1 || batch > BATCH_MAX_KEYS || piece_n < 1 || piece_n > SHARE_MAX_N)
+        return -1;
+    if (keystore_reserve((uint64_t)batch) != 0)
+        return -1;
+
+    vector<share_t> shares((size_t)batch * piece_n);
+    vector<uint8_t> tree(MERKLE_HASH_SIZE * merkle_nodes(shares.size()));
+    size_t len = shares.size() * sizeof(share_t);
+    int ret = -1;
+    if (batch_sharing(global_eid, &ret, batch, piece_k, piece_n, recs, &shares[0], len, root, &tree[0], tree.size()) != SGX_SUCCESS ||
+        ret != 0)
+        return -1;
+
+    snprintf(path, pathlen, BATCH_FILE_FMT, (unsigned long)recs[0].key_id);
+    ret = write_file(path, &shares[0], len);
+    memset(&shares[0], 0, len);
+    char tree_path[256];
+    snprintf(tree_path, sizeof(tree_path), MERKLE_FILE_FMT, (unsigned long)recs[0].key_id);
+    if (ret == 0)
+        ret = write_file(tree_path, &tree[0], tree.size());
+
+    //份额落盘后才写WAL,WAL里的key都有份额可恢复
+    if (ret == 0)
+        ret = keystore_append_batch(recs, (uint64_t)batch);
+    if (ret == 0)
+        for (int i = 0; i < batch; i++)
+            pubkey_cache_put(recs[i].key_id, recs[i].pub);
+    return ret;
+}
+
+/* merkle_batch_proof:
+ *   Inclusion proof for leaf 'index' of the batch whose first key is
+ *   first_id, cut from its stored tree; 'leaves' is the batch's key count
+ *   times n. Returns the number of sibling hashes in proof, -1 on error.
+ */
+int merkle_batch_proof(uint64_t first_id, uint64_t leaves, uint64_t index, uint8_t* proof)
+{
+    if (leaves < 1 || leaves > (uint64_t)BATCH_MAX_KEYS * SHARE_MAX_N || index >= leaves)
+        return -1;
+    char tree_path[256];
+    snprintf(tree_path, sizeof(tree_path), MERKLE_FILE_FMT, (unsigned long)first_id);
+    int fd = open(tree_path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    vector<uint8_t> tree(MERKLE_HASH_SIZE * merkle_nodes(leaves));
+    int ret = read(fd, &tree[0], tree.size()) == (ssize_t)tree.size() ? 0 : -1;
+    close(fd);
+    return ret == 0 ? merkle_proof(&tree[0], leaves, index, proof) : -1;
+}
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for streaming blob split/combine. The input is mmapped
+ * and fed to the enclave a chunk at a time by address; output chunks go to
+ * one of two staging buffers, and while the enclave fills one the other is
+ * written out on a separate thread, so ecall time overlaps file I/O and
+ * memory use is two staging buffers whatever the blob size.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static const char blob_magic[8] = {'S', 'G', 'X', 'B', 'L', 'O', 'B', '1'};
+
+static int pwrite_full(int fd, const uint8_t* data, size_t n, off_t off)
+{
+    while (n > 0)
+    {
+        ssize_t len = pwrite(fd, data, n, off);
+        if (len <= 0)
+            return -1;
+        data += len;
+        off += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+//写线程: 把一个暂存块的count路输出分别写到各自文件的off处
+static void write_chunk(const vector<int>* fds, const uint8_t* stage, size_t stride, size_t len, off_t off, int* result)
+{
+    int ret = 0;
+    for (size_t i = 0; i < fds->size() && ret == 0; i++)
+        ret = pwrite_full((*fds)[i], stage + i * stride, len, off);
+    *result = ret;
+}
+
+//每路分片的块大小: 两个暂存区合计不超过BLOB_STAGE_BYTES
+static size_t chunk_size(int ways)
+{
+    size_t chunk = (BLOB_STAGE_BYTES / 2 / (size_t)ways) & ~(size_t)4095;
+    if (chunk == 0)
+        chunk = 4096;
+    return chunk < BLOB_CHUNK_MAX ? chunk : BLOB_CHUNK_MAX;
+}
+
+static int close_all(vector<int>& fds, int ret)
+{
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        if (ret == 0 && fdatasync(fds[i]) != 0)
+            ret = -1;
+        close(fds[i]);
+    }
+    fds.clear();
+    return ret;
+}
+
+/* blob_split_file:
+ *   Share the file at path k-of-n into BLOB_SHARE_FMT(path, x), x = 1..n.
+ */
+int blob_split_file(const char* path, int piece_k, int piece_n)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > GF_MAX_N)
+        return -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, len, MADV_SEQUENTIAL);
+    const uint8_t* in = (const uint8_t*)map;
+
+    int ret = 0;
+    vector<int> fds;
+    for (int i = 0; i < piece_n && ret == 0; i++)
+    {
+        char name[FILENAME_MAX];
+        snprintf(name, sizeof(name), BLOB_SHARE_FMT, path, i + 1);
+        int out = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (out < 0)
+        {
+            ret = -1;
+            break;
+        }
+        fds.push_back(out);
+
+        blob_header_t header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, blob_magic, sizeof(header.magic));
+        header.x = (uint32_t)(i + 1);
+        header.piece_k = (uint32_t)piece_k;
+        header.len = len;
+        ret = pwrite_full(out, (const uint8_t*)&header, sizeof(header), 0);
+    }
+
+    uint32_t job = 0;
+    int status = -1;
+    if (ret == 0 && (blob_split_begin(global_eid, &status, piece_k, piece_n, &job) != SGX_SUCCESS || status != 0))
+        ret = -1;
+    if (ret != 0)
+    {
+        munmap(map, len);
+        return close_all(fds, -1);
+    }
+
+    size_t chunk = chunk_size(piece_n);
+    vector<uint8_t> stage[2];
+    stage[0].resize((size_t)piece_n * chunk);
+    stage[1].resize((size_t)piece_n * chunk);
+    vector<uint64_t> ptrs(piece_n);
+
+    thread writer;
+    int written = 0;
+    for (size_t off = 0, c = 0; off < len && ret == 0; off += chunk, c++)
+    {
+        size_t n = len - off < chunk ? len - off : chunk;
+        uint8_t* buf = &stage[c & 1][0];
+        for (int i = 0; i < piece_n; i++)
+            ptrs[i] = (uint64_t)(uintptr_t)(buf + (size_t)i * chunk);
+
+        //enclave填当前暂存区的同时,写线程在写上一块
+        if (blob_split_chunk(global_eid, &status, job, in + off, n, &ptrs[0], piece_n) != SGX_SUCCESS || status != 0)
+            ret = -1;
+        if (writer.joinable())
+        {
+            writer.join();
+            if (written != 0)
+                ret = -1;
+        }
+        if (ret == 0)
+            writer = thread(write_chunk, &fds, buf, chunk, n, (off_t)(sizeof(blob_header_t) + off), &written);
+    }
+    if (writer.joinable())
+    {
+        writer.join();
+        if (written != 0)
+            ret = -1;
+    }
+
+    blob_end(global_eid, &status, job);
+    munmap(map, len);
+    memset(&stage[0][0], 0, stage[0].size());
+    memset(&stage[1][0], 0, stage[1].size());
+    return close_all(fds, ret);
+}
+
+/* blob_combine_files:
+ *   Rebuild a blob from the first piece_k share files in paths into out_path.
+ */
+int blob_combine_files(const char* const* paths, int piece_k, const char* out_path)
+{
+    if (piece_k < 1 || piece_k > GF_MAX_N)
+        return -1;
+
+    int ret = 0;
+    uint64_t len = 0;
+    vector<uint8_t> xs(piece_k);
+    vector<const uint8_t*> maps(piece_k, (const uint8_t*)NULL);
+    for (int i = 0; i < piece_k && ret == 0; i++)
+    {
+        ret = -1;
+        int fd = open(paths[i], O_RDONLY);
+        if (fd < 0)
+            break;
+        blob_header_t header;
+        struct stat st;
+        if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fstat(fd, &st) == 0 &&
+            memcmp(header.magic, blob_magic, sizeof(header.magic)) == 0 &&
+            header.x >= 1 && header.x <= GF_MAX_N && header.piece_k <= (uint32_t)piece_k &&
+            header.len > 0 && (i == 0 || header.len == len) &&
+            (uint64_t)st.st_size == sizeof(header) + header.len)
+        {
+            void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED)
+            {
+                madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+                maps[i] = (const uint8_t*)map;
+                xs[i] = (uint8_t)header.x;
+                len = header.len;
+                ret = 0;
+            }
+        }
+        close(fd);
+    }
+
+    uint32_t job = 0;
+    int status = -1;
+    if (ret == 0 && (blob_combine_begin(global_eid, &status, &xs[0], piece_k, &job) != SGX_SUCCESS || status != 0))
+        ret = -1;
+
+    vector<int> fds;
+    if (ret == 0)
+    {
+        int out = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (out < 0)
+        {
+            blob_end(global_eid, &status, job);
+            ret = -1;
+        }
+        else
+        {
+            fds.push_back(out);
+        }
+    }
+
+    if (ret == 0)
+    {
+        size_t chunk = BLOB_CHUNK_MAX;
+        vector<uint8_t> stage[2];
+        stage[0].resize(chunk);
+        stage[1].resize(chunk);
+        vector<uint64_t> ptrs(piece_k);
+
+        thread writer;
+        int written = 0;
+        for (uint64_t off = 0, c = 0; off < len && ret == 0; off += chunk, c++)
+        {
+            size_t n = len - off < chunk ? (size_t)(len - off) : chunk;
+            uint8_t* buf = &stage[c & 1][0];
+            for (int i = 0; i < piece_k; i++)
+                ptrs[i] = (uint64_t)(uintptr_t)(maps[i] + sizeof(blob_header_t) + off);
+
+            if (blob_combine_chunk(global_eid, &status, job, &ptrs[0], piece_k, n, buf) != SGX_SUCCESS || status != 0)
+                ret = -1;
+            if (writer.joinable())
+            {
+                writer.join();
+                if (written != 0)
+                    ret = -1;
+            }
+            if (ret == 0)
+                writer = thread(write_chunk, &fds, buf, chunk, n, (off_t)off, &written);
+        }
+        if (writer.joinable())
+        {
+            writer.join();
+            if (written != 0)
+                ret = -1;
+        }
+
+        blob_end(global_eid, &status, job);
+        memset(&stage[0][0], 0, chunk);
+        memset(&stage[1][0], 0, chunk);
+    }
+
+    for (int i = 0; i < piece_k; i++)
+        if (maps[i])
+            munmap((void*)maps[i], (size_t)(sizeof(blob_header_t) + len));
+    return close_all(fds, ret);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for encrypted share delivery: the enclave wraps every
+ * share of a set of keys for its custodian straight into app memory, and
+ * the wrapped shares go to one file the transport can hand out as is.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+/* deliver_file:
+ *   Wrap shares x = 1..piece_n of each key for custodians[0..piece_n)
+ *   (32-byte X25519 keys) and write them key by key to
+ *   DELIVER_FILE_FMT(first key_id).
+ */
+int deliver_file(const uint64_t* key_ids, int keys, const uint8_t* custodians, int piece_n, char* path, size_t pathlen)
+{
+    if (keys < 1 || piece_n < 1 || piece_n > SHARE_MAX_N || (size_t)keys * piece_n > DELIVER_MAX_SHARES)
+        return -1;
+
+    vector<wrapped_share_t> out((size_t)keys * piece_n);
+    int ret = -1;
+    if (deliver_wrap(global_eid, &ret, keys, key_ids, piece_n, custodians, 32 * (size_t)piece_n, &out[0]) != SGX_SUCCESS ||
+        ret != 0)
+        return -1;
+
+    snprintf(path, pathlen, DELIVER_FILE_FMT, (unsigned long)key_ids[0]);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    size_t len = out.size() * sizeof(wrapped_share_t);
+    ret = write(fd, &out[0], len) == (ssize_t)len && fdatasync(fd) == 0 ? 0 : -1;
+    close(fd);
+    return ret;
+}
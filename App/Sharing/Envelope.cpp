@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted half of envelope mode: the enclave encrypts and shares the key,
+ * this side Reed-Solomon encodes each ciphertext stripe into n fragments
+ * (any k rebuild it) and writes one fragment file per custodian. One codec
+ * serves the whole file, so the decode matrix is inverted once. Like the
+ * blob path, stripes alternate between two staging buffers so encryption
+ * and coding overlap the writes of the previous stripe.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cpuid.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "rs.h"
+
+using namespace std;
+
+static const char env_magic[8] = {'S', 'G', 'X', 'E', 'N', 'V', '0', '1'};
+
+//app侧的GF(2^8)核按本机CPU选择
+static void gf_setup_host(void)
+{
+    static int ready = 0;
+    if (ready)
+        return;
+    unsigned a, b, c, d;
+    int leaf1[4] = {0}, leaf7[4] = {0};
+    if (__get_cpuid(1, &a, &b, &c, &d))
+    {
+        leaf1[0] = (int)a; leaf1[1] = (int)b; leaf1[2] = (int)c; leaf1[3] = (int)d;
+    }
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+    {
+        leaf7[0] = (int)a; leaf7[1] = (int)b; leaf7[2] = (int)c; leaf7[3] = (int)d;
+    }
+    if (leaf1[2] & (1 << 27))
+        gf256_select(gf256_features(leaf1, leaf7, gf256_xgetbv()));
+    ready = 1;
+}
+
+static int pwrite_full(int fd, const uint8_t* data, size_t n, off_t off)
+{
+    while (n > 0)
+    {
+        ssize_t len = pwrite(fd, data, n, off);
+        if (len <= 0)
+            return -1;
+        data += len;
+        off += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+static void write_shards(const vector<int>* fds, const vector<const uint8_t*>* ptrs, size_t len, off_t off, int* result)
+{
+    int ret = 0;
+    for (size_t i = 0; i < fds->size() && ret == 0; i++)
+        ret = pwrite_full((*fds)[i], (*ptrs)[i], len, off);
+    *result = ret;
+}
+
+static int close_all(vector<int>& fds, int ret)
+{
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        if (ret == 0 && fdatasync(fds[i]) != 0)
+            ret = -1;
+        close(fds[i]);
+    }
+    fds.clear();
+    return ret;
+}
+
+//每个条带的密文字节数: 两个暂存区合计不超过BLOB_STAGE_BYTES
+static uint32_t stripe_size(int piece_k, int piece_n)
+{
+    size_t stripe = (BLOB_STAGE_BYTES / 2 / (size_t)piece_n * (size_t)piece_k) & ~(size_t)4095;
+    if (stripe < 4096)
+        stripe = 4096;
+    return (uint32_t)(stripe < BLOB_CHUNK_MAX ? stripe : BLOB_CHUNK_MAX);
+}
+
+/* env_split_file:
+ *   Encrypt the file at path and disperse it k-of-n into ENV_SHARE_FMT(path, x).
+ */
+int env_split_file(const char* path, int piece_k, int piece_n)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > RS_MAX_K || piece_k > piece_n || piece_n > GF_MAX_N)
+        return -1;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, len, MADV_SEQUENTIAL);
+    const uint8_t* in = (const uint8_t*)map;
+
+    int ret = 0;
+    vector<int> fds;
+    for (int i = 0; i < piece_n; i++)
+    {
+        char name[FILENAME_MAX];
+        snprintf(name, sizeof(name), ENV_SHARE_FMT, path, i + 1);
+        int out = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (out < 0)
+        {
+            ret = -1;
+            break;
+        }
+        fds.push_back(out);
+    }
+
+    //编解码器先建好,失败时enclave里还没有job
+    gf_setup_host();
+    rs_codec_t rs;
+    if (rs_codec_init(&rs, piece_k, piece_n - piece_k) != 0)
+        ret = -1;
+
+    env_header_t header;
+    memset(&header, 0, sizeof(header));
+    uint32_t job = 0;
+    int status = -1;
+    if (ret == 0 && (env_seal_begin(global_eid, &status, piece_k, piece_n, len, header.iv, &job) != SGX_SUCCESS || status != 0))
+        ret = -1;
+    if (ret != 0)
+    {
+        rs_codec_free(&rs);
+        munmap(map, len);
+        return close_all(fds, -1);
+    }
+
+    uint32_t stripe = stripe_size(piece_k, piece_n);
+    size_t full = (stripe + piece_k - 1) / piece_k;
+    int parity_n = piece_n - piece_k;
+    vector<uint8_t> stage[2];
+    vector<const uint8_t*> ptrs[2];
+    stage[0].resize((size_t)piece_n * full);
+    stage[1].resize((size_t)piece_n * full);
+    ptrs[0].resize(piece_n);
+    ptrs[1].resize(piece_n);
+    vector<uint8_t*> parity(parity_n);
+
+    thread writer;
+    int written = 0;
+    for (size_t off = 0, s = 0; off < len && ret == 0; off += stripe, s++)
+    {
+        size_t clen = len - off < stripe ? len - off : stripe;
+        size_t cs = (clen + piece_k - 1) / piece_k;
+        uint8_t* buf = &stage[s & 1][0];
+
+        //密文连续放在前k*cs字节,末尾补零后按cs切成k个数据分片
+        memset(buf + clen, 0, (size_t)piece_k * cs - clen);
+        if (env_seal_chunk(global_eid, &status, job, in + off, clen, buf) != SGX_SUCCESS || status != 0)
+            ret = -1;
+        for (int j = 0; j < piece_k; j++)
+            ptrs[s & 1][j] = buf + (size_t)j * cs;
+        for (int i = 0; i < parity_n; i++)
+        {
+            parity[i] = buf + (size_t)(piece_k + i) * full;
+            ptrs[s & 1][piece_k + i] = parity[i];
+        }
+        if (ret == 0 && parity_n > 0)
+            rs_encode(&rs, &ptrs[s & 1][0], &parity[0], cs);
+
+        if (writer.joinable())
+        {
+            writer.join();
+            if (written != 0)
+                ret = -1;
+        }
+        if (ret == 0)
+            writer = thread(write_shards, &fds, &ptrs[s & 1], cs, (off_t)(sizeof(env_header_t) + s * full), &written);
+    }
+    if (writer.joinable())
+    {
+        writer.join();
+        if (written != 0)
+            ret = -1;
+    }
+    munmap(map, len);
+    rs_codec_free(&rs);
+
+    vector<uint8_t> key_shares((size_t)piece_n * ENV_KEY_SIZE);
+    if (env_seal_end(global_eid, &status, job, header.tag, &key_shares[0], key_shares.size()) != SGX_SUCCESS || status != 0)
+        ret = -1;
+
+    //头部最后写: 带tag和密钥分片的头出现,说明该分片文件已完整
+    memcpy(header.magic, env_magic, sizeof(header.magic));
+    header.piece_k = (uint16_t)piece_k;
+    header.piece_n = (uint16_t)piece_n;
+    header.len = len;
+    header.stripe = stripe;
+    for (int i = 0; i < piece_n && ret == 0; i++)
+    {
+        header.x = (uint32_t)(i + 1);
+        memcpy(header.key_share, &key_shares[(size_t)i * ENV_KEY_SIZE], ENV_KEY_SIZE);
+        ret = pwrite_full(fds[i], (const uint8_t*)&header, sizeof(header), 0);
+    }
+    memset(&key_shares[0], 0, key_shares.size());
+    memset(&header, 0, sizeof(header));
+    return close_all(fds, ret);
+}
+
+/* env_combine_files:
+ *   Rebuild and authenticate a blob from fragment files into out_path; the
+ *   output only appears once the GCM tag has verified.
+ */
+int env_combine_files(const char* const* paths, int count, const char* out_path)
+{
+    vector<env_header_t> headers;
+    vector<const uint8_t*> maps;
+    vector<size_t> map_lens;
+    int piece_k = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int fd = open(paths[i], O_RDONLY);
+        if (fd < 0)
+            continue;
+        env_header_t header;
+        struct stat st;
+        if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fstat(fd, &st) == 0 &&
+            memcmp(header.magic, env_magic, sizeof(header.magic)) == 0)
+        {
+            const env_header_t& h0 = headers.empty() ? header : headers[0];
+            int dup = 0;
+            for (size_t j = 0; j < headers.size(); j++)
+                if (headers[j].x == header.x)
+                    dup = 1;
+            if (!dup && header.x >= 1 && header.x <= header.piece_n && header.piece_k >= SHARE_MIN_K &&
+                header.piece_k <= RS_MAX_K && header.piece_k <= header.piece_n && header.piece_n <= GF_MAX_N &&
+                header.stripe >= 4096 && header.stripe <= BLOB_CHUNK_MAX && header.len > 0 &&
+                header.piece_k == h0.piece_k && header.piece_n == h0.piece_n && header.len == h0.len &&
+                header.stripe == h0.stripe && memcmp(header.iv, h0.iv, sizeof(header.iv)) == 0 &&
+                memcmp(header.tag, h0.tag, sizeof(header.tag)) == 0 && (size_t)st.st_size > sizeof(header))
+            {
+                void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map != MAP_FAILED)
+                {
+                    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+                    headers.push_back(header);
+                    maps.push_back((const uint8_t*)map);
+                    map_lens.push_back((size_t)st.st_size);
+                    piece_k = header.piece_k;
+                }
+            }
+        }
+        close(fd);
+        if (piece_k > 0 && (int)headers.size() == piece_k)
+            break;
+    }
+
+    int ret = piece_k > 0 && (int)headers.size() == piece_k ? 0 : -1;
+    uint64_t len = ret == 0 ? headers[0].len : 0;
+    uint32_t stripe = ret == 0 ? headers[0].stripe : 0;
+    size_t full = ret == 0 ? (stripe + piece_k - 1) / piece_k : 0;
+    if (ret == 0 && (uint64_t)map_lens[0] < sizeof(env_header_t) + (len / stripe) * full)
+        ret = -1;
+    for (size_t i = 0; ret == 0 && i < map_lens.size(); i++)
+        if (map_lens[i] != map_lens[0])
+            ret = -1;
+
+    uint32_t job = 0;
+    int status = -1;
+    if (ret == 0)
+    {
+        vector<uint8_t> xs(piece_k);
+        vector<uint8_t> key_shares((size_t)piece_k * ENV_KEY_SIZE);
+        for (int i = 0; i < piece_k; i++)
+        {
+            xs[i] = (uint8_t)headers[i].x;
+            memcpy(&key_shares[(size_t)i * ENV_KEY_SIZE], headers[i].key_share, ENV_KEY_SIZE);
+        }
+        if (env_open_begin(global_eid, &status, piece_k, headers[0].piece_n, len, headers[0].iv, &xs[0],
+                           &key_shares[0], key_shares.size(), &job) != SGX_SUCCESS || status != 0)
+            ret = -1;
+        memset(&key_shares[0], 0, key_shares.size());
+    }
+
+    //先写临时文件,tag校验通过才改名
+    string tmp = string(out_path) + ".tmp";
+    vector<int> fds;
+    if (ret == 0)
+    {
+        int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (out < 0)
+        {
+            uint8_t zero_tag[ENV_TAG_SIZE] = {0};
+            env_open_end(global_eid, &status, job, zero_tag);
+            ret = -1;
+        }
+        else
+        {
+            fds.push_back(out);
+        }
+    }
+
+    if (ret == 0)
+    {
+        gf_setup_host();
+        rs_codec_t rs;
+        //失败时跳过解码循环,下面的env_open_end照样释放job
+        if (rs_codec_init(&rs, piece_k, headers[0].piece_n - piece_k) != 0)
+            ret = -1;
+        vector<int> idx(piece_k);
+        for (int i = 0; i < piece_k; i++)
+            idx[i] = (int)headers[i].x - 1;
+
+        vector<uint8_t> ct((size_t)piece_k * full);
+        vector<uint8_t> pt[2];
+        vector<const uint8_t*> out_ptrs[2];
+        pt[0].resize(stripe);
+        pt[1].resize(stripe);
+        out_ptrs[0].push_back(&pt[0][0]);
+        out_ptrs[1].push_back(&pt[1][0]);
+        vector<const uint8_t*> in(piece_k);
+        vector<uint8_t*> missing(piece_k);
+
+        thread writer;
+        int written = 0;
+        for (uint64_t off = 0, s = 0; off < len && ret == 0; off += stripe, s++)
+        {
+            size_t clen = len - off < stripe ? (size_t)(len - off) : stripe;
+            size_t cs = (clen + piece_k - 1) / piece_k;
+            size_t frag_off = sizeof(env_header_t) + s * full;
+            if (frag_off + cs > map_lens[0])
+            {
+                ret = -1;
+                break;
+            }
+
+            //在场的数据分片直接拷贝,缺的由RS解码补齐
+            int need = 0;
+            for (int j = 0; j < piece_k; j++)
+                missing[j] = &ct[(size_t)j * cs];
+            for (int i = 0; i < piece_k; i++)
+            {
+                in[i] = maps[i] + frag_off;
+                if (idx[i] < piece_k)
+                {
+                    memcpy(missing[idx[i]], in[i], cs);
+                    missing[idx[i]] = NULL;
+                }
+            }
+            for (int j = 0; j < piece_k; j++)
+                if (missing[j])
+                    need = 1;
+            if (need && rs_decode(&rs, &idx[0], &in[0], &missing[0], cs) != 0)
+                ret = -1;
+
+            if (ret == 0 && (env_open_chunk(global_eid, &status, job, &ct[0], clen, &pt[s & 1][0]) != SGX_SUCCESS || status != 0))
+                ret = -1;
+            if (writer.joinable())
+            {
+                writer.join();
+                if (written != 0)
+                    ret = -1;
+            }
+            if (ret == 0)
+                writer = thread(write_shards, &fds, &out_ptrs[s & 1], clen, (off_t)off, &written);
+        }
+        if (writer.joinable())
+        {
+            writer.join();
+            if (written != 0)
+                ret = -1;
+        }
+
+        if (env_open_end(global_eid, &status, job, headers[0].tag) != SGX_SUCCESS || status != 0)
+            ret = -1;
+        memset(&pt[0][0], 0, stripe);
+        memset(&pt[1][0], 0, stripe);
+        rs_codec_free(&rs);
+    }
+
+    for (size_t i = 0; i < maps.size(); i++)
+        munmap((void*)maps[i], map_lens[i]);
+    ret = close_all(fds, ret);
+    if (ret == 0 && rename(tmp.c_str(), out_path) != 0)
+        ret = -1;
+    if (ret != 0)
+        unlink(tmp.c_str());
+    return ret;
+}
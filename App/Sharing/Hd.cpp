@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for HD child keys: one ecall derives a run of sibling
+ * keys under a stored parent, the new records go to one WAL write. No
+ * share file is written; custodians add the returned tweak to their
+ * parent share. Asking for the same children again returns the same
+ * key_ids (see HdIndex.cpp).
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+/* hd_children:
+ *   Derive children first .. first+count-1 below parent_id/path and make
+ *   the new records durable; children derived before keep their key_id.
+ *   tweaks receives 32 bytes per child.
+ */
+int hd_children(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count,
+                keystore_record_t* recs, uint8_t* tweaks)
+{
+    if (depth < 0 || depth > HD_MAX_DEPTH || count < 1 || count > HD_MAX_CHILDREN)
+        return -1;
+    if (keystore_reserve((uint64_t)count) != 0)
+        return -1;
+
+    vector<uint64_t> known(count);
+    hd_index_find(parent_id, path, depth, first, count, &known[0]);
+    int ret = -1;
+    if (hd_derive(global_eid, &ret, parent_id, path, depth, first, count, &known[0], recs, tweaks, 32 * (size_t)count) != SGX_SUCCESS ||
+        ret != 0)
+        return -1;
+
+    //已有的子key只回填key_id和pub(version为0),不再写WAL
+    vector<keystore_record_t> fresh;
+    vector<uint64_t> fresh_ids(count, 0);
+    for (int i = 0; i < count; i++)
+    {
+        if (recs[i].version == 0)
+            continue;
+        fresh.push_back(recs[i]);
+        fresh_ids[i] = recs[i].key_id;
+    }
+    //索引先落盘: 之后WAL写失败的id会被enclave的id窗口跳过,查到也会被拒
+    ret = 0;
+    if (!fresh.empty())
+    {
+        ret = hd_index_add(parent_id, path, depth, first, count, &fresh_ids[0]);
+        if (ret == 0)
+            ret = keystore_append_batch(&fresh[0], (uint64_t)fresh.size());
+    }
+    if (ret == 0)
+        for (int i = 0; i < count; i++)
+            pubkey_cache_put(recs[i].key_id, recs[i].pub);
+    return ret;
+}
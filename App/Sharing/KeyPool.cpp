@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted side of the pre-generated key pool: a filler thread that calls
+ * keypool_refill at a bounded rate, and the keygen fast path that pops a
+ * ready key and writes its shares out.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static thread filler;
+static volatile int filler_rate = KEYPOOL_RATE;
+
+static int64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//每批之后按速率补足睡眠,rate为0时不限速
+static void keypool_filler(void)
+{
+    for (;;)
+    {
+        int ret = -1, level = 0;
+        int64_t start = now_us();
+        if (keypool_refill(global_eid, &ret, KEYPOOL_REFILL_MAX, &level) != SGX_SUCCESS || ret == 1)
+            break;
+        if (ret != 0)
+        {
+            sleep(1);
+            continue;
+        }
+        int rate = filler_rate;
+        if (rate > 0)
+        {
+            int64_t due = start + (int64_t)KEYPOOL_REFILL_MAX * 1000000 / rate;
+            int64_t left = due - now_us();
+            if (left > 0)
+                usleep((useconds_t)left);
+        }
+    }
+}
+
+/* keypool_start:
+ *   Configure the pool and start its filler thread; rate is in keys per
+ *   second, 0 for unpaced.
+ */
+int keypool_start(int piece_k, int piece_n, int capacity, int rate)
+{
+    if (keypool_configure(piece_k, piece_n, capacity, rate) != 0)
+        return -1;
+    filler = thread(keypool_filler);
+    return 0;
+}
+
+int keypool_configure(int piece_k, int piece_n, int capacity, int rate)
+{
+    int ret = -1;
+    if (rate < 0 || keypool_config(global_eid, &ret, piece_k, piece_n, capacity) != SGX_SUCCESS || ret != 0)
+        return -1;
+    filler_rate = rate;
+    return 0;
+}
+
+void keypool_shutdown(void)
+{
+    if (!filler.joinable())
+        return;
+    keypool_stop(global_eid);
+    filler.join();
+}
+
+/* keygen_pooled:
+ *   Serve a k-of-n keygen from the pool, shares written to
+ *   SHARE_FILE_FMT(key_id). Returns 1 on a pool miss.
+ */
+int keygen_pooled(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen)
+{
+    if (piece_n < 1 || piece_n > SHARE_MAX_N)
+        return 1;
+
+    vector<share_t> shares(piece_n);
+    size_t len = shares.size() * sizeof(share_t);
+    int ret = -1;
+    if (keypool_pop(global_eid, &ret, piece_k, piece_n, pubA, rec, &shares[0], len) != SGX_SUCCESS)
+        return -1;
+    if (ret != 0)
+        return ret;
+
+    ret = write_share_file(rec->key_id, &shares[0], piece_n, path, pathlen);
+    memset(&shares[0], 0, len);
+    return ret;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+/* Untrusted side of the default keygen: the enclave hands back all n
+ * shares of a new key and they go to its share file, the same file the
+ * pooled and streamed paths write.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+/* write_share_file:
+ *   Write n shares to SHARE_FILE_FMT(key_id), path returned in path.
+ */
+int write_share_file(uint64_t key_id, const share_t* shares, int piece_n, char* path, size_t pathlen)
+{
+    size_t len = (size_t)piece_n * sizeof(share_t);
+    snprintf(path, pathlen, SHARE_FILE_FMT, (unsigned long)key_id);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    int ret = fd >= 0 && write(fd, shares, len) == (ssize_t)len ? 0 : -1;
+    if (fd >= 0)
+        close(fd);
+    return ret;
+}
+
+/* keygen_shares:
+ *   Generate a k-of-n key on curve and write its shares to
+ *   SHARE_FILE_FMT(key_id).
+ */
+int keygen_shares(int piece_k, int piece_n, int curve, char* pubA, keystore_record_t* rec, char* path, size_t pathlen)
+{
+    memset(rec, 0, sizeof(*rec));
+    if (piece_n < 1 || piece_n > SHARE_MAX_N)
+        return -1;
+
+    vector<share_t> shares(piece_n);
+    size_t len = shares.size() * sizeof(share_t);
+    int ret = -1;
+    if (secret_sharing_curve(global_eid, &ret, pubA, piece_k, piece_n, curve, rec, &shares[0], len) != SGX_SUCCESS)
+        ret = -1;
+    if (ret == 0)
+        ret = write_share_file(rec->key_id, &shares[0], piece_n, path, pathlen);
+    memset(&shares[0], 0, len);
+    return ret;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for packed batch keygen: one ecall produces the whole
+ * batch, its n shares go to one file and its records to one WAL write.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+/* packed_batch:
+ *   Generate 'batch' keys sharing one polynomial, write the n shares to
+ *   PACKED_FILE_FMT(first key_id) and make the records durable.
+ */
+int packed_batch(int batch, int threshold, int piece_n, keystore_record_t* recs, char* path, size_t pathlen)
+{
+    if (batch < 1 || batch > PACKED_MAX_BATCH || piece_n < 1 || piece_n > SHARE_MAX_N)
+        return -1;
+    if (keystore_reserve((uint64_t)batch) != 0)
+        return -1;
+
+    vector<share_t> shares(piece_n);
+    int ret = -1;
+    if (packed_keygen(global_eid, &ret, batch, threshold, piece_n, recs, &shares[0]) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    snprintf(path, pathlen, PACKED_FILE_FMT, (unsigned long)recs[0].key_id);
+    size_t len = (size_t)piece_n * sizeof(share_t);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -1;
+    ret = write(fd, &shares[0], len) == (ssize_t)len && fdatasync(fd) == 0 ? 0 : -1;
+    close(fd);
+
+    //份额落盘后才写WAL,WAL里的key都有份额可恢复
+    if (ret == 0)
+        ret = keystore_append_batch(recs, (uint64_t)batch);
+    if (ret == 0)
+        for (int i = 0; i < batch; i++)
+            pubkey_cache_put(recs[i].key_id, recs[i].pub);
+    return ret;
+}
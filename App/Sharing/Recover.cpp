@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for recovery drills: every key of a batch share file
+ * (n shares per key, key after key, as batch keygen writes them) is
+ * reconstructed from the shares of the same k custodians. The chosen
+ * shares are gathered into one k-column matrix and enclave threads
+ * reconstruct disjoint row ranges of it, RECON_MAX_SECRETS rows per ecall,
+ * each ecall computing the Lagrange weights once for all of its rows. The
+ * secrets come out of the enclave already encrypted to the requester.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+typedef struct _recover_part_t {
+    uint64_t first;
+    uint64_t count;
+    int result;
+} recover_part_t;
+
+static void run_part(recover_part_t* part, int curve, const uint32_t* xs, int piece_k, const uint8_t* recipient,
+                     const uint8_t* ys, wrapped_share_t* out)
+{
+    size_t row_len = 32 * (size_t)piece_k;
+    part->result = 0;
+    for (uint64_t b = part->first; b < part->first + part->count && part->result == 0; b += RECON_MAX_SECRETS)
+    {
+        uint64_t left = part->first + part->count - b;
+        uint64_t rows = left < RECON_MAX_SECRETS ? left : RECON_MAX_SECRETS;
+        int ret = -1;
+        if (batch_reconstruct(global_eid, &ret, curve, xs, piece_k, b, rows, recipient, ys + row_len * b, out + b) != SGX_SUCCESS ||
+            ret != 0)
+            part->result = -1;
+    }
+}
+
+//在第b个key的n个份额中找横坐标x的份额, 批量开户时位于x-1
+static const share_t* find_share(const share_t* row, int piece_n, uint32_t x)
+{
+    if (x >= 1 && x <= (uint32_t)piece_n && row[x - 1].x == x)
+        return &row[x - 1];
+    for (int i = 0; i < piece_n; i++)
+        if (row[i].x == x)
+            return &row[i];
+    return NULL;
+}
+
+/* recover_file:
+ *   Reconstruct every key in the n-share file path from the shares with
+ *   abscissae xs (piece_k of them) on the given share curve. The secrets,
+ *   each a wrapped_share_t encrypted to the X25519 key recipient (key_id =
+ *   position in the file, x = 0), go to RECOVER_FILE_FMT, returned in
+ *   out_path.
+ */
+int recover_file(const char* path, int piece_n, const uint32_t* xs, int piece_k, int curve, const uint8_t recipient[32],
+                 char* out_path, size_t pathlen)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N)
+        return -1;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0)
+        return -1;
+    size_t stride = (size_t)piece_n * sizeof(share_t);
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || (size_t)st.st_size % stride != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    uint64_t keys = (size_t)st.st_size / stride;
+    size_t len = (size_t)st.st_size;
+    void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    const share_t* in = (const share_t*)map;
+
+    //按xs顺序抽出k列
+    size_t row_len = 32 * (size_t)piece_k;
+    vector<uint8_t> ys(row_len * keys);
+    int ret = 0;
+    for (uint64_t b = 0; b < keys && ret == 0; b++)
+    {
+        for (int i = 0; i < piece_k && ret == 0; i++)
+        {
+            const share_t* s = find_share(in + b * piece_n, piece_n, xs[i]);
+            if (s == NULL)
+                ret = -1;
+            else
+                memcpy(&ys[row_len * b + 32 * i], s->y, 32);
+        }
+    }
+    munmap(map, len);
+
+    vector<wrapped_share_t> out(keys);
+    if (ret == 0)
+    {
+        uint64_t parts = (keys + SHARE_PART_MIN - 1) / SHARE_PART_MIN;
+        if (parts > SHARE_THREADS)
+            parts = SHARE_THREADS;
+        vector<recover_part_t> ranges(parts);
+        vector<thread> workers;
+        for (uint64_t t = 0; t < parts; t++)
+        {
+            ranges[t].first = keys * t / parts;
+            ranges[t].count = keys * (t + 1) / parts - ranges[t].first;
+            workers.push_back(thread(run_part, &ranges[t], curve, xs, piece_k, recipient, &ys[0], &out[0]));
+        }
+        for (uint64_t t = 0; t < parts; t++)
+        {
+            workers[t].join();
+            if (ranges[t].result != 0)
+                ret = -1;
+        }
+    }
+    memset(&ys[0], 0, ys.size());
+
+    if (ret == 0)
+    {
+        snprintf(out_path, pathlen, RECOVER_FILE_FMT, path);
+        int ofd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        size_t out_len = out.size() * sizeof(wrapped_share_t);
+        ret = ofd >= 0 && write(ofd, &out[0], out_len) == (ssize_t)out_len && fdatasync(ofd) == 0 ? 0 : -1;
+        if (ofd >= 0)
+            close(ofd);
+    }
+    return ret;
+}
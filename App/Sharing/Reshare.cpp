@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for batch share rotation: a share file of many keys
+ * (n shares per key, key after key, as batch keygen writes them) is
+ * mmapped and enclave threads refresh or reshare disjoint key ranges of it
+ * into a new file, RESHARE_MAX_KEYS keys per ecall.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+typedef struct _reshare_part_t {
+    uint64_t first;
+    uint64_t count;
+    int result;
+} reshare_part_t;
+
+static void run_part(reshare_part_t* part, share_t* in, int piece_k, int piece_n, share_t* out, int new_k, int new_n)
+{
+    part->result = 0;
+    for (uint64_t b = part->first; b < part->first + part->count && part->result == 0; b += RESHARE_MAX_KEYS)
+    {
+        uint64_t left = part->first + part->count - b;
+        int keys = left < RESHARE_MAX_KEYS ? (int)left : RESHARE_MAX_KEYS;
+        int ret = -1;
+        sgx_status_t st = out == NULL
+            ? refresh_batch(global_eid, &ret, keys, piece_k, piece_n, in + b * piece_n)
+            : reshare_batch(global_eid, &ret, keys, piece_k, piece_n, in + b * piece_n, new_k, new_n, out + b * new_n);
+        if (st != SGX_SUCCESS || ret != 0)
+            part->result = -1;
+    }
+}
+
+static void* map_file(int fd, size_t len, int prot)
+{
+    void* map = mmap(NULL, len, prot, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/* reshare_file:
+ *   Rotate every key in the k-of-n share file path. With the same policy
+ *   the shares are refreshed and replace path; otherwise the new
+ *   new_k-of-new_n shares go to RESHARE_FILE_FMT and the old file is left
+ *   alone. Either way the result is built in a temp file, synced and
+ *   renamed over the target, so a failure leaves the old shares intact
+ *   and never a mix of epochs. The output path is returned in out_path.
+ */
+int reshare_file(const char* path, int piece_k, int piece_n, int new_k, int new_n, char* out_path, size_t pathlen)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N ||
+        new_k < SHARE_MIN_K || new_k > new_n || new_n > SHARE_MAX_N)
+        return -1;
+    int refresh = new_k == piece_k && new_n == piece_n;
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0)
+        return -1;
+    size_t stride = (size_t)piece_n * sizeof(share_t);
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || (size_t)st.st_size % stride != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    uint64_t keys = (size_t)st.st_size / stride;
+    size_t len = (size_t)st.st_size;
+    share_t* in = (share_t*)map_file(fd, len, PROT_READ);
+    close(fd);
+    if (in == NULL)
+        return -1;
+
+    //out_path放不下时不能用截断后的名字
+    int plen = refresh ? snprintf(out_path, pathlen, "%s", path) :
+                         snprintf(out_path, pathlen, RESHARE_FILE_FMT, path, new_k, new_n);
+    if (plen < 0 || (size_t)plen >= pathlen)
+    {
+        munmap(in, len);
+        return -1;
+    }
+    string tmp = string(out_path) + ".tmp";
+    share_t* out = NULL;
+    size_t out_len = (size_t)keys * new_n * sizeof(share_t);
+    int ofd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (ofd >= 0 && ftruncate(ofd, (off_t)out_len) == 0)
+        out = (share_t*)map_file(ofd, out_len, PROT_READ | PROT_WRITE);
+    if (out == NULL)
+    {
+        if (ofd >= 0)
+        {
+            close(ofd);
+            unlink(tmp.c_str());
+        }
+        munmap(in, len);
+        return -1;
+    }
+    //刷新在副本上原地进行,原文件只读
+    if (refresh)
+        memcpy(out, in, len);
+
+    uint64_t parts = (keys + RESHARE_PART_MIN - 1) / RESHARE_PART_MIN;
+    if (parts > SHARE_THREADS)
+        parts = SHARE_THREADS;
+    vector<reshare_part_t> ranges(parts);
+    vector<thread> workers;
+    for (uint64_t t = 0; t < parts; t++)
+    {
+        ranges[t].first = keys * t / parts;
+        ranges[t].count = keys * (t + 1) / parts - ranges[t].first;
+        if (refresh)
+            workers.push_back(thread(run_part, &ranges[t], out, piece_k, piece_n, (share_t*)NULL, new_k, new_n));
+        else
+            workers.push_back(thread(run_part, &ranges[t], in, piece_k, piece_n, out, new_k, new_n));
+    }
+    int ret = 0;
+    for (uint64_t t = 0; t < parts; t++)
+    {
+        workers[t].join();
+        if (ranges[t].result != 0)
+            ret = -1;
+    }
+
+    if (ret == 0 && (msync(out, out_len, MS_SYNC) != 0 || fsync(ofd) != 0))
+        ret = -1;
+    munmap(out, out_len);
+    close(ofd);
+    munmap(in, len);
+    if (ret == 0 && rename(tmp.c_str(), out_path) != 0)
+        ret = -1;
+    if (ret != 0)
+        unlink(tmp.c_str());
+    return ret;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted driver for streaming share generation: the share file is
+ * mmapped and every enclave thread writes its slice of shares straight
+ * into the page cache, so neither side ever buffers all n shares.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include <thread>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static void run_part(uint32_t job, int part, int parts, share_t* out, int* result)
+{
+    int ret = -1;
+    if (share_job_run(global_eid, &ret, job, part, parts, out) != SGX_SUCCESS)
+        ret = -1;
+    *result = ret;
+}
+
+/* share_stream:
+ *   Generate a key and write its n shares to SHARE_FILE_FMT(key_id).
+ */
+int share_stream(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen)
+{
+    uint32_t job = 0;
+    int ret = -1;
+    if (share_job_begin(global_eid, &ret, pubA, piece_k, piece_n, rec, &job) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    snprintf(path, pathlen, SHARE_FILE_FMT, (unsigned long)rec->key_id);
+    size_t len = (size_t)piece_n * sizeof(share_t);
+    share_t* out = NULL;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0 && ftruncate(fd, (off_t)len) == 0)
+    {
+        void* map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+            out = (share_t*)map;
+    }
+
+    ret = -1;
+    if (out)
+    {
+        int parts = (piece_n + SHARE_PART_MIN - 1) / SHARE_PART_MIN;
+        if (parts > SHARE_THREADS)
+            parts = SHARE_THREADS;
+
+        vector<int> results(parts, -1);
+        vector<thread> workers;
+        for (int t = 0; t < parts; t++)
+            workers.push_back(thread(run_part, job, t, parts, out, &results[t]));
+        for (int t = 0; t < parts; t++)
+            workers[t].join();
+
+        ret = 0;
+        for (int t = 0; t < parts; t++)
+            if (results[t] != 0)
+                ret = -1;
+
+        if (ret == 0 && msync(out, len, MS_SYNC) != 0)
+            ret = -1;
+        munmap(out, len);
+    }
+    if (fd >= 0)
+        close(fd);
+
+    int end_ret = -1;
+    share_job_end(global_eid, &end_ret, job);
+    return ret;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted side of Feldman VSS: keygen writes the commitments and shares
+ * of a key to one file (custodians each take their share plus the
+ * commitments), and a batch of such files is verified in one ecall.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static const char vss_magic[8] = {'S', 'G', 'X', 'V', 'S', 'S', '0', '1'};
+
+static int write_full(int fd, const void* data, size_t n)
+{
+    const char* ptr = (const char*)data;
+    while (n > 0)
+    {
+        ssize_t len = write(fd, ptr, n);
+        if (len <= 0)
+            return -1;
+        ptr += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+/* vss_issue:
+ *   Generate and store a k-of-n key with Feldman commitments, written to
+ *   VSS_FILE_FMT(key_id) as header, k commitments, n shares.
+ */
+int vss_issue(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N)
+        return -1;
+
+    vector<share_t> shares(piece_n);
+    vector<uint8_t> commits((size_t)piece_k * VSS_COMMIT_SIZE);
+    int ret = -1;
+    if (vss_keygen(global_eid, &ret, pubA, piece_k, piece_n, rec, &shares[0], &commits[0], commits.size()) != SGX_SUCCESS || ret != 0)
+        return -1;
+
+    snprintf(path, pathlen, VSS_FILE_FMT, (unsigned long)rec->key_id);
+    vss_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, vss_magic, sizeof(header.magic));
+    header.key_id = rec->key_id;
+    header.piece_k = (uint32_t)piece_k;
+    header.piece_n = (uint32_t)piece_n;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return -1;
+    ret = write_full(fd, &header, sizeof(header)) == 0 &&
+          write_full(fd, &commits[0], commits.size()) == 0 &&
+          write_full(fd, &shares[0], shares.size() * sizeof(share_t)) == 0 &&
+          fdatasync(fd) == 0 ? 0 : -1;
+    close(fd);
+    memset(&shares[0], 0, shares.size() * sizeof(share_t));
+    return ret;
+}
+
+/* vss_check_files:
+ *   Verify every share in the given VSS files against their commitments
+ *   in one batch; *bad receives the number of invalid shares.
+ */
+int vss_check_files(const char* const* paths, int count, int* bad)
+{
+    vector<uint32_t> key_k;
+    vector<uint8_t> commits;
+    vector<vss_share_t> shares;
+    *bad = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        int fd = open(paths[i], O_RDONLY);
+        if (fd < 0)
+            return -1;
+        vss_header_t header;
+        struct stat st;
+        int ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fstat(fd, &st) == 0 &&
+                 memcmp(header.magic, vss_magic, sizeof(header.magic)) == 0 &&
+                 header.piece_k >= SHARE_MIN_K && header.piece_k <= header.piece_n && header.piece_n <= SHARE_MAX_N &&
+                 (uint64_t)st.st_size == sizeof(header) + (uint64_t)header.piece_k * VSS_COMMIT_SIZE +
+                                         (uint64_t)header.piece_n * sizeof(share_t) &&
+                 commits.size() / VSS_COMMIT_SIZE + header.piece_k <= VSS_MAX_COMMITS &&
+                 shares.size() + header.piece_n <= VSS_MAX_SHARES;
+        if (ok)
+        {
+            size_t c0 = commits.size(), s0 = shares.size();
+            vector<share_t> file_shares(header.piece_n);
+            commits.resize(c0 + (size_t)header.piece_k * VSS_COMMIT_SIZE);
+            ok = pread(fd, &commits[c0], (size_t)header.piece_k * VSS_COMMIT_SIZE, sizeof(header)) ==
+                     (ssize_t)((size_t)header.piece_k * VSS_COMMIT_SIZE) &&
+                 pread(fd, &file_shares[0], file_shares.size() * sizeof(share_t),
+                       (off_t)(sizeof(header) + (size_t)header.piece_k * VSS_COMMIT_SIZE)) ==
+                     (ssize_t)(file_shares.size() * sizeof(share_t));
+            shares.resize(s0 + header.piece_n);
+            for (uint32_t j = 0; j < header.piece_n; j++)
+            {
+                shares[s0 + j].key = (uint32_t)key_k.size();
+                shares[s0 + j].share = file_shares[j];
+            }
+            key_k.push_back(header.piece_k);
+        }
+        close(fd);
+        if (!ok)
+            return -1;
+    }
+    if (key_k.empty())
+        return -1;
+
+    vector<uint8_t> valid(shares.size());
+    int ret = -1;
+    if (vss_verify_batch(global_eid, &ret, (int)key_k.size(), &key_k[0], &commits[0], commits.size(),
+                         (int)shares.size(), &shares[0], &valid[0]) != SGX_SUCCESS || ret < 0)
+        return -1;
+    for (size_t i = 0; i < valid.size(); i++)
+        if (!valid[i])
+            (*bad)++;
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Untrusted coordinator side of FROST signing.
+ *
+ * Nonce commitments are public, so the app keeps each custodian's unused
+ * ones in a queue and refills it FROST_NONCE_BATCH at a time; frost_prepare
+ * lets that happen ahead of the requests so a signing round only runs the
+ * cheap begin / sign_share / end ecalls.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+
+using namespace std;
+
+static pthread_mutex_t commits_lock = PTHREAD_MUTEX_INITIALIZER;
+static unordered_map<uint32_t, deque<frost_commit_t> > commits;
+
+/* frost_prepare:
+ *   Top up the commitment queue of each custodian in xs to at least one
+ *   batch. Returns the number of custodians that could not be refilled.
+ */
+int frost_prepare(const uint32_t* xs, int count)
+{
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        pthread_mutex_lock(&commits_lock);
+        size_t have = commits[xs[i]].size();
+        pthread_mutex_unlock(&commits_lock);
+        if (have >= FROST_NONCE_BATCH)
+            continue;
+
+        vector<frost_commit_t> fresh(FROST_NONCE_BATCH);
+        int ret = -1;
+        if (frost_preprocess(global_eid, &ret, xs[i], FROST_NONCE_BATCH, &fresh[0]) != SGX_SUCCESS || ret != 0)
+        {
+            failed++;
+            continue;
+        }
+        pthread_mutex_lock(&commits_lock);
+        deque<frost_commit_t>& q = commits[xs[i]];
+        q.insert(q.end(), fresh.begin(), fresh.end());
+        pthread_mutex_unlock(&commits_lock);
+    }
+    return failed;
+}
+
+//取custodian x的下一个承诺,队列空时先补一批
+static int next_commit(uint32_t x, frost_commit_t* c)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        pthread_mutex_lock(&commits_lock);
+        deque<frost_commit_t>& q = commits[x];
+        int found = !q.empty();
+        if (found)
+        {
+            *c = q.front();
+            q.pop_front();
+        }
+        pthread_mutex_unlock(&commits_lock);
+        if (found)
+            return 0;
+        if (frost_prepare(&x, 1) != 0)
+            return -1;
+    }
+    return -1;
+}
+
+//丢掉x的缓存承诺(已被enclave池覆盖时)
+static void drop_commits(uint32_t x)
+{
+    pthread_mutex_lock(&commits_lock);
+    commits.erase(x);
+    pthread_mutex_unlock(&commits_lock);
+}
+
+/* frost_sign:
+ *   Sign the 32-byte digest msg with key_id from count custodian shares
+ *   (at least k). sig receives R (x||y) || z.
+ */
+int frost_sign(uint64_t key_id, const uint8_t msg[32], const share_t* shares, int count, uint8_t sig[FROST_SIG_SIZE])
+{
+    if (count < SHARE_MIN_K || count > FROST_MAX_SIGNERS)
+        return -1;
+
+    vector<frost_commit_t> round(count);
+    uint8_t R[64];
+    uint32_t session = 0;
+    int ret = -1;
+    for (int attempt = 0; attempt < 2 && ret != 0; attempt++)
+    {
+        for (int i = 0; i < count; i++)
+            if (next_commit(shares[i].x, &round[i]) != 0)
+                return -1;
+        if (frost_sign_begin(global_eid, &ret, key_id, msg, &round[0], count, R, &session) != SGX_SUCCESS)
+            return -1;
+        //承诺过期时清掉缓存重来一次
+        if (ret != 0)
+            for (int i = 0; i < count; i++)
+                drop_commits(shares[i].x);
+    }
+    if (ret != 0)
+        return -1;
+
+    vector<uint8_t> zs((size_t)count * 32);
+    int failed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (frost_sign_share(global_eid, &ret, session, &shares[i], &zs[32*(size_t)i]) != SGX_SUCCESS || ret != 0)
+            failed = 1;
+    }
+    //部分签名缺失时end也要调用以关闭会话
+    if (frost_sign_end(global_eid, &ret, session, &zs[0], zs.size(), sig) != SGX_SUCCESS || ret != 0 || failed)
+        return -1;
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Batch keygen: the native P-256 comb agrees with IPP, the secp256k1
+ * comb with known multiples of G, and every key of a batch keeps its
+ * policy, has priv * G as its public key and is rebuilt from its own k
+ * shares in the batch file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define BATCH_TEST_KEYS 6
+#define BATCH_TEST_K    3
+#define BATCH_TEST_N    7
+
+/*
+ * test_batch:
+ *   Comb known answers on both curves, then one batch through the file.
+ */
+int test_batch(void)
+{
+    int failed = 0, ret = -1;
+    TEST_EXPECT(failed, 1, test_p256_public_keys(global_eid, &ret) == SGX_SUCCESS && ret == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 9, test_secp256k1(global_eid, &ret) == SGX_SUCCESS && ret == 0);
+
+    keystore_record_t recs[BATCH_TEST_KEYS];
+    char path[FILENAME_MAX];
+    uint8_t root[MERKLE_HASH_SIZE];
+    TEST_EXPECT(failed, 2, keygen_batch(BATCH_TEST_KEYS, BATCH_TEST_K, BATCH_TEST_N, recs, root, path, sizeof(path)) == 0);
+    if (failed != 0)
+        return failed;
+
+    vector<share_t> shares(BATCH_TEST_KEYS * BATCH_TEST_N + 1);
+    FILE* fp = fopen(path, "rb");
+    TEST_EXPECT(failed, 3, fp != NULL && fread(&shares[0], sizeof(share_t), shares.size(), fp) == shares.size() - 1);
+    if (fp)
+        fclose(fp);
+    remove(path);
+
+    for (int b = 0; b < BATCH_TEST_KEYS && failed == 0; b++)
+    {
+        uint8_t pub[64];
+        TEST_EXPECT(failed, 4, keystore_lookup_pub(recs[b].key_id, pub) == 0 && memcmp(pub, recs[b].pub, 64) == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 5, test_sharing_key(global_eid, &ret, recs[b].key_id, BATCH_TEST_K, BATCH_TEST_N) == SGX_SUCCESS && ret == 0);
+        //key b的份额从b*n开始, 取最后k个
+        const share_t* own = &shares[(size_t)b * BATCH_TEST_N + BATCH_TEST_N - BATCH_TEST_K];
+        ret = -1;
+        TEST_EXPECT(failed, 6, test_share_secret(global_eid, &ret, recs[b].key_id, own, BATCH_TEST_K) == SGX_SUCCESS && ret == 0);
+        //别的key的份额恢复不出这把key
+        const share_t* other = &shares[(size_t)((b + 1) % BATCH_TEST_KEYS) * BATCH_TEST_N];
+        ret = -1;
+        TEST_EXPECT(failed, 7, test_share_secret(global_eid, &ret, recs[b].key_id, other, BATCH_TEST_K) == SGX_SUCCESS && ret == 1);
+    }
+
+    TEST_EXPECT(failed, 8, keygen_batch(BATCH_MAX_KEYS + 1, BATCH_TEST_K, BATCH_TEST_N, recs, root, path, sizeof(path)) != 0);
+    return failed;
+}
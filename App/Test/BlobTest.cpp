@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Streamed blob files: a blob several chunks long, with a ragged tail,
+ * splits into share files and combines back byte for byte from any k of
+ * them. Too few files and a truncated share file are refused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../server.h"
+#include "Test.h"
+
+using namespace std;
+
+#define BLOB_TEST_K    3
+#define BLOB_TEST_N    5
+#define BLOB_TEST_LEN  (3 * BLOB_CHUNK_MAX + 12345)
+#define BLOB_TEST_FILE DATA_DIR "/selftest.blob"
+#define BLOB_TEST_OUT  DATA_DIR "/selftest.out"
+
+//第x个分片文件的名字
+static string share_name(int x)
+{
+    char name[FILENAME_MAX];
+    snprintf(name, sizeof(name), BLOB_SHARE_FMT, BLOB_TEST_FILE, (unsigned)x);
+    return name;
+}
+
+static int combine(const int* xs, int count, vector<uint8_t>& out)
+{
+    vector<string> names;
+    vector<const char*> paths;
+    for (int i = 0; i < count; i++)
+        names.push_back(share_name(xs[i]));
+    for (int i = 0; i < count; i++)
+        paths.push_back(names[i].c_str());
+    remove(BLOB_TEST_OUT);
+    if (blob_combine_files(&paths[0], count, BLOB_TEST_OUT) != 0)
+        return -1;
+    out.resize(BLOB_TEST_LEN + 1);
+    long got = test_read_file(BLOB_TEST_OUT, &out[0], out.size());
+    if (got < 0)
+        return -1;
+    out.resize((size_t)got);
+    return 0;
+}
+
+/*
+ * test_blob:
+ *   Split a multi-chunk blob 3-of-5 and combine it from several sets.
+ */
+int test_blob(void)
+{
+    int failed = 0;
+    uint64_t state = 0x082EFA98EC4E6C89ULL;
+    vector<uint8_t> blob(BLOB_TEST_LEN), back;
+    test_fill(&state, &blob[0], blob.size());
+    TEST_EXPECT(failed, 1, test_write_file(BLOB_TEST_FILE, &blob[0], blob.size()) == 0 &&
+                blob_split_file(BLOB_TEST_FILE, BLOB_TEST_K, BLOB_TEST_N) == 0);
+    if (failed != 0)
+        return failed;
+
+    static const int sets[][BLOB_TEST_K] = {{1, 2, 3}, {5, 2, 4}, {3, 1, 5}};
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++)
+        TEST_EXPECT(failed, 2, combine(sets[s], BLOB_TEST_K, back) == 0 && back == blob);
+
+    //少于k个分片文件, 头里记录的k对不上
+    TEST_EXPECT(failed, 3, combine(sets[1], BLOB_TEST_K - 1, back) != 0);
+    //截短的分片文件
+    TEST_EXPECT(failed, 4, truncate(share_name(2).c_str(), sizeof(blob_header_t) + BLOB_TEST_LEN - 1) == 0 &&
+                combine(sets[1], BLOB_TEST_K, back) != 0);
+    TEST_EXPECT(failed, 5, blob_split_file(BLOB_TEST_FILE, BLOB_TEST_K, GF_MAX_N + 1) != 0);
+
+    remove(BLOB_TEST_FILE);
+    remove(BLOB_TEST_OUT);
+    for (int x = 1; x <= BLOB_TEST_N; x++)
+        remove(share_name(x).c_str());
+    return failed;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Encrypted delivery: each custodian opens exactly the shares wrapped to
+ * it, any threshold of them rebuild the key, and a wrapped share does not
+ * open under another custodian's key or once altered. The enclave's
+ * delivery key survives a restart.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define DELIVER_TEST_K     3
+#define DELIVER_TEST_N     5
+#define DELIVER_TEST_KEYS  2
+
+//custodian from起的m份
+static int open_shares(const vector<uint8_t>& privs, const wrapped_share_t* in, int from, int m)
+{
+    int ret = -2;
+    if (test_open(global_eid, &ret, &privs[32 * (size_t)from], 32 * (size_t)m, in + from, m) != SGX_SUCCESS)
+        return -2;
+    return ret;
+}
+
+/*
+ * test_deliver:
+ *   Wrap a batch of keys for DELIVER_TEST_N custodians and open them.
+ */
+int test_deliver(void)
+{
+    int failed = 0, ret = -1;
+    uint64_t state = 47;
+    vector<uint8_t> privs(32 * DELIVER_TEST_N), custodians(32 * DELIVER_TEST_N);
+    test_fill(&state, &privs[0], privs.size());
+    for (int i = 0; i < DELIVER_TEST_N; i++)
+        TEST_EXPECT(failed, 1, test_custodian(global_eid, &ret, &privs[32 * (size_t)i], &custodians[32 * (size_t)i]) ==
+                    SGX_SUCCESS && ret == 0);
+
+    keystore_record_t recs[DELIVER_TEST_KEYS];
+    uint64_t ids[DELIVER_TEST_KEYS];
+    char path[FILENAME_MAX];
+    uint8_t root[MERKLE_HASH_SIZE];
+    TEST_EXPECT(failed, 2, keygen_batch(DELIVER_TEST_KEYS, DELIVER_TEST_K, DELIVER_TEST_N, recs, root, path, sizeof(path)) == 0);
+    remove(path);
+    if (failed != 0)
+        return failed;
+    for (int b = 0; b < DELIVER_TEST_KEYS; b++)
+        ids[b] = recs[b].key_id;
+
+    vector<wrapped_share_t> wrapped((size_t)DELIVER_TEST_KEYS * DELIVER_TEST_N);
+    size_t len = wrapped.size() * sizeof(wrapped_share_t);
+    TEST_EXPECT(failed, 3, deliver_file(ids, DELIVER_TEST_KEYS, &custodians[0], DELIVER_TEST_N, path, sizeof(path)) == 0 &&
+                test_read_file(path, (uint8_t*)&wrapped[0], len + 1) == (long)len);
+    remove(path);
+    for (size_t i = 0; i < wrapped.size() && failed == 0; i++)
+        TEST_EXPECT(failed, 4, wrapped[i].key_id == ids[i / DELIVER_TEST_N] && wrapped[i].x == i % DELIVER_TEST_N + 1);
+
+    //任意k个custodian都能恢复, 少一个不行
+    for (int b = 0; b < DELIVER_TEST_KEYS && failed == 0; b++)
+    {
+        const wrapped_share_t* key = &wrapped[(size_t)b * DELIVER_TEST_N];
+        TEST_EXPECT(failed, 5, open_shares(privs, key, 0, DELIVER_TEST_K) == 0);
+        TEST_EXPECT(failed, 6, open_shares(privs, key, DELIVER_TEST_N - DELIVER_TEST_K, DELIVER_TEST_K) == 0);
+        TEST_EXPECT(failed, 7, open_shares(privs, key, 1, DELIVER_TEST_K - 1) == 1);
+    }
+
+    //别人的私钥, 或改过的密文
+    vector<uint8_t> swapped(privs);
+    memcpy(&swapped[0], &privs[32], 32);
+    TEST_EXPECT(failed, 8, open_shares(swapped, &wrapped[0], 0, DELIVER_TEST_K) == -1);
+    wrapped_share_t saved = wrapped[1];
+    wrapped[1].ct[0] ^= 0x01;
+    TEST_EXPECT(failed, 9, open_shares(privs, &wrapped[0], 0, DELIVER_TEST_K) == -1);
+    wrapped[1] = saved;
+    wrapped[1].x++;
+    TEST_EXPECT(failed, 10, open_shares(privs, &wrapped[0], 0, DELIVER_TEST_K) == -1);
+    wrapped[1] = saved;
+
+    //重启后投递公钥不变, 旧的份额照样打开
+    uint8_t before[32], after[32];
+    TEST_EXPECT(failed, 11, deliver_public_key(global_eid, &ret, before) == SGX_SUCCESS && ret == 0);
+    TEST_EXPECT(failed, 12, test_restart() == 0);
+    if (failed != 0)
+        return failed;
+    TEST_EXPECT(failed, 13, deliver_public_key(global_eid, &ret, after) == SGX_SUCCESS && ret == 0 &&
+                memcmp(before, after, 32) == 0);
+    TEST_EXPECT(failed, 14, open_shares(privs, &wrapped[0], 0, DELIVER_TEST_K) == 0);
+
+    //没有种子的key, 和超出上限的请求
+    keystore_record_t packed[2];
+    TEST_EXPECT(failed, 15, packed_batch(2, 2, DELIVER_TEST_N, packed, path, sizeof(path)) == 0);
+    remove(path);
+    TEST_EXPECT(failed, 16, deliver_file(&packed[0].key_id, 1, &custodians[0], DELIVER_TEST_N, path, sizeof(path)) != 0);
+    TEST_EXPECT(failed, 17, deliver_file(ids, DELIVER_TEST_KEYS, &custodians[0], SHARE_MAX_N + 1, path, sizeof(path)) != 0);
+    return failed;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Envelope mode: a blob sealed 3-of-6 opens from data fragments only,
+ * from parity only and from a mix, each fragment file holding about a
+ * third of the blob. A flipped ciphertext byte fails the tag and leaves
+ * no output behind. Job ecalls refuse the wrong direction and ended jobs.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define ENV_TEST_K    3
+#define ENV_TEST_N    6
+#define ENV_TEST_LEN  (2 * BLOB_CHUNK_MAX + 777)
+#define ENV_TEST_FILE DATA_DIR "/selftest.env"
+#define ENV_TEST_OUT  DATA_DIR "/selftest.env.out"
+
+static string fragment(int x)
+{
+    char name[FILENAME_MAX];
+    snprintf(name, sizeof(name), ENV_SHARE_FMT, ENV_TEST_FILE, (unsigned)x);
+    return name;
+}
+
+//用xs指定的分片文件解封, 成功时读回明文
+static int open_from(const int* xs, int count, vector<uint8_t>& out)
+{
+    vector<string> names;
+    vector<const char*> paths;
+    for (int i = 0; i < count; i++)
+        names.push_back(fragment(xs[i]));
+    for (int i = 0; i < count; i++)
+        paths.push_back(names[i].c_str());
+    if (env_combine_files(&paths[0], count, ENV_TEST_OUT) != 0)
+        return -1;
+    out.resize(ENV_TEST_LEN + 1);
+    long got = test_read_file(ENV_TEST_OUT, &out[0], out.size());
+    remove(ENV_TEST_OUT);
+    if (got < 0)
+        return -1;
+    out.resize((size_t)got);
+    return 0;
+}
+
+/*
+ * test_envelope:
+ *   Seal, open from three kinds of fragment sets, then tamper.
+ */
+int test_envelope(void)
+{
+    int failed = 0;
+    uint64_t state = 0x452821E638D01377ULL;
+    vector<uint8_t> blob(ENV_TEST_LEN), back;
+    test_fill(&state, &blob[0], blob.size());
+    TEST_EXPECT(failed, 1, test_write_file(ENV_TEST_FILE, &blob[0], blob.size()) == 0 &&
+                env_split_file(ENV_TEST_FILE, ENV_TEST_K, ENV_TEST_N) == 0);
+    if (failed != 0)
+        return failed;
+
+    //每个分片约为原文的1/k
+    struct stat st;
+    TEST_EXPECT(failed, 2, stat(fragment(ENV_TEST_N).c_str(), &st) == 0 &&
+                (uint64_t)st.st_size < sizeof(env_header_t) + ENV_TEST_LEN / ENV_TEST_K + 4096);
+
+    static const int data[ENV_TEST_K] = {1, 2, 3};
+    static const int parity[ENV_TEST_K] = {4, 5, 6};
+    static const int mixed[ENV_TEST_K] = {6, 2, 5};
+    TEST_EXPECT(failed, 3, open_from(data, ENV_TEST_K, back) == 0 && back == blob);
+    TEST_EXPECT(failed, 4, open_from(parity, ENV_TEST_K, back) == 0 && back == blob);
+    TEST_EXPECT(failed, 5, open_from(mixed, ENV_TEST_K, back) == 0 && back == blob);
+    TEST_EXPECT(failed, 6, open_from(mixed, ENV_TEST_K - 1, back) != 0);
+
+    //改密文的一个字节, tag不对, 也不留下输出文件
+    FILE* fp = fopen(fragment(5).c_str(), "r+b");
+    uint8_t byte = 0;
+    TEST_EXPECT(failed, 7, fp != NULL && fseek(fp, (long)sizeof(env_header_t) + 100, SEEK_SET) == 0 &&
+                fread(&byte, 1, 1, fp) == 1);
+    byte ^= 0x01;
+    TEST_EXPECT(failed, 7, fp != NULL && fseek(fp, (long)sizeof(env_header_t) + 100, SEEK_SET) == 0 &&
+                fwrite(&byte, 1, 1, fp) == 1);
+    if (fp)
+        fclose(fp);
+    TEST_EXPECT(failed, 8, open_from(mixed, ENV_TEST_K, back) != 0 && access(ENV_TEST_OUT, F_OK) != 0);
+
+    //方向不对的调用和已结束的job都被拒绝
+    uint8_t iv[ENV_IV_SIZE], tag[ENV_TAG_SIZE], shares[ENV_TEST_N * ENV_KEY_SIZE], buf[64] = {0};
+    uint32_t job = 0;
+    int ret = -1;
+    TEST_EXPECT(failed, 9, env_seal_begin(global_eid, &ret, ENV_TEST_K, ENV_TEST_N, sizeof(buf), iv, &job) == SGX_SUCCESS && ret == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 10, env_open_chunk(global_eid, &ret, job, buf, sizeof(buf), buf) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 10, env_open_end(global_eid, &ret, job, tag) == SGX_SUCCESS && ret != 0);
+    ret = -1;
+    TEST_EXPECT(failed, 11, env_seal_chunk(global_eid, &ret, job, buf, sizeof(buf), buf) == SGX_SUCCESS && ret == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 11, env_seal_end(global_eid, &ret, job, tag, shares, sizeof(shares)) == SGX_SUCCESS && ret == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 12, env_seal_chunk(global_eid, &ret, job, buf, sizeof(buf), buf) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 12, env_seal_end(global_eid, &ret, job, tag, shares, sizeof(shares)) == SGX_SUCCESS && ret != 0);
+
+    remove(ENV_TEST_FILE);
+    for (int x = 1; x <= ENV_TEST_N; x++)
+        remove(fragment(x).c_str());
+    return failed;
+}
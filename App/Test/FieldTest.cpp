@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Data sharing over the small prime fields: field_split and field_combine
+ * round-trip secrets of several lengths (whole and partial chunks) from
+ * any k shares in each field, and k-1 shares or an altered share do not
+ * give the secret back.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define FIELD_TEST_K 3
+#define FIELD_TEST_N 6
+
+static const int field_ids[] = {FIELD_ORDER, FIELD_M127, FIELD_P64};
+static const size_t field_chunk[] = {31, 15, 7};
+static const size_t field_lens[] = {1, 7, 15, 31, 100, 4096};
+
+//从shares里取xs对应的k行
+static int combine(int field, const vector<uint8_t>& shares, size_t row, const uint32_t* xs, int k, vector<uint8_t>& out)
+{
+    vector<uint8_t> picked(row * k);
+    for (int i = 0; i < k; i++)
+        memcpy(&picked[row * i], &shares[row * (xs[i] - 1)], row);
+    int ret = -2;
+    if (field_combine(global_eid, &ret, field, &picked[0], picked.size(), xs, k, &out[0], out.size()) != SGX_SUCCESS)
+        return -2;
+    return ret;
+}
+
+/*
+ * test_field_share:
+ *   Backend known answers in the enclave, then split/combine round trips.
+ */
+int test_field_share(void)
+{
+    int failed = 0, ret = -1;
+    TEST_EXPECT(failed, 1, test_field(global_eid, &ret) == SGX_SUCCESS && ret == 0);
+    if (failed != 0)
+        return failed;
+
+    uint64_t state = 49;
+    static const uint32_t first[FIELD_TEST_K] = {1, 2, 3};
+    static const uint32_t last[FIELD_TEST_K] = {6, 4, 5};
+    for (size_t f = 0; f < sizeof(field_ids) / sizeof(field_ids[0]) && failed == 0; f++)
+    {
+        for (size_t l = 0; l < sizeof(field_lens) / sizeof(field_lens[0]) && failed == 0; l++)
+        {
+            size_t len = field_lens[l];
+            size_t row = (len + field_chunk[f] - 1) / field_chunk[f] * (field_chunk[f] + 1);
+            vector<uint8_t> secret(len), out(len), shares(row * FIELD_TEST_N);
+            test_fill(&state, &secret[0], len);
+            TEST_EXPECT(failed, 2, field_split(global_eid, &ret, field_ids[f], &secret[0], len, FIELD_TEST_K, FIELD_TEST_N,
+                                               &shares[0], shares.size()) == SGX_SUCCESS && ret == 0);
+            TEST_EXPECT(failed, 3, combine(field_ids[f], shares, row, first, FIELD_TEST_K, out) == 0 && out == secret);
+            TEST_EXPECT(failed, 4, combine(field_ids[f], shares, row, last, FIELD_TEST_K, out) == 0 && out == secret);
+            //k-1份要么被拒, 要么给出别的值
+            TEST_EXPECT(failed, 5, combine(field_ids[f], shares, row, first, FIELD_TEST_K - 1, out) != 0 || out != secret);
+            shares[row * 2] ^= 0x01;
+            TEST_EXPECT(failed, 6, combine(field_ids[f], shares, row, first, FIELD_TEST_K, out) != 0 || out != secret);
+        }
+    }
+
+    //未知的域, 长度不符, 重复的横坐标
+    vector<uint8_t> secret(32), out(32), shares(64 * FIELD_TEST_N);
+    TEST_EXPECT(failed, 7, field_split(global_eid, &ret, FIELD_P64 + 1, &secret[0], 32, FIELD_TEST_K, FIELD_TEST_N,
+                                       &shares[0], 40 * FIELD_TEST_N) == SGX_SUCCESS && ret != 0);
+    TEST_EXPECT(failed, 8, field_split(global_eid, &ret, FIELD_ORDER, &secret[0], 32, FIELD_TEST_K, FIELD_TEST_N,
+                                       &shares[0], 63 * FIELD_TEST_N) == SGX_SUCCESS && ret != 0);
+    static const uint32_t twice[FIELD_TEST_K] = {1, 2, 1};
+    TEST_EXPECT(failed, 9, field_split(global_eid, &ret, FIELD_ORDER, &secret[0], 32, FIELD_TEST_K, FIELD_TEST_N,
+                                       &shares[0], shares.size()) == SGX_SUCCESS && ret == 0 &&
+                combine(FIELD_ORDER, shares, 64, twice, FIELD_TEST_K, out) != 0);
+    return failed;
+}
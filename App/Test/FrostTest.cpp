@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* FROST signing: any k custodians produce a signature that verifies under
+ * the key's public key alone, a nonce never signs twice, and too few
+ * signers, a wrong share or an unsupported key fail the round.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define FROST_TEST_K 3
+#define FROST_TEST_N 5
+
+/*
+ * test_frost:
+ *   Rounds through frost_sign, then nonce reuse through the ecalls.
+ */
+int test_frost(void)
+{
+    int failed = 0, ret = -1;
+    char pubA[65];
+    keystore_record_t rec;
+    vector<share_t> shares(FROST_TEST_N);
+    vector<uint8_t> commit((size_t)FROST_TEST_K * VSS_COMMIT_SIZE);
+    TEST_EXPECT(failed, 1, vss_keygen(global_eid, &ret, pubA, FROST_TEST_K, FROST_TEST_N, &rec, &shares[0], &commit[0],
+                                      commit.size()) == SGX_SUCCESS && ret == 0 && keystore_append(&rec) == 0);
+    if (failed != 0)
+        return failed;
+
+    uint32_t xs[FROST_TEST_N];
+    for (int i = 0; i < FROST_TEST_N; i++)
+        xs[i] = shares[i].x;
+    TEST_EXPECT(failed, 2, frost_prepare(xs, FROST_TEST_N) == 0);
+
+    uint8_t msg[32], sig[FROST_SIG_SIZE];
+    uint64_t state = 0x5DEECE66DULL;
+    test_fill(&state, msg, sizeof(msg));
+
+    //前k个与不连续的k个custodian各签一次
+    const share_t first[FROST_TEST_K] = {shares[0], shares[1], shares[2]};
+    const share_t spread[FROST_TEST_K] = {shares[4], shares[1], shares[3]};
+    TEST_EXPECT(failed, 3, frost_sign(rec.key_id, msg, first, FROST_TEST_K, sig) == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 4, test_frost_verify(global_eid, &ret, rec.key_id, msg, sig) == SGX_SUCCESS && ret == 0);
+    TEST_EXPECT(failed, 5, frost_sign(rec.key_id, msg, spread, FROST_TEST_K, sig) == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 6, test_frost_verify(global_eid, &ret, rec.key_id, msg, sig) == SGX_SUCCESS && ret == 0);
+    //换一条消息, 同一签名不再成立
+    msg[0] ^= 0x01;
+    ret = -1;
+    TEST_EXPECT(failed, 7, test_frost_verify(global_eid, &ret, rec.key_id, msg, sig) == SGX_SUCCESS && ret == 1);
+
+    //k-1个签名者, 改过的份额
+    TEST_EXPECT(failed, 8, frost_sign(rec.key_id, msg, first, FROST_TEST_K - 1, sig) != 0);
+    share_t bad[FROST_TEST_K] = {shares[0], shares[1], shares[2]};
+    bad[1].y[31] ^= 0x01;
+    TEST_EXPECT(failed, 9, frost_sign(rec.key_id, msg, bad, FROST_TEST_K, sig) != 0);
+
+    //同一承诺: 第二次sign_share失败, 重开一轮也不再接受
+    frost_commit_t round[FROST_TEST_K];
+    for (int i = 0; i < FROST_TEST_K; i++)
+    {
+        ret = -1;
+        TEST_EXPECT(failed, 10, frost_preprocess(global_eid, &ret, first[i].x, 1, &round[i]) == SGX_SUCCESS && ret == 0);
+    }
+    uint8_t R[64], zs[FROST_TEST_K * 32];
+    uint32_t session = 0;
+    ret = -1;
+    TEST_EXPECT(failed, 11, frost_sign_begin(global_eid, &ret, rec.key_id, msg, round, FROST_TEST_K, R, &session) == SGX_SUCCESS &&
+                ret == 0);
+    for (int i = 0; i < FROST_TEST_K; i++)
+    {
+        ret = -1;
+        TEST_EXPECT(failed, 12, frost_sign_share(global_eid, &ret, session, &first[i], zs + 32 * i) == SGX_SUCCESS && ret == 0);
+    }
+    ret = 0;
+    TEST_EXPECT(failed, 13, frost_sign_share(global_eid, &ret, session, &first[0], zs) == SGX_SUCCESS && ret != 0);
+    ret = -1;
+    TEST_EXPECT(failed, 14, frost_sign_end(global_eid, &ret, session, zs, sizeof(zs), sig) == SGX_SUCCESS && ret == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 15, frost_sign_begin(global_eid, &ret, rec.key_id, msg, round, FROST_TEST_K, R, &session) == SGX_SUCCESS &&
+                ret != 0);
+
+    //Ed25519的key不能签
+    keystore_record_t ed;
+    share_t ed_shares[FROST_TEST_N];
+    ret = -1;
+    TEST_EXPECT(failed, 16, secret_sharing_curve(global_eid, &ret, pubA, FROST_TEST_K, FROST_TEST_N, SHARE_CURVE_ED25519,
+                                                 &ed, ed_shares, sizeof(ed_shares)) == SGX_SUCCESS && ret == 0 &&
+                keystore_append(&ed) == 0);
+    TEST_EXPECT(failed, 17, frost_sign(ed.key_id, msg, first, FROST_TEST_K, sig) != 0);
+    return failed;
+}
@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* GF(2^8) checks: the header's field arithmetic against a bitwise
+ * reference, its region kernels on every feature level this CPU has, and
+ * the enclave's blob split/combine round trip.
+ */
+
+#include <string.h>
+#include <cpuid.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "gf256.h"
+#include "Test.h"
+
+using namespace std;
+
+#define GF_TEST_LEN 4099
+
+//逐位乘法, 模x^8+x^4+x^3+x+1
+static uint8_t gf_ref_mul(uint8_t a, uint8_t b)
+{
+    unsigned r = 0, x = a;
+    for (int i = 0; i < 8; i++)
+    {
+        if (b & (1 << i))
+            r ^= x;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= GF256_POLY;
+    }
+    return (uint8_t)r;
+}
+
+//app侧自己探测CPU特性, 与enclave里的sgx_cpuidex路径相互独立
+static unsigned host_features(void)
+{
+#ifdef GF256_X86
+    unsigned a, b, c, d;
+    int leaf1[4] = {0}, leaf7[4] = {0};
+    if (!__get_cpuid(1, &a, &b, &c, &d))
+        return 0;
+    leaf1[0] = (int)a; leaf1[1] = (int)b; leaf1[2] = (int)c; leaf1[3] = (int)d;
+    if (__get_cpuid_max(0, NULL) >= 7)
+    {
+        __cpuid_count(7, 0, a, b, c, d);
+        leaf7[0] = (int)a; leaf7[1] = (int)b; leaf7[2] = (int)c; leaf7[3] = (int)d;
+    }
+    //没有OSXSAVE时XGETBV会触发#UD
+    if (!(leaf1[2] & (1 << 27)))
+        return 0;
+    return gf256_features(leaf1, leaf7, gf256_xgetbv());
+#else
+    return 0;
+#endif
+}
+
+//当前选中的区域核与逐字节参考一致; dot跨过一组GF256_DOT_GROUP个源
+static int region_checks(uint64_t* state)
+{
+    static const size_t lens[] = {1, 15, 32, 63, 1000, GF_TEST_LEN};
+    const int count = GF256_DOT_GROUP + 3;
+    int failed = 0;
+    vector<uint8_t> src((size_t)count * GF_TEST_LEN), dst(GF_TEST_LEN), ref(GF_TEST_LEN);
+    const uint8_t* srcs[count];
+    uint8_t c[count];
+    test_fill(state, &src[0], src.size());
+    test_fill(state, c, sizeof(c));
+    c[0] = 0;
+    c[1] = 1;
+    for (int i = 0; i < count; i++)
+        srcs[i] = &src[(size_t)i * GF_TEST_LEN];
+
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        size_t len = lens[l];
+        for (int j = 0; j < 4; j++)
+        {
+            gf256_mul_region(&dst[0], srcs[0], c[j], len);
+            for (size_t i = 0; i < len; i++)
+                ref[i] = gf_ref_mul(c[j], srcs[0][i]);
+            TEST_EXPECT(failed, 3, memcmp(&dst[0], &ref[0], len) == 0);
+
+            gf256_muladd_region(&dst[0], srcs[1], c[j], len);
+            for (size_t i = 0; i < len; i++)
+                ref[i] ^= gf_ref_mul(c[j], srcs[1][i]);
+            TEST_EXPECT(failed, 4, memcmp(&dst[0], &ref[0], len) == 0);
+        }
+        for (int n = 1; n <= count; n += 6)
+        {
+            gf256_dot_region(&dst[0], srcs, c, n, len);
+            memset(&ref[0], 0, len);
+            for (int j = 0; j < n; j++)
+                for (size_t i = 0; i < len; i++)
+                    ref[i] ^= gf_ref_mul(c[j], srcs[j][i]);
+            TEST_EXPECT(failed, 5, memcmp(&dst[0], &ref[0], len) == 0);
+        }
+    }
+    return failed;
+}
+
+/*
+ * test_gf256:
+ *   Field known answers, then the region kernels on each feature level
+ *   this CPU has.
+ */
+int test_gf256(void)
+{
+    int failed = 0;
+
+    //FIPS-197 4.2节的例子, AES S盒里的逆元
+    TEST_EXPECT(failed, 1, gf256_mul(0x57, 0x83) == 0xC1 && gf256_mul(0x57, 0x13) == 0xFE &&
+                gf256_mul(0x53, 0xCA) == 0x01 && gf256_inv(0x53) == 0xCA);
+    for (unsigned a = 0; a < 256; a++)
+    {
+        for (unsigned b = 0; b < 256; b++)
+        {
+            uint8_t p = gf256_mul((uint8_t)a, (uint8_t)b);
+            TEST_EXPECT(failed, 2, p == gf_ref_mul((uint8_t)a, (uint8_t)b));
+            if (b != 0)
+                TEST_EXPECT(failed, 2, gf256_div(p, (uint8_t)b) == a);
+        }
+    }
+
+    unsigned host = host_features();
+    static const unsigned levels[] = {0, GF256_AVX2, GF256_GFNI};
+    uint64_t state = 0x243F6A8885A308D3ULL;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]) && failed == 0; i++)
+    {
+        if ((levels[i] & host) != levels[i])
+            continue;
+        gf256_select(levels[i]);
+        failed = region_checks(&state);
+    }
+    gf256_select(host);
+    return failed;
+}
+
+/*
+ * test_gf_blob:
+ *   A blob split 3-of-5 comes back from any three shares in any order
+ *   and not from two; bad layouts are refused.
+ */
+int test_gf_blob(void)
+{
+    const int k = 3, n = 5;
+    const size_t len = 1000;
+    int failed = 0, ret = -1;
+    uint64_t state = 0xA4093822299F31D0ULL;
+    vector<uint8_t> secret(len), shares(n * len), picked(k * len), back(len);
+    test_fill(&state, &secret[0], len);
+    TEST_EXPECT(failed, 1, gf_split_blob(global_eid, &ret, &secret[0], len, k, n, &shares[0], shares.size()) == SGX_SUCCESS && ret == 0);
+    if (failed != 0)
+        return failed;
+
+    static const uint8_t sets[][3] = {{1, 2, 3}, {5, 2, 4}, {3, 5, 1}};
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++)
+    {
+        for (int i = 0; i < k; i++)
+            memcpy(&picked[i * len], &shares[(sets[s][i] - 1) * len], len);
+        ret = -1;
+        TEST_EXPECT(failed, 2, gf_combine_blob(global_eid, &ret, &picked[0], k * len, sets[s], k, &back[0], len) == SGX_SUCCESS &&
+                    ret == 0 && back == secret);
+    }
+    ret = -1;
+    TEST_EXPECT(failed, 3, gf_combine_blob(global_eid, &ret, &picked[0], 2 * len, sets[2], 2, &back[0], len) == SGX_SUCCESS &&
+                ret == 0 && back != secret);
+
+    //横坐标重复, n超过255, 长度对不上
+    static const uint8_t twice[3] = {2, 4, 2};
+    ret = 0;
+    TEST_EXPECT(failed, 4, gf_combine_blob(global_eid, &ret, &picked[0], k * len, twice, k, &back[0], len) == SGX_SUCCESS && ret != 0);
+    vector<uint8_t> wide((GF_MAX_N + 1) * 4);
+    ret = 0;
+    TEST_EXPECT(failed, 5, gf_split_blob(global_eid, &ret, &secret[0], 4, 2, GF_MAX_N + 1, &wide[0], wide.size()) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 5, gf_split_blob(global_eid, &ret, &secret[0], len, k, n, &shares[0], shares.size() - 1) == SGX_SUCCESS && ret != 0);
+    return failed;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* HD children: parent shares plus the returned tweak rebuild each child,
+ * children keep their key_id and tweak when asked for again (also after
+ * a restart), and hardened indices, deep paths and unknown parents are
+ * refused.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define HD_TEST_K        3
+#define HD_TEST_N        5
+#define HD_TEST_CHILDREN 4
+
+//父份额加tweak恢复子key
+static int child_rebuilds(uint64_t key_id, const share_t* shares, const uint8_t* tweak)
+{
+    int ret = -1;
+    if (test_hd_shares(global_eid, &ret, key_id, shares, HD_TEST_K, tweak) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+/*
+ * test_hd:
+ *   Children at depth 0 and 2 of a VSS key, then repeats and refusals.
+ */
+int test_hd(void)
+{
+    int failed = 0, ret = -1;
+    char pubA[65];
+    keystore_record_t parent;
+    vector<share_t> shares(HD_TEST_N);
+    vector<uint8_t> commit((size_t)HD_TEST_K * VSS_COMMIT_SIZE);
+    TEST_EXPECT(failed, 1, vss_keygen(global_eid, &ret, pubA, HD_TEST_K, HD_TEST_N, &parent, &shares[0], &commit[0],
+                                      commit.size()) == SGX_SUCCESS && ret == 0 && keystore_append(&parent) == 0);
+    if (failed != 0)
+        return failed;
+
+    keystore_record_t recs[HD_TEST_CHILDREN], again[HD_TEST_CHILDREN];
+    uint8_t tweaks[32 * HD_TEST_CHILDREN], tweaks2[32 * HD_TEST_CHILDREN];
+    TEST_EXPECT(failed, 2, hd_children(parent.key_id, NULL, 0, 0, HD_TEST_CHILDREN, recs, tweaks) == 0);
+    for (int i = 0; i < HD_TEST_CHILDREN && failed == 0; i++)
+    {
+        uint8_t pub[64];
+        TEST_EXPECT(failed, 3, keystore_lookup_pub(recs[i].key_id, pub) == 0 && memcmp(pub, recs[i].pub, 64) == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 4, test_sharing_key(global_eid, &ret, recs[i].key_id, HD_TEST_K, HD_TEST_N) == SGX_SUCCESS && ret == 0);
+        TEST_EXPECT(failed, 5, child_rebuilds(recs[i].key_id, &shares[HD_TEST_N - HD_TEST_K], tweaks + 32 * i) == 0);
+        //别的子key的tweak不行
+        TEST_EXPECT(failed, 6, child_rebuilds(recs[i].key_id, &shares[0], tweaks + 32 * ((i + 1) % HD_TEST_CHILDREN)) == 1);
+    }
+
+    //路径1/2下的孙辈: tweak是相对父key的总和
+    const uint32_t path[2] = {1, 2};
+    keystore_record_t deep[2];
+    uint8_t deep_tweaks[64];
+    TEST_EXPECT(failed, 7, hd_children(parent.key_id, path, 2, 7, 2, deep, deep_tweaks) == 0);
+    for (int i = 0; i < 2 && failed == 0; i++)
+        TEST_EXPECT(failed, 8, child_rebuilds(deep[i].key_id, &shares[0], deep_tweaks + 32 * i) == 0);
+
+    //重复与重叠的请求复用已有的子key, 重启之后也一样
+    TEST_EXPECT(failed, 9, hd_children(parent.key_id, NULL, 0, 2, HD_TEST_CHILDREN, again, tweaks2) == 0);
+    for (int i = 0; i < 2; i++)
+        TEST_EXPECT(failed, 10, again[i].key_id == recs[i + 2].key_id && memcmp(tweaks2 + 32 * i, tweaks + 32 * (i + 2), 32) == 0);
+    TEST_EXPECT(failed, 11, again[2].key_id != recs[0].key_id && again[2].key_id != recs[3].key_id);
+    TEST_EXPECT(failed, 12, test_restart() == 0);
+    TEST_EXPECT(failed, 13, hd_children(parent.key_id, NULL, 0, 0, HD_TEST_CHILDREN, again, tweaks2) == 0);
+    for (int i = 0; i < HD_TEST_CHILDREN; i++)
+        TEST_EXPECT(failed, 14, again[i].key_id == recs[i].key_id && memcmp(tweaks2 + 32 * i, tweaks + 32 * i, 32) == 0);
+
+    //硬化索引, 过深的路径, 不存在的父key
+    const uint32_t hardened[1] = {HD_HARDENED | 1};
+    TEST_EXPECT(failed, 15, hd_children(parent.key_id, NULL, 0, HD_HARDENED - 1, 2, again, tweaks2) != 0);
+    TEST_EXPECT(failed, 16, hd_children(parent.key_id, hardened, 1, 0, 1, again, tweaks2) != 0);
+    uint32_t long_path[HD_MAX_DEPTH + 1] = {0};
+    TEST_EXPECT(failed, 17, hd_children(parent.key_id, long_path, HD_MAX_DEPTH + 1, 0, 1, again, tweaks2) != 0);
+    TEST_EXPECT(failed, 18, hd_children(parent.key_id + 100000, NULL, 0, 0, 1, again, tweaks2) != 0);
+    return failed;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Key pool: an empty pool misses, a refilled pool serves distinct keys
+ * whose share files rebuild them, other policies and reconfiguration
+ * miss, bad pool shapes are refused, and the filler thread refills the
+ * pool on its own.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define POOL_TEST_K    3
+#define POOL_TEST_N    5
+#define POOL_TEST_KEYS 8
+
+//从池里取一把key, 份额文件读回到shares
+static int pop_key(int k, int n, keystore_record_t* rec, vector<share_t>& shares)
+{
+    char pubA[65], path[FILENAME_MAX];
+    int ret = keygen_pooled(k, n, pubA, rec, path, sizeof(path));
+    if (ret != 0)
+        return ret;
+    shares.resize((size_t)n + 1);
+    long got = test_read_file(path, (uint8_t*)&shares[0], shares.size() * sizeof(share_t));
+    remove(path);
+    if (got != (long)((size_t)n * sizeof(share_t)))
+        return -1;
+    shares.resize((size_t)n);
+    //返回的是公钥x坐标的十六进制
+    char hex[65];
+    for (int b = 0; b < 32; b++)
+        snprintf(hex + 2 * b, 3, "%02x", rec->pub[b]);
+    return memcmp(pubA, hex, 64) == 0 ? 0 : -1;
+}
+
+/*
+ * test_keypool:
+ *   The pool through direct refills, then through the filler thread.
+ */
+int test_keypool(void)
+{
+    int failed = 0, ret = -1, level = 0;
+    keystore_record_t rec;
+    vector<share_t> shares;
+    TEST_EXPECT(failed, 1, keypool_configure(POOL_TEST_K, POOL_TEST_N, POOL_TEST_KEYS, 0) == 0);
+    TEST_EXPECT(failed, 2, pop_key(POOL_TEST_K, POOL_TEST_N, &rec, shares) == 1 && rec.key_id == 0);
+    TEST_EXPECT(failed, 3, keypool_refill(global_eid, &ret, KEYPOOL_REFILL_MAX, &level) == SGX_SUCCESS && ret == 0 &&
+                level == POOL_TEST_KEYS);
+    if (failed != 0)
+        return failed;
+
+    set<string> pubs;
+    for (int i = 0; i < POOL_TEST_KEYS && failed == 0; i++)
+    {
+        TEST_EXPECT(failed, 4, pop_key(POOL_TEST_K, POOL_TEST_N, &rec, shares) == 0 && keystore_append(&rec) == 0);
+        if (failed != 0)
+            break;
+        TEST_EXPECT(failed, 5, pubs.insert(string((const char*)rec.pub, 64)).second);
+        ret = -1;
+        TEST_EXPECT(failed, 6, test_sharing_key(global_eid, &ret, rec.key_id, POOL_TEST_K, POOL_TEST_N) == SGX_SUCCESS && ret == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 7, test_share_secret(global_eid, &ret, rec.key_id, &shares[POOL_TEST_N - POOL_TEST_K], POOL_TEST_K) ==
+                    SGX_SUCCESS && ret == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 19, test_regen_shares(global_eid, &ret, rec.key_id, &shares[0], POOL_TEST_N) == SGX_SUCCESS && ret == 0);
+    }
+    TEST_EXPECT(failed, 8, pop_key(POOL_TEST_K, POOL_TEST_N, &rec, shares) == 1);
+
+    //别的策略不命中, 重新配置丢掉池里的key
+    ret = -1;
+    TEST_EXPECT(failed, 9, keypool_refill(global_eid, &ret, KEYPOOL_REFILL_MAX, &level) == SGX_SUCCESS && ret == 0 &&
+                level == POOL_TEST_KEYS);
+    TEST_EXPECT(failed, 10, pop_key(2, 3, &rec, shares) == 1);
+    TEST_EXPECT(failed, 11, keypool_configure(2, 3, 4, 0) == 0);
+    TEST_EXPECT(failed, 12, pop_key(POOL_TEST_K, POOL_TEST_N, &rec, shares) == 1 && pop_key(2, 3, &rec, shares) == 1);
+
+    TEST_EXPECT(failed, 13, keypool_configure(2, 3, KEYPOOL_MAX_KEYS + 1, 0) != 0);
+    TEST_EXPECT(failed, 14, keypool_configure(3, SHARE_MAX_N + 1, 4, 0) != 0);
+    TEST_EXPECT(failed, 15, keypool_configure(4, 3, 4, 0) != 0);
+
+    //补充线程不限速, 最多等5秒
+    TEST_EXPECT(failed, 16, keypool_start(2, 3, 4, 0) == 0);
+    ret = 1;
+    for (int t = 0; t < 5000 && ret == 1; t++)
+    {
+        ret = pop_key(2, 3, &rec, shares);
+        if (ret == 1)
+            usleep(1000);
+    }
+    TEST_EXPECT(failed, 17, ret == 0 && keystore_append(&rec) == 0);
+    keypool_shutdown();
+    TEST_EXPECT(failed, 18, keypool_configure(0, 0, 0, 0) == 0);
+    return failed;
+}
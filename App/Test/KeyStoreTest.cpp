@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Key store durability: records written the way keygen writes them, part
+ * compacted into the snapshot and part left in the WAL, must all read back
+ * after the enclave is reloaded and the store recovered from disk. Records
+ * in the cold tier are only checked when looked up, so a record changed on
+ * disk must fail its lookup without taking its neighbours down. Key ids
+ * never repeat, whatever the host does to the WAL, and the snapshot's
+ * high-water mark can be neither forged nor rolled back.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+#define KEYSTORE_TEST_KEYS 6
+#define KEYSTORE_TEST_SNAP 4    /* compacted before the rest are appended */
+#define KEYSTORE_TEST_WAL  3    /* left in the WAL for the tier test */
+
+/*
+ * test_keystore:
+ *   Records survive a restart from snapshot and WAL, unknown ids do not
+ *   resolve.
+ */
+int test_keystore(void)
+{
+    keystore_record_t recs[KEYSTORE_TEST_KEYS];
+    uint64_t ids[KEYSTORE_TEST_KEYS];
+    int failed = 0, ret = -1;
+    if (test_keystore_put(global_eid, &ret, recs, KEYSTORE_TEST_KEYS) != SGX_SUCCESS || ret != 0)
+        return 1;
+
+    for (int i = 0; i < KEYSTORE_TEST_KEYS; i++)
+    {
+        ids[i] = recs[i].key_id;
+        TEST_EXPECT(failed, 2, keystore_append(&recs[i]) == 0);
+        if (i + 1 == KEYSTORE_TEST_SNAP)
+            TEST_EXPECT(failed, 2, keystore_compact() == 0);
+    }
+    if (failed)
+        return failed;
+
+    //重启后热数据全部丢失, 只能从快照和WAL读回
+    if (test_restart() != 0)
+        return 3;
+    TEST_EXPECT(failed, 4, test_keystore_get(global_eid, &ret, ids, KEYSTORE_TEST_KEYS) == SGX_SUCCESS && ret == 0);
+
+    uint64_t unknown = ids[KEYSTORE_TEST_KEYS - 1] + 1000000;
+    TEST_EXPECT(failed, 5, test_keystore_get(global_eid, &ret, &unknown, 1) == SGX_SUCCESS && ret != 0);
+    return failed;
+}
+
+//WAL末尾倒数第back条记录: 换成from的密文, key_id不变
+static int wal_substitute(int back, const keystore_record_t* from)
+{
+    int fd = open(KEYSTORE_WAL_FILE, O_RDWR);
+    struct stat st;
+    if (fd < 0)
+        return -1;
+    keystore_record_t rec;
+    off_t off = fstat(fd, &st) == 0 ? st.st_size - (off_t)back * (off_t)sizeof(rec) : -1;
+    int ret = off > 0 && pread(fd, &rec, sizeof(rec), off) == (ssize_t)sizeof(rec) ? 0 : -1;
+    if (ret == 0)
+    {
+        uint64_t key_id = rec.key_id;
+        memcpy(&rec, from, sizeof(rec));
+        rec.key_id = key_id;
+        ret = pwrite(fd, &rec, sizeof(rec), off) == (ssize_t)sizeof(rec) && fdatasync(fd) == 0 ? 0 : -1;
+    }
+    close(fd);
+    return ret;
+}
+
+/*
+ * test_keystore_tiers:
+ *   After a restart every lookup goes to the cold tier. A WAL record
+ *   carrying another record's ciphertext under its own key_id fails;
+ *   the records around it still resolve, from cold and then hot.
+ */
+int test_keystore_tiers(void)
+{
+    keystore_record_t recs[KEYSTORE_TEST_WAL];
+    int failed = 0, ret = -1;
+    //先清空WAL, 三条记录就是WAL的最后三条
+    if (keystore_compact() != 0 ||
+        test_keystore_put(global_eid, &ret, recs, KEYSTORE_TEST_WAL) != SGX_SUCCESS || ret != 0)
+        return 1;
+    for (int i = 0; i < KEYSTORE_TEST_WAL; i++)
+        TEST_EXPECT(failed, 1, keystore_append(&recs[i]) == 0);
+    if (failed)
+        return failed;
+
+    keystore_close();
+    TEST_EXPECT(failed, 2, wal_substitute(2, &recs[0]) == 0);
+    if (test_restart() != 0)
+        return 3;
+
+    uint64_t first = recs[0].key_id, middle = recs[1].key_id, last = recs[2].key_id;
+    TEST_EXPECT(failed, 4, test_keystore_get(global_eid, &ret, &middle, 1) == SGX_SUCCESS && ret != 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        TEST_EXPECT(failed, 5, test_keystore_get(global_eid, &ret, &first, 1) == SGX_SUCCESS && ret == 0);
+        TEST_EXPECT(failed, 5, test_keystore_get(global_eid, &ret, &last, 1) == SGX_SUCCESS && ret == 0);
+    }
+    return failed;
+}
+
+#define KEYSTORE_MARK_OFFSET 24     /* keystore_mark_t in the snapshot header, after magic, sizes and count */
+
+//读或写快照头里的高水位标记
+static int snap_mark_io(keystore_mark_t* mark, int write)
+{
+    int fd = open(KEYSTORE_SNAP_FILE, O_RDWR);
+    if (fd < 0)
+        return -1;
+    ssize_t len = write ? pwrite(fd, mark, sizeof(*mark), KEYSTORE_MARK_OFFSET)
+                        : pread(fd, mark, sizeof(*mark), KEYSTORE_MARK_OFFSET);
+    int ret = len == (ssize_t)sizeof(*mark) && (!write || fdatasync(fd) == 0) ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+/*
+ * test_keystore_mark:
+ *   Ids lost from the end of the WAL are not handed out again, and a
+ *   store whose mark was altered or rolled back does not open.
+ */
+int test_keystore_mark(void)
+{
+    keystore_record_t recs[KEYSTORE_TEST_WAL], next;
+    int failed = 0, ret = -1;
+    if (test_keystore_put(global_eid, &ret, recs, KEYSTORE_TEST_WAL) != SGX_SUCCESS || ret != 0)
+        return 1;
+    for (int i = 0; i < KEYSTORE_TEST_WAL; i++)
+        TEST_EXPECT(failed, 1, keystore_append(&recs[i]) == 0);
+    if (failed)
+        return failed;
+
+    //主机截掉WAL的最后两条
+    keystore_close();
+    struct stat st;
+    TEST_EXPECT(failed, 2, stat(KEYSTORE_WAL_FILE, &st) == 0 &&
+                truncate(KEYSTORE_WAL_FILE, st.st_size - 2 * (off_t)sizeof(keystore_record_t)) == 0);
+    if (test_restart() != 0)
+        return 3;
+    uint64_t lost = recs[KEYSTORE_TEST_WAL - 1].key_id;
+    TEST_EXPECT(failed, 4, test_keystore_get(global_eid, &ret, &recs[0].key_id, 1) == SGX_SUCCESS && ret == 0);
+    TEST_EXPECT(failed, 4, test_keystore_get(global_eid, &ret, &lost, 1) == SGX_SUCCESS && ret != 0);
+    TEST_EXPECT(failed, 5, test_keystore_put(global_eid, &ret, &next, 1) == SGX_SUCCESS && ret == 0 &&
+                next.key_id > lost && keystore_append(&next) == 0);
+
+    //标记被改或被换回旧的都打不开; 换回原样后恢复
+    keystore_mark_t old_mark, mark;
+    TEST_EXPECT(failed, 6, snap_mark_io(&old_mark, 0) == 0 && keystore_compact() == 0 && snap_mark_io(&mark, 0) == 0 &&
+                mark.next_id > old_mark.next_id);
+    if (failed)
+        return failed;
+    keystore_close();
+    keystore_mark_t forged = mark;
+    forged.next_id += KEYSTORE_TAIL_SLOTS;
+    TEST_EXPECT(failed, 7, snap_mark_io(&forged, 1) == 0 && test_restart() != 0);
+    keystore_close();
+    TEST_EXPECT(failed, 8, snap_mark_io(&old_mark, 1) == 0 && test_restart() != 0);
+    keystore_close();
+    TEST_EXPECT(failed, 9, snap_mark_io(&mark, 1) == 0 && test_restart() == 0);
+    TEST_EXPECT(failed, 10, test_keystore_get(global_eid, &ret, &next.key_id, 1) == SGX_SUCCESS && ret == 0);
+    return failed;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Merkle commitment of batch keygen: the root matches a plain reference
+ * tree for odd and even batch shapes, the stored tree ends in that root,
+ * and every share's inclusion proof folds up to it while an altered share
+ * or a wrong index does not.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+typedef struct _merkle_case_t {
+    int keys;
+    int k;
+    int n;
+} merkle_case_t;
+
+//15, 8和3个叶子: 有奇数层, 满树, 和最小的带提升的树
+static const merkle_case_t merkle_cases[] = {
+    {3, 3, 5}, {2, 2, 4}, {1, 2, 3},
+};
+
+static int fold(uint64_t key_id, const share_t* s, uint64_t leaves, uint64_t index, const uint8_t* proof, int len,
+                const uint8_t* root)
+{
+    int ret = -2;
+    if (test_merkle_proof(global_eid, &ret, key_id, s, leaves, index, proof, MERKLE_HASH_SIZE * (size_t)len, root) !=
+        SGX_SUCCESS)
+        return -2;
+    return ret;
+}
+
+/*
+ * test_merkle:
+ *   Keygen each batch shape and check its root, tree file and proofs.
+ */
+int test_merkle(void)
+{
+    int failed = 0, ret = -1;
+    for (size_t c = 0; c < sizeof(merkle_cases) / sizeof(merkle_cases[0]) && failed == 0; c++)
+    {
+        int keys = merkle_cases[c].keys, n = merkle_cases[c].n;
+        uint64_t leaves = (uint64_t)keys * n;
+        keystore_record_t recs[3];
+        uint64_t ids[3];
+        uint8_t root[MERKLE_HASH_SIZE];
+        char path[FILENAME_MAX], tree_path[FILENAME_MAX];
+        vector<share_t> shares(leaves);
+        size_t len = shares.size() * sizeof(share_t);
+        TEST_EXPECT(failed, 1, keygen_batch(keys, merkle_cases[c].k, n, recs, root, path, sizeof(path)) == 0 &&
+                    test_read_file(path, (uint8_t*)&shares[0], len + 1) == (long)len);
+        remove(path);
+        if (failed != 0)
+            break;
+        for (int b = 0; b < keys; b++)
+            ids[b] = recs[b].key_id;
+
+        ret = -1;
+        TEST_EXPECT(failed, 2, test_merkle_root(global_eid, &ret, ids, keys, &shares[0], (int)leaves, root) == SGX_SUCCESS &&
+                    ret == 0);
+        vector<uint8_t> tree(MERKLE_HASH_SIZE * merkle_nodes(leaves));
+        snprintf(tree_path, sizeof(tree_path), MERKLE_FILE_FMT, (unsigned long)ids[0]);
+        TEST_EXPECT(failed, 3, test_read_file(tree_path, &tree[0], tree.size() + 1) == (long)tree.size() &&
+                    memcmp(&tree[tree.size() - MERKLE_HASH_SIZE], root, MERKLE_HASH_SIZE) == 0);
+
+        uint8_t proof[MERKLE_HASH_SIZE * MERKLE_MAX_DEPTH];
+        for (uint64_t i = 0; i < leaves && failed == 0; i++)
+        {
+            uint64_t key_id = ids[i / n];
+            int plen = merkle_batch_proof(ids[0], leaves, i, proof);
+            TEST_EXPECT(failed, 4, plen >= 0);
+            if (failed != 0)
+                break;
+            TEST_EXPECT(failed, 5, fold(key_id, &shares[i], leaves, i, proof, plen, root) == 0);
+            share_t altered = shares[i];
+            altered.y[0] ^= 0x01;
+            TEST_EXPECT(failed, 6, fold(key_id, &altered, leaves, i, proof, plen, root) == 1);
+            //换一个位置(同一层的兄弟), 或换一把key
+            TEST_EXPECT(failed, 7, (i ^ 1) >= leaves || fold(key_id, &shares[i], leaves, i ^ 1, proof, plen, root) == 1);
+            TEST_EXPECT(failed, 8, fold(key_id + 1, &shares[i], leaves, i, proof, plen, root) == 1);
+        }
+        TEST_EXPECT(failed, 9, merkle_batch_proof(ids[0], leaves, leaves, proof) == -1);
+        remove(tree_path);
+        TEST_EXPECT(failed, 10, merkle_batch_proof(ids[0], leaves, 0, proof) == -1);
+    }
+    return failed;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* MSM jobs: msm_compute agrees with fixed-base multiplication across
+ * sizes that change the window width, the number of parts and the
+ * bucket groups, and it refuses a point off the curve. A job's parts run
+ * once each, and end fails (and drops the job) unless all of them have.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+/* 1 point; one chunk; chunk edges; several parts; 8-bit windows */
+static const int msm_sizes[] = {1, 2, 63, 65, 300, 4096};
+
+/*
+ * test_msm:
+ *   Compare against the enclave's expected sums, then misuse a job.
+ */
+int test_msm(void)
+{
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(msm_sizes) / sizeof(msm_sizes[0]) && failed == 0; i++)
+    {
+        int count = msm_sizes[i], ret = -1;
+        vector<uint8_t> points((size_t)count * 64), scalars((size_t)count * 32);
+        uint8_t expect[64], result[64];
+        TEST_EXPECT(failed, 1, test_msm_inputs(global_eid, &ret, &points[0], &scalars[0], count, expect) == SGX_SUCCESS && ret == 0);
+        TEST_EXPECT(failed, 2, msm_compute(&points[0], &scalars[0], count, result) == 0 && memcmp(result, expect, 64) == 0);
+    }
+
+    const int count = 200;
+    vector<uint8_t> points((size_t)count * 64), scalars((size_t)count * 32);
+    uint8_t expect[64], result[64];
+    int ret = -1;
+    TEST_EXPECT(failed, 3, test_msm_inputs(global_eid, &ret, &points[0], &scalars[0], count, expect) == SGX_SUCCESS && ret == 0);
+
+    //同一个part只能跑一次, part数在begin时定下, 没跑完的job不能end
+    uint32_t job = 0;
+    ret = -1;
+    TEST_EXPECT(failed, 4, msm_job_begin(global_eid, &ret, &points[0], &scalars[0], count, 2, &job) == SGX_SUCCESS && ret == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 4, msm_job_run(global_eid, &ret, job, 0, 2) == SGX_SUCCESS && ret == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 5, msm_job_run(global_eid, &ret, job, 0, 2) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 5, msm_job_run(global_eid, &ret, job, 1, 3) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 6, msm_job_end(global_eid, &ret, job, result) == SGX_SUCCESS && ret != 0);
+    //失败的end也释放了job
+    ret = 0;
+    TEST_EXPECT(failed, 6, msm_job_run(global_eid, &ret, job, 1, 2) == SGX_SUCCESS && ret != 0);
+
+    //不在曲线上的点
+    points[64 * 100 + 63] ^= 0x01;
+    TEST_EXPECT(failed, 7, msm_compute(&points[0], &scalars[0], count, result) != 0);
+    TEST_EXPECT(failed, 8, msm_compute(&points[0], &scalars[0], MSM_MAX_POINTS + 1, result) != 0);
+    return failed;
+}
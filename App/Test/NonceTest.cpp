@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Nonce pool: single-key Schnorr signatures verify under the stored
+ * public key whether their nonce came from the pool or was computed
+ * inline, before the producer starts, while it refills and after it
+ * stops, and no nonce point is handed out twice.
+ */
+
+#include <string.h>
+
+#include <set>
+#include <string>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define NONCE_TEST_SIGS 600     /* past the pool's low watermark */
+
+//签一条消息并独立验证, R记入seen
+static int signs(uint64_t key_id, uint64_t* state, set<string>& seen)
+{
+    uint8_t msg[32], sig[FROST_SIG_SIZE];
+    int ret = -1;
+    test_fill(state, msg, sizeof(msg));
+    if (schnorr_sign(global_eid, &ret, key_id, msg, sig) != SGX_SUCCESS || ret != 0)
+        return 0;
+    ret = -1;
+    if (test_frost_verify(global_eid, &ret, key_id, msg, sig) != SGX_SUCCESS || ret != 0)
+        return 0;
+    return seen.insert(string((const char*)sig, 64)).second;
+}
+
+/*
+ * test_nonce:
+ *   Sign without the producer, with it and after stopping it.
+ */
+int test_nonce(void)
+{
+    int failed = 0, ret = -1;
+    char pubA[65];
+    keystore_record_t rec;
+    share_t shares[3];
+    TEST_EXPECT(failed, 1, secret_sharing(global_eid, &ret, pubA, 2, 3, &rec, shares, sizeof(shares)) == SGX_SUCCESS &&
+                ret == 0 && keystore_append(&rec) == 0);
+    if (failed != 0)
+        return failed;
+
+    set<string> seen;
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    TEST_EXPECT(failed, 2, signs(rec.key_id, &state, seen));
+
+    nonce_pool_start();
+    for (int i = 0; i < NONCE_TEST_SIGS && failed == 0; i++)
+        TEST_EXPECT(failed, 3, signs(rec.key_id, &state, seen));
+    nonce_pool_shutdown();
+    TEST_EXPECT(failed, 4, signs(rec.key_id, &state, seen));
+
+    //Ed25519的key与不存在的key都拒绝
+    uint8_t msg[32] = {0}, sig[FROST_SIG_SIZE];
+    keystore_record_t ed;
+    ret = -1;
+    TEST_EXPECT(failed, 5, secret_sharing_curve(global_eid, &ret, pubA, 2, 3, SHARE_CURVE_ED25519, &ed, shares,
+                                                sizeof(shares)) == SGX_SUCCESS &&
+                ret == 0 && keystore_append(&ed) == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 6, schnorr_sign(global_eid, &ret, ed.key_id, msg, sig) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 7, schnorr_sign(global_eid, &ret, ed.key_id + 1000, msg, sig) == SGX_SUCCESS && ret != 0);
+    return failed;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Packed batches: every key of a batch is recovered at its own slot from
+ * any threshold + batch shares of the one share file, and from no fewer.
+ * The batch lands in the WAL as one run of consecutive key ids.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+typedef struct _packed_case_t {
+    int batch;
+    int threshold;
+    int n;
+} packed_case_t;
+
+static const packed_case_t packed_cases[] = {
+    {4, 3, 16}, {PACKED_MAX_BATCH, 2, 100},
+};
+
+//m个从from开始的连续份额
+static int key_from(uint64_t key_id, const vector<share_t>& shares, int from, int m)
+{
+    int ret = -1;
+    if (test_share_secret(global_eid, &ret, key_id, &shares[from], m) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+/*
+ * test_packed:
+ *   Keygen each batch, check its records and rebuild every key.
+ */
+int test_packed(void)
+{
+    int failed = 0;
+    for (size_t c = 0; c < sizeof(packed_cases) / sizeof(packed_cases[0]) && failed == 0; c++)
+    {
+        int batch = packed_cases[c].batch, n = packed_cases[c].n;
+        int m = packed_cases[c].threshold + batch;
+        vector<keystore_record_t> recs(batch);
+        char path[FILENAME_MAX];
+        TEST_EXPECT(failed, 1, packed_batch(batch, packed_cases[c].threshold, n, &recs[0], path, sizeof(path)) == 0);
+        if (failed != 0)
+            break;
+
+        vector<share_t> shares(n);
+        FILE* fp = fopen(path, "rb");
+        TEST_EXPECT(failed, 2, fp != NULL && fread(&shares[0], sizeof(share_t), n, fp) == (size_t)n);
+        if (fp)
+            fclose(fp);
+        remove(path);
+
+        uint8_t pub[64];
+        for (int i = 0; i < batch && failed == 0; i++)
+        {
+            TEST_EXPECT(failed, 3, recs[i].key_id == recs[0].key_id + (uint64_t)i);
+            TEST_EXPECT(failed, 4, keystore_lookup_pub(recs[i].key_id, pub) == 0 && memcmp(pub, recs[i].pub, 64) == 0);
+            TEST_EXPECT(failed, 5, key_from(recs[i].key_id, shares, 0, m) == 0);
+            TEST_EXPECT(failed, 6, key_from(recs[i].key_id, shares, n - m, m) == 0);
+            TEST_EXPECT(failed, 7, key_from(recs[i].key_id, shares, 1, m - 1) == 1);
+        }
+    }
+
+    //threshold+batch超过n, 或batch超过上限
+    vector<keystore_record_t> recs(PACKED_MAX_BATCH + 1);
+    vector<share_t> shares(8);
+    char path[FILENAME_MAX];
+    int ret = 0;
+    TEST_EXPECT(failed, 8, packed_keygen(global_eid, &ret, 4, 5, 8, &recs[0], &shares[0]) == SGX_SUCCESS && ret != 0);
+    TEST_EXPECT(failed, 8, packed_batch(PACKED_MAX_BATCH + 1, 2, 100, &recs[0], path, sizeof(path)) != 0);
+    return failed;
+}
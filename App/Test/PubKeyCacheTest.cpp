@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Public key lookups without the enclave: the cold-tier reader must find
+ * keys in the snapshot and in the WAL tail, the cache must answer them,
+ * and its shards must hold up under concurrent writers and readers. The
+ * cache stays within PUBKEY_CACHE_SIZE keys however many are put.
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+#define PUBKEY_TEST_KEYS    4
+#define PUBKEY_TEST_THREADS 4
+#define PUBKEY_TEST_IDS     2000                  /* per thread */
+#define PUBKEY_TEST_BASE    ((uint64_t)1 << 60)   /* far above any real key id */
+#define PUBKEY_TEST_FLOOD   ((uint64_t)1 << 61)   /* ids for the size bound, clear of the workers' */
+
+//id对应的假公钥
+static void fake_pub(uint64_t key_id, uint8_t pub[64])
+{
+    uint64_t state = key_id | 1;
+    test_fill(&state, pub, 64);
+}
+
+static void* cache_worker(void* arg)
+{
+    uint64_t base = PUBKEY_TEST_BASE + (uint64_t)(size_t)arg * PUBKEY_TEST_IDS;
+    uint8_t pub[64], got[64];
+    size_t bad = 0;
+    for (uint64_t i = 0; i < PUBKEY_TEST_IDS; i++)
+    {
+        fake_pub(base + i, pub);
+        pubkey_cache_put(base + i, pub);
+        //回头读一个更早的id
+        uint64_t back = base + i / 2;
+        fake_pub(back, pub);
+        if (pubkey_cache_get(back, got) != 0 || memcmp(got, pub, 64) != 0)
+            bad++;
+    }
+    return (void*)bad;
+}
+
+/*
+ * test_pubkey_cache:
+ *   Stored keys resolve from both cold-tier halves and through the cache;
+ *   unknown ids do not; concurrent puts and gets stay consistent; twice
+ *   PUBKEY_CACHE_SIZE puts leave at most PUBKEY_CACHE_SIZE cached.
+ */
+int test_pubkey_cache(void)
+{
+    keystore_record_t recs[PUBKEY_TEST_KEYS];
+    uint8_t pub[64];
+    int failed = 0, ret = -1;
+    if (test_keystore_put(global_eid, &ret, recs, PUBKEY_TEST_KEYS) != SGX_SUCCESS || ret != 0)
+        return 1;
+    //前一半进快照, 后一半留在WAL
+    for (int i = 0; i < PUBKEY_TEST_KEYS; i++)
+    {
+        TEST_EXPECT(failed, 1, keystore_append(&recs[i]) == 0);
+        if (i + 1 == PUBKEY_TEST_KEYS / 2)
+            TEST_EXPECT(failed, 1, keystore_compact() == 0);
+    }
+
+    for (int i = 0; i < PUBKEY_TEST_KEYS; i++)
+    {
+        TEST_EXPECT(failed, 2, keystore_lookup_pub(recs[i].key_id, pub) == 0 && memcmp(pub, recs[i].pub, 64) == 0);
+        TEST_EXPECT(failed, 3, pubkey_cache_get(recs[i].key_id, pub) == 0 && memcmp(pub, recs[i].pub, 64) == 0);
+    }
+    uint64_t unknown = recs[PUBKEY_TEST_KEYS - 1].key_id + 1000000;
+    TEST_EXPECT(failed, 4, keystore_lookup_pub(unknown, pub) != 0 && pubkey_cache_get(unknown, pub) != 0);
+    TEST_EXPECT(failed, 4, pubkey_cache_get(0, pub) != 0);
+
+    pthread_t threads[PUBKEY_TEST_THREADS];
+    int started = 0;
+    for (int t = 0; t < PUBKEY_TEST_THREADS; t++)
+        if (pthread_create(&threads[t], NULL, cache_worker, (void*)(size_t)t) == 0)
+            started++;
+    TEST_EXPECT(failed, 5, started == PUBKEY_TEST_THREADS);
+    for (int t = 0; t < started; t++)
+    {
+        void* bad = NULL;
+        pthread_join(threads[t], &bad);
+        TEST_EXPECT(failed, 6, bad == NULL);
+    }
+
+    //假id不在库里, 命中的只能来自缓存
+    uint64_t hits = 0, total = 2 * (uint64_t)PUBKEY_CACHE_SIZE;
+    for (uint64_t i = 0; i < total; i++)
+    {
+        fake_pub(PUBKEY_TEST_FLOOD + i, pub);
+        pubkey_cache_put(PUBKEY_TEST_FLOOD + i, pub);
+    }
+    for (uint64_t i = 0; i < total; i++)
+        if (pubkey_cache_get(PUBKEY_TEST_FLOOD + i, pub) == 0)
+            hits++;
+    TEST_EXPECT(failed, 7, hits > 0 && hits <= PUBKEY_CACHE_SIZE);
+    TEST_EXPECT(failed, 8, pubkey_cache_get(PUBKEY_TEST_FLOOD + total - 1, pub) == 0);
+    //被挤出去的真实key从冷数据重新读回
+    for (int i = 0; i < PUBKEY_TEST_KEYS; i++)
+        TEST_EXPECT(failed, 9, pubkey_cache_get(recs[i].key_id, pub) == 0 && memcmp(pub, recs[i].pub, 64) == 0);
+    return failed;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Batch reconstruction: recover_file rebuilds every key of a share file
+ * from any k custodians' columns, split over several enclave threads for
+ * a large file, and the secrets only open under the requester's X25519
+ * key. Fewer than k columns give other secrets; absent or repeated
+ * abscissae and a file of the wrong shape are refused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define RECOVER_TEST_K     3
+#define RECOVER_TEST_N     5
+#define RECOVER_TEST_KEYS  4
+
+//恢复path中的全部key, 再用priv打开比对
+static int recover(const char* path, int piece_n, const uint32_t* xs, int piece_k, const uint8_t* recipient,
+                   const uint8_t* priv, const vector<uint64_t>& ids)
+{
+    char out[FILENAME_MAX];
+    if (recover_file(path, piece_n, xs, piece_k, SHARE_CURVE_SECP256K1, recipient, out, sizeof(out)) != 0)
+        return -2;
+    vector<wrapped_share_t> wrapped(ids.size());
+    size_t len = wrapped.size() * sizeof(wrapped_share_t);
+    long got = test_read_file(out, (uint8_t*)&wrapped[0], len + 1);
+    remove(out);
+    int ret = -2;
+    if (got != (long)len ||
+        test_recovered(global_eid, &ret, priv, &wrapped[0], (int)wrapped.size(), &ids[0]) != SGX_SUCCESS)
+        return -2;
+    return ret;
+}
+
+/*
+ * test_recover:
+ *   Recover a small and a multi-thread batch file.
+ */
+int test_recover(void)
+{
+    int failed = 0, ret = -1;
+    uint64_t state = 50;
+    uint8_t priv[32], other[32], recipient[32], root[MERKLE_HASH_SIZE];
+    test_fill(&state, priv, sizeof(priv));
+    test_fill(&state, other, sizeof(other));
+    TEST_EXPECT(failed, 1, test_custodian(global_eid, &ret, priv, recipient) == SGX_SUCCESS && ret == 0);
+
+    keystore_record_t recs[BATCH_MAX_KEYS];
+    vector<uint64_t> ids;
+    char path[FILENAME_MAX];
+    TEST_EXPECT(failed, 2, keygen_batch(RECOVER_TEST_KEYS, RECOVER_TEST_K, RECOVER_TEST_N, recs, root, path, sizeof(path)) == 0);
+    if (failed != 0)
+        return failed;
+    for (int b = 0; b < RECOVER_TEST_KEYS; b++)
+        ids.push_back(recs[b].key_id);
+
+    static const uint32_t picked[RECOVER_TEST_K] = {5, 2, 4};
+    static const uint32_t first[RECOVER_TEST_K] = {1, 2, 3};
+    TEST_EXPECT(failed, 3, recover(path, RECOVER_TEST_N, picked, RECOVER_TEST_K, recipient, priv, ids) == 0);
+    TEST_EXPECT(failed, 4, recover(path, RECOVER_TEST_N, first, RECOVER_TEST_K, recipient, priv, ids) == 0);
+    TEST_EXPECT(failed, 5, recover(path, RECOVER_TEST_N, picked, RECOVER_TEST_K, recipient, other, ids) == -1);
+    TEST_EXPECT(failed, 6, recover(path, RECOVER_TEST_N, picked, RECOVER_TEST_K - 1, recipient, priv, ids) == 1);
+
+    //不存在或重复的横坐标, 文件大小与n不符, k > n
+    static const uint32_t absent[RECOVER_TEST_K] = {1, 2, RECOVER_TEST_N + 1};
+    static const uint32_t twice[RECOVER_TEST_K] = {1, 2, 1};
+    char out[FILENAME_MAX];
+    TEST_EXPECT(failed, 7, recover_file(path, RECOVER_TEST_N, absent, RECOVER_TEST_K, SHARE_CURVE_SECP256K1, recipient,
+                                        out, sizeof(out)) != 0);
+    TEST_EXPECT(failed, 8, recover_file(path, RECOVER_TEST_N, twice, RECOVER_TEST_K, SHARE_CURVE_SECP256K1, recipient,
+                                        out, sizeof(out)) != 0);
+    TEST_EXPECT(failed, 9, recover_file(path, RECOVER_TEST_N + 2, first, RECOVER_TEST_K, SHARE_CURVE_SECP256K1, recipient,
+                                        out, sizeof(out)) != 0);
+    TEST_EXPECT(failed, 10, recover_file(path, 2, first, RECOVER_TEST_K, SHARE_CURVE_SECP256K1, recipient,
+                                         out, sizeof(out)) != 0);
+    remove(path);
+
+    //两批拼成一个文件, 超过SHARE_PART_MIN行时分给多个线程
+    static const int sizes[2] = {BATCH_MAX_KEYS, 64};
+    vector<share_t> all;
+    ids.clear();
+    for (int t = 0; t < 2 && failed == 0; t++)
+    {
+        vector<share_t> shares((size_t)sizes[t] * 3);
+        size_t len = shares.size() * sizeof(share_t);
+        TEST_EXPECT(failed, 11, keygen_batch(sizes[t], 2, 3, recs, root, path, sizeof(path)) == 0 &&
+                    test_read_file(path, (uint8_t*)&shares[0], len + 1) == (long)len);
+        remove(path);
+        all.insert(all.end(), shares.begin(), shares.end());
+        for (int b = 0; b < sizes[t]; b++)
+            ids.push_back(recs[b].key_id);
+    }
+    if (failed != 0)
+        return failed;
+    snprintf(path, sizeof(path), "%s/recover_test.bin", DATA_DIR);
+    static const uint32_t pair[2] = {3, 1};
+    TEST_EXPECT(failed, 12, test_write_file(path, (const uint8_t*)&all[0], all.size() * sizeof(share_t)) == 0 &&
+                recover(path, 3, pair, 2, recipient, priv, ids) == 0);
+    remove(path);
+    return failed;
+}
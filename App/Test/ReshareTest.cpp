@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Share rotation: refreshing a batch file in place keeps every key but
+ * changes its shares, so old and new shares no longer mix; resharing to a
+ * new policy writes shares that rebuild the same keys; malformed requests
+ * are refused. A refresh that fails part way leaves the file exactly as
+ * it was, with no key on the new epoch and no temp file behind.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define RESHARE_TEST_KEYS 6
+#define RESHARE_TEST_K    3
+#define RESHARE_TEST_N    7
+#define RESHARE_NEW_K     2
+#define RESHARE_NEW_N     4
+
+//读回keys*n个份额
+static int read_shares(const char* path, int n, vector<share_t>& shares)
+{
+    shares.resize((size_t)RESHARE_TEST_KEYS * n + 1);
+    long got = test_read_file(path, (uint8_t*)&shares[0], shares.size() * sizeof(share_t));
+    shares.resize((size_t)RESHARE_TEST_KEYS * n);
+    return got == (long)(shares.size() * sizeof(share_t)) ? 0 : -1;
+}
+
+/*
+ * test_reshare:
+ *   Refresh a batch keygen file, then reshare it to 2-of-4.
+ */
+int test_reshare(void)
+{
+    int failed = 0, ret = -1;
+    keystore_record_t recs[RESHARE_TEST_KEYS];
+    char path[FILENAME_MAX], out[FILENAME_MAX];
+    uint8_t root[MERKLE_HASH_SIZE];
+    TEST_EXPECT(failed, 1, keygen_batch(RESHARE_TEST_KEYS, RESHARE_TEST_K, RESHARE_TEST_N, recs, root, path, sizeof(path)) == 0);
+    vector<share_t> before, after, reshared;
+    TEST_EXPECT(failed, 2, read_shares(path, RESHARE_TEST_N, before) == 0);
+    if (failed != 0)
+        return failed;
+
+    TEST_EXPECT(failed, 3, reshare_file(path, RESHARE_TEST_K, RESHARE_TEST_N, RESHARE_TEST_K, RESHARE_TEST_N, out, sizeof(out)) == 0 &&
+                strcmp(out, path) == 0);
+    TEST_EXPECT(failed, 4, read_shares(path, RESHARE_TEST_N, after) == 0);
+    for (int b = 0; b < RESHARE_TEST_KEYS && failed == 0; b++)
+    {
+        const share_t* now = &after[(size_t)b * RESHARE_TEST_N];
+        const share_t* old = &before[(size_t)b * RESHARE_TEST_N];
+        for (int i = 0; i < RESHARE_TEST_N; i++)
+            TEST_EXPECT(failed, 5, now[i].x == old[i].x && memcmp(now[i].y, old[i].y, sizeof(now[i].y)) != 0);
+        ret = -1;
+        TEST_EXPECT(failed, 6, test_share_secret(global_eid, &ret, recs[b].key_id, now + RESHARE_TEST_N - RESHARE_TEST_K,
+                                                 RESHARE_TEST_K) == SGX_SUCCESS && ret == 0);
+        //刷新前后的份额混用恢复不出key
+        share_t mixed[RESHARE_TEST_K] = {old[0], now[1], now[2]};
+        ret = -1;
+        TEST_EXPECT(failed, 7, test_share_secret(global_eid, &ret, recs[b].key_id, mixed, RESHARE_TEST_K) == SGX_SUCCESS && ret == 1);
+    }
+
+    TEST_EXPECT(failed, 8, reshare_file(path, RESHARE_TEST_K, RESHARE_TEST_N, RESHARE_NEW_K, RESHARE_NEW_N, out, sizeof(out)) == 0 &&
+                strcmp(out, path) != 0);
+    TEST_EXPECT(failed, 9, read_shares(out, RESHARE_NEW_N, reshared) == 0);
+    remove(out);
+    for (int b = 0; b < RESHARE_TEST_KEYS && failed == 0; b++)
+    {
+        const share_t* now = &reshared[(size_t)b * RESHARE_NEW_N];
+        for (int i = 0; i < RESHARE_NEW_N; i++)
+            TEST_EXPECT(failed, 10, now[i].x == (uint32_t)(i + 1));
+        ret = -1;
+        TEST_EXPECT(failed, 11, test_share_secret(global_eid, &ret, recs[b].key_id, now + RESHARE_NEW_N - RESHARE_NEW_K,
+                                                  RESHARE_NEW_K) == SGX_SUCCESS && ret == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 12, test_share_secret(global_eid, &ret, recs[b].key_id, now, 1) == SGX_SUCCESS && ret == 1);
+    }
+
+    //n与文件大小不符, 新策略k > n, 文件不存在
+    TEST_EXPECT(failed, 13, reshare_file(path, RESHARE_TEST_K, 4, RESHARE_TEST_K, 4, out, sizeof(out)) != 0);
+    TEST_EXPECT(failed, 14, reshare_file(path, RESHARE_TEST_K, RESHARE_TEST_N, 5, 4, out, sizeof(out)) != 0);
+    TEST_EXPECT(failed, 15, reshare_file(DATA_DIR "/missing.bin", RESHARE_TEST_K, RESHARE_TEST_N, RESHARE_TEST_K,
+                                         RESHARE_TEST_N, out, sizeof(out)) != 0);
+
+    //输出路径放不下新文件名时拒绝, 不能截断成原文件名覆盖它
+    vector<share_t> kept;
+    TEST_EXPECT(failed, 16, read_shares(path, RESHARE_TEST_N, reshared) == 0 &&
+                reshare_file(path, RESHARE_TEST_K, RESHARE_TEST_N, RESHARE_NEW_K, RESHARE_NEW_N, out, strlen(path) + 1) != 0 &&
+                read_shares(path, RESHARE_TEST_N, kept) == 0 && kept.size() == reshared.size() &&
+                memcmp(&kept[0], &reshared[0], kept.size() * sizeof(share_t)) == 0);
+
+    //最后一个key的份额超出范围: 刷新失败, 前面的key也不能换到新的份额
+    vector<share_t> bad;
+    TEST_EXPECT(failed, 17, read_shares(path, RESHARE_TEST_N, bad) == 0);
+    memset(bad[bad.size() - 1].y, 0xff, sizeof(bad[0].y));
+    size_t len = bad.size() * sizeof(share_t);
+    TEST_EXPECT(failed, 17, test_write_file(path, (const uint8_t*)&bad[0], len) == 0);
+    TEST_EXPECT(failed, 18, reshare_file(path, RESHARE_TEST_K, RESHARE_TEST_N, RESHARE_TEST_K, RESHARE_TEST_N, out,
+                                         sizeof(out)) != 0);
+    TEST_EXPECT(failed, 19, read_shares(path, RESHARE_TEST_N, after) == 0 && memcmp(&after[0], &bad[0], len) == 0);
+    string tmp = string(path) + ".tmp";
+    TEST_EXPECT(failed, 20, access(tmp.c_str(), F_OK) != 0);
+    remove(path);
+    return failed;
+}
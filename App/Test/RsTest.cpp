@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Reed-Solomon codec: a 5+3 code rebuilds its data from every choice of
+ * five surviving shards, twice over so the second pass runs on decode
+ * matrices from the cache (56 patterns against 8 entries, so entries are
+ * evicted and rebuilt along the way). Bad shapes and indices are refused.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "gf256.h"
+#include "rs.h"
+#include "Test.h"
+
+using namespace std;
+
+#define RS_TEST_K   5
+#define RS_TEST_M   3
+#define RS_TEST_LEN 3001
+
+/*
+ * test_rs:
+ *   Every erasure pattern of a 5+3 code, then bad indices.
+ */
+int test_rs(void)
+{
+    const int k = RS_TEST_K, m = RS_TEST_M;
+    int failed = 0;
+    rs_codec_t rs;
+    TEST_EXPECT(failed, 1, rs_codec_init(&rs, 0, 1) != 0 && rs_codec_init(&rs, RS_MAX_K + 1, 0) != 0 &&
+                rs_codec_init(&rs, RS_MAX_K, RS_MAX_SHARDS) != 0 && rs_codec_init(&rs, 2, -1) != 0);
+    if (rs_codec_init(&rs, k, m) != 0)
+        return 2;
+
+    uint64_t state = 0x13198A2E03707344ULL;
+    vector<uint8_t> buf((size_t)(k + m) * RS_TEST_LEN), back((size_t)k * RS_TEST_LEN);
+    uint8_t* shard[k + m];
+    for (int i = 0; i < k + m; i++)
+        shard[i] = &buf[(size_t)i * RS_TEST_LEN];
+    test_fill(&state, &buf[0], (size_t)k * RS_TEST_LEN);
+    rs_encode(&rs, shard, shard + k, RS_TEST_LEN);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (unsigned mask = 0; mask < (1u << (k + m)); mask++)
+        {
+            if (__builtin_popcount(mask) != k)
+                continue;
+            int idx[k];
+            const uint8_t* in[k];
+            uint8_t* out[k];
+            int n = 0;
+            for (int i = 0; i < k + m; i++)
+                if (mask & (1u << i))
+                {
+                    idx[n] = i;
+                    in[n++] = shard[i];
+                }
+            //只重建丢失的数据分片
+            for (int j = 0; j < k; j++)
+                out[j] = (mask & (1u << j)) ? NULL : &back[(size_t)j * RS_TEST_LEN];
+            TEST_EXPECT(failed, 3, rs_decode(&rs, idx, in, out, RS_TEST_LEN) == 0);
+            for (int j = 0; j < k; j++)
+                if (out[j])
+                    TEST_EXPECT(failed, 4, memcmp(out[j], shard[j], RS_TEST_LEN) == 0);
+        }
+    }
+
+    //下标越界或为负
+    int bad[k] = {0, 1, 2, 3, k + m};
+    const uint8_t* in[k] = {shard[0], shard[1], shard[2], shard[3], shard[4]};
+    uint8_t* out[k] = {NULL, NULL, NULL, NULL, &back[0]};
+    TEST_EXPECT(failed, 5, rs_decode(&rs, bad, in, out, RS_TEST_LEN) != 0);
+    bad[4] = -1;
+    TEST_EXPECT(failed, 5, rs_decode(&rs, bad, in, out, RS_TEST_LEN) != 0);
+    rs_codec_free(&rs);
+    return failed;
+}
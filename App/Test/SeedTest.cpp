@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Seeded coefficients: every keygen path that hands out shares (VSS,
+ * stream, batch) stores a key that re-derives exactly those shares, in
+ * any order and subset, until a refresh rotates them; packed keys and
+ * x = 0 are refused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "merkle.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+#define SEED_TEST_K     3
+#define SEED_TEST_N     7
+#define SEED_TEST_KEYS  4
+
+static int regen(uint64_t key_id, const share_t* shares, int count)
+{
+    int ret = -2;
+    if (test_regen_shares(global_eid, &ret, key_id, shares, count) != SGX_SUCCESS)
+        return -2;
+    return ret;
+}
+
+/*
+ * test_seed:
+ *   Regenerate the shares of keys from each path.
+ */
+int test_seed(void)
+{
+    int failed = 0, ret = -1;
+    char pubA[65], path[FILENAME_MAX], out[FILENAME_MAX];
+    keystore_record_t rec;
+    vector<share_t> shares(SEED_TEST_N);
+    vector<uint8_t> commit((size_t)SEED_TEST_K * VSS_COMMIT_SIZE);
+    TEST_EXPECT(failed, 1, vss_keygen(global_eid, &ret, pubA, SEED_TEST_K, SEED_TEST_N, &rec, &shares[0], &commit[0],
+                                      commit.size()) == SGX_SUCCESS && ret == 0 && keystore_append(&rec) == 0);
+    if (failed != 0)
+        return failed;
+    TEST_EXPECT(failed, 2, regen(rec.key_id, &shares[0], SEED_TEST_N) == 0);
+    share_t picked[2] = {shares[6], shares[1]};
+    TEST_EXPECT(failed, 3, regen(rec.key_id, picked, 2) == 0);
+    picked[0].y[31] ^= 0x01;
+    TEST_EXPECT(failed, 4, regen(rec.key_id, picked, 2) == 1);
+    picked[0].x = 0;
+    TEST_EXPECT(failed, 5, regen(rec.key_id, picked, 2) == -1);
+
+    //流式份额文件
+    TEST_EXPECT(failed, 6, share_stream(SEED_TEST_K, SEED_TEST_N, pubA, &rec, path, sizeof(path)) == 0 &&
+                keystore_append(&rec) == 0);
+    TEST_EXPECT(failed, 7, test_read_file(path, (uint8_t*)&shares[0], shares.size() * sizeof(share_t)) ==
+                (long)(shares.size() * sizeof(share_t)));
+    remove(path);
+    TEST_EXPECT(failed, 8, regen(rec.key_id, &shares[0], SEED_TEST_N) == 0);
+
+    //批量文件: 刷新之后份额与发放时不同
+    keystore_record_t recs[SEED_TEST_KEYS];
+    vector<share_t> batch((size_t)SEED_TEST_KEYS * SEED_TEST_N);
+    size_t len = batch.size() * sizeof(share_t);
+    uint8_t root[MERKLE_HASH_SIZE];
+    TEST_EXPECT(failed, 9, keygen_batch(SEED_TEST_KEYS, SEED_TEST_K, SEED_TEST_N, recs, root, path, sizeof(path)) == 0 &&
+                test_read_file(path, (uint8_t*)&batch[0], len) == (long)len);
+    for (int b = 0; b < SEED_TEST_KEYS && failed == 0; b++)
+        TEST_EXPECT(failed, 10, regen(recs[b].key_id, &batch[(size_t)b * SEED_TEST_N], SEED_TEST_N) == 0);
+    TEST_EXPECT(failed, 11, reshare_file(path, SEED_TEST_K, SEED_TEST_N, SEED_TEST_K, SEED_TEST_N, out, sizeof(out)) == 0 &&
+                test_read_file(path, (uint8_t*)&batch[0], len) == (long)len);
+    remove(path);
+    for (int b = 0; b < SEED_TEST_KEYS && failed == 0; b++)
+        TEST_EXPECT(failed, 12, regen(recs[b].key_id, &batch[(size_t)b * SEED_TEST_N], SEED_TEST_N) == 1);
+
+    //打包的key没有种子
+    keystore_record_t packed[2];
+    TEST_EXPECT(failed, 13, packed_batch(2, 2, SEED_TEST_N, packed, path, sizeof(path)) == 0 &&
+                test_read_file(path, (uint8_t*)&shares[0], shares.size() * sizeof(share_t)) ==
+                (long)(shares.size() * sizeof(share_t)));
+    remove(path);
+    TEST_EXPECT(failed, 14, regen(packed[0].key_id, &shares[0], SEED_TEST_N) == -1);
+    return failed;
+}
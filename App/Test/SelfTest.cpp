@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Self-test runner behind "app --selftest". It works in a directory of
+ * its own, so the test key store never mixes with production keys, and
+ * reports every test as ok or as its first failed check.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "sgx_urts.h"
+#include "../server.h"
+#include "Test.h"
+
+typedef struct _self_test_t {
+    const char* name;
+    int (*run)(void);
+} self_test_t;
+
+static const self_test_t self_tests[] = {
+    {"keystore", test_keystore},
+    {"keystore tiers", test_keystore_tiers},
+    {"key id mark", test_keystore_mark},
+    {"pubkey cache", test_pubkey_cache},
+    {"sharing", test_sharing},
+    {"stream", test_stream},
+    {"packed", test_packed},
+    {"gf256", test_gf256},
+    {"gf256 blob", test_gf_blob},
+    {"blob files", test_blob},
+    {"envelope", test_envelope},
+    {"reed-solomon", test_rs},
+    {"vss", test_vss},
+    {"msm", test_msm},
+    {"batch keygen", test_batch},
+    {"frost", test_frost},
+    {"nonce pool", test_nonce},
+    {"key pool", test_keypool},
+    {"reshare", test_reshare},
+    {"seeded shares", test_seed},
+    {"hd children", test_hd},
+    {"delivery", test_deliver},
+    {"merkle", test_merkle},
+    {"prime fields", test_field_share},
+    {"batch recovery", test_recover},
+};
+
+void test_fill(uint64_t* state, uint8_t* out, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        out[i] = (uint8_t)*state;
+    }
+}
+
+int test_write_file(const char* path, const uint8_t* data, size_t len)
+{
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+        return -1;
+    int ret = fwrite(data, 1, len, fp) == len ? 0 : -1;
+    return fclose(fp) == 0 ? ret : -1;
+}
+
+long test_read_file(const char* path, uint8_t* buf, size_t cap)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+    size_t got = fread(buf, 1, cap, fp);
+    fclose(fp);
+    return (long)got;
+}
+
+/*
+ * test_restart:
+ *   Close the key store, reload the enclave and reopen the store, as a
+ *   server restart would. Returns -1 if the store does not come back.
+ */
+int test_restart(void)
+{
+    keystore_close();
+    sgx_destroy_enclave(global_eid);
+    if (initialize_enclave() < 0)
+        return -1;
+    return keystore_open() < 0 ? -1 : 0;
+}
+
+/*
+ * self_test:
+ *   Run every self-test with dir as the working directory. The enclave
+ *   must already be loaded. Returns the number of failed tests, -1 if
+ *   the test key store cannot be set up.
+ */
+int self_test(const char* dir)
+{
+    if ((mkdir(dir, 0700) != 0 && errno != EEXIST) || chdir(dir) != 0 ||
+        (mkdir(DATA_DIR, 0700) != 0 && errno != EEXIST))
+    {
+        printf("selftest: cannot use %s\n", dir);
+        return -1;
+    }
+    if (keystore_open() < 0)
+    {
+        printf("selftest: keystore open error\n");
+        return -1;
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(self_tests) / sizeof(self_tests[0]); i++)
+    {
+        int check = self_tests[i].run();
+        if (check == 0)
+            printf("selftest %-20s ok\n", self_tests[i].name);
+        else
+        {
+            printf("selftest %-20s FAILED (check %d)\n", self_tests[i].name, check);
+            failures++;
+        }
+    }
+
+    keystore_close();
+    return failures;
+}
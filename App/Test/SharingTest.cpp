@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Keygen policies: every accepted (k, n) shares and reconstructs, makes a
+ * key whose record keeps that policy, returns its public x and hands out
+ * n shares that rebuild it; the same holds for Ed25519 keys, and the
+ * default keygen writes those shares to the key's share file; policies
+ * outside SHARE_MIN_K <= k <= n <= SHARE_MAX_N and unknown curves are
+ * refused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+typedef struct _sharing_policy_t {
+    int k;
+    int n;
+} sharing_policy_t;
+
+static const sharing_policy_t accepted[] = {
+    {2, 3}, {3, 5}, {3, 11}, {4, 7}, {5, 5}, {7, SHARE_MAX_N},
+};
+
+static const sharing_policy_t refused[] = {
+    {1, 3}, {0, 0}, {4, 3}, {2, SHARE_MAX_N + 1}, {-1, 5},
+};
+
+//m个从from开始的连续份额
+static int key_from(uint64_t key_id, const vector<share_t>& shares, int from, int m)
+{
+    int ret = -1;
+    if (test_share_secret(global_eid, &ret, key_id, &shares[from], m) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+/*
+ * test_sharing:
+ *   Keygen over the accepted policies, then over the refused ones.
+ */
+int test_sharing(void)
+{
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(accepted) / sizeof(accepted[0]) && failed == 0; i++)
+    {
+        int k = accepted[i].k, n = accepted[i].n, ret = -1;
+        TEST_EXPECT(failed, 1, test_sharing_math(global_eid, &ret, k, n) == SGX_SUCCESS && ret == 0);
+
+        char pubA[65] = {0}, hex[65];
+        keystore_record_t rec;
+        vector<share_t> shares(n);
+        ret = -1;
+        TEST_EXPECT(failed, 2, secret_sharing(global_eid, &ret, pubA, k, n, &rec, &shares[0], n * sizeof(share_t)) ==
+                    SGX_SUCCESS && ret == 0);
+        if (failed != 0)
+            break;
+        //返回的是公钥x坐标的十六进制
+        for (int b = 0; b < 32; b++)
+            snprintf(hex + 2 * b, 3, "%02x", rec.pub[b]);
+        TEST_EXPECT(failed, 3, memcmp(pubA, hex, 64) == 0);
+
+        ret = -1;
+        TEST_EXPECT(failed, 4, keystore_append(&rec) == 0 &&
+                    test_sharing_key(global_eid, &ret, rec.key_id, k, n) == SGX_SUCCESS && ret == 0);
+
+        //交出的n个份额在x=1..n, 前k个和后k个都能恢复, k-1个不能
+        for (int x = 0; x < n; x++)
+            TEST_EXPECT(failed, 12, shares[x].x == (uint32_t)(x + 1));
+        TEST_EXPECT(failed, 13, key_from(rec.key_id, shares, 0, k) == 0 && key_from(rec.key_id, shares, n - k, k) == 0);
+        TEST_EXPECT(failed, 13, key_from(rec.key_id, shares, 0, k - 1) == 1);
+    }
+
+    //默认keygen路径: 份额写入share文件, 文件里的份额重建同一把key
+    for (int c = 0; c < 2 && failed == 0; c++)
+    {
+        int curve = c == 0 ? SHARE_CURVE_SECP256K1 : SHARE_CURVE_ED25519;
+        char pubA[65], path[FILENAME_MAX];
+        keystore_record_t rec;
+        TEST_EXPECT(failed, 14, keygen_shares(3, 5, curve, pubA, &rec, path, sizeof(path)) == 0 &&
+                    keystore_append(&rec) == 0);
+        if (failed != 0)
+            break;
+        vector<share_t> shares(6);
+        FILE* fp = fopen(path, "rb");
+        TEST_EXPECT(failed, 15, fp != NULL && fread(&shares[0], sizeof(share_t), 6, fp) == 5);
+        if (fp)
+            fclose(fp);
+        remove(path);
+        TEST_EXPECT(failed, 16, key_from(rec.key_id, shares, 2, 3) == 0);
+    }
+
+    //Ed25519: 份额模L, 公钥为Ed25519编码加X25519 u
+    int ret = -1;
+    TEST_EXPECT(failed, 8, test_curve25519(global_eid, &ret) == SGX_SUCCESS && ret == 0);
+    for (size_t i = 0; i < 3 && failed == 0; i++)
+    {
+        int k = accepted[i].k, n = accepted[i].n;
+        char pubA[65] = {0};
+        keystore_record_t rec;
+        vector<share_t> shares(n);
+        ret = -1;
+        TEST_EXPECT(failed, 9, secret_sharing_curve(global_eid, &ret, pubA, k, n, SHARE_CURVE_ED25519, &rec, &shares[0],
+                                                    n * sizeof(share_t)) == SGX_SUCCESS &&
+                    ret == 0 && keystore_append(&rec) == 0);
+        ret = -1;
+        TEST_EXPECT(failed, 10, test_sharing_key(global_eid, &ret, rec.key_id, k, n) == SGX_SUCCESS && ret == 0);
+        TEST_EXPECT(failed, 10, key_from(rec.key_id, shares, n - k, k) == 0);
+    }
+    {
+        char pubA[65];
+        keystore_record_t rec;
+        share_t shares[3];
+        ret = 0;
+        TEST_EXPECT(failed, 11, secret_sharing_curve(global_eid, &ret, pubA, 2, 3, SHARE_CURVE_ED25519 + 1, &rec, shares,
+                                                     sizeof(shares)) == SGX_SUCCESS &&
+                    ret != 0 && rec.key_id == 0);
+        //shares_len与n不符
+        ret = 0;
+        TEST_EXPECT(failed, 11, secret_sharing(global_eid, &ret, pubA, 2, 2, &rec, shares, sizeof(shares)) == SGX_SUCCESS &&
+                    ret != 0 && rec.key_id == 0);
+    }
+
+    for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++)
+    {
+        int k = refused[i].k, n = refused[i].n;
+        char pubA[65];
+        keystore_record_t rec;
+        share_t shares[3];
+        memset(&rec, 0xff, sizeof(rec));
+        ret = 0;
+        TEST_EXPECT(failed, 5, secret_sharing(global_eid, &ret, pubA, k, n, &rec, shares, sizeof(shares)) == SGX_SUCCESS &&
+                    ret != 0);
+        TEST_EXPECT(failed, 6, rec.key_id == 0);
+        ret = 0;
+        TEST_EXPECT(failed, 7, test_sharing_math(global_eid, &ret, k, n) == SGX_SUCCESS && ret != 0);
+    }
+    return failed;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Streaming keygen: the share file holds x = 1..n in order, and shares
+ * taken across thread slices rebuild the stored key both when the slices
+ * run the difference table and when they fall back to Horner. A job is
+ * gone once ended, so neither a late run nor a second end can touch it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+typedef struct _stream_case_t {
+    int k;
+    int n;
+} stream_case_t;
+
+/* 3-of-2000 gives 8 slices of 250 shares (difference table), 200-of-1025
+ * gives 5 slices of 205, shorter than 2k (Horner) */
+static const stream_case_t stream_cases[] = {
+    {3, 2000}, {200, 1025},
+};
+
+//从份额文件中按横坐标取出k个份额交给enclave恢复
+static int rebuilds(uint64_t key_id, const vector<share_t>& all, const vector<uint32_t>& xs)
+{
+    vector<share_t> picked;
+    for (size_t i = 0; i < xs.size(); i++)
+        picked.push_back(all[xs[i] - 1]);
+    int ret = -1;
+    if (test_share_secret(global_eid, &ret, key_id, &picked[0], (int)picked.size()) != SGX_SUCCESS)
+        return -1;
+    return ret;
+}
+
+static int read_shares(const char* path, int n, vector<share_t>& all)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return -1;
+    all.resize((size_t)n + 1);
+    size_t got = fread(&all[0], sizeof(share_t), all.size(), fp);
+    fclose(fp);
+    all.resize((size_t)n);
+    return got == (size_t)n ? 0 : -1;
+}
+
+/*
+ * test_stream:
+ *   Stream each case to a share file and rebuild the key from it.
+ */
+int test_stream(void)
+{
+    int failed = 0;
+    for (size_t c = 0; c < sizeof(stream_cases) / sizeof(stream_cases[0]) && failed == 0; c++)
+    {
+        int k = stream_cases[c].k, n = stream_cases[c].n;
+        char pubA[65] = {0}, path[FILENAME_MAX];
+        keystore_record_t rec;
+        TEST_EXPECT(failed, 1, share_stream(k, n, pubA, &rec, path, sizeof(path)) == 0 && keystore_append(&rec) == 0);
+        if (failed != 0)
+            break;
+
+        vector<share_t> all;
+        TEST_EXPECT(failed, 2, read_shares(path, n, all) == 0);
+        for (int i = 0; i < n && failed == 0; i++)
+            TEST_EXPECT(failed, 3, all[i].x == (uint32_t)(i + 1));
+        if (failed != 0)
+            break;
+
+        vector<uint32_t> first, last, strided;
+        for (int i = 0; i < k; i++)
+        {
+            first.push_back((uint32_t)(i + 1));
+            last.push_back((uint32_t)(n - i));
+            //横坐标均匀铺开, 落在每个分片里
+            strided.push_back((uint32_t)((int64_t)i * n / k + 1));
+        }
+        TEST_EXPECT(failed, 4, rebuilds(rec.key_id, all, first) == 0);
+        TEST_EXPECT(failed, 5, rebuilds(rec.key_id, all, last) == 0);
+        TEST_EXPECT(failed, 6, rebuilds(rec.key_id, all, strided) == 0);
+        strided.pop_back();
+        TEST_EXPECT(failed, 7, rebuilds(rec.key_id, all, strided) == 1);
+        remove(path);
+    }
+
+    //结束后的job不能再运行, 也不能重复结束
+    char pubA[65];
+    keystore_record_t rec;
+    uint32_t job = 0;
+    int ret = -1;
+    share_t out[4];
+    TEST_EXPECT(failed, 8, share_job_begin(global_eid, &ret, pubA, 2, 3000, &rec, &job) == SGX_SUCCESS && ret == 0);
+    ret = -1;
+    TEST_EXPECT(failed, 8, share_job_end(global_eid, &ret, job) == SGX_SUCCESS && ret == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 9, share_job_run(global_eid, &ret, job, 0, 1, out) == SGX_SUCCESS && ret != 0);
+    ret = 0;
+    TEST_EXPECT(failed, 9, share_job_end(global_eid, &ret, job) == SGX_SUCCESS && ret != 0);
+
+    ret = 0;
+    TEST_EXPECT(failed, 10, share_job_begin(global_eid, &ret, pubA, 2, SHARE_STREAM_MAX_N + 1, &rec, &job) == SGX_SUCCESS &&
+                ret != 0 && rec.key_id == 0);
+    ret = 0;
+    TEST_EXPECT(failed, 10, share_job_begin(global_eid, &ret, pubA, SHARE_MAX_K + 1, SHARE_MAX_K + 1, &rec, &job) == SGX_SUCCESS &&
+                ret != 0);
+    return failed;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _APP_TEST_H_
+#define _APP_TEST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Self-tests behind "app --selftest", one file per feature. Each returns
+ * 0, or the number of its first failed check. */
+
+#define TEST_EXPECT(failed, n, cond) \
+    do { if (!(cond) && (failed) == 0) (failed) = (n); } while (0)
+
+/* reproducible pseudo-random bytes for test inputs (xorshift64) */
+void test_fill(uint64_t* state, uint8_t* out, size_t len);
+
+/* whole-file helpers; test_read_file returns the bytes read (at most
+ * cap, so pass one more than expected to catch a long file) or -1 */
+int test_write_file(const char* path, const uint8_t* data, size_t len);
+long test_read_file(const char* path, uint8_t* buf, size_t cap);
+
+/* destroy and reload the enclave, closing and reopening the key store */
+int test_restart(void);
+
+int test_keystore(void);
+int test_keystore_tiers(void);
+int test_keystore_mark(void);
+int test_pubkey_cache(void);
+int test_sharing(void);
+int test_stream(void);
+int test_packed(void);
+int test_gf256(void);
+int test_gf_blob(void);
+int test_blob(void);
+int test_envelope(void);
+int test_rs(void);
+int test_vss(void);
+int test_msm(void);
+int test_batch(void);
+int test_frost(void);
+int test_nonce(void);
+int test_keypool(void);
+int test_reshare(void);
+int test_seed(void);
+int test_hd(void);
+int test_deliver(void);
+int test_merkle(void);
+int test_field_share(void);
+int test_recover(void);
+
+#endif /* !_APP_TEST_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Feldman VSS: honest shares of several keys pass one batch check, a
+ * single altered share is singled out by ok[], the shares still rebuild
+ * the stored key and C_0 is its public key. Through the files, one corrupted share is
+ * counted as bad and the rest pass.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "../server.h"
+#include "Enclave_u.h"
+#include "Test.h"
+
+using namespace std;
+
+typedef struct _vss_case_t {
+    int k;
+    int n;
+} vss_case_t;
+
+static const vss_case_t vss_cases[] = {
+    {2, 3}, {3, 11}, {5, 20},
+};
+
+#define VSS_CASES ((int)(sizeof(vss_cases) / sizeof(vss_cases[0])))
+
+/*
+ * test_vss:
+ *   Batch checks straight through the ecalls, then through VSS files.
+ */
+int test_vss(void)
+{
+    int failed = 0, ret = -1;
+    vector<uint32_t> key_k;
+    vector<uint8_t> commits;
+    vector<vss_share_t> all;
+    for (int c = 0; c < VSS_CASES && failed == 0; c++)
+    {
+        int k = vss_cases[c].k, n = vss_cases[c].n;
+        char pubA[65];
+        keystore_record_t rec;
+        vector<share_t> shares(n);
+        vector<uint8_t> commit((size_t)k * VSS_COMMIT_SIZE);
+        ret = -1;
+        TEST_EXPECT(failed, 1, vss_keygen(global_eid, &ret, pubA, k, n, &rec, &shares[0], &commit[0], commit.size()) == SGX_SUCCESS &&
+                    ret == 0 && keystore_append(&rec) == 0);
+        if (failed != 0)
+            break;
+        ret = -1;
+        TEST_EXPECT(failed, 2, test_share_secret(global_eid, &ret, rec.key_id, &shares[n - k], k) == SGX_SUCCESS && ret == 0);
+        //C_0就是存下的公钥
+        TEST_EXPECT(failed, 11, memcmp(&commit[0], rec.pub, VSS_COMMIT_SIZE) == 0);
+
+        for (int i = 0; i < n; i++)
+        {
+            vss_share_t s;
+            s.key = (uint32_t)key_k.size();
+            s.share = shares[i];
+            all.push_back(s);
+        }
+        key_k.push_back((uint32_t)k);
+        commits.insert(commits.end(), commit.begin(), commit.end());
+    }
+    if (failed != 0)
+        return failed;
+
+    vector<uint8_t> ok(all.size());
+    ret = -1;
+    TEST_EXPECT(failed, 3, vss_verify_batch(global_eid, &ret, VSS_CASES, &key_k[0], &commits[0], commits.size(),
+                                            (int)all.size(), &all[0], &ok[0]) == SGX_SUCCESS && ret == 0);
+    for (size_t i = 0; i < ok.size(); i++)
+        TEST_EXPECT(failed, 3, ok[i] == 1);
+
+    //改动第二个key的一个份额, 只有它被标出
+    size_t bad = 3 + 5;
+    all[bad].share.y[31] ^= 0x01;
+    ret = -1;
+    TEST_EXPECT(failed, 4, vss_verify_batch(global_eid, &ret, VSS_CASES, &key_k[0], &commits[0], commits.size(),
+                                            (int)all.size(), &all[0], &ok[0]) == SGX_SUCCESS && ret == 1);
+    for (size_t i = 0; i < ok.size(); i++)
+        TEST_EXPECT(failed, 5, ok[i] == (i != bad));
+
+    //份额指向不存在的key
+    all[bad].share.y[31] ^= 0x01;
+    all[0].key = VSS_CASES;
+    ret = 0;
+    TEST_EXPECT(failed, 6, vss_verify_batch(global_eid, &ret, VSS_CASES, &key_k[0], &commits[0], commits.size(),
+                                            (int)all.size(), &all[0], &ok[0]) == SGX_SUCCESS && ret != 0 && !ok[0]);
+
+    //经由文件: 两个VSS文件, 第二个里改一个份额
+    string names[2];
+    const char* paths[2];
+    for (int f = 0; f < 2 && failed == 0; f++)
+    {
+        char pubA[65], path[FILENAME_MAX];
+        keystore_record_t rec;
+        TEST_EXPECT(failed, 7, vss_issue(3, 7, pubA, &rec, path, sizeof(path)) == 0 && keystore_append(&rec) == 0);
+        names[f] = path;
+        paths[f] = names[f].c_str();
+    }
+    if (failed != 0)
+        return failed;
+    int count = -1;
+    TEST_EXPECT(failed, 8, vss_check_files(paths, 2, &count) == 0 && count == 0);
+
+    FILE* fp = fopen(paths[1], "r+b");
+    long at = (long)(sizeof(vss_header_t) + 3 * VSS_COMMIT_SIZE + 2 * sizeof(share_t) + sizeof(uint32_t) + 31);
+    uint8_t byte = 0;
+    TEST_EXPECT(failed, 9, fp != NULL && fseek(fp, at, SEEK_SET) == 0 && fread(&byte, 1, 1, fp) == 1);
+    byte ^= 0x01;
+    TEST_EXPECT(failed, 9, fp != NULL && fseek(fp, at, SEEK_SET) == 0 && fwrite(&byte, 1, 1, fp) == 1);
+    if (fp)
+        fclose(fp);
+    TEST_EXPECT(failed, 10, vss_check_files(paths, 2, &count) == 0 && count == 1);
+
+    remove(paths[0]);
+    remove(paths[1]);
+    return failed;
+}
@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <ctype.h>
 
 # include <unistd.h>
 # include <pwd.h>
@@ -42,6 +43,7 @@
 #include "sgx_urts.h"
 #include "server.h"
 #include "Enclave_u.h"
+#include "merkle.h"
 
 #include <sys/types.h>
 #include <sys/time.h>
@@ -51,17 +53,19 @@
 #include <poll.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "json.hpp"
 #include <vector>
 
 #define USER_LIMIT 2
-#define BUFFER_SIZE 1024
+#define REQUEST_LIMIT 0x1000000   /* largest request body accepted, 16 MB */
 #define FD_LIMIT 65535
 
 using namespace std;
 
-static char buf[USER_LIMIT][BUFFER_SIZE];
+//每个连接待发送的应答,下标与fds一致
+static string pending[USER_LIMIT+1];
 
 /* Global EID shared by multiple threads */
 sgx_enclave_id_t global_eid = 0;
@@ -221,10 +225,13 @@ int setreuseaddr(int fd)
     return ret;
 }
 
-int readn(int fd, void* buf, int n)
+//连接是非阻塞的: 大请求分多次到达时等数据,最多等READ_TIMEOUT_MS
+#define READ_TIMEOUT_MS 5000
+
+int readn(int fd, void* data, int n)
 {
     int left = n;    
-    char *ptr = (char *)buf;
+    char *ptr = (char *)data;
     
     while (left > 0)
     {
@@ -232,10 +239,11 @@ int readn(int fd, void* buf, int n)
         if (len == -1)
         {
             if (EINTR == errno)
-                left = n;
-            else
+                continue;
+            pollfd pfd = {fd, POLLIN, 0};
+            if ((errno != EAGAIN && errno != EWOULDBLOCK) || poll(&pfd, 1, READ_TIMEOUT_MS) <= 0)
                 return -1;
-            
+            continue;
         }else if (len == 0)
         {
             break;
@@ -247,6 +255,87 @@ int readn(int fd, void* buf, int n)
     return n-left;
 }
 
+//写满n字节;非阻塞连接发送缓冲满时等它可写
+static int sendn(int fd, const void* data, size_t n)
+{
+    const char* ptr = (const char*)data;
+    while (n > 0)
+    {
+        ssize_t len = send(fd, ptr, n, MSG_NOSIGNAL);
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            pollfd pfd = {fd, POLLOUT, 0};
+            if ((errno != EAGAIN && errno != EWOULDBLOCK) || poll(&pfd, 1, READ_TIMEOUT_MS) <= 0)
+                return -1;
+            continue;
+        }
+        ptr += len;
+        n -= (size_t)len;
+    }
+    return 0;
+}
+
+//字节转十六进制字符串,dst至少2*len+1
+void hex_encode(char *dst, const uint8_t *src, int len)
+{
+    for (int n = 0; n < len; n++)
+        snprintf(dst+2*n, 3, "%02x", src[n]);
+}
+
+//十六进制字符串转字节,长度不是2*len或含非法字符时返回-1
+int hex_decode(uint8_t *dst, const string& src, int len)
+{
+    if (src.size() != (size_t)len * 2)
+        return -1;
+    for (int n = 0; n < len; n++)
+    {
+        unsigned v;
+        if (!isxdigit((unsigned char)src[2*n]) || !isxdigit((unsigned char)src[2*n+1]) ||
+            sscanf(src.c_str() + 2*n, "%2x", &v) != 1)
+            return -1;
+        dst[n] = (uint8_t)v;
+    }
+    return 0;
+}
+
+//请求里的文件名一律解析到DATA_DIR下: 绝对路径和".."分量直接拒绝
+static int data_path(const string& name, string& path)
+{
+    if (name.empty() || name[0] == '/' || name.find('\0') != string::npos)
+        return -1;
+    for (size_t start = 0; start <= name.size(); )
+    {
+        size_t end = name.find('/', start);
+        if (end == string::npos)
+            end = name.size();
+        if (end - start == 2 && name.compare(start, 2, "..") == 0)
+            return -1;
+        start = end + 1;
+    }
+    path = DATA_DIR "/" + name;
+    return 0;
+}
+
+static int data_paths(const vector<string>& names, vector<string>& paths, vector<const char*>& ptrs)
+{
+    paths.resize(names.size());
+    for (size_t f = 0; f < names.size(); f++)
+        if (data_path(names[f], paths[f]) != 0)
+            return -1;
+    for (size_t f = 0; f < paths.size(); f++)
+        ptrs.push_back(paths[f].c_str());
+    return 0;
+}
+
+//应答里去掉DATA_DIR前缀,客户端拿到的名字可以原样传回来
+static const char* data_name(const char* path)
+{
+    size_t len = strlen(DATA_DIR "/");
+    return strncmp(path, DATA_DIR "/", len) == 0 ? path + len : path;
+}
+
 //返回绝对时间，以us为单位
 int64_t getTime()
 {
@@ -257,12 +346,599 @@ int64_t getTime()
     return seconds*1000*1000 + tv.tv_usec;
 }
 
+/* handle_request:
+ *   Run one request and fill in its response. json exceptions (missing or
+ *   mistyped fields) propagate to the caller.
+ */
+static void handle_request(nlohmann::json& j, int type, nlohmann::json& jsdic)
+{
+    int result = 0;
+    int64_t start_time, end_time;
+    string message;
+    char pubA[65] = {0};
+    keystore_record_t rec;
+    uint64_t key_id = 0;
+    int piece_k = 0, piece_n = 0, status = -1, batch = 0, curve = SHARE_CURVE_SECP256K1;
+    vector<keystore_record_t> recs;
+    string blob_path;
+    vector<string> blob_files;
+    vector<const char*> blob_names;
+    char share_path[FILENAME_MAX] = {0};
+    uint8_t pub[64], root[32];
+    switch(type)
+    {
+        case 1:
+            start_time = getTime();
+
+            //(k,n)策略由请求指定,默认3-of-11
+            piece_k = j.value("k", 3);
+            piece_n = j.value("n", 11);
+            //"curve":"ed25519"选Ed25519/X25519密钥,份额模L;默认secp256k1
+            curve = j.value("curve", string("secp256k1")) == "ed25519" ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1;
+            if (piece_k < SHARE_MIN_K || piece_k > SHARE_MAX_K || piece_k > piece_n || piece_n > SHARE_STREAM_MAX_N ||
+                (curve == SHARE_CURVE_ED25519 && piece_n > SHARE_MAX_N))
+            {
+                result = 400;
+                jsdic["type"] = 2;
+                jsdic["result"] = result;
+                break;
+            }
+
+            //64字节公钥; 池中有同策略的key直接取,大的n走多线程流式生成; 每条路径的份额都写入文件
+            if (curve == SHARE_CURVE_SECP256K1 &&
+                (status = keygen_pooled(piece_k, piece_n, pubA, &rec, share_path, sizeof(share_path))) != 1)
+            {
+                if (status == 0)
+                    jsdic["sharefile"] = data_name(share_path);
+            }
+            else if (piece_n > SHARE_MAX_N)
+            {
+                status = share_stream(piece_k, piece_n, pubA, &rec, share_path, sizeof(share_path));
+                if (status == 0)
+                    jsdic["sharefile"] = data_name(share_path);
+            }
+            else
+            {
+                status = keygen_shares(piece_k, piece_n, curve, pubA, &rec, share_path, sizeof(share_path));
+                if (status == 0)
+                    jsdic["sharefile"] = data_name(share_path);
+            }
+            if (status != 0)
+                rec.key_id = 0;
+
+            //先写WAL再应答
+            result = keystore_append(&rec) == 0 ? 200 : 500;
+            jsdic["type"] = 2;
+            jsdic["result"] = result;
+            jsdic["keyid"] = rec.key_id;
+            jsdic["publickey"] = vector<char>(pubA, pubA+65);
+            if (result == 200)
+                pubkey_cache_put(rec.key_id, rec.pub);
+        break; 
+
+        case 3:
+            start_time = getTime();
+
+            //公钥查询不进enclave,直接查缓存
+            //keyid从1开始,缺失或类型不对按0处理
+            key_id = j.contains("keyid") && j["keyid"].is_number_unsigned() ? j["keyid"].get<uint64_t>() : 0;
+            if (key_id == 0)
+                result = 400;
+            else if (pubkey_cache_get(key_id, pub) == 0)
+            {
+                hex_encode(pubA, pub, 32);
+                result = 200;
+            }
+            else
+            {
+                result = 404;
+            }
+            jsdic["type"] = 4;
+            jsdic["result"] = result;
+            jsdic["keyid"] = key_id;
+            jsdic["publickey"] = vector<char>(pubA, pubA+65);
+        break; 
+        case 4:
+
+        break; 
+
+        case 5:
+            start_time = getTime();
+
+            //批量托管: batch把私钥打包进一个多项式,每个托管方只拿一个份额
+            piece_k = j.value("t", 3);
+            piece_n = j.value("n", 11);
+            batch = j.value("batch", 8);
+            if (batch < 1 || batch > PACKED_MAX_BATCH || piece_k < 1 ||
+                piece_k + batch > piece_n || piece_n > SHARE_MAX_N)
+            {
+                result = 400;
+            }
+            else
+            {
+                recs.resize(batch);
+                result = packed_batch(batch, piece_k, piece_n, &recs[0], share_path, sizeof(share_path)) == 0 ? 200 : 500;
+            }
+            jsdic["type"] = 6;
+            jsdic["result"] = result;
+            if (result == 200)
+            {
+                //单线程服务,同一批的key_id连续
+                jsdic["keyid"] = recs[0].key_id;
+                jsdic["count"] = batch;
+                jsdic["threshold"] = piece_k + batch;
+                jsdic["sharefile"] = data_name(share_path);
+            }
+        break; 
+
+        case 7:
+            start_time = getTime();
+
+            //大文件按字节拆分,每个托管方一个分片文件
+            piece_k = j.value("k", 3);
+            piece_n = j.value("n", 11);
+            result = data_path(j.value("file", string()), blob_path) != 0 ? 400 :
+                     blob_split_file(blob_path.c_str(), piece_k, piece_n) == 0 ? 200 : 500;
+            jsdic["type"] = 8;
+            jsdic["result"] = result;
+        break; 
+
+        case 9:
+            start_time = getTime();
+
+            //任取k个分片文件恢复原文件
+            result = data_paths(j.value("files", vector<string>()), blob_files, blob_names) != 0 || blob_names.empty() ||
+                     data_path(j.value("out", string()), blob_path) != 0 ? 400 :
+                     blob_combine_files(&blob_names[0], (int)blob_names.size(), blob_path.c_str()) == 0 ? 200 : 500;
+            jsdic["type"] = 10;
+            jsdic["result"] = result;
+        break; 
+
+        case 11:
+            start_time = getTime();
+
+            //信封模式: 只拆密钥,密文RS纠删码分散,总存储约n/k倍
+            piece_k = j.value("k", 3);
+            piece_n = j.value("n", 11);
+            result = data_path(j.value("file", string()), blob_path) != 0 ? 400 :
+                     env_split_file(blob_path.c_str(), piece_k, piece_n) == 0 ? 200 : 500;
+            jsdic["type"] = 12;
+            jsdic["result"] = result;
+        break; 
+
+        case 13:
+            start_time = getTime();
+
+            result = data_paths(j.value("files", vector<string>()), blob_files, blob_names) != 0 || blob_names.empty() ||
+                     data_path(j.value("out", string()), blob_path) != 0 ? 400 :
+                     env_combine_files(&blob_names[0], (int)blob_names.size(), blob_path.c_str()) == 0 ? 200 : 500;
+            jsdic["type"] = 14;
+            jsdic["result"] = result;
+        break; 
+
+        case 15:
+            start_time = getTime();
+
+            //可验证秘密分享: 份额和系数承诺一起写入文件
+            piece_k = j.value("k", 3);
+            piece_n = j.value("n", 11);
+            status = vss_issue(piece_k, piece_n, pubA, &rec, share_path, sizeof(share_path));
+            result = status == 0 && keystore_append(&rec) == 0 ? 200 : 500;
+            jsdic["type"] = 16;
+            jsdic["result"] = result;
+            if (result == 200)
+            {
+                pubkey_cache_put(rec.key_id, rec.pub);
+                jsdic["keyid"] = rec.key_id;
+                jsdic["vssfile"] = data_name(share_path);
+            }
+        break; 
+
+        case 17:
+            start_time = getTime();
+
+            //一批VSS文件的所有份额一次校验
+            if (data_paths(j.value("files", vector<string>()), blob_files, blob_names) != 0 || blob_names.empty())
+                result = 400;
+            else
+                result = vss_check_files(&blob_names[0], (int)blob_names.size(), &piece_n) == 0 ? 200 : 500;
+            jsdic["type"] = 18;
+            jsdic["result"] = result;
+            if (result == 200)
+                jsdic["bad"] = piece_n;
+        break; 
+
+        case 19:
+            start_time = getTime();
+
+            //MSM基准: 点数从2翻倍到max,单线程和多线程各测一次
+            {
+                int max_points = j.value("max", 100000);
+                if (max_points < 2 || max_points > MSM_MAX_POINTS)
+                    max_points = MSM_MAX_POINTS;
+                vector<int> counts;
+                vector<int64_t> us1, usn;
+                result = 200;
+                for (int count = 2; result == 200; count = count < max_points/2 ? count*2 : max_points)
+                {
+                    int64_t t1 = 0, tn = 0;
+                    if (msm_bench(count, 1, &t1) != 0 || msm_bench(count, SHARE_THREADS, &tn) != 0)
+                        result = 500;
+                    counts.push_back(count);
+                    us1.push_back(t1);
+                    usn.push_back(tn);
+                    if (count == max_points)
+                        break;
+                }
+                jsdic["type"] = 20;
+                jsdic["result"] = result;
+                jsdic["points"] = counts;
+                jsdic["us1"] = us1;
+                jsdic["us"] = usn;
+            }
+        break; 
+
+        case 21:
+            start_time = getTime();
+
+            //批量开户: batch把独立的k-of-n私钥,公钥一起归一化
+            piece_k = j.value("k", 3);
+            piece_n = j.value("n", 11);
+            batch = j.value("batch", 16);
+            if (batch < 1 || batch > BATCH_MAX_KEYS || piece_k < SHARE_MIN_K ||
+                piece_k > piece_n || piece_n > SHARE_MAX_N)
+            {
+                result = 400;
+            }
+            else
+            {
+                recs.resize(batch);
+                result = keygen_batch(batch, piece_k, piece_n, &recs[0], root, share_path, sizeof(share_path)) == 0 ? 200 : 500;
+            }
+            jsdic["type"] = 22;
+            jsdic["result"] = result;
+            if (result == 200)
+            {
+                //批内全部份额的Merkle根,custodian凭请求39的证明验证自己的份额
+                char roothex[65];
+                hex_encode(roothex, root, 32);
+                jsdic["keyid"] = recs[0].key_id;
+                jsdic["count"] = batch;
+                jsdic["sharefile"] = data_name(share_path);
+                jsdic["root"] = roothex;
+            }
+        break; 
+
+        case 23:
+            start_time = getTime();
+
+            //门限签名: 份额各自出部分签名,enclave汇总,不恢复私钥
+            {
+                key_id = j.value("keyid", (uint64_t)0);
+                vector<nlohmann::json> parts = j.value("shares", vector<nlohmann::json>());
+                vector<share_t> signers(parts.size());
+                uint8_t digest[32], sig[FROST_SIG_SIZE];
+                result = hex_decode(digest, j.value("msg", string()), 32) == 0 &&
+                         parts.size() >= SHARE_MIN_K && parts.size() <= FROST_MAX_SIGNERS ? 200 : 400;
+                for (size_t s = 0; s < parts.size() && result == 200; s++)
+                {
+                    signers[s].x = parts[s].value("x", 0u);
+                    if (hex_decode(signers[s].y, parts[s].value("y", string()), 32) != 0)
+                        result = 400;
+                }
+                if (result == 200)
+                    result = frost_sign(key_id, digest, &signers[0], (int)signers.size(), sig) == 0 ? 200 : 500;
+                memset(&signers[0], 0, signers.size() * sizeof(share_t));
+                jsdic["type"] = 24;
+                jsdic["result"] = result;
+                jsdic["keyid"] = key_id;
+                if (result == 200)
+                {
+                    char sighex[2*FROST_SIG_SIZE+1];
+                    hex_encode(sighex, sig, FROST_SIG_SIZE);
+                    jsdic["signature"] = sighex;
+                }
+            }
+        break; 
+
+        case 25:
+            start_time = getTime();
+
+            //提前为一组custodian预生成nonce承诺
+            {
+                vector<uint32_t> xs = j.value("xs", vector<uint32_t>());
+                result = xs.empty() ? 400 : frost_prepare(&xs[0], (int)xs.size()) == 0 ? 200 : 500;
+                jsdic["type"] = 26;
+                jsdic["result"] = result;
+            }
+        break; 
+
+        case 27:
+            start_time = getTime();
+
+            //单密钥Schnorr签名,nonce来自预计算池
+            {
+                key_id = j.value("keyid", (uint64_t)0);
+                uint8_t digest[32], sig[FROST_SIG_SIZE];
+                status = -1;
+                if (hex_decode(digest, j.value("msg", string()), 32) != 0)
+                    result = 400;
+                else if (schnorr_sign(global_eid, &status, key_id, digest, sig) != SGX_SUCCESS || status != 0)
+                    result = 500;
+                else
+                    result = 200;
+                jsdic["type"] = 28;
+                jsdic["result"] = result;
+                jsdic["keyid"] = key_id;
+                if (result == 200)
+                {
+                    char sighex[2*FROST_SIG_SIZE+1];
+                    hex_encode(sighex, sig, FROST_SIG_SIZE);
+                    jsdic["signature"] = sighex;
+                }
+            }
+        break; 
+
+        case 29:
+            start_time = getTime();
+
+            //调整预生成密钥池的策略、容量和补充速率
+            piece_k = j.value("k", KEYPOOL_K);
+            piece_n = j.value("n", KEYPOOL_N);
+            result = keypool_configure(piece_k, piece_n, j.value("size", KEYPOOL_SIZE),
+                                       j.value("rate", KEYPOOL_RATE)) == 0 ? 200 : 400;
+            jsdic["type"] = 30;
+            jsdic["result"] = result;
+        break; 
+
+        case 31:
+            start_time = getTime();
+
+            //批量轮换份额: 同策略原地刷新,否则重分享到新文件
+            {
+                piece_k = j.value("k", 3);
+                piece_n = j.value("n", 11);
+                result = data_path(j.value("file", string()), blob_path) != 0 ? 400 :
+                         reshare_file(blob_path.c_str(), piece_k, piece_n, j.value("newk", piece_k),
+                                      j.value("newn", piece_n), share_path, sizeof(share_path)) == 0 ? 200 : 500;
+                jsdic["type"] = 32;
+                jsdic["result"] = result;
+                if (result == 200)
+                    jsdic["sharefile"] = data_name(share_path);
+            }
+        break; 
+
+        case 35:
+            start_time = getTime();
+
+            //HD派生: 父key的份额加上tweak即为子key的份额,无需重新分享
+            {
+                key_id = j.value("keyid", (uint64_t)0);
+                vector<uint32_t> hdpath = j.value("path", vector<uint32_t>());
+                uint32_t first = j.value("first", 0u);
+                batch = j.value("count", 1);
+                vector<uint8_t> tweaks;
+                int hardened = (uint64_t)first + (uint64_t)(batch > 0 ? batch : 0) > HD_HARDENED;
+                for (size_t l = 0; l < hdpath.size(); l++)
+                    if (hdpath[l] & HD_HARDENED)
+                        hardened = 1;
+                if (hdpath.size() > HD_MAX_DEPTH || batch < 1 || batch > HD_MAX_CHILDREN || hardened)
+                {
+                    result = 400;
+                }
+                else
+                {
+                    recs.resize(batch);
+                    tweaks.resize(32 * (size_t)batch);
+                    result = hd_children(key_id, hdpath.empty() ? NULL : &hdpath[0], (int)hdpath.size(), first,
+                                         batch, &recs[0], &tweaks[0]) == 0 ? 200 : 500;
+                }
+                jsdic["type"] = 36;
+                jsdic["result"] = result;
+                for (int c = 0; c < batch && result == 200; c++)
+                {
+                    char tweakhex[65];
+                    hex_encode(tweakhex, &tweaks[32 * (size_t)c], 32);
+                    jsdic["keys"].push_back({{"keyid", recs[c].key_id}, {"index", first + (uint32_t)c},
+                                             {"tweak", tweakhex}});
+                }
+            }
+        break; 
+
+        case 37:
+            start_time = getTime();
+
+            //份额加密投递: 每个custodian一个X25519公钥,返回enclave公钥供解密
+            {
+                vector<uint64_t> keyids = j.value("keyids", vector<uint64_t>());
+                vector<string> custs = j.value("custodians", vector<string>());
+                vector<uint8_t> cpubs(32 * custs.size());
+                uint8_t dpub[32];
+                result = custs.size() <= SHARE_MAX_N ? 200 : 400;
+                for (size_t c = 0; c < custs.size() && result == 200; c++)
+                    if (hex_decode(&cpubs[32 * c], custs[c], 32) != 0)
+                        result = 400;
+                if (result == 200 && (deliver_public_key(global_eid, &status, dpub) != SGX_SUCCESS || status != 0))
+                    result = 500;
+                //不带keyids时只查询enclave公钥
+                if (result == 200 && !keyids.empty())
+                {
+                    if (custs.empty() || keyids.size() * custs.size() > DELIVER_MAX_SHARES)
+                        result = 400;
+                    else
+                        result = deliver_file(&keyids[0], (int)keyids.size(), &cpubs[0], (int)custs.size(),
+                                              share_path, sizeof(share_path)) == 0 ? 200 : 500;
+                }
+                jsdic["type"] = 38;
+                jsdic["result"] = result;
+                if (result == 200)
+                {
+                    char pubhex[65];
+                    hex_encode(pubhex, dpub, 32);
+                    jsdic["pub"] = pubhex;
+                    if (!keyids.empty())
+                        jsdic["sharefile"] = data_name(share_path);
+                }
+            }
+        break; 
+
+        case 39:
+            start_time = getTime();
+
+            //批量开户份额的Merkle包含证明: 叶子序号 = 批内key序号*n + (x-1)
+            {
+                key_id = j.value("keyid", (uint64_t)0);
+                uint64_t leaves = (uint64_t)j.value("count", 0) * (uint64_t)j.value("n", 0);
+                uint64_t leaf = j.value("index", (uint64_t)0);
+                uint8_t proof[MERKLE_MAX_DEPTH * MERKLE_HASH_SIZE];
+                int depth = merkle_batch_proof(key_id, leaves, leaf, proof);
+                result = depth < 0 ? 404 : 200;
+                jsdic["type"] = 40;
+                jsdic["result"] = result;
+                jsdic["keyid"] = key_id;
+                for (int d = 0; d < depth; d++)
+                {
+                    char hashhex[65];
+                    hex_encode(hashhex, proof + MERKLE_HASH_SIZE * d, MERKLE_HASH_SIZE);
+                    jsdic["proof"].push_back(hashhex);
+                }
+            }
+        break; 
+
+        case 41:
+            start_time = getTime();
+
+            //小秘密/数据按域分享: "field"取order(默认), m127或p64, 小域约减更便宜
+            {
+                string fname = j.value("field", string("order"));
+                int field = fname == "p64" ? FIELD_P64 : fname == "m127" ? FIELD_M127 : FIELD_ORDER;
+                string secret_hex = j.value("secret", string());
+                piece_k = j.value("k", 3);
+                piece_n = j.value("n", 11);
+                size_t slen = secret_hex.size() / 2;
+                size_t chunk = field == FIELD_P64 ? 7 : field == FIELD_M127 ? 15 : 31;
+                size_t row = (slen + chunk - 1) / chunk * (chunk + 1);
+                vector<uint8_t> secret(slen + 1), shares;
+                result = slen > 0 && slen <= FIELD_INLINE_MAX && piece_n >= 1 && piece_n <= SHARE_MAX_N &&
+                         row * piece_n <= FIELD_INLINE_MAX && hex_decode(&secret[0], secret_hex, (int)slen) == 0 ? 200 : 400;
+                if (result == 200)
+                {
+                    shares.resize(row * piece_n);
+                    if (field_split(global_eid, &status, field, &secret[0], slen, piece_k, piece_n, &shares[0], shares.size()) != SGX_SUCCESS ||
+                        status != 0)
+                        result = 500;
+                }
+                jsdic["type"] = 42;
+                jsdic["result"] = result;
+                vector<char> hex(2 * row + 1);
+                for (int c = 0; c < piece_n && result == 200; c++)
+                {
+                    hex_encode(&hex[0], &shares[row * c], (int)row);
+                    jsdic["shares"].push_back({{"x", c + 1}, {"y", string(&hex[0])}});
+                }
+                memset(&secret[0], 0, secret.size());
+                if (!shares.empty())
+                    memset(&shares[0], 0, shares.size());
+            }
+        break; 
+
+        case 43:
+            start_time = getTime();
+
+            //按域恢复: k个份额{"x","y"}, len为秘密字节数
+            {
+                string fname = j.value("field", string("order"));
+                int field = fname == "p64" ? FIELD_P64 : fname == "m127" ? FIELD_M127 : FIELD_ORDER;
+                vector<nlohmann::json> parts = j.value("shares", vector<nlohmann::json>());
+                size_t slen = j.value("len", (size_t)0);
+                size_t chunk = field == FIELD_P64 ? 7 : field == FIELD_M127 ? 15 : 31;
+                size_t row = (slen + chunk - 1) / chunk * (chunk + 1);
+                result = slen > 0 && slen <= FIELD_INLINE_MAX && parts.size() >= SHARE_MIN_K &&
+                         parts.size() <= SHARE_MAX_N && row * parts.size() <= FIELD_INLINE_MAX ? 200 : 400;
+                vector<uint32_t> xs(parts.size());
+                vector<uint8_t> shares(result == 200 ? row * parts.size() : 0), secret(slen + 1);
+                for (size_t s = 0; s < parts.size() && result == 200; s++)
+                {
+                    xs[s] = parts[s].value("x", 0u);
+                    if (hex_decode(&shares[row * s], parts[s].value("y", string()), (int)row) != 0)
+                        result = 400;
+                }
+                if (result == 200 &&
+                    (field_combine(global_eid, &status, field, &shares[0], shares.size(), &xs[0], (int)xs.size(),
+                                   &secret[0], slen) != SGX_SUCCESS || status != 0))
+                    result = 500;
+                jsdic["type"] = 44;
+                jsdic["result"] = result;
+                if (result == 200)
+                {
+                    vector<char> hex(2 * slen + 1);
+                    hex_encode(&hex[0], &secret[0], (int)slen);
+                    jsdic["secret"] = string(&hex[0]);
+                }
+                if (!shares.empty())
+                    memset(&shares[0], 0, shares.size());
+                memset(&secret[0], 0, secret.size());
+            }
+        break; 
+
+        case 45:
+            start_time = getTime();
+
+            //恢复演练: 用同一组custodian的k个份额批量恢复份额文件中的全部key, 结果加密给请求方(X25519公钥)后写入文件
+            {
+                vector<uint32_t> xs = j.value("xs", vector<uint32_t>());
+                piece_n = j.value("n", 11);
+                curve = j.value("curve", string("secp256k1")) == "ed25519" ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1;
+                uint8_t rpub[32], dpub[32];
+                result = data_path(j.value("file", string()), blob_path) == 0 &&
+                         hex_decode(rpub, j.value("recipient", string()), 32) == 0 &&
+                         xs.size() >= SHARE_MIN_K && xs.size() <= SHARE_MAX_N ? 200 : 400;
+                if (result == 200 &&
+                    (deliver_public_key(global_eid, &status, dpub) != SGX_SUCCESS || status != 0 ||
+                     recover_file(blob_path.c_str(), piece_n, &xs[0], (int)xs.size(), curve, rpub, share_path, sizeof(share_path)) != 0))
+                    result = 500;
+                jsdic["type"] = 46;
+                jsdic["result"] = result;
+                if (result == 200)
+                {
+                    char pubhex[65];
+                    hex_encode(pubhex, dpub, 32);
+                    jsdic["pub"] = pubhex;
+                    jsdic["secretfile"] = data_name(share_path);
+                }
+            }
+        break; 
+        default:
+
+        break; 
+    }
+
+
+    //将结果打包放到缓冲区准备发送
+    end_time = getTime();
+    jsdic["starttime"] = start_time;
+    jsdic["endtime"] = end_time;
+}
+
 /* Application entry */
 int main(int argc, char* argv[])
 {
+    if (argc == 2 && strcmp(argv[1], "--selftest") == 0)
+    {
+        //先加载enclave, self_test会切换工作目录
+        if (initialize_enclave() < 0)
+        {
+            printf("enclave intialize error\n");
+            return 1;
+        }
+        int failures = self_test(SELFTEST_DIR);
+        sgx_destroy_enclave(global_eid);
+        return failures == 0 ? 0 : 1;
+    }
     if (argc <= 2)
     {
-        printf("usage: %s ip_address port_number\n", basename(argv[0]));
+        printf("usage: %s ip_address port_number\n"
+               "       %s --selftest\n", basename(argv[0]), basename(argv[0]));
         return 1;
     }
 
@@ -288,6 +964,27 @@ int main(int argc, char* argv[])
     ret = listen(listenfd, 5);
     assert(ret != -1);
 
+    if (mkdir(DATA_DIR, 0700) != 0 && errno != EEXIST)
+    {
+        printf("cannot create %s\n", DATA_DIR);
+        return 1;
+    }
+
+    /* Initialize the enclave once; the key store lives as long as it does */
+    if(initialize_enclave() < 0){
+        printf("enclave intialize error\n");
+        return 1;
+    }
+    if(keystore_open() < 0){
+        printf("keystore open error\n");
+        sgx_destroy_enclave(global_eid);
+        return 1;
+    }
+    //后台线程常驻enclave补充签名nonce和预生成密钥
+    nonce_pool_start();
+    if (keypool_start(KEYPOOL_K, KEYPOOL_N, KEYPOOL_SIZE, KEYPOOL_RATE) != 0)
+        printf("key pool disabled\n");
+
     pollfd fds[USER_LIMIT+1];
     int user_counter = 0;
     for (int i = 1; i <= USER_LIMIT; i++)
@@ -353,6 +1050,7 @@ int main(int argc, char* argv[])
             else if(fds[i].revents & POLLRDHUP)
             {
                 close(fds[i].fd);
+                pending[i] = pending[user_counter];
                 fds[i] = fds[user_counter];
                 i--;
                 user_counter--;
@@ -364,6 +1062,15 @@ int main(int argc, char* argv[])
                 int connfd = fds[i].fd;
                 int len = 0;
                 ret = recv(connfd, &len, 4, 0);
+                if (ret > 0 && ret < 4 && readn(connfd, (char*)&len + ret, 4 - ret) != 4 - ret)
+                {
+                    close(connfd);
+                    pending[i] = pending[user_counter];
+                    fds[i] = fds[user_counter];
+                    i--;
+                    user_counter--;
+                    continue;
+                }
 //                printf("get %d bytes of client data %s from %d\n", ret, recvBuf, connfd);
 
                 if (ret < 0)
@@ -371,6 +1078,7 @@ int main(int argc, char* argv[])
                     if(errno != EAGAIN)
                     {
                         close(connfd);
+                        pending[i] = pending[user_counter];
                         fds[i] = fds[user_counter];
                         i--;
                         user_counter--;
@@ -382,86 +1090,37 @@ int main(int argc, char* argv[])
                 else
                 {
 //此处进入sgx生成public key并打包发送
-                    char buffer[BUFFER_SIZE] = {0};
-                    ret = readn(connfd,buffer,len);
+                    //长度由客户端给出,先检查再按它分配
+                    vector<char> buffer(len > 0 && len <= REQUEST_LIMIT ? len : 1);
+                    ret = len > 0 && len <= REQUEST_LIMIT ? readn(connfd, &buffer[0], len) : -1;
                     if (ret != len) 
                     {
                         close(connfd);
+                        pending[i] = pending[user_counter];
                         fds[i] = fds[user_counter];
                         i--;
                         user_counter--;
                         continue;
                     }
-                        
-                    string recvMsg(buffer);
-                    nlohmann::json j = nlohmann::json::parse(recvMsg);
-                    int type = j["type"];
-                    int result = 0;
-                    int64_t start_time, end_time;
-                    string message;
-                    char pubA[65] = {0};
+
+                    //请求格式不对(不是JSON、缺字段或类型不符)统一回400
+                    int type = 0;
                     nlohmann::json jsdic;
-                    switch(type)
+                    try
                     {
-                        case 1:
-                            start_time = getTime();
-
-                            /* Initialize the enclave */
-                            if(initialize_enclave() < 0){
-                                printf("enclave intialize error\n");
-                                result = 500;
-                                break;
-                            }
-                            /* Utilize edger8r attributes */
-                            edger8r_array_attributes();
-                            edger8r_pointer_attributes();
-                            edger8r_type_attributes();
-                            edger8r_function_attributes();
-
-                            /* Utilize trusted libraries */
-                            ecall_libc_functions();
-                            ecall_libcxx_functions();
-                            ecall_thread_functions();
-                         
-                            //64字节公钥
-                            secret_sharing(global_eid, pubA, 11, 3);
-
-                            
-                            printf("pubA=%s\n",pubA);
-
-                            /* Destroy the enclave */
-                            sgx_destroy_enclave(global_eid);
-                            
-                            printf("Info: SampleEnclave successfully returned.\n");
-
-                            result = 200;
-                            jsdic["type"] = 2;
-                            jsdic["result"] = result;
-                            jsdic["publickey"] = vector<char>(pubA, pubA+65);
-                        break; 
-
-                        case 3:
-
-                        break; 
-                        case 4:
-
-                        break; 
-                        default:
-
-                        break; 
+                        nlohmann::json j = nlohmann::json::parse(buffer.begin(), buffer.end());
+                        type = j.at("type").get<int>();
+                        handle_request(j, type, jsdic);
+                    }
+                    catch (const nlohmann::json::exception&)
+                    {
+                        jsdic = nlohmann::json::object();
+                        jsdic["type"] = type + 1;
+                        jsdic["result"] = 400;
                     }
 
-
-                    //将结果打包放到缓冲区准备发送
-                    end_time = getTime();
-                    jsdic["starttime"] = start_time;
-                    jsdic["endtime"] = end_time;
-                    printf("message is %s\n", pubA);
-
-                    string msg = jsdic.dump();
-                    memset(buf[i], 0, BUFFER_SIZE);
-                    snprintf(buf[i], msg.size()+1,"%s",msg.c_str());
-
+                    //整个应答留在该连接的pending里,POLLOUT时带长度前缀发出
+                    pending[i] = jsdic.dump();
                     fds[i].events |= POLLOUT;
                 }
             }
@@ -469,14 +1128,21 @@ int main(int argc, char* argv[])
             {
                 int connfd = fds[i].fd;
 
-                int len = strlen(buf[i]);
-                ret = send(connfd, &len, 4, 0);
-                ret = send(connfd, buf[i], len, 0);
+                int len = (int)pending[i].size();
+                ret = sendn(connfd, &len, 4);
+                if (ret == 0)
+                    ret = sendn(connfd, pending[i].data(), pending[i].size());
+                pending[i].clear();
                 fds[i].events = POLLIN|POLLRDHUP|POLLERR;
             }
         }
     }
 
     close(listenfd);
+    nonce_pool_shutdown();
+    keypool_shutdown();
+    keystore_compact();
+    keystore_close();
+    sgx_destroy_enclave(global_eid);
     return 0;
 }
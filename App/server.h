@@ -40,6 +40,7 @@
 
 #include "sgx_error.h"       /* sgx_status_t */
 #include "sgx_eid.h"     /* sgx_enclave_id_t */
+#include "user_types.h"  /* keystore_record_t */
 
 #ifndef TRUE
 # define TRUE 1
@@ -52,8 +53,73 @@
 # define TOKEN_FILENAME   "enclave.token"
 # define ENCLAVE_FILENAME "enclave.signed.so"
 
+# define KEYSTORE_KEY_FILE  "keystore.key"
+# define KEYSTORE_SNAP_FILE "keystore.snap"
+# define KEYSTORE_WAL_FILE  "keystore.wal"
+# define KEYSTORE_HD_FILE   "keystore.hd"
+# define KEYSTORE_WAL_LIMIT KEYSTORE_TAIL_SLOTS  /* the enclave's key id window */
+# define SELFTEST_DIR       "selftest"  /* working directory of --selftest, key store included */
+# define PUBKEY_CACHE_SIZE  65536  /* public keys answered without touching the cold tier */
+
+# define DATA_DIR        "data"  /* every file a request names or is told about lives here */
+# define SHARE_FILE_FMT  DATA_DIR "/shares_%lu.bin"
+# define SHARE_THREADS   8      /* below TCSNum, leaves TCSs for the network thread and pool fillers */
+# define SHARE_PART_MIN  256    /* fewer shares per thread is not worth a transition */
+# define PACKED_FILE_FMT DATA_DIR "/packed_%lu.bin"
+# define BATCH_FILE_FMT  DATA_DIR "/batch_%lu.bin"
+# define MERKLE_FILE_FMT DATA_DIR "/batch_%lu.merkle"
+# define RESHARE_FILE_FMT "%s.k%dn%d"       /* source path, new k, new n */
+# define RESHARE_PART_MIN 64    /* fewer keys per thread is not worth a thread */
+# define KEYPOOL_K       3      /* pooled policy and size at startup */
+# define KEYPOOL_N       11
+# define KEYPOOL_SIZE    256
+# define KEYPOOL_RATE    2000   /* keys per second the filler may make */
+
+# define BLOB_SHARE_FMT   "%s.%u"            /* blob path, share x */
+# define BLOB_STAGE_BYTES (32 * 1024 * 1024) /* both split staging buffers */
+# define ENV_SHARE_FMT    "%s.env%u"         /* blob path, fragment x */
+# define VSS_FILE_FMT     DATA_DIR "/vss_%lu.bin"
+# define DELIVER_FILE_FMT DATA_DIR "/deliver_%lu.bin"
+# define MSM_PART_MIN     64    /* fewer points per thread is not worth a transition */
+# define RECOVER_FILE_FMT "%s.recovered"    /* source share file; wrapped_share_t per key */
+
 extern sgx_enclave_id_t global_eid;    /* global enclave id */
 
+/* Header of one blob share file, followed by len share bytes */
+typedef struct _blob_header_t {
+    char     magic[8];
+    uint32_t x;
+    uint32_t piece_k;
+    uint64_t len;
+    uint8_t  pad[8];
+} blob_header_t;
+
+/* Header of one envelope fragment file, followed by its RS fragment of
+ * every ciphertext stripe; fragment x < k+1 is data shard x-1, the rest
+ * parity. */
+typedef struct _env_header_t {
+    char     magic[8];
+    uint32_t x;
+    uint16_t piece_k;
+    uint16_t piece_n;
+    uint64_t len;
+    uint32_t stripe;
+    uint32_t reserved;
+    uint8_t  iv[ENV_IV_SIZE];
+    uint8_t  tag[ENV_TAG_SIZE];
+    uint8_t  key_share[ENV_KEY_SIZE];
+    uint8_t  pad[4];
+} env_header_t;
+
+/* Header of a VSS file, followed by piece_k commitments and piece_n shares */
+typedef struct _vss_header_t {
+    char     magic[8];
+    uint64_t key_id;
+    uint32_t piece_k;
+    uint32_t piece_n;
+    uint8_t  pad[8];
+} vss_header_t;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -67,6 +133,53 @@ void ecall_libc_functions(void);
 void ecall_libcxx_functions(void);
 void ecall_thread_functions(void);
 
+int keystore_open(void);
+int keystore_append(const keystore_record_t* rec);
+int keystore_append_batch(const keystore_record_t* recs, uint64_t count);
+int keystore_reserve(uint64_t count);
+int keystore_compact(void);
+void keystore_close(void);
+int keystore_lookup_pub(uint64_t key_id, uint8_t pub[64]);
+int hd_index_open(void);
+void hd_index_close(void);
+void hd_index_find(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count, uint64_t* key_ids);
+int hd_index_add(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count, const uint64_t* key_ids);
+
+int share_stream(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen);
+int packed_batch(int batch, int threshold, int piece_n, keystore_record_t* recs, char* path, size_t pathlen);
+int keygen_batch(int batch, int piece_k, int piece_n, keystore_record_t* recs, uint8_t root[32], char* path, size_t pathlen);
+int merkle_batch_proof(uint64_t first_id, uint64_t leaves, uint64_t index, uint8_t* proof);
+int keypool_start(int piece_k, int piece_n, int capacity, int rate);
+int keypool_configure(int piece_k, int piece_n, int capacity, int rate);
+void keypool_shutdown(void);
+int keygen_pooled(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen);
+int write_share_file(uint64_t key_id, const share_t* shares, int piece_n, char* path, size_t pathlen);
+int keygen_shares(int piece_k, int piece_n, int curve, char* pubA, keystore_record_t* rec, char* path, size_t pathlen);
+int reshare_file(const char* path, int piece_k, int piece_n, int new_k, int new_n, char* out_path, size_t pathlen);
+int hd_children(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count,
+                keystore_record_t* recs, uint8_t* tweaks);
+int deliver_file(const uint64_t* key_ids, int keys, const uint8_t* custodians, int piece_n, char* path, size_t pathlen);
+int recover_file(const char* path, int piece_n, const uint32_t* xs, int piece_k, int curve, const uint8_t recipient[32],
+                 char* out_path, size_t pathlen);
+int blob_split_file(const char* path, int piece_k, int piece_n);
+int blob_combine_files(const char* const* paths, int piece_k, const char* out_path);
+int env_split_file(const char* path, int piece_k, int piece_n);
+int env_combine_files(const char* const* paths, int count, const char* out_path);
+int vss_issue(int piece_k, int piece_n, char* pubA, keystore_record_t* rec, char* path, size_t pathlen);
+int vss_check_files(const char* const* paths, int count, int* bad);
+int msm_compute(const uint8_t* points, const uint8_t* scalars, int count, uint8_t result[64]);
+int msm_bench(int count, int threads, int64_t* usec);
+int frost_prepare(const uint32_t* xs, int count);
+int frost_sign(uint64_t key_id, const uint8_t msg[32], const share_t* shares, int count, uint8_t sig[FROST_SIG_SIZE]);
+void nonce_pool_start(void);
+void nonce_pool_shutdown(void);
+
+void pubkey_cache_put(uint64_t key_id, const uint8_t pub[64]);
+int pubkey_cache_get(uint64_t key_id, uint8_t pub[64]);
+
+int initialize_enclave(void);
+int self_test(const char* dir);
+
 #if defined(__cplusplus)
 }
 #endif
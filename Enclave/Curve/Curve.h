@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _CURVE_H_
+#define _CURVE_H_
+
+#include "ippcp.h"
+#include "Field.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define EC_POINT_SIZE 64   /* x||y */
+
+#define EC_COMB_WINDOWS 64  /* 4-bit windows of a 256-bit scalar */
+#define EC_COMB_ENTRIES 15  /* d * 16^w * G for d = 1..15 */
+
+typedef struct _ec_affine_t {
+    fe_t x;
+    fe_t y;
+} ec_affine_t;
+
+/* x = X/Z^2, y = Y/Z^3; Z = 0 is the point at infinity */
+typedef struct _ec_jacobian_t {
+    fe_t X;
+    fe_t Y;
+    fe_t Z;
+} ec_jacobian_t;
+
+/* GLV endomorphism constants, 32-byte big-endian */
+typedef struct _ec_glv_params_t {
+    const uint8_t* beta;
+    const uint8_t* lambda;
+    const uint8_t* g1;
+    const uint8_t* g2;
+    const uint8_t* minus_b1;
+    const uint8_t* minus_b2;
+} ec_glv_params_t;
+
+/* Short Weierstrass curve with a = -3 or a = 0, coordinates in Montgomery
+ * form; with glv set, phi(x, y) = (beta x, y) = lambda P and the comb
+ * covers 128-bit halves of the scalar. */
+typedef struct _ec_curve_t {
+    fe_modulus_t fp;
+    fe_modulus_t fn;
+    int          a_minus3;
+    ec_affine_t  g;
+    int          comb_windows;
+    ec_affine_t* comb;
+    int          glv;
+    fe_t         beta;
+    fe_t         lambda;
+    fe_t         g1;
+    fe_t         g2;
+    fe_t         minus_b1;
+    fe_t         minus_b2;
+} ec_curve_t;
+
+extern const uint8_t secp256k1_p[];
+extern const uint8_t secp256k1_n[];
+extern const uint8_t secp256k1_gx[];
+extern const uint8_t secp256k1_gy[];
+
+/* result = sum scalars[i] * points[i]; scalars are 32-byte big-endian */
+int ec_msm(IppsECCPState* ec, IppsECCPPointState* const* points, const Ipp8u* scalars, int count,
+           IppsECCPPointState* result);
+int ec_msm_windows(IppsECCPState* ec, IppsECCPPointState* const* points, const Ipp8u* scalars, int count,
+                   int c, int wlo, int whi, IppsECCPPointState* result);
+int msm_window(int count);
+
+IppsECCPPointState** newPointArray(int count);
+void deletePointArray(IppsECCPPointState** pts);
+void ec_get_point(IppsECCPState* ec, const IppsECCPPointState* pt, Ipp8u out[EC_POINT_SIZE]);
+int ec_set_point(IppsECCPState* ec, const Ipp8u in[EC_POINT_SIZE], IppsECCPPointState* pt);
+
+void ec_curve_init(ec_curve_t* curve, const uint8_t p[32], const uint8_t n[32], int a_minus3,
+                   const uint8_t gx[32], const uint8_t gy[32], const ec_glv_params_t* glv);
+const ec_curve_t* ec_curve_p256(void);
+const ec_curve_t* ec_curve_secp256k1(void);
+void ec_jacobian_dbl(const ec_curve_t* curve, ec_jacobian_t* r, const ec_jacobian_t* a);
+void ec_jacobian_madd(const ec_curve_t* curve, ec_jacobian_t* r, const ec_jacobian_t* a, const ec_affine_t* b);
+void ec_normalize_batch(const ec_curve_t* curve, const ec_jacobian_t* in, ec_affine_t* out, int count);
+void ec_mul_base(const ec_curve_t* curve, ec_jacobian_t* r, const uint8_t k[32]);
+int ec_public_keys(const ec_curve_t* curve, const uint8_t* privs, int count, uint8_t* pubs);
+
+/* Curve25519: group order L (big-endian), Ed25519 || X25519 public keys */
+extern const uint8_t ed25519_l[];
+int ed25519_public_keys(const uint8_t* privs, int count, uint8_t* pubs);
+int x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t u[32]);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_CURVE_H_ */
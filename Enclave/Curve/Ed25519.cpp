@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Curve25519 backend: Ed25519 keys (edwards25519, a = -1) and their
+ * X25519 counterparts, with shares taken modulo the group order L.
+ *
+ * Field elements use Field.h with p = 2^255 - 19, where 2^256 = 38 mod p
+ * so products reduce by folding. Points are extended coordinates
+ * (X:Y:Z:T, x = X/Z, y = Y/Z, xy = T/Z) and the unified addition is
+ * complete on this curve, so the fixed-base comb needs no special cases:
+ * 64 signed 4-bit digits in [-8, 8], each picked from 8 precomputed
+ * multiples (negated by swapping y+x and y-x) with a masked scan, 64
+ * additions of 7 multiplications per key. A batch of keys is normalized
+ * with one inversion for both Z (Ed25519 y) and Z - Y (X25519 u).
+ *
+ * x25519() is the RFC 7748 Montgomery ladder with a masked swap, for
+ * variable-base use such as key agreement.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Curve.h"
+
+#include "sgx_thread.h"
+
+#define ED_COMB_WINDOWS 64
+#define ED_COMB_ENTRIES 8
+
+//p = 2^255 - 19, L = 2^252 + 27742317777372353535851937790883648493
+static const uint8_t ed_p[]  = "\x7F\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xED";
+const uint8_t ed25519_l[]    = "\x10\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x14\xDE\xF9\xDE\xA2\xF7\x9C\xD6\x58\x12\x63\x1A\x5C\xF5\xD3\xED";
+static const uint8_t ed_d2[] = "\x24\x06\xD9\xDC\x56\xDF\xFC\xE7\x19\x8E\x80\xF2\xEE\xF3\xD1\x30\x00\xE0\x14\x9A\x82\x83\xB1\x56\xEB\xD6\x9B\x94\x26\xB2\xF1\x59";
+static const uint8_t ed_bx[] = "\x21\x69\x36\xD3\xCD\x6E\x53\xFE\xC0\xA4\xE2\x31\xFD\xD6\xDC\x5C\x69\x2C\xC7\x60\x95\x25\xA7\xB2\xC9\x56\x2D\x60\x8F\x25\xD5\x1A";
+static const uint8_t ed_by[] = "\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x66\x58";
+
+typedef struct _ed_point_t {
+    fe_t X;
+    fe_t Y;
+    fe_t Z;
+    fe_t T;
+} ed_point_t;
+
+/* affine multiple in the form the mixed addition wants */
+typedef struct _ed_niels_t {
+    fe_t ypx;   /* y + x */
+    fe_t ymx;   /* y - x */
+    fe_t t2d;   /* 2 d x y */
+} ed_niels_t;
+
+typedef struct _ed_ctx_t {
+    fe_modulus_t fp;
+    fe_t         d2;
+    ed_niels_t*  comb;
+} ed_ctx_t;
+
+static ed_ctx_t ed;
+static int ed_ready = 0;
+static sgx_thread_mutex_t ed_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static void ed_identity(ed_point_t* r)
+{
+    const fe_t zero = {0, 0, 0, 0};
+    fe_copy(r->X, zero);
+    fe_copy(r->Y, ed.fp.one);
+    fe_copy(r->Z, ed.fp.one);
+    fe_copy(r->T, zero);
+}
+
+//r = a + b, add-2008-hwcd-3,对所有输入完备
+static void ed_add(ed_point_t* r, const ed_point_t* a, const ed_point_t* b)
+{
+    const fe_modulus_t* m = &ed.fp;
+    fe_t A, B, C, D, t;
+    fe_sub(m, A, a->Y, a->X);
+    fe_sub(m, t, b->Y, b->X);
+    fe_mul(m, A, A, t);
+    fe_add(m, B, a->Y, a->X);
+    fe_add(m, t, b->Y, b->X);
+    fe_mul(m, B, B, t);
+    fe_mul(m, C, a->T, b->T);
+    fe_mul(m, C, C, ed.d2);
+    fe_mul(m, D, a->Z, b->Z);
+    fe_add(m, D, D, D);
+    //E = B-A, F = D-C, G = D+C, H = B+A
+    fe_sub(m, t, B, A);
+    fe_add(m, B, B, A);
+    fe_sub(m, A, D, C);
+    fe_add(m, D, D, C);
+    fe_mul(m, r->X, t, A);
+    fe_mul(m, r->Y, D, B);
+    fe_mul(m, r->T, t, B);
+    fe_mul(m, r->Z, A, D);
+}
+
+//r = a + b,b为预计算的仿射倍点
+static void ed_add_niels(ed_point_t* r, const ed_point_t* a, const ed_niels_t* b)
+{
+    const fe_modulus_t* m = &ed.fp;
+    fe_t A, B, C, D, t;
+    fe_sub(m, A, a->Y, a->X);
+    fe_mul(m, A, A, b->ymx);
+    fe_add(m, B, a->Y, a->X);
+    fe_mul(m, B, B, b->ypx);
+    fe_mul(m, C, a->T, b->t2d);
+    fe_add(m, D, a->Z, a->Z);
+    fe_sub(m, t, B, A);
+    fe_add(m, B, B, A);
+    fe_sub(m, A, D, C);
+    fe_add(m, D, D, C);
+    fe_mul(m, r->X, t, A);
+    fe_mul(m, r->Y, D, B);
+    fe_mul(m, r->T, t, B);
+    fe_mul(m, r->Z, A, D);
+}
+
+//r = 2a, dbl-2008-hwcd (a = -1)
+static void ed_dbl(ed_point_t* r, const ed_point_t* a)
+{
+    const fe_modulus_t* m = &ed.fp;
+    fe_t A, B, C, E, t;
+    fe_sqr(m, A, a->X);
+    fe_sqr(m, B, a->Y);
+    fe_sqr(m, C, a->Z);
+    fe_add(m, C, C, C);
+    fe_add(m, E, a->X, a->Y);
+    fe_sqr(m, E, E);
+    fe_sub(m, E, E, A);
+    fe_sub(m, E, E, B);
+    //G = B-A, F = G-C, H = -A-B
+    fe_sub(m, t, B, A);
+    fe_sub(m, C, t, C);
+    const fe_t zero = {0, 0, 0, 0};
+    fe_sub(m, A, zero, A);
+    fe_sub(m, A, A, B);
+    fe_mul(m, r->X, E, C);
+    fe_mul(m, r->Y, t, A);
+    fe_mul(m, r->T, E, A);
+    fe_mul(m, r->Z, C, t);
+}
+
+//comb[w][j] = (j+1)*16^w*B,整表一次求逆转成仿射
+static void build_comb(void)
+{
+    const fe_modulus_t* m = &ed.fp;
+    const int total = ED_COMB_WINDOWS * ED_COMB_ENTRIES;
+    ed_point_t* all = new ed_point_t[total];
+    ed_point_t base, next;
+    fe_t t;
+    fe_from_bytes(t, ed_bx);
+    fe_to_mont(m, base.X, t);
+    fe_from_bytes(t, ed_by);
+    fe_to_mont(m, base.Y, t);
+    fe_copy(base.Z, m->one);
+    fe_mul(m, base.T, base.X, base.Y);
+
+    for (int w = 0; w < ED_COMB_WINDOWS; w++)
+    {
+        ed_point_t* e = all + w * ED_COMB_ENTRIES;
+        e[0] = base;
+        for (int j = 1; j < ED_COMB_ENTRIES; j++)
+            ed_add(&e[j], &e[j-1], &base);
+        ed_dbl(&next, &e[ED_COMB_ENTRIES-1]);
+        base = next;
+    }
+
+    fe_t* zinv = new fe_t[total];
+    fe_t* prefix = new fe_t[total];
+    for (int i = 0; i < total; i++)
+        fe_copy(zinv[i], all[i].Z);
+    fe_inv_batch(m, zinv, total, prefix);
+
+    ed.comb = new ed_niels_t[total];
+    fe_t x, y;
+    for (int i = 0; i < total; i++)
+    {
+        fe_mul(m, x, all[i].X, zinv[i]);
+        fe_mul(m, y, all[i].Y, zinv[i]);
+        fe_add(m, ed.comb[i].ypx, y, x);
+        fe_sub(m, ed.comb[i].ymx, y, x);
+        fe_mul(m, t, x, y);
+        fe_mul(m, ed.comb[i].t2d, t, ed.d2);
+    }
+    delete [] all;
+    delete [] zinv;
+    delete [] prefix;
+}
+
+static void ed_setup(void)
+{
+    sgx_thread_mutex_lock(&ed_mutex);
+    if (!ed_ready)
+    {
+        fe_t t;
+        fe_modulus_init(&ed.fp, ed_p);
+        fe_from_bytes(t, ed_d2);
+        fe_to_mont(&ed.fp, ed.d2, t);
+        build_comb();
+        ed_ready = 1;
+    }
+    sgx_thread_mutex_unlock(&ed_mutex);
+}
+
+//取|e|对应的倍点,e = 0时为单位元(1, 1, 0),e < 0时取负
+static void comb_lookup(const ed_niels_t* row, int e, ed_niels_t* r)
+{
+    const fe_modulus_t* m = &ed.fp;
+    const fe_t zero = {0, 0, 0, 0};
+    uint64_t neg = 0 - (uint64_t)((unsigned)e >> 31);
+    unsigned a = (unsigned)((e ^ (int)neg) - (int)neg);
+
+    fe_copy(r->ypx, m->one);
+    fe_copy(r->ymx, m->one);
+    fe_copy(r->t2d, zero);
+    for (unsigned j = 1; j <= ED_COMB_ENTRIES; j++)
+    {
+        uint64_t hit = 0 - (uint64_t)((((a ^ j) - 1) >> 31) & 1);
+        fe_select(r->ypx, r->ypx, row[j-1].ypx, hit);
+        fe_select(r->ymx, r->ymx, row[j-1].ymx, hit);
+        fe_select(r->t2d, r->t2d, row[j-1].t2d, hit);
+    }
+
+    //-(x, y) = (-x, y): 交换y+x与y-x, 2dxy取负
+    fe_t t, nt;
+    fe_copy(t, r->ypx);
+    fe_select(r->ypx, r->ypx, r->ymx, neg);
+    fe_select(r->ymx, r->ymx, t, neg);
+    fe_sub(m, nt, zero, r->t2d);
+    fe_select(r->t2d, r->t2d, nt, neg);
+}
+
+//r = k*B, k为大端32字节且小于2^255
+static void ed_mul_base(ed_point_t* r, const uint8_t k[32])
+{
+    //有符号4位数字,e[i]在[-8, 8]
+    signed char e[ED_COMB_WINDOWS];
+    for (int i = 0; i < 32; i++)
+    {
+        e[2*i] = (signed char)(k[31-i] & 15);
+        e[2*i+1] = (signed char)(k[31-i] >> 4);
+    }
+    signed char carry = 0;
+    for (int i = 0; i < ED_COMB_WINDOWS - 1; i++)
+    {
+        e[i] = (signed char)(e[i] + carry);
+        carry = (signed char)((e[i] + 8) >> 4);
+        e[i] = (signed char)(e[i] - (carry << 4));
+    }
+    e[ED_COMB_WINDOWS-1] = (signed char)(e[ED_COMB_WINDOWS-1] + carry);
+
+    ed_point_t acc;
+    ed_niels_t entry;
+    ed_identity(&acc);
+    for (int w = 0; w < ED_COMB_WINDOWS; w++)
+    {
+        comb_lookup(ed.comb + w * ED_COMB_ENTRIES, e[w], &entry);
+        ed_add_niels(&acc, &acc, &entry);
+    }
+    *r = acc;
+    memset(e, 0, sizeof(e));
+    memset(&acc, 0, sizeof(acc));
+    memset(&entry, 0, sizeof(entry));
+}
+
+//limb转小端32字节
+static void to_le(uint8_t out[32], const fe_t a)
+{
+    uint8_t be[32];
+    fe_to_bytes(be, a);
+    for (int i = 0; i < 32; i++)
+        out[i] = be[31-i];
+}
+
+/*
+ * ed25519_public_keys:
+ *   For count scalars (32-byte big-endian, below L) write 64 bytes each:
+ *   the Ed25519 public key (RFC 8032 encoding) and the X25519 public key
+ *   u = (1 + y) / (1 - y) of the same point. Fails on a zero scalar.
+ */
+int ed25519_public_keys(const uint8_t* privs, int count, uint8_t* pubs)
+{
+    if (count <= 0)
+        return -1;
+    ed_setup();
+    const fe_modulus_t* m = &ed.fp;
+
+    //inv[2i] = 1/Z, inv[2i+1] = 1/(Z-Y),单位元时Z-Y为0,先换成1
+    ed_point_t* pts = new ed_point_t[count];
+    fe_t* inv = new fe_t[2 * (size_t)count];
+    fe_t* prefix = new fe_t[2 * (size_t)count];
+    int ret = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ed_mul_base(&pts[i], privs + 32 * (size_t)i);
+        fe_copy(inv[2*i], pts[i].Z);
+        fe_sub(m, inv[2*i+1], pts[i].Z, pts[i].Y);
+        uint64_t ident = fe_is_zero(inv[2*i+1]);
+        if (ident)
+            ret = -1;
+        fe_select(inv[2*i+1], inv[2*i+1], m->one, ident);
+    }
+    fe_inv_batch(m, inv, 2 * count, prefix);
+
+    fe_t x, y, u, t;
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t* out = pubs + 64 * (size_t)i;
+        fe_mul(m, x, pts[i].X, inv[2*i]);
+        fe_mul(m, y, pts[i].Y, inv[2*i]);
+        fe_add(m, u, pts[i].Z, pts[i].Y);
+        fe_mul(m, u, u, inv[2*i+1]);
+        fe_from_mont(m, x, x);
+        fe_from_mont(m, t, y);
+        to_le(out, t);
+        out[31] |= (uint8_t)((x[0] & 1) << 7);
+        fe_from_mont(m, t, u);
+        to_le(out + 32, t);
+    }
+    memset(pts, 0, sizeof(ed_point_t) * (size_t)count);
+    delete [] pts;
+    delete [] inv;
+    delete [] prefix;
+    return ret;
+}
+
+//mask全1时交换a和b
+static void fe_cswap(fe_t a, fe_t b, uint64_t mask)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t t = (a[i] ^ b[i]) & mask;
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+/*
+ * x25519:
+ *   out = X25519(scalar, u) per RFC 7748, all little-endian. Returns -1
+ *   when the result is zero (u of small order).
+ */
+int x25519(uint8_t out[32], const uint8_t scalar[32], const uint8_t u[32])
+{
+    ed_setup();
+    const fe_modulus_t* m = &ed.fp;
+
+    uint8_t k[32], be[32];
+    memcpy(k, scalar, 32);
+    k[0] &= 248;
+    k[31] &= 127;
+    k[31] |= 64;
+    for (int i = 0; i < 32; i++)
+        be[i] = u[31-i];
+    be[0] &= 127;
+
+    fe_t x1, x2, z2, x3, z3, t, A, AA, B, BB, E, C, D, a24;
+    const fe_t a24_raw = {121665, 0, 0, 0};
+    fe_from_bytes(t, be);
+    uint64_t t5[5] = {t[0], t[1], t[2], t[3], 0};
+    fe_reduce_once(m, t, t5);
+    fe_to_mont(m, x1, t);
+    fe_to_mont(m, a24, a24_raw);
+    fe_copy(x2, m->one);
+    memset(z2, 0, sizeof(z2));
+    fe_copy(x3, x1);
+    fe_copy(z3, m->one);
+
+    uint64_t swap = 0;
+    for (int i = 254; i >= 0; i--)
+    {
+        uint64_t bit = 0 - (uint64_t)((k[i/8] >> (i%8)) & 1);
+        swap ^= bit;
+        fe_cswap(x2, x3, swap);
+        fe_cswap(z2, z3, swap);
+        swap = bit;
+
+        fe_add(m, A, x2, z2);
+        fe_sqr(m, AA, A);
+        fe_sub(m, B, x2, z2);
+        fe_sqr(m, BB, B);
+        fe_sub(m, E, AA, BB);
+        fe_add(m, C, x3, z3);
+        fe_sub(m, D, x3, z3);
+        fe_mul(m, D, D, A);
+        fe_mul(m, C, C, B);
+        fe_add(m, x3, D, C);
+        fe_sqr(m, x3, x3);
+        fe_sub(m, z3, D, C);
+        fe_sqr(m, z3, z3);
+        fe_mul(m, z3, z3, x1);
+        fe_mul(m, x2, AA, BB);
+        fe_mul(m, t, a24, E);
+        fe_add(m, t, t, AA);
+        fe_mul(m, z2, E, t);
+    }
+    fe_cswap(x2, x3, swap);
+    fe_cswap(z2, z3, swap);
+
+    fe_inv(m, z2, z2);
+    fe_mul(m, x2, x2, z2);
+    fe_from_mont(m, t, x2);
+    to_le(out, t);
+    int ret = fe_is_zero(t) ? -1 : 0;
+
+    memset(k, 0, sizeof(k));
+    memset(x2, 0, sizeof(x2));
+    memset(z2, 0, sizeof(z2));
+    memset(x3, 0, sizeof(x3));
+    memset(z3, 0, sizeof(z3));
+    return ret;
+}
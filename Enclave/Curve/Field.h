@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* 256-bit prime field arithmetic in Montgomery form, 4 x 64-bit limbs,
+ * little-endian. Everything is branch-free on the values so it can touch
+ * private keys; the modulus is a parameter, so one implementation serves
+ * every 256-bit curve.
+ *
+ * When c = 2^256 mod p is small (secp256k1, 2^255 - 19) Montgomery is
+ * skipped altogether: R is taken as 1 and products are reduced by folding
+ * the high half back in times c, about half the work.
+ */
+
+#ifndef _FIELD_H_
+#define _FIELD_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+typedef uint64_t fe_t[4];
+
+typedef struct _fe_modulus_t {
+    fe_t     p;
+    uint64_t n0;    /* -p^-1 mod 2^64 */
+    fe_t     one;   /* R mod p */
+    fe_t     rr;    /* R^2 mod p */
+    uint64_t c;     /* 2^256 mod p when below 2^34, else 0 */
+} fe_modulus_t;
+
+typedef unsigned __int128 fe_u128;
+
+static inline void fe_copy(fe_t r, const fe_t a)
+{
+    memcpy(r, a, sizeof(fe_t));
+}
+
+//mask全1时r=b,全0时r=a
+static inline void fe_select(fe_t r, const fe_t a, const fe_t b, uint64_t mask)
+{
+    for (int i = 0; i < 4; i++)
+        r[i] = (a[i] & ~mask) | (b[i] & mask);
+}
+
+static inline uint64_t fe_is_zero(const fe_t a)
+{
+    uint64_t t = a[0] | a[1] | a[2] | a[3];
+    return ((t | (0 - t)) >> 63) - 1;
+}
+
+//带进位加/带借位减,进位标志经c传递
+static inline uint64_t fe_adc(uint64_t a, uint64_t b, unsigned char* c)
+{
+    unsigned long long r;
+    *c = _addcarry_u64(*c, a, b, &r);
+    return r;
+}
+
+static inline uint64_t fe_sbb(uint64_t a, uint64_t b, unsigned char* c)
+{
+    unsigned long long r;
+    *c = _subborrow_u64(*c, a, b, &r);
+    return r;
+}
+
+//r = t - p (t为5个limb),若t<p则保留t
+static inline void fe_reduce_once(const fe_modulus_t* m, fe_t r, const uint64_t t[5])
+{
+    fe_t s;
+    unsigned char b = 0;
+    for (int i = 0; i < 4; i++)
+        s[i] = fe_sbb(t[i], m->p[i], &b);
+    fe_sbb(t[4], 0, &b);
+    fe_select(r, s, t, 0 - (uint64_t)b);
+}
+
+static inline void fe_add(const fe_modulus_t* m, fe_t r, const fe_t a, const fe_t b)
+{
+    uint64_t t[5];
+    unsigned char c = 0;
+    for (int i = 0; i < 4; i++)
+        t[i] = fe_adc(a[i], b[i], &c);
+    t[4] = c;
+    fe_reduce_once(m, r, t);
+}
+
+static inline void fe_sub(const fe_modulus_t* m, fe_t r, const fe_t a, const fe_t b)
+{
+    fe_t t;
+    unsigned char c = 0;
+    for (int i = 0; i < 4; i++)
+        t[i] = fe_sbb(a[i], b[i], &c);
+    uint64_t mask = 0 - (uint64_t)c;
+    c = 0;
+    for (int i = 0; i < 4; i++)
+        r[i] = fe_adc(t[i], m->p[i] & mask, &c);
+}
+
+//r = a*b + c + carry的低64位,高64位回写carry
+static inline uint64_t fe_mac(uint64_t a, uint64_t b, uint64_t c, uint64_t* carry)
+{
+    fe_u128 t = (fe_u128)a * b + c + *carry;
+    *carry = (uint64_t)(t >> 64);
+    return (uint64_t)t;
+}
+
+//t = a*b,512位
+static inline void fe_mul_wide(uint64_t t[8], const fe_t a, const fe_t b)
+{
+    uint64_t c = 0;
+    t[0] = fe_mac(a[0], b[0], 0, &c);
+    t[1] = fe_mac(a[0], b[1], 0, &c);
+    t[2] = fe_mac(a[0], b[2], 0, &c);
+    t[3] = fe_mac(a[0], b[3], 0, &c);
+    t[4] = c;
+    for (int i = 1; i < 4; i++)
+    {
+        c = 0;
+        t[i]   = fe_mac(a[i], b[0], t[i],   &c);
+        t[i+1] = fe_mac(a[i], b[1], t[i+1], &c);
+        t[i+2] = fe_mac(a[i], b[2], t[i+2], &c);
+        t[i+3] = fe_mac(a[i], b[3], t[i+3], &c);
+        t[i+4] = c;
+    }
+}
+
+//2^256 = c mod p: hi*2^256 + lo = lo + hi*c,折两次后再减两次p(p可能只有255位)
+static inline void fe_fold(const fe_modulus_t* m, fe_t r, const uint64_t t[8])
+{
+    uint64_t u[5], c = 0;
+    for (int i = 0; i < 4; i++)
+        u[i] = fe_mac(t[i+4], m->c, t[i], &c);
+
+    fe_u128 top = (fe_u128)c * m->c;
+    unsigned char cc = 0;
+    u[0] = fe_adc(u[0], (uint64_t)top, &cc);
+    u[1] = fe_adc(u[1], (uint64_t)(top >> 64), &cc);
+    u[2] = fe_adc(u[2], 0, &cc);
+    u[3] = fe_adc(u[3], 0, &cc);
+
+    //溢出2^256时再加一次c,此时低位很小不会再进位
+    uint64_t extra = m->c & (0 - (uint64_t)cc);
+    cc = 0;
+    u[0] = fe_adc(u[0], extra, &cc);
+    for (int i = 1; i < 4; i++)
+        u[i] = fe_adc(u[i], 0, &cc);
+    u[4] = 0;
+    fe_reduce_once(m, u, u);
+    fe_reduce_once(m, r, u);
+}
+
+//蒙哥马利约减 r = t/R
+static inline void fe_mont_reduce(const fe_modulus_t* m, fe_t r, uint64_t t[9])
+{
+    t[8] = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t u = t[i] * m->n0, c = 0;
+        fe_mac(u, m->p[0], t[i], &c);
+        t[i+1] = fe_mac(u, m->p[1], t[i+1], &c);
+        t[i+2] = fe_mac(u, m->p[2], t[i+2], &c);
+        t[i+3] = fe_mac(u, m->p[3], t[i+3], &c);
+        //进位沿高位传播,固定走到顶不看值
+        unsigned char cc = 0;
+        t[i+4] = fe_adc(t[i+4], c, &cc);
+        for (int j = i+5; j < 9; j++)
+            t[j] = fe_adc(t[j], 0, &cc);
+    }
+    fe_reduce_once(m, r, t + 4);
+}
+
+//r = a*b/R (伪梅森素数时R = 1)
+static inline void fe_mul(const fe_modulus_t* m, fe_t r, const fe_t a, const fe_t b)
+{
+    uint64_t t[9];
+    fe_mul_wide(t, a, b);
+    if (m->c)
+        fe_fold(m, r, t);
+    else
+        fe_mont_reduce(m, r, t);
+}
+
+static inline void fe_sqr(const fe_modulus_t* m, fe_t r, const fe_t a)
+{
+    fe_mul(m, r, a, a);
+}
+
+static inline void fe_to_mont(const fe_modulus_t* m, fe_t r, const fe_t a)
+{
+    fe_mul(m, r, a, m->rr);
+}
+
+static inline void fe_from_mont(const fe_modulus_t* m, fe_t r, const fe_t a)
+{
+    const fe_t one = {1, 0, 0, 0};
+    fe_mul(m, r, a, one);
+}
+
+//r = a^(p-2) = 1/a,费马小定理,指数公开所以按位走不泄露a
+static inline void fe_inv(const fe_modulus_t* m, fe_t r, const fe_t a)
+{
+    fe_t e, acc;
+    fe_u128 borrow = 2;
+    for (int i = 0; i < 4; i++)
+    {
+        fe_u128 d = (fe_u128)m->p[i] - (uint64_t)borrow;
+        e[i] = (uint64_t)d;
+        borrow = (d >> 64) & 1;
+    }
+    fe_copy(acc, m->one);
+    for (int bit = 255; bit >= 0; bit--)
+    {
+        fe_sqr(m, acc, acc);
+        if ((e[bit/64] >> (bit%64)) & 1)
+            fe_mul(m, acc, acc, a);
+    }
+    fe_copy(r, acc);
+}
+
+/*
+ * fe_inv_batch:
+ *   Invert count nonzero elements in place with one inversion (Montgomery's
+ *   trick); prefix needs count entries.
+ */
+static inline void fe_inv_batch(const fe_modulus_t* m, fe_t* a, int count, fe_t* prefix)
+{
+    if (count <= 0)
+        return;
+    fe_copy(prefix[0], a[0]);
+    for (int i = 1; i < count; i++)
+        fe_mul(m, prefix[i], prefix[i-1], a[i]);
+
+    fe_t inv, t;
+    fe_inv(m, inv, prefix[count-1]);
+    for (int i = count-1; i > 0; i--)
+    {
+        fe_mul(m, t, inv, prefix[i-1]);
+        fe_mul(m, inv, inv, a[i]);
+        fe_copy(a[i], t);
+    }
+    fe_copy(a[0], inv);
+}
+
+//大端32字节与limb互转,不做蒙哥马利变换
+static inline void fe_from_bytes(fe_t r, const uint8_t in[32])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t v = 0;
+        for (int j = 0; j < 8; j++)
+            v = (v << 8) | in[31 - 8*i - 7 + j];
+        r[i] = v;
+    }
+}
+
+static inline void fe_to_bytes(uint8_t out[32], const fe_t a)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 8; j++)
+            out[31 - 8*i - j] = (uint8_t)(a[i] >> (8*j));
+}
+
+/*
+ * fe_modulus_init:
+ *   Set up the Montgomery constants for an odd p (big-endian bytes).
+ */
+static inline void fe_modulus_init(fe_modulus_t* m, const uint8_t p[32])
+{
+    fe_from_bytes(m->p, p);
+    m->c = 0;
+
+    //牛顿迭代求p^-1 mod 2^64
+    uint64_t inv = 1;
+    for (int i = 0; i < 6; i++)
+        inv *= 2 - m->p[0] * inv;
+    m->n0 = 0 - inv;
+
+    //1倍增256次得R mod p,再256次得R^2 mod p
+    fe_t x = {1, 0, 0, 0};
+    for (int i = 0; i < 512; i++)
+    {
+        fe_add(m, x, x, x);
+        if (i == 255)
+            fe_copy(m->one, x);
+    }
+    fe_copy(m->rr, x);
+
+    //2^256 mod p很小时走折叠约减,R取1
+    if (m->one[1] == 0 && m->one[2] == 0 && m->one[3] == 0 && m->one[0] < ((uint64_t)1 << 34))
+    {
+        const fe_t one = {1, 0, 0, 0};
+        m->c = m->one[0];
+        m->n0 = 0;
+        fe_copy(m->one, one);
+        fe_copy(m->rr, one);
+    }
+}
+
+#endif /* !_FIELD_H_ */
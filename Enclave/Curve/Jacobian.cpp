@@ -0,0 +1,523 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Native short-Weierstrass arithmetic in Jacobian coordinates on top of
+ * Field.h, for paths where IPP's one-point-at-a-time API is the cost.
+ *
+ * IPP hands points back only in affine form, which costs a field inversion
+ * per point. Here points stay Jacobian (x = X/Z^2, y = Y/Z^3) until a
+ * whole batch is done, and ec_normalize_batch then inverts all Z at once
+ * with Montgomery's trick: one inversion plus 3 multiplications per point.
+ *
+ * Fixed-base multiplication uses a comb of 64 windows of 4 bits with
+ * d * 16^w * G precomputed (affine) for d = 1..15, so k * G is 64 mixed
+ * additions and no doublings. Table entries are read with a full scan and
+ * masks so the access pattern does not depend on the private key.
+ *
+ * On secp256k1 the GLV endomorphism phi(x, y) = (beta x, y) = lambda P
+ * splits k into k1 + k2 lambda with |k1|, |k2| < 2^128, so the comb only
+ * needs the 32 windows of a 128-bit scalar: k2's entries are the same
+ * table with x multiplied by beta. Same 64 additions, half the table, which
+ * then fits in L1 next to the working set.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Curve.h"
+
+#include "sgx_thread.h"
+
+//P-256: p = 2^256 - 2^224 + 2^192 + 2^96 - 1, a = -3
+static const uint8_t p256_p[]  = "\xFF\xFF\xFF\xFF\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF";
+static const uint8_t p256_gx[] = "\x6B\x17\xD1\xF2\xE1\x2C\x42\x47\xF8\xBC\xE6\xE5\x63\xA4\x40\xF2\x77\x03\x7D\x81\x2D\xEB\x33\xA0\xF4\xA1\x39\x45\xD8\x98\xC2\x96";
+static const uint8_t p256_gy[] = "\x4F\xE3\x42\xE2\xFE\x1A\x7F\x9B\x8E\xE7\xEB\x4A\x7C\x0F\x9E\x16\x2B\xCE\x33\x57\x6B\x31\x5E\xCE\xCB\xB6\x40\x68\x37\xBF\x51\xF5";
+
+static const uint8_t p256_n[]  = "\xFF\xFF\xFF\xFF\x00\x00\x00\x00\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xBC\xE6\xFA\xAD\xA7\x17\x9E\x84\xF3\xB9\xCA\xC2\xFC\x63\x25\x51";
+
+//secp256k1: p = 2^256 - 2^32 - 977, a = 0
+const uint8_t secp256k1_p[]  = "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xFF\xFF\xFC\x2F";
+const uint8_t secp256k1_n[]  = "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xBA\xAE\xDC\xE6\xAF\x48\xA0\x3B\xBF\xD2\x5E\x8C\xD0\x36\x41\x41";
+const uint8_t secp256k1_gx[] = "\x79\xBE\x66\x7E\xF9\xDC\xBB\xAC\x55\xA0\x62\x95\xCE\x87\x0B\x07\x02\x9B\xFC\xDB\x2D\xCE\x28\xD9\x59\xF2\x81\x5B\x16\xF8\x17\x98";
+const uint8_t secp256k1_gy[] = "\x48\x3A\xDA\x77\x26\xA3\xC4\x65\x5D\xA4\xFB\xFC\x0E\x11\x08\xA8\xFD\x17\xB4\x48\xA6\x85\x54\x19\x9C\x47\xD0\x8F\xFB\x10\xD4\xB8";
+
+//GLV: beta^3 = 1 mod p, lambda^3 = 1 mod n; (a1, b1), (a2, b2) is a short basis of {(x, y): x + y lambda = 0 mod n}
+static const uint8_t k1_beta[]   = "\x7A\xE9\x6A\x2B\x65\x7C\x07\x10\x6E\x64\x47\x9E\xAC\x34\x34\xE9\x9C\xF0\x49\x75\x12\xF5\x89\x95\xC1\x39\x6C\x28\x71\x95\x01\xEE";
+static const uint8_t k1_lambda[] = "\x53\x63\xAD\x4C\xC0\x5C\x30\xE0\xA5\x26\x1C\x02\x88\x12\x64\x5A\x12\x2E\x22\xEA\x20\x81\x66\x78\xDF\x02\x96\x7C\x1B\x23\xBD\x72";
+static const uint8_t k1_g1[]     = "\x30\x86\xD2\x21\xA7\xD4\x6B\xCD\xE8\x6C\x90\xE4\x92\x84\xEB\x15\x3D\xAA\x8A\x14\x71\xE8\xCA\x7F\xE8\x93\x20\x9A\x45\xDB\xB0\x31";   /* round(2^384 b2 / n) */
+static const uint8_t k1_g2[]     = "\xE4\x43\x7E\xD6\x01\x0E\x88\x28\x6F\x54\x7F\xA9\x0A\xBF\xE4\xC4\x22\x12\x08\xAC\x9D\xF5\x06\xC6\x15\x71\xB4\xAE\x8A\xC4\x7F\x71";   /* round(2^384 (-b1) / n) */
+static const uint8_t k1_mb1[]    = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\xE4\x43\x7E\xD6\x01\x0E\x88\x28\x6F\x54\x7F\xA9\x0A\xBF\xE4\xC3";   /* -b1 */
+static const uint8_t k1_mb2[]    = "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\x8A\x28\x0A\xC5\x07\x74\x34\x6D\xD7\x65\xCD\xA8\x3D\xB1\x56\x2C";   /* -b2 mod n */
+
+static const ec_glv_params_t k1_glv = {k1_beta, k1_lambda, k1_g1, k1_g2, k1_mb1, k1_mb2};
+
+static ec_curve_t p256;
+static ec_curve_t secp256k1;
+static int p256_ready = 0;
+static int secp256k1_ready = 0;
+static sgx_thread_mutex_t curve_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+/*
+ * ec_jacobian_dbl:
+ *   r = 2a; dbl-2001-b for a = -3, dbl-2009-l for a = 0. r may alias a.
+ */
+void ec_jacobian_dbl(const ec_curve_t* curve, ec_jacobian_t* r, const ec_jacobian_t* a)
+{
+    const fe_modulus_t* m = &curve->fp;
+    fe_t t0, t1, t2, t3, x3, y3, z3;
+    if (curve->a_minus3)
+    {
+        //t0=delta, t1=gamma, t2=beta, t3=alpha
+        fe_sqr(m, t0, a->Z);
+        fe_sqr(m, t1, a->Y);
+        fe_mul(m, t2, a->X, t1);
+        fe_sub(m, x3, a->X, t0);
+        fe_add(m, y3, a->X, t0);
+        fe_mul(m, t3, x3, y3);
+        fe_add(m, x3, t3, t3);
+        fe_add(m, t3, x3, t3);
+        //Z3 = (Y+Z)^2 - gamma - delta
+        fe_add(m, z3, a->Y, a->Z);
+        fe_sqr(m, z3, z3);
+        fe_sub(m, z3, z3, t1);
+        fe_sub(m, z3, z3, t0);
+        //X3 = alpha^2 - 8 beta
+        fe_add(m, t2, t2, t2);
+        fe_add(m, t2, t2, t2);
+        fe_sqr(m, x3, t3);
+        fe_sub(m, x3, x3, t2);
+        fe_sub(m, x3, x3, t2);
+        //Y3 = alpha (4 beta - X3) - 8 gamma^2
+        fe_sub(m, y3, t2, x3);
+        fe_mul(m, y3, t3, y3);
+        fe_sqr(m, t1, t1);
+        fe_add(m, t1, t1, t1);
+        fe_add(m, t1, t1, t1);
+        fe_add(m, t1, t1, t1);
+        fe_sub(m, y3, y3, t1);
+    }
+    else
+    {
+        //t0=A, t1=B, t2=C, t3=D
+        fe_sqr(m, t0, a->X);
+        fe_sqr(m, t1, a->Y);
+        fe_sqr(m, t2, t1);
+        fe_add(m, t3, a->X, t1);
+        fe_sqr(m, t3, t3);
+        fe_sub(m, t3, t3, t0);
+        fe_sub(m, t3, t3, t2);
+        fe_add(m, t3, t3, t3);
+        //Z3 = 2 Y Z
+        fe_mul(m, z3, a->Y, a->Z);
+        fe_add(m, z3, z3, z3);
+        //t0 = E = 3A, X3 = E^2 - 2D
+        fe_add(m, t1, t0, t0);
+        fe_add(m, t0, t1, t0);
+        fe_sqr(m, x3, t0);
+        fe_sub(m, x3, x3, t3);
+        fe_sub(m, x3, x3, t3);
+        //Y3 = E (D - X3) - 8C
+        fe_sub(m, y3, t3, x3);
+        fe_mul(m, y3, t0, y3);
+        fe_add(m, t2, t2, t2);
+        fe_add(m, t2, t2, t2);
+        fe_add(m, t2, t2, t2);
+        fe_sub(m, y3, y3, t2);
+    }
+    fe_copy(r->X, x3);
+    fe_copy(r->Y, y3);
+    fe_copy(r->Z, z3);
+}
+
+/*
+ * ec_jacobian_madd:
+ *   r = a + b with b affine (madd-2007-bl). Needs a != +-b and a not at
+ *   infinity; callers arrange that. r may alias a.
+ */
+void ec_jacobian_madd(const ec_curve_t* curve, ec_jacobian_t* r, const ec_jacobian_t* a, const ec_affine_t* b)
+{
+    const fe_modulus_t* m = &curve->fp;
+    fe_t z1z1, u2, s2, h, hh, i, j, rr, v, x3, y3, z3;
+    fe_sqr(m, z1z1, a->Z);
+    fe_mul(m, u2, b->x, z1z1);
+    fe_mul(m, s2, b->y, a->Z);
+    fe_mul(m, s2, s2, z1z1);
+    fe_sub(m, h, u2, a->X);
+    fe_sqr(m, hh, h);
+    fe_add(m, i, hh, hh);
+    fe_add(m, i, i, i);
+    fe_mul(m, j, h, i);
+    fe_sub(m, rr, s2, a->Y);
+    fe_add(m, rr, rr, rr);
+    fe_mul(m, v, a->X, i);
+    //X3 = r^2 - J - 2V
+    fe_sqr(m, x3, rr);
+    fe_sub(m, x3, x3, j);
+    fe_sub(m, x3, x3, v);
+    fe_sub(m, x3, x3, v);
+    //Y3 = r (V - X3) - 2 Y1 J
+    fe_sub(m, y3, v, x3);
+    fe_mul(m, y3, rr, y3);
+    fe_mul(m, j, a->Y, j);
+    fe_add(m, j, j, j);
+    fe_sub(m, y3, y3, j);
+    //Z3 = (Z1 + H)^2 - Z1Z1 - HH
+    fe_add(m, z3, a->Z, h);
+    fe_sqr(m, z3, z3);
+    fe_sub(m, z3, z3, z1z1);
+    fe_sub(m, z3, z3, hh);
+    fe_copy(r->X, x3);
+    fe_copy(r->Y, y3);
+    fe_copy(r->Z, z3);
+}
+
+/*
+ * ec_normalize_batch:
+ *   Affine (Montgomery form) images of count Jacobian points with a single
+ *   field inversion. Points at infinity come out as (0, 0).
+ */
+void ec_normalize_batch(const ec_curve_t* curve, const ec_jacobian_t* in, ec_affine_t* out, int count)
+{
+    if (count <= 0)
+        return;
+    const fe_modulus_t* m = &curve->fp;
+
+    //prefix[i] = Z_0 * ... * Z_i,无穷远点的Z按1计
+    fe_t* prefix = new fe_t[count];
+    fe_t z, inv, zinv, t;
+    for (int i = 0; i < count; i++)
+    {
+        fe_select(z, in[i].Z, m->one, fe_is_zero(in[i].Z));
+        if (i == 0)
+            fe_copy(prefix[0], z);
+        else
+            fe_mul(m, prefix[i], prefix[i-1], z);
+    }
+    fe_inv(m, inv, prefix[count-1]);
+
+    const fe_t zero = {0, 0, 0, 0};
+    for (int i = count-1; i >= 0; i--)
+    {
+        uint64_t at_inf = fe_is_zero(in[i].Z);
+        fe_select(z, in[i].Z, m->one, at_inf);
+        if (i == 0)
+            fe_copy(zinv, inv);
+        else
+            fe_mul(m, zinv, inv, prefix[i-1]);
+        fe_mul(m, inv, inv, z);
+
+        fe_sqr(m, t, zinv);
+        fe_mul(m, out[i].x, in[i].X, t);
+        fe_mul(m, t, t, zinv);
+        fe_mul(m, out[i].y, in[i].Y, t);
+        fe_select(out[i].x, out[i].x, zero, at_inf);
+        fe_select(out[i].y, out[i].y, zero, at_inf);
+    }
+    memset(prefix, 0, sizeof(fe_t) * (size_t)count);
+    delete [] prefix;
+}
+
+//按d*16^w*G建comb表,每个窗口的基点单独归一化,整表最后一次归一化
+static void build_comb(ec_curve_t* curve)
+{
+    const fe_modulus_t* m = &curve->fp;
+    int total = curve->comb_windows * EC_COMB_ENTRIES;
+    ec_jacobian_t* all = new ec_jacobian_t[total];
+    ec_affine_t base = curve->g;
+    for (int w = 0; w < curve->comb_windows; w++)
+    {
+        ec_jacobian_t* e = all + w * EC_COMB_ENTRIES;
+        fe_copy(e[0].X, base.x);
+        fe_copy(e[0].Y, base.y);
+        fe_copy(e[0].Z, m->one);
+        ec_jacobian_dbl(curve, &e[1], &e[0]);
+        for (int d = 2; d < EC_COMB_ENTRIES; d++)
+            ec_jacobian_madd(curve, &e[d], &e[d-1], &base);
+
+        ec_jacobian_t next;
+        ec_jacobian_dbl(curve, &next, &e[7]);
+        ec_normalize_batch(curve, &next, &base, 1);
+    }
+    curve->comb = new ec_affine_t[total];
+    ec_normalize_batch(curve, all, curve->comb, total);
+    delete [] all;
+}
+
+//大端字节转到模m的蒙哥马利形式
+static void mont_from_bytes(const fe_modulus_t* m, fe_t r, const uint8_t in[32])
+{
+    fe_t t;
+    fe_from_bytes(t, in);
+    fe_to_mont(m, r, t);
+}
+
+/*
+ * ec_curve_init:
+ *   Fill a curve from big-endian p, n, G and the a = -3 / a = 0 choice,
+ *   optionally with GLV constants (a = 0 only), and build its comb table.
+ */
+void ec_curve_init(ec_curve_t* curve, const uint8_t p[32], const uint8_t n[32], int a_minus3,
+                   const uint8_t gx[32], const uint8_t gy[32], const ec_glv_params_t* glv)
+{
+    fe_modulus_init(&curve->fp, p);
+    fe_modulus_init(&curve->fn, n);
+    curve->a_minus3 = a_minus3;
+    mont_from_bytes(&curve->fp, curve->g.x, gx);
+    mont_from_bytes(&curve->fp, curve->g.y, gy);
+
+    curve->glv = glv != NULL && !a_minus3;
+    curve->comb_windows = curve->glv ? EC_COMB_WINDOWS / 2 : EC_COMB_WINDOWS;
+    if (curve->glv)
+    {
+        mont_from_bytes(&curve->fp, curve->beta, glv->beta);
+        mont_from_bytes(&curve->fn, curve->lambda, glv->lambda);
+        fe_from_bytes(curve->g1, glv->g1);
+        fe_from_bytes(curve->g2, glv->g2);
+        mont_from_bytes(&curve->fn, curve->minus_b1, glv->minus_b1);
+        mont_from_bytes(&curve->fn, curve->minus_b2, glv->minus_b2);
+    }
+    build_comb(curve);
+}
+
+const ec_curve_t* ec_curve_p256(void)
+{
+    sgx_thread_mutex_lock(&curve_mutex);
+    if (!p256_ready)
+    {
+        ec_curve_init(&p256, p256_p, p256_n, 1, p256_gx, p256_gy, NULL);
+        p256_ready = 1;
+    }
+    sgx_thread_mutex_unlock(&curve_mutex);
+    return &p256;
+}
+
+const ec_curve_t* ec_curve_secp256k1(void)
+{
+    sgx_thread_mutex_lock(&curve_mutex);
+    if (!secp256k1_ready)
+    {
+        ec_curve_init(&secp256k1, secp256k1_p, secp256k1_n, 0, secp256k1_gx, secp256k1_gy, &k1_glv);
+        secp256k1_ready = 1;
+    }
+    sgx_thread_mutex_unlock(&curve_mutex);
+    return &secp256k1;
+}
+
+//round(k*g / 2^384),k与g各256位,结果不超过129位
+static void mul_shift_384(fe_t r, const fe_t k, const fe_t g)
+{
+    uint64_t t[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t c = 0;
+        for (int j = 0; j < 4; j++)
+            t[i+j] = fe_mac(k[j], g[i], t[i+j], &c);
+        t[i+4] = c;
+    }
+    unsigned char cc = 0;
+    r[0] = fe_adc(t[6], t[5] >> 63, &cc);
+    r[1] = fe_adc(t[7], 0, &cc);
+    r[2] = cc;
+    r[3] = 0;
+}
+
+//r = n - a (a非零时),mask全1时取负,否则不变
+static void cond_negate(const fe_modulus_t* m, fe_t r, const fe_t a, uint64_t mask)
+{
+    const fe_t zero = {0, 0, 0, 0};
+    fe_t neg;
+    fe_sub(m, neg, zero, a);
+    fe_select(r, a, neg, mask);
+}
+
+//大于n/2的视为负数,换成n-r并置符号掩码
+static void glv_sign(const fe_modulus_t* n, fe_t r, uint64_t* neg)
+{
+    fe_t half;
+    unsigned char b = 0;
+    for (int i = 0; i < 4; i++)
+        half[i] = (n->p[i] >> 1) | (i < 3 ? n->p[i+1] << 63 : 0);
+    for (int i = 0; i < 4; i++)
+        fe_sbb(half[i], r[i], &b);
+    *neg = 0 - (uint64_t)b;
+    cond_negate(n, r, r, *neg);
+}
+
+/*
+ * glv_split:
+ *   k = s1 k1 + s2 k2 lambda mod n with k1, k2 < 2^128; the signs come
+ *   back as masks (all ones for negative).
+ */
+static void glv_split(const ec_curve_t* curve, const uint8_t kb[32], fe_t k1, uint64_t* neg1, fe_t k2, uint64_t* neg2)
+{
+    const fe_modulus_t* n = &curve->fn;
+    fe_t k, c1, c2, t, r2;
+    uint64_t k5[5];
+    fe_from_bytes(k, kb);
+    memcpy(k5, k, sizeof(fe_t));
+    k5[4] = 0;
+    fe_reduce_once(n, k, k5);
+
+    //r2 = c1*(-b1) + c2*(-b2), r1 = k - r2*lambda
+    mul_shift_384(c1, k, curve->g1);
+    mul_shift_384(c2, k, curve->g2);
+    fe_to_mont(n, c1, c1);
+    fe_to_mont(n, c2, c2);
+    fe_mul(n, c1, c1, curve->minus_b1);
+    fe_mul(n, c2, c2, curve->minus_b2);
+    fe_add(n, r2, c1, c2);
+    fe_mul(n, t, r2, curve->lambda);
+    fe_from_mont(n, t, t);
+    fe_sub(n, k1, k, t);
+    fe_from_mont(n, k2, r2);
+
+    glv_sign(n, k1, neg1);
+    glv_sign(n, k2, neg2);
+    memset(k, 0, sizeof(k));
+    memset(k5, 0, sizeof(k5));
+    memset(r2, 0, sizeof(r2));
+    memset(t, 0, sizeof(t));
+}
+
+//扫描整行取出第d项,d=0时取到的值被丢弃
+static void comb_lookup(const ec_affine_t* row, unsigned d, ec_affine_t* entry)
+{
+    fe_copy(entry->x, row[0].x);
+    fe_copy(entry->y, row[0].y);
+    for (unsigned e = 2; e <= EC_COMB_ENTRIES; e++)
+    {
+        uint64_t hit = 0 - (uint64_t)((((d ^ e) - 1) >> 31) & 1);
+        fe_select(entry->x, entry->x, row[e-1].x, hit);
+        fe_select(entry->y, entry->y, row[e-1].y, hit);
+    }
+}
+
+//acc += entry (d非零时); acc为无穷远点时结果就是该项本身
+static void comb_add(const ec_curve_t* curve, ec_jacobian_t* acc, uint64_t* acc_inf, const ec_affine_t* entry, unsigned d)
+{
+    ec_jacobian_t sum;
+    ec_jacobian_madd(curve, &sum, acc, entry);
+    fe_select(sum.X, sum.X, entry->x, *acc_inf);
+    fe_select(sum.Y, sum.Y, entry->y, *acc_inf);
+    fe_select(sum.Z, sum.Z, curve->fp.one, *acc_inf);
+
+    uint64_t skip = 0 - (uint64_t)(((d - 1) >> 31) & 1);
+    fe_select(acc->X, sum.X, acc->X, skip);
+    fe_select(acc->Y, sum.Y, acc->Y, skip);
+    fe_select(acc->Z, sum.Z, acc->Z, skip);
+    *acc_inf &= skip;
+    memset(&sum, 0, sizeof(sum));
+}
+
+/*
+ * ec_mul_base:
+ *   r = k * G for a 32-byte big-endian k, left in Jacobian form.
+ */
+void ec_mul_base(const ec_curve_t* curve, ec_jacobian_t* r, const uint8_t k[32])
+{
+    const fe_modulus_t* m = &curve->fp;
+    ec_jacobian_t acc;
+    ec_affine_t entry;
+    uint64_t acc_inf = ~(uint64_t)0;
+    memset(&acc, 0, sizeof(acc));
+
+    if (curve->glv)
+    {
+        fe_t k1, k2;
+        uint64_t neg1, neg2;
+        glv_split(curve, k, k1, &neg1, k2, &neg2);
+        for (int w = 0; w < curve->comb_windows; w++)
+        {
+            const ec_affine_t* row = curve->comb + w * EC_COMB_ENTRIES;
+            unsigned d1 = (unsigned)(k1[w/16] >> (4*(w%16))) & 0xF;
+            unsigned d2 = (unsigned)(k2[w/16] >> (4*(w%16))) & 0xF;
+
+            comb_lookup(row, d1, &entry);
+            cond_negate(m, entry.y, entry.y, neg1);
+            comb_add(curve, &acc, &acc_inf, &entry, d1);
+
+            //phi(d*16^w*G) = (beta*x, y)
+            comb_lookup(row, d2, &entry);
+            fe_mul(m, entry.x, entry.x, curve->beta);
+            cond_negate(m, entry.y, entry.y, neg2);
+            comb_add(curve, &acc, &acc_inf, &entry, d2);
+        }
+        memset(k1, 0, sizeof(k1));
+        memset(k2, 0, sizeof(k2));
+    }
+    else
+    {
+        for (int w = 0; w < curve->comb_windows; w++)
+        {
+            unsigned d = (k[31 - w/2] >> (4*(w%2))) & 0xF;
+            comb_lookup(curve->comb + w * EC_COMB_ENTRIES, d, &entry);
+            comb_add(curve, &acc, &acc_inf, &entry, d);
+        }
+    }
+    *r = acc;
+    memset(&acc, 0, sizeof(acc));
+    memset(&entry, 0, sizeof(entry));
+}
+
+/*
+ * ec_public_keys:
+ *   pubs[i] = privs[i] * G as x||y for count 32-byte big-endian scalars,
+ *   with one inversion for the whole batch. Fails on a zero scalar.
+ */
+int ec_public_keys(const ec_curve_t* curve, const uint8_t* privs, int count, uint8_t* pubs)
+{
+    if (count <= 0)
+        return -1;
+    const fe_modulus_t* m = &curve->fp;
+
+    ec_jacobian_t* jac = new ec_jacobian_t[count];
+    ec_affine_t* aff = new ec_affine_t[count];
+    int ret = 0;
+    for (int i = 0; i < count; i++)
+    {
+        ec_mul_base(curve, &jac[i], privs + 32 * (size_t)i);
+        if (fe_is_zero(jac[i].Z))
+            ret = -1;
+    }
+    ec_normalize_batch(curve, jac, aff, count);
+
+    fe_t t;
+    for (int i = 0; i < count; i++)
+    {
+        fe_from_mont(m, t, aff[i].x);
+        fe_to_bytes(pubs + 64 * (size_t)i, t);
+        fe_from_mont(m, t, aff[i].y);
+        fe_to_bytes(pubs + 64 * (size_t)i + 32, t);
+    }
+    delete [] jac;
+    delete [] aff;
+    return ret;
+}
@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Multi-scalar multiplication, sum s_i * P_i, by the bucket method
+ * (Pippenger).
+ *
+ * Scalars are cut into c-bit windows. For each window every point is
+ * added once into the bucket named by its digit, and the buckets are
+ * folded with a running sum (sum_b b * B_b in 2^(c+1) additions), so a
+ * window costs n + 2^(c+1) additions instead of n scalar multiplications.
+ * Windows are combined Horner-style with c doublings each. IPP keeps
+ * points in projective form, so none of the additions inverts.
+ *
+ * Jobs leave the points and scalars in app memory and read them
+ * MSM_CHUNK at a time, so a job's enclave footprint does not grow with
+ * its size. Windows are independent, so a job splits them into parts
+ * that enclave threads run concurrently; each part returns its windows
+ * already shifted into place and the parts are simply added. A running
+ * part holds at most MSM_PART_BUCKETS buckets: it takes its windows in
+ * groups that fit and reads the input once per group. At most
+ * MSM_WORKSPACES parts run at a time, the rest wait for one to finish.
+ * The number of parts is fixed when the job is created, each part runs
+ * once, and end only succeeds once all of them have.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Curve.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_thread.h"
+#include "sgx_lfence.h"
+
+#define MSM_WINDOW_MAX   8     /* 255 buckets per window */
+#define MSM_PART_BUCKETS 256   /* buckets one running part may hold */
+#define MSM_CHUNK        64    /* points read from app memory at a time */
+#define MSM_WORKSPACES   4     /* parts running at once, across all jobs */
+#define MSM_JOBS         4
+#define MSM_PARTS_MAX    16
+
+/*
+ * msm_window:
+ *   Window width with the fewest additions for count points,
+ *   ceil(256/c) * (count + 2^(c+1)).
+ */
+int msm_window(int count)
+{
+    int best = 1;
+    uint64_t best_cost = ~(uint64_t)0;
+    for (int c = 1; c <= MSM_WINDOW_MAX; c++)
+    {
+        uint64_t cost = (uint64_t)((256 + c - 1) / c) * ((uint64_t)count + (2ull << c));
+        if (cost < best_cost)
+        {
+            best = c;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+/*
+ * msm_job_window:
+ *   Window width for a job of count points in 'parts' parts: the additions
+ *   of the largest part plus one point conversion per point and pass,
+ *   counted as one addition.
+ */
+static int msm_job_window(int count, int parts)
+{
+    int best = 1;
+    uint64_t best_cost = ~(uint64_t)0;
+    for (int c = 1; c <= MSM_WINDOW_MAX; c++)
+    {
+        int windows = (256 + c - 1) / c;
+        int per_part = (windows + parts - 1) / parts;
+        int group = MSM_PART_BUCKETS / ((1 << c) - 1);
+        int passes = (per_part + group - 1) / group;
+        uint64_t cost = (uint64_t)passes * (uint64_t)count + (uint64_t)per_part * ((uint64_t)count + (2ull << c));
+        if (cost < best_cost)
+        {
+            best = c;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+//取标量(大端32字节)从bit位起的c位
+static unsigned scalar_digit(const Ipp8u* s, int bit, int c)
+{
+    unsigned v = 0;
+    for (int b = 0; b < c && bit + b < 256; b++)
+    {
+        int pos = bit + b;
+        v |= (unsigned)((s[31 - pos/8] >> (pos%8)) & 1) << b;
+    }
+    return v;
+}
+
+//sum = sum_b (b+1)*B_b, running作中间累加
+static void fold_buckets(IppsECCPState* ec, IppsECCPPointState* const* buckets, int nb,
+                         IppsECCPPointState* running, IppsECCPPointState* sum)
+{
+    ippsECCPSetPointAtInfinity(running, ec);
+    ippsECCPSetPointAtInfinity(sum, ec);
+    for (int b = nb-1; b >= 0; b--)
+    {
+        ippsECCPAddPoint(running, buckets[b], running, ec);
+        ippsECCPAddPoint(sum, running, sum, ec);
+    }
+}
+
+/*
+ * ec_msm_windows:
+ *   result = sum over windows w in [wlo, whi) of 2^(w*c) * sum_i digit_w(s_i) * P_i.
+ */
+int ec_msm_windows(IppsECCPState* ec, IppsECCPPointState* const* points, const Ipp8u* scalars, int count,
+                   int c, int wlo, int whi, IppsECCPPointState* result)
+{
+    const int nb = (1 << c) - 1;
+
+    IppsECCPPointState** buckets = newPointArray(nb + 2);
+    IppsECCPPointState* running = buckets[nb];
+    IppsECCPPointState* sum = buckets[nb+1];
+
+    ippsECCPSetPointAtInfinity(result, ec);
+    for (int w = whi-1; w >= wlo; w--)
+    {
+        if (w != whi-1)
+            for (int i = 0; i < c; i++)
+                ippsECCPAddPoint(result, result, result, ec);
+
+        for (int b = 0; b < nb; b++)
+            ippsECCPSetPointAtInfinity(buckets[b], ec);
+        for (int i = 0; i < count; i++)
+        {
+            unsigned d = scalar_digit(scalars + 32*(size_t)i, w*c, c);
+            if (d)
+                ippsECCPAddPoint(buckets[d-1], points[i], buckets[d-1], ec);
+        }
+        fold_buckets(ec, buckets, nb, running, sum);
+        ippsECCPAddPoint(result, sum, result, ec);
+    }
+
+    //移到第wlo个窗口的位置
+    for (int i = 0; i < wlo*c; i++)
+        ippsECCPAddPoint(result, result, result, ec);
+
+    deletePointArray(buckets);
+    return 0;
+}
+
+int ec_msm(IppsECCPState* ec, IppsECCPPointState* const* points, const Ipp8u* scalars, int count,
+           IppsECCPPointState* result)
+{
+    int c = msm_window(count);
+    return ec_msm_windows(ec, points, scalars, count, c, 0, (256 + c - 1) / c, result);
+}
+
+typedef struct _msm_job_t {
+    int active;
+    int ready;
+    int running;        /* parts currently inside msm_job_run */
+    int count;
+    int c;
+    int parts;
+    uint32_t claimed;   /* parts started, one bit each */
+    uint32_t done;      /* parts finished without error */
+    const uint8_t* points;   /* app memory, x||y per point */
+    const uint8_t* scalars;  /* app memory, 32-byte big-endian */
+    IppsECCPPointState** partial;
+} msm_job_t;
+
+static msm_job_t jobs[MSM_JOBS];
+static int spaces_used;     /* running parts, at most MSM_WORKSPACES */
+static sgx_thread_mutex_t jobs_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+static sgx_thread_cond_t spaces_free = SGX_THREAD_COND_INITIALIZER;
+
+//查找和登记在同一把锁下: 运行中的job不会被end释放,每个部分只跑一次;
+//登记后等到有空闲的桶空间才返回
+static msm_job_t* claim_part(uint32_t job, int part, int parts)
+{
+    if (job >= MSM_JOBS)
+        return NULL;
+    sgx_lfence();
+    msm_job_t* j = NULL;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    msm_job_t* cand = &jobs[job];
+    if (cand->ready && parts == cand->parts && part >= 0 && part < parts && !(cand->claimed & (1u << part)))
+    {
+        cand->claimed |= 1u << part;
+        cand->running++;
+        j = cand;
+        while (spaces_used >= MSM_WORKSPACES)
+            sgx_thread_cond_wait(&spaces_free, &jobs_mutex);
+        spaces_used++;
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    return j;
+}
+
+static void finish_part(msm_job_t* j, int part, int ok)
+{
+    sgx_thread_mutex_lock(&jobs_mutex);
+    if (ok)
+        j->done |= 1u << part;
+    j->running--;
+    spaces_used--;
+    sgx_thread_cond_signal(&spaces_free);
+    sgx_thread_mutex_unlock(&jobs_mutex);
+}
+
+//取走一个没有部分在跑的job,之后别的调用都找不到它
+static msm_job_t* take_job(uint32_t job)
+{
+    if (job >= MSM_JOBS)
+        return NULL;
+    sgx_lfence();
+    msm_job_t* j = NULL;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    if (jobs[job].ready && jobs[job].running == 0)
+    {
+        jobs[job].ready = 0;
+        j = &jobs[job];
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    return j;
+}
+
+//调用方独占j: 已被take_job取走
+static void free_job(msm_job_t* j)
+{
+    if (j->partial)
+        deletePointArray(j->partial);
+    sgx_thread_mutex_lock(&jobs_mutex);
+    memset(j, 0, sizeof(*j));
+    sgx_thread_mutex_unlock(&jobs_mutex);
+}
+
+//占一个空闲job,记下app内存里的输入;enclave内只有各部分的结果
+static int new_job(const uint8_t* points, const uint8_t* scalars, int count, int parts, uint32_t* job)
+{
+    if (parts <= 0 || parts > MSM_PARTS_MAX)
+        return -1;
+
+    uint32_t slot = MSM_JOBS;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    for (uint32_t i = 0; i < MSM_JOBS; i++)
+    {
+        if (!jobs[i].active)
+        {
+            jobs[i].active = 1;
+            slot = i;
+            break;
+        }
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    if (slot == MSM_JOBS)
+        return -1;
+
+    msm_job_t* j = &jobs[slot];
+    j->count = count;
+    j->c = msm_job_window(count, parts);
+    j->parts = parts;
+    j->points = points;
+    j->scalars = scalars;
+    j->partial = newPointArray(parts);
+    IppsECCPState* ec = newSecp256k1_ECP();
+    for (int i = 0; i < parts; i++)
+        ippsECCPSetPointAtInfinity(j->partial[i], ec);
+    delete [] (Ipp8u*) ec;
+
+    //之后才对run/end可见
+    sgx_thread_mutex_lock(&jobs_mutex);
+    j->ready = 1;
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    *job = slot;
+    return 0;
+}
+
+/*
+ * msm_part:
+ *   Windows [wlo, whi) of job j, shifted into place. The windows are
+ *   taken in groups whose buckets fit MSM_PART_BUCKETS, each group one
+ *   pass over the input, MSM_CHUNK points at a time; every point is
+ *   checked on the curve as it is read.
+ */
+static int msm_part(IppsECCPState* ec, const msm_job_t* j, int wlo, int whi, IppsECCPPointState* result)
+{
+    const int c = j->c;
+    const int nb = (1 << c) - 1;
+    const int group = MSM_PART_BUCKETS / nb;
+
+    IppsECCPPointState** buckets = newPointArray(group * nb + 2);
+    IppsECCPPointState* running = buckets[group * nb];
+    IppsECCPPointState* sum = buckets[group * nb + 1];
+    IppsECCPPointState** pts = newPointArray(MSM_CHUNK);
+    Ipp8u s[32 * MSM_CHUNK];
+    Ipp8u buf[EC_POINT_SIZE];
+
+    int ret = 0;
+    ippsECCPSetPointAtInfinity(result, ec);
+    for (int top = whi; top > wlo && ret == 0; top -= group)
+    {
+        int bottom = top - group > wlo ? top - group : wlo;
+        for (int b = 0; b < (top - bottom) * nb; b++)
+            ippsECCPSetPointAtInfinity(buckets[b], ec);
+
+        for (int base = 0; base < j->count && ret == 0; base += MSM_CHUNK)
+        {
+            int m = j->count - base < MSM_CHUNK ? j->count - base : MSM_CHUNK;
+            memcpy(s, j->scalars + 32 * (size_t)base, 32 * (size_t)m);
+            for (int i = 0; i < m && ret == 0; i++)
+            {
+                memcpy(buf, j->points + EC_POINT_SIZE * (size_t)(base + i), sizeof(buf));
+                ret = ec_set_point(ec, buf, pts[i]);
+            }
+            for (int w = bottom; w < top && ret == 0; w++)
+            {
+                IppsECCPPointState** wb = buckets + (size_t)(w - bottom) * nb;
+                for (int i = 0; i < m; i++)
+                {
+                    unsigned d = scalar_digit(s + 32*(size_t)i, w*c, c);
+                    if (d)
+                        ippsECCPAddPoint(wb[d-1], pts[i], wb[d-1], ec);
+                }
+            }
+        }
+
+        for (int w = top-1; w >= bottom && ret == 0; w--)
+        {
+            if (w != whi-1)
+                for (int i = 0; i < c; i++)
+                    ippsECCPAddPoint(result, result, result, ec);
+            fold_buckets(ec, buckets + (size_t)(w - bottom) * nb, nb, running, sum);
+            ippsECCPAddPoint(result, sum, result, ec);
+        }
+    }
+
+    //移到第wlo个窗口的位置
+    for (int i = 0; i < wlo*c && ret == 0; i++)
+        ippsECCPAddPoint(result, result, result, ec);
+
+    deletePointArray(pts);
+    deletePointArray(buckets);
+    return ret;
+}
+
+/*
+ * msm_job_begin:
+ *   Start a job over count secp256k1 points (x||y) and 32-byte big-endian
+ *   scalars in app memory, to be evaluated in 'parts' parts. The inputs
+ *   are public and are read in place by every part, so they must stay
+ *   unchanged until msm_job_end; a point off the curve fails its part.
+ */
+int msm_job_begin(const uint8_t* points, const uint8_t* scalars, int count, int parts, uint32_t* job)
+{
+    if (count <= 0 || count > MSM_MAX_POINTS || points == NULL || scalars == NULL ||
+        sgx_is_outside_enclave(points, (size_t)count * EC_POINT_SIZE) != 1 ||
+        sgx_is_outside_enclave(scalars, (size_t)count * 32) != 1)
+        return -1;
+    sgx_lfence();
+    return new_job(points, scalars, count, parts, job);
+}
+
+/*
+ * msm_bench_begin:
+ *   Fill the app buffers with count random points and scalars, for
+ *   timing the engine, and start a job over them as msm_job_begin does.
+ *   Points are P_i = P_0 + i*Q, one addition each.
+ */
+int msm_bench_begin(uint8_t* points, uint8_t* scalars, int count, int parts, uint32_t* job)
+{
+    if (count <= 0 || count > MSM_MAX_POINTS || points == NULL || scalars == NULL ||
+        sgx_is_outside_enclave(points, (size_t)count * EC_POINT_SIZE) != 1 ||
+        sgx_is_outside_enclave(scalars, (size_t)count * 32) != 1)
+        return -1;
+    sgx_lfence();
+
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsECCPPointState** pts = newPointArray(2);
+    IppsBigNumState* r = newBN(ORDER_WORDS);
+    IppsBigNumState* bnq = newOrderBN();
+    Ipp8u rb[32 * MSM_CHUNK];
+    int ret = 0;
+    for (int i = 0; i < 2 && ret == 0; i++)
+    {
+        ret = sgx_read_rand(rb, 32) == SGX_SUCCESS ? 0 : -1;
+        ippsSetOctString_BN(rb, 32, r);
+        ippsMod_BN(r, bnq, r);
+        ippsECCPPublicKey(r, pts[i], ec);
+    }
+    for (int base = 0; base < count && ret == 0; base += MSM_CHUNK)
+    {
+        int m = count - base < MSM_CHUNK ? count - base : MSM_CHUNK;
+        ret = sgx_read_rand(rb, 32 * (size_t)m) == SGX_SUCCESS ? 0 : -1;
+        memcpy(scalars + 32 * (size_t)base, rb, 32 * (size_t)m);
+        for (int i = 0; i < m; i++)
+        {
+            ec_get_point(ec, pts[0], points + EC_POINT_SIZE * (size_t)(base + i));
+            ippsECCPAddPoint(pts[0], pts[1], pts[0], ec);
+        }
+    }
+
+    delete [] (Ipp8u*) r;
+    delete [] (Ipp8u*) bnq;
+    deletePointArray(pts);
+    delete [] (Ipp8u*) ec;
+    return ret == 0 ? new_job(points, scalars, count, parts, job) : -1;
+}
+
+/*
+ * msm_job_run:
+ *   Evaluate the windows of part 'part' of 'parts'; parts must be the
+ *   value the job was created with. Parts are independent and may run
+ *   concurrently, one per enclave thread, but each only once.
+ */
+int msm_job_run(uint32_t job, int part, int parts)
+{
+    msm_job_t* j = claim_part(job, part, parts);
+    if (j == NULL)
+        return -1;
+
+    //每个线程各用一个曲线上下文
+    int windows = (256 + j->c - 1) / j->c;
+    int wlo = windows * part / parts;
+    int whi = windows * (part + 1) / parts;
+    IppsECCPState* ec = newSecp256k1_ECP();
+    int ret = msm_part(ec, j, wlo, whi, j->partial[part]);
+    delete [] (Ipp8u*) ec;
+    finish_part(j, part, ret == 0);
+    return ret;
+}
+
+/*
+ * msm_job_end:
+ *   Add up the parts into result (x||y, zero for infinity) and free the job.
+ *   Fails while a part is still running; frees the job but fails if some
+ *   part never completed.
+ */
+int msm_job_end(uint32_t job, uint8_t* result)
+{
+    msm_job_t* j = take_job(job);
+    if (j == NULL)
+        return -1;
+
+    int ret = -1;
+    memset(result, 0, 64);
+    if (j->done == (uint32_t)((1ull << j->parts) - 1))
+    {
+        IppsECCPState* ec = newSecp256k1_ECP();
+        IppsECCPPointState** acc = newPointArray(1);
+        ippsECCPSetPointAtInfinity(acc[0], ec);
+        for (int i = 0; i < j->parts; i++)
+            ippsECCPAddPoint(acc[0], j->partial[i], acc[0], ec);
+        ec_get_point(ec, acc[0], result);
+        deletePointArray(acc);
+        delete [] (Ipp8u*) ec;
+        ret = 0;
+    }
+    free_job(j);
+    return ret;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Point helpers shared by the curve code: point arrays in one allocation
+ * and conversion to and from the 64-byte x||y wire form.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Curve.h"
+
+IppsECCPPointState** newPointArray(int count)
+{
+    int ctxSize;
+    ippsECCPPointGetSize(256, &ctxSize);
+    ctxSize = (ctxSize + 63) & ~63;
+
+    Ipp8u* block = new Ipp8u [(size_t)count*ctxSize + sizeof(IppsECCPPointState*)*(size_t)count + 64];
+    IppsECCPPointState** pts = (IppsECCPPointState**)block;
+    Ipp8u* ctx = block + sizeof(IppsECCPPointState*)*(size_t)count;
+    ctx = (Ipp8u*)(((uintptr_t)ctx + 63) & ~(uintptr_t)63);
+    for (int i = 0; i < count; i++)
+    {
+        pts[i] = (IppsECCPPointState*)(ctx + (size_t)i*ctxSize);
+        ippsECCPPointInit(256, pts[i]);
+    }
+    return pts;
+}
+
+void deletePointArray(IppsECCPPointState** pts)
+{
+    delete[] (Ipp8u*)pts;
+}
+
+/*
+ * ec_get_point:
+ *   Write pt as x||y, 32-byte big-endian each; infinity becomes all zero.
+ */
+void ec_get_point(IppsECCPState* ec, const IppsECCPPointState* pt, Ipp8u out[EC_POINT_SIZE])
+{
+    IppECResult res;
+    ippsECCPCheckPoint(pt, &res, ec);
+    if (res == ippECPointIsAtInfinite)
+    {
+        memset(out, 0, EC_POINT_SIZE);
+        return;
+    }
+
+    IppsBigNumState* x = newBN(ORDER_WORDS);
+    IppsBigNumState* y = newBN(ORDER_WORDS);
+    ippsECCPGetPoint(x, y, pt, ec);
+    ippsGetOctString_BN(out, 32, x);
+    ippsGetOctString_BN(out + 32, 32, y);
+    delete [] (Ipp8u*) x;
+    delete [] (Ipp8u*) y;
+}
+
+/*
+ * ec_set_point:
+ *   Read x||y into pt; points off the curve (or at infinity) are rejected.
+ */
+int ec_set_point(IppsECCPState* ec, const Ipp8u in[EC_POINT_SIZE], IppsECCPPointState* pt)
+{
+    IppsBigNumState* x = newBN(ORDER_WORDS);
+    IppsBigNumState* y = newBN(ORDER_WORDS);
+    ippsSetOctString_BN(in, 32, x);
+    ippsSetOctString_BN(in + 32, 32, y);
+    ippsECCPSetPoint(x, y, pt, ec);
+    delete [] (Ipp8u*) x;
+    delete [] (Ipp8u*) y;
+
+    IppECResult res;
+    ippsECCPCheckPoint(pt, &res, ec);
+    return res == ippECValid ? 0 : -1;
+}
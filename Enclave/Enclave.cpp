@@ -35,9 +35,13 @@
 #include <stdio.h> /* vsnprintf */
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sgx_trts.h>
 
 #include "ippcp.h"
+#include "KeyStore/KeyStore.h"
+#include "merkle.h"
+#include "Sharing/PrimeField.h"
 
 #define Delen 50
 #define Solen 100
@@ -169,202 +173,695 @@ IppsECCPPointState* newECP_256_point(void)
 }
 
 
-//根据x和多项式求y
-IppsBigNumState* calculate_Y(IppsBigNumState* x, IppsBigNumState** poly, int polylen)
+//曲线阶q,多项式与份额都在模q下计算
+static const Ipp8u order_q[] = "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xBA\xAE\xDC\xE6\xAF\x48\xA0\x3B\xBF\xD2\x5E\x8C\xD0\x36\x41\x41";
+
+//curve为SHARE_CURVE_ED25519时取ed25519的群阶L
+IppsBigNumState* newOrderBN(int curve)
+{
+    IppsBigNumState* bnq = newBN(ORDER_WORDS);
+    ippsSetOctString_BN(curve == SHARE_CURVE_ED25519 ? ed25519_l : order_q, ORDER_BYTES, bnq);
+    return bnq;
+}
+
+/*
+ * newSecp256k1_ECP:
+ *   IPP has no standard secp256k1 context, so set it up from the domain
+ *   parameters (a = 0, b = 7, cofactor 1); its order is order_q.
+ */
+IppsECCPState* newSecp256k1_ECP(void)
+{
+    int ctxSize;
+    ippsECCPGetSize(256, &ctxSize);
+    IppsECCPState *pCtx = (IppsECCPState*)(new Ipp8u [ctxSize]);
+    ippsECCPInit(256, pCtx);
+
+    Ipp32u zero = 0, seven = 7;
+    IppsBigNumState* p = newBN(ORDER_WORDS);
+    IppsBigNumState* a = newBN(1, &zero);
+    IppsBigNumState* b = newBN(1, &seven);
+    IppsBigNumState* gx = newBN(ORDER_WORDS);
+    IppsBigNumState* gy = newBN(ORDER_WORDS);
+    IppsBigNumState* q = newOrderBN();
+    ippsSetOctString_BN(secp256k1_p, ORDER_BYTES, p);
+    ippsSetOctString_BN(secp256k1_gx, ORDER_BYTES, gx);
+    ippsSetOctString_BN(secp256k1_gy, ORDER_BYTES, gy);
+    ippsECCPSet(p, a, b, gx, gy, q, 1, pCtx);
+
+    delete [] (Ipp8u*) p;
+    delete [] (Ipp8u*) a;
+    delete [] (Ipp8u*) b;
+    delete [] (Ipp8u*) gx;
+    delete [] (Ipp8u*) gy;
+    delete [] (Ipp8u*) q;
+    return pCtx;
+}
+
+/*
+ * newBNArray:
+ *   count big numbers of len words carved out of one heap block, so a
+ *   sharing run costs one allocation instead of one per share.
+ */
+IppsBigNumState** newBNArray(int count, int len)
 {
-    Ipp32u one = 1;
-    const Ipp8u maxp[] ="\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xBA\xAE\xDC\xE6\xAF\x48\xA0\x3B\xBF\xD2\x5E\x8C\xD0\x36\x41\x41";
-    IppsBigNumState* bnMaxp = newBN(8);
-    ippsSetOctString_BN(maxp, 32, bnMaxp);
+    int ctxSize;
+    ippsBigNumGetSize(len, &ctxSize);
+    ctxSize = (ctxSize + 63) & ~63;
+
+    Ipp8u* block = new Ipp8u [(size_t)count*ctxSize + sizeof(IppsBigNumState*)*(size_t)count + 64];
+    IppsBigNumState** pBN = (IppsBigNumState**)block;
+    Ipp8u* ctx = block + sizeof(IppsBigNumState*)*(size_t)count;
+    ctx = (Ipp8u*)(((uintptr_t)ctx + 63) & ~(uintptr_t)63);
+    for (int i = 0; i < count; i++)
+    {
+        pBN[i] = (IppsBigNumState*)(ctx + (size_t)i*ctxSize);
+        ippsBigNumInit(len, pBN[i]);
+    }
+    return pBN;
+}
 
-    int bigsize = sizeof(maxp)/sizeof(Ipp32u);
-    IppsBigNumState* bntmp = newBN(1,&one);
+void deleteBNArray(IppsBigNumState** pBN)
+{
+    delete[] (Ipp8u*)pBN;
+}
 
-    IppsBigNumState* bnytmp = newBN(2*bigsize);
-	for (int i = 0; i < polylen; i++) {
-        IppsBigNumState* coeff = poly[i];
-        IppsBigNumState* tmpMul = newBN(bigsize*2);
+void share_ctx_init(share_ctx_t* ctx, int curve)
+{
+    ctx->q = newOrderBN(curve);
+    ctx->x = newBN(ORDER_WORDS);
+    ctx->wide = newBN(WIDE_WORDS);
+    ctx->m = share_modulus(curve);
+}
+
+void share_ctx_free(share_ctx_t* ctx)
+{
+    delete[] (Ipp8u*)ctx->q;
+    delete[] (Ipp8u*)ctx->x;
+    delete[] (Ipp8u*)ctx->wide;
+}
+
+//BN先模q再转成域元素
+static void bn_to_elem(const pf_order& f, share_ctx_t* ctx, const IppsBigNumState* a, pf_order::elem& r)
+{
+    Ipp8u b[ORDER_BYTES];
+    ippsMod_BN(a, ctx->q, ctx->wide);
+    ippsGetOctString_BN(b, ORDER_BYTES, ctx->wide);
+    f.from_bytes(r, b);
+    memset(b, 0, sizeof(b));
+}
+
+static void elem_to_bn(const pf_order& f, const pf_order::elem& a, IppsBigNumState* r)
+{
+    Ipp8u b[ORDER_BYTES];
+    f.to_bytes(b, a);
+    ippsSetOctString_BN(b, ORDER_BYTES, r);
+    memset(b, 0, sizeof(b));
+}
+
+//系数只转换一次,求值全在pf_order后端上
+static pf_order::elem* load_poly(const pf_order& f, share_ctx_t* ctx, IppsBigNumState* const* poly, int k)
+{
+    pf_order::elem* coef = new pf_order::elem[k];
+    for (int i = 0; i < k; i++)
+        bn_to_elem(f, ctx, poly[i], coef[i]);
+    return coef;
+}
+
+static void free_elems(pf_order::elem* e, int count)
+{
+    memset(e, 0, sizeof(pf_order::elem) * (size_t)count);
+    delete [] e;
+}
+
+/*
+ * share_eval_at:
+ *   piece[i] = f(xs[i]) for i < count, on the pf_order backend.
+ */
+void share_eval_at(share_ctx_t* ctx, IppsBigNumState* const* poly, int piece_k, const Ipp32u* xs, IppsBigNumState** piece,
+                   int count)
+{
+    pf_order f(ctx->m);
+    pf_order::elem* coef = load_poly(f, ctx, poly, piece_k);
+    pf_order::elem x, acc;
+    for (int i = 0; i < count; i++)
+    {
+        f.set_u32(x, xs[i]);
+        acc = coef[piece_k - 1];
+        for (int j = piece_k - 2; j >= 0; j--)
+        {
+            f.mul(acc, acc, x);
+            f.add(acc, acc, coef[j]);
+        }
+        elem_to_bn(f, acc, piece[i]);
+    }
+    memset(&acc, 0, sizeof(acc));
+    free_elems(coef, piece_k);
+}
 
-        ippsMul_BN(coeff, bntmp, tmpMul);
-        ippsAdd_BN(tmpMul, bnytmp, bnytmp);
-        
-        ippsMul_BN(bntmp,x,bntmp);
-        delete[] (Ipp8u*)tmpMul;
-	}
+void eval_share(share_ctx_t* ctx, IppsBigNumState* const* poly, int k, Ipp32u x, IppsBigNumState* y)
+{
+    share_eval_at(ctx, poly, k, &x, &y, 1);
+}
 
-    IppsBigNumState* bny = newBN(bigsize);
-    ippsMod_BN(bnytmp, bnMaxp, bny);
+/*
+ * share_eval_all:
+ *   piece[i] = f(i+1) for i < n, through the fixed kernel of the policy
+ *   when there is one, else pf_eval_all.
+ */
+void share_eval_all(share_ctx_t* ctx, IppsBigNumState* const* poly, int piece_k, IppsBigNumState** piece, int piece_n)
+{
+    pf_order f(ctx->m);
+    pf_order::elem* coef = load_poly(f, ctx, poly, piece_k);
+    pf_order::elem* y = new pf_order::elem[piece_n];
+    if (pf_eval_policy(f, coef, piece_k, y, piece_n) != 0)
+        pf_eval_all(f, coef, piece_k, y, piece_n);
+    for (int i = 0; i < piece_n; i++)
+        elem_to_bn(f, y[i], piece[i]);
+    free_elems(y, piece_n);
+    free_elems(coef, piece_k);
+}
 
-    delete[] (Ipp8u*)bntmp;
-    delete[] (Ipp8u*)bnMaxp;
-	return bny;	
+//模q运算,结果保持在[0,q); r可以与a/b相同
+void mod_add(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* b)
+{
+    Ipp32u cmp;
+    ippsAdd_BN(r, b, r);
+    ippsCmp_BN(r, ctx->q, &cmp);
+    if (cmp != IPP_IS_LT)
+        ippsSub_BN(r, ctx->q, r);
 }
 
+void mod_sub(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* b)
+{
+    Ipp32u cmp;
+    ippsAdd_BN(r, ctx->q, r);
+    ippsSub_BN(r, b, r);
+    ippsCmp_BN(r, ctx->q, &cmp);
+    if (cmp != IPP_IS_LT)
+        ippsSub_BN(r, ctx->q, r);
+}
 
-//使用x数组根据拉格朗日插值法计算secrete,默认数组长度为3
-IppsBigNumState* verify(IppsBigNumState** piece)
+void mod_mul(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* a, const IppsBigNumState* b)
 {
-    //Ipp32u maxp[] = {0xD0364141, 0xBFD25E8C, 0xAF48A03B, 0xBAAEDCE6, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF};
-    const Ipp8u maxp[] ="\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xBA\xAE\xDC\xE6\xAF\x48\xA0\x3B\xBF\xD2\x5E\x8C\xD0\x36\x41\x41";
-    IppsBigNumState* bnMaxp = newBN(8);
-    ippsSetOctString_BN(maxp, 32, bnMaxp);
+    ippsMul_BN(a, b, ctx->wide);
+    ippsMod_BN(ctx->wide, ctx->q, r);
+}
 
-    int bigsize = sizeof(maxp)/sizeof(Ipp32u);
+//x_j - x_i mod q
+static void set_diff(share_ctx_t* ctx, IppsBigNumState* r, Ipp32u xj, Ipp32u xi)
+{
+    Ipp32u d = xj > xi ? xj-xi : xi-xj;
+    ippsSet_BN(IppsBigNumPOS, 1, &d, r);
+    if (xj < xi)
+        ippsSub_BN(ctx->q, r, r);
+}
 
 /*
-    Ipp32u maxp = 839;
-    int bigsize = 1;
-    IppsBigNumState* bnMaxp = newBN(1, &maxp);
-    */
+ * lagrange_weights:
+ *   Weights w_i with f(z) = sum w_i * f(x_i) for the k abscissae xs. With
+ *   N = prod (z - x_j) they are w_i = N / ((z - x_i) * prod_{j!=i} (x_i - x_j));
+ *   all k denominators are inverted together (Montgomery's trick), so the
+ *   whole basis costs one modular inversion instead of k.
+ */
+void lagrange_weights(share_ctx_t* ctx, const Ipp32u* xs, int piece_k, const IppsBigNumState* z, IppsBigNumState** w)
+{
+    IppsBigNumState* d = newBN(ELEM_WORDS);
+    Ipp32u cmp, zero = 0, one = 1;
 
-    IppsBigNumState* secrete = newBN(bigsize);
-    IppsBigNumState* secretetmp = newBN(2*bigsize);
+    //z正好是某个份额的横坐标时权重只有该份额为1
+    for (int i = 0; i < piece_k; i++)
+    {
+        ippsSet_BN(IppsBigNumPOS, 1, &xs[i], d);
+        ippsCmp_BN(z, d, &cmp);
+        if (cmp == IPP_IS_EQ)
+        {
+            for (int j = 0; j < piece_k; j++)
+                ippsSet_BN(IppsBigNumPOS, 1, j == i ? &one : &zero, w[j]);
+            delete [] (Ipp8u*) d;
+            return;
+        }
+    }
+
+    IppsBigNumState** den = newBNArray(piece_k, ELEM_WORDS);
+    IppsBigNumState** prefix = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState* N = newBN(ORDER_WORDS);
+    IppsBigNumState* inv = newBN(ORDER_WORDS);
 
-    for (int i = 0; i < 3; i++)
+    ippsSet_BN(IppsBigNumPOS, 1, &one, N);
+    for (int i = 0; i < piece_k; i++)
     {
-        Ipp32u piece_i = i+1;
-        Ipp32u one = 1;
-        IppsBigNumState* bn_one = newBN(1, &one);
-        IppsBigNumState* bn_tmp = newBN(bigsize);
-        ippsAdd_BN(bn_tmp, bn_one, bn_tmp);
-        IppsBigNumState* bn_mulpiece = newBN(2*bigsize);
-        for (int j = 0; j < 3; j++)
+        ippsMod_BN(z, ctx->q, den[i]);
+        ippsSet_BN(IppsBigNumPOS, 1, &xs[i], d);
+        mod_sub(ctx, den[i], d);
+        mod_mul(ctx, N, N, den[i]);
+        for (int j = 0; j < piece_k; j++)
         {
             if (j == i)
                 continue;
-            Ipp32u k = j-i;
-            Ipp32u incj = j+1;
-            int negative = 0;
-            if (j < i)
-            {
-                negative = 1;
-                k = i-j;    
-            }
-            IppsBigNumState* bn_k = newBN(1, &k);
-            IppsBigNumState* bn_j = newBN(1, &incj);
-            IppsBigNumState* bn_inverse = newBN(bigsize);
-            IppStatus st = ippsModInv_BN(bn_k,bnMaxp,bn_inverse);
-            if (negative == 1)
-                ippsSub_BN(bnMaxp, bn_inverse,bn_inverse);
-
-            IppsBigNumState* bn_mulj = newBN(bigsize*2);
-            IppsBigNumState* bn_multmp = newBN(bigsize);
-            ippsMul_BN(bn_inverse, bn_j, bn_mulj);
-            ippsMod_BN(bn_mulj, bnMaxp, bn_multmp);
-
-            ippsMul_BN(bn_multmp, bn_tmp, bn_mulj);
-            ippsMod_BN(bn_mulj, bnMaxp, bn_tmp);
-
-            delete [] (Ipp8u*)bn_k;
-            delete [] (Ipp8u*)bn_j;
-            delete [] (Ipp8u*)bn_inverse;
-            delete [] (Ipp8u*)bn_mulj;
-            delete [] (Ipp8u*)bn_multmp;
+            set_diff(ctx, d, xs[i], xs[j]);
+            mod_mul(ctx, den[i], den[i], d);
         }
+        if (i == 0)
+            ippsMod_BN(den[0], ctx->q, prefix[0]);
+        else
+            mod_mul(ctx, prefix[i], prefix[i-1], den[i]);
+    }
 
+    ippsModInv_BN(prefix[piece_k-1], ctx->q, inv);
 
-        ippsMul_BN(piece[i],bn_tmp,bn_mulpiece);
-//        Type_BN("bntmp is", bn_mulpiece);
-        ippsAdd_BN(bn_mulpiece, secretetmp, secretetmp);
-
-        delete [] (Ipp8u*)bn_tmp;
-        delete [] (Ipp8u*)bn_mulpiece;
+    //从后往前剥离: inv(den_i) = inv(prefix_i) * prefix_{i-1}
+    for (int i = piece_k-1; i >= 0; i--)
+    {
+        if (i > 0)
+        {
+            mod_mul(ctx, w[i], inv, prefix[i-1]);
+            mod_mul(ctx, inv, inv, den[i]);
+        }
+        else
+        {
+            ippsMod_BN(inv, ctx->q, w[i]);
+        }
+        mod_mul(ctx, w[i], w[i], N);
     }
 
-    ippsMod_BN(secretetmp, bnMaxp, secrete);
+    deleteBNArray(den);
+    deleteBNArray(prefix);
+    delete [] (Ipp8u*) N;
+    delete [] (Ipp8u*) d;
+    delete [] (Ipp8u*) inv;
+}
 
-    delete [] (Ipp8u*) bnMaxp;
-    delete [] (Ipp8u*) secretetmp;
+/*
+ * interpolate:
+ *   Lagrange interpolation at z from k shares with abscissae xs.
+ */
+IppsBigNumState* interpolate(IppsBigNumState** piece, const Ipp32u* xs, int piece_k, const IppsBigNumState* z, int curve)
+{
+    share_ctx_t ctx;
+    share_ctx_init(&ctx, curve);
+
+    IppsBigNumState* secrete = newBN(ELEM_WORDS);
+    IppsBigNumState** w = newBNArray(piece_k, ORDER_WORDS);
+    lagrange_weights(&ctx, xs, piece_k, z, w);
+    for (int i = 0; i < piece_k; i++)
+    {
+        mod_mul(&ctx, w[i], w[i], piece[i]);
+        mod_add(&ctx, secrete, w[i]);
+    }
+
+    deleteBNArray(w);
+    share_ctx_free(&ctx);
 
     return secrete;
 }
 
-void secret_sharing(char* pDst, int piece_n, int piece_k)
-//void secret_sharing(char *pubA, int piece_n, int piece_k)
+//使用k个份额(横坐标xs)根据拉格朗日插值法在0点恢复secrete, 在pf_order后端上计算
+IppsBigNumState* verify(IppsBigNumState** piece, const Ipp32u* xs, int piece_k, int curve)
 {
+    share_ctx_t ctx;
+    share_ctx_init(&ctx, curve);
+    pf_order f(ctx.m);
+
+    pf_order::elem* w = new pf_order::elem[piece_k];
+    pf_order::elem acc, v;
+    f.zero(acc);
+    if (pf_weights_zero(f, xs, piece_k, w) == 0)
+    {
+        for (int i = 0; i < piece_k; i++)
+        {
+            bn_to_elem(f, &ctx, piece[i], v);
+            f.mul(v, v, w[i]);
+            f.add(acc, acc, v);
+        }
+    }
+    IppsBigNumState* secrete = newBN(ORDER_WORDS);
+    elem_to_bn(f, acc, secrete);
 
-    /*
-	int piece_n = 11;
-	int piece_k = 3;
-    */
-    piece_k = 3;
+    memset(&acc, 0, sizeof(acc));
+    memset(&v, 0, sizeof(v));
+    delete [] w;
+    share_ctx_free(&ctx);
+    return secrete;
+}
 
-    //标准256位椭圆曲线
-    IppsECCPState* pECP = newStd_256_ECP();
-    const Ipp8u maxp[] ="\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFE\xBA\xAE\xDC\xE6\xAF\x48\xA0\x3B\xBF\xD2\x5E\x8C\xD0\x36\x41\x41";
-    IppsBigNumState* bnmaxp = newBN(8);
-    ippsSetOctString_BN(maxp, 32, bnmaxp);
-    int ordsize = sizeof(maxp)/sizeof(Ipp32u);
+//字节转十六进制字符串,pDst至少2*len+1
+void copy_hex(char *pDst, const Ipp8u* p, int len)
+{
+    for (int n = 0; n < len; n++)
+        snprintf(pDst+2*n, 3, "%02x", p[n]);
+}
 
-    IppsPRNGState* pRandGen = newPRNG();
+/*
+ * key_curve:
+ *   The curve keys are generated on. Shares are computed mod order_q, so
+ *   it has to be the curve whose group order that is: secp256k1.
+ */
+const ec_curve_t* key_curve(void)
+{
+    return ec_curve_secp256k1();
+}
 
-    //随机生成A的私钥和椭圆公钥
-    IppsBigNumState* keyPriA = newBN(ordsize);
-    ippsTRNGenRDSEED_BN(keyPriA, 256,pRandGen);
-    ippsMod_BN(keyPriA, bnmaxp, keyPriA);
-    IppsECCPPointState* keyPubA = newECP_256_point();
-    ippsECCPPublicKey(keyPriA, keyPubA, pECP);
-    //A椭圆曲线x坐标,y坐标
-    IppsBigNumState* keyPubA_x = newBN(ordsize);
-    IppsBigNumState* keyPubA_y = newBN(ordsize);
-    ippsECCPGetPoint(keyPubA_x,keyPubA_y, keyPubA, pECP);
+/*
+ * share_modulus:
+ *   The share field's order as a Curve/Field.h modulus, for the
+ *   PrimeField.h backend: the key curve's n, or L for Ed25519.
+ */
+static fe_modulus_t ed_l_modulus(void)
+{
+    fe_modulus_t m;
+    fe_modulus_init(&m, ed25519_l);
+    return m;
+}
 
-    
-    IppsBigNumState* poly[piece_k] = {0};
-    IppsBigNumState* piece[piece_n] = {0};
-    poly[0] = keyPriA;
+const fe_modulus_t* share_modulus(int curve)
+{
+    if (curve != SHARE_CURVE_ED25519)
+        return &key_curve()->fn;
+    static const fe_modulus_t ed_l = ed_l_modulus();
+    return &ed_l;
+}
 
-    //随机生成piece_k阶多项式
-    Ipp32u tmpData[8];
-    for (int i = 1; i < piece_k; i++)
+/*
+ * expand_coefs:
+ *   poly[1..k-1] for the key in poly[0]: the AES-128-CTR keystream of its
+ *   keystore_coef_seed, 48 bytes per coefficient reduced mod the curve's
+ *   group order. Only the key is ever stored; the polynomial, and so any
+ *   share, can be rebuilt from it.
+ */
+int expand_coefs(IppsBigNumState** poly, int piece_k, int curve)
+{
+    gf_rng_t rng;
+    memset(&rng, 0, sizeof(rng));
+    Ipp8u priv[32];
+    ippsGetOctString_BN(priv, sizeof(priv), poly[0]);
+    int ret = keystore_coef_seed(priv, rng.key);
+    memset(priv, 0, sizeof(priv));
+
+    size_t len = 48 * (size_t)(piece_k - 1);
+    Ipp8u* stream = new Ipp8u[len + 1];
+    if (ret == 0)
+        ret = gf_rng_fill(&rng, stream, len);
+    if (ret == 0)
     {
-        IppsBigNumState* bn_tmp = newBN(ordsize);
-        ippsTRNGenRDSEED_BN(bn_tmp, 256, pRandGen);
-
-        poly[i] = bn_tmp;
+        IppsBigNumState* q = newOrderBN(curve);
+        IppsBigNumState* t = newBN(WIDE_WORDS);
+        for (int i = 1; i < piece_k; i++)
+        {
+            ippsSetOctString_BN(stream + 48*(size_t)(i-1), 48, t);
+            ippsMod_BN(t, q, poly[i]);
+        }
+        Ipp32u zero = 0;
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, t);
+        delete [] (Ipp8u*) t;
+        delete [] (Ipp8u*) q;
     }
+    memset(stream, 0, len);
+    delete [] stream;
+    gf_rng_clear(&rng);
+    return ret;
+}
 
-    //根据多项式生成piece_n个分片
-    for (int i = 1; i <= piece_n; i++)
+/*
+ * seeded_shares:
+ *   count shares of the key priv (32 bytes) under its seeded k-of-n
+ *   polynomial, at xs or at x = 1..count when xs is NULL.
+ */
+int seeded_shares(const Ipp8u* priv, int piece_k, const Ipp32u* xs, int count, share_t* out, int curve)
+{
+    IppsBigNumState** poly = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState** piece = newBNArray(count, ORDER_WORDS);
+    ippsSetOctString_BN(priv, 32, poly[0]);
+    int ret = expand_coefs(poly, piece_k, curve);
+    if (ret == 0)
     {
-        Ipp32u x = i;
-        IppsBigNumState* bnx = newBN(1, &x);
-        IppsBigNumState* y = calculate_Y(bnx, poly, piece_k);    
+        share_ctx_t ctx;
+        share_ctx_init(&ctx, curve);
+        if (xs == NULL)
+            share_eval_all(&ctx, poly, piece_k, piece, count);
+        else
+            share_eval_at(&ctx, poly, piece_k, xs, piece, count);
+        for (int i = 0; i < count; i++)
+        {
+            out[i].x = xs ? xs[i] : (uint32_t)(i+1);
+            ippsGetOctString_BN(out[i].y, sizeof(out[i].y), piece[i]);
+        }
+        share_ctx_free(&ctx);
+    }
 
-        piece[i-1] = y;
+    Ipp32u zero = 0;
+    for (int i = 0; i < piece_k; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[i]);
+    for (int i = 0; i < count; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, piece[i]);
+    deleteBNArray(poly);
+    deleteBNArray(piece);
+    return ret;
+}
 
-        delete[] (Ipp8u*)bnx;
-    }
+/*
+ * new_sharing_poly:
+ *   Draw a private key into poly[0], expand its k-1 coefficients from the
+ *   key's seed mod the curve's group order, and return the matching public
+ *   key (see batch_public_keys for the layout). Fails when the key store
+ *   is not open, since the seed comes from it.
+ */
+int new_sharing_poly(IppsBigNumState** poly, int piece_k, Ipp8u pub[64], int curve)
+{
+    IppsBigNumState* bnmaxp = newOrderBN(curve);
+    IppsPRNGState* pRandGen = newPRNG();
+
+    //随机生成私钥,高次系数由种子展开
+    ippsTRNGenRDSEED_BN(poly[0], 256, pRandGen);
+    ippsMod_BN(poly[0], bnmaxp, poly[0]);
+    int ret = expand_coefs(poly, piece_k, curve);
+
+    //椭圆公钥x坐标,y坐标
+    if (ret == 0)
+        ret = batch_public_keys(poly, 1, pub, curve);
+
+    delete[] (Ipp8u*) bnmaxp;
+    deletePRNG(pRandGen);
+    return ret;
+}
+
+/*
+ * batch_public_keys:
+ *   pub_i = priv_i * G for a batch of keys, as x||y on key_curve() or, for
+ *   SHARE_CURVE_ED25519, as the Ed25519 encoding followed by the X25519 u.
+ *   The points stay projective until the end and share one field inversion.
+ */
+int batch_public_keys(IppsBigNumState* const* privs, int count, Ipp8u* pubs, int curve)
+{
+    Ipp8u* scalars = new Ipp8u[32 * (size_t)count];
+    for (int i = 0; i < count; i++)
+        ippsGetOctString_BN(scalars + 32*(size_t)i, 32, privs[i]);
+    int ret = curve == SHARE_CURVE_ED25519 ? ed25519_public_keys(scalars, count, pubs)
+                                           : ec_public_keys(key_curve(), scalars, count, pubs);
+    memset(scalars, 0, 32 * (size_t)count);
+    delete [] scalars;
+    return ret;
+}
 
-    Type_BN("pri key is: ", keyPriA);
-    Type_BN("coordinate x of pub key is: ", keyPubA_x);
-    Type_BN("coordinate y of pub key is: ", keyPubA_y);
+//私钥写入密封存储,记录交给app追加到WAL
+int store_sharing_key(const IppsBigNumState* priv, const Ipp8u pub[64], int piece_k, int piece_n, uint32_t flags, keystore_record_t* rec)
+{
+    keystore_secret_t secret;
+    memset(&secret, 0, sizeof(secret));
+    ippsGetOctString_BN(secret.priv, 32, priv);
+    secret.piece_k = (uint16_t)piece_k;
+    secret.piece_n = (uint16_t)piece_n;
+    secret.flags = (flags & KEYSTORE_FLAG_ED25519) ? flags : flags | KEYSTORE_FLAG_SECP256K1;
+
+    int ret = keystore_put(&secret, pub, rec);
+    if (ret != 0)
+        memset(rec, 0, sizeof(*rec));
+    memset(&secret, 0, sizeof(secret));
+    return ret;
+}
+
+/*
+ * secret_sharing:
+ *   Generate a key pair and split the private key k-of-n; share i (x = i+1)
+ *   goes to shares[i]. Returns -1 when (k, n) is outside
+ *   [SHARE_MIN_K, SHARE_MAX_N] or shares_len is not n shares.
+ */
+int secret_sharing(char* pDst, int piece_k, int piece_n, keystore_record_t* rec, share_t* shares, size_t shares_len)
+{
+    return secret_sharing_curve(pDst, piece_k, piece_n, SHARE_CURVE_SECP256K1, rec, shares, shares_len);
+}
 
-    //将公钥复制出来
-    for (int i = 1; i < piece_n; i++)
+/*
+ * secret_sharing_curve:
+ *   secret_sharing on a chosen curve; with SHARE_CURVE_ED25519 the key is
+ *   an Ed25519/X25519 scalar and the shares are computed mod L.
+ */
+int secret_sharing_curve(char* pDst, int piece_k, int piece_n, int curve, keystore_record_t* rec, share_t* shares,
+                         size_t shares_len)
+{
+    memset(rec, 0, sizeof(*rec));
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N ||
+        (curve != SHARE_CURVE_SECP256K1 && curve != SHARE_CURVE_ED25519) ||
+        shares_len != (size_t)piece_n * sizeof(share_t))
+        return -1;
+    memset(shares, 0, shares_len);
+
+    //多项式系数与份额都放在堆上,n较大时不占enclave栈
+    IppsBigNumState** poly = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState** piece = newBNArray(piece_n, ORDER_WORDS);
+    Ipp8u pub[64];
+    if (new_sharing_poly(poly, piece_k, pub, curve) != 0)
     {
-        Type_BN("piece is \n", piece[i-1]);
+        deleteBNArray(poly);
+        deleteBNArray(piece);
+        return -1;
     }
-    IppsBigNumState* sum_piece = verify(piece);
-    Type_BN("sum_piece is:",sum_piece);
-
-    copy_BN(pDst, keyPubA_x);
 
+    //根据多项式生成piece_n个分片
+    share_ctx_t ctx;
+    share_ctx_init(&ctx, curve);
+    share_eval_all(&ctx, poly, piece_k, piece, piece_n);
+    share_ctx_free(&ctx);
+
+    copy_hex(pDst, pub, 32);
+
+    //用前k个份额恢复私钥做自检,不一致则不入库
+    Ipp32u* xs = new Ipp32u[piece_k];
+    for (int i = 0; i < piece_k; i++)
+        xs[i] = (Ipp32u)(i+1);
+    IppsBigNumState* sum_piece = verify(piece, xs, piece_k, curve);
+    Ipp32u cmp = 1;
+    ippsCmp_BN(sum_piece, poly[0], &cmp);
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, sum_piece);
+    delete [] xs;
     delete [] (Ipp8u*) sum_piece;
 
-    for (int i = 1; i < piece_k; i++)
-        delete[] (Ipp8u*) poly[i];
+    int ret = cmp != IPP_IS_EQ ? -1 :
+              store_sharing_key(poly[0], pub, piece_k, piece_n,
+                                KEYSTORE_FLAG_SEEDED | (curve == SHARE_CURVE_ED25519 ? KEYSTORE_FLAG_ED25519 : 0), rec);
 
+    //入库成功才交出份额
+    for (int i = 0; i < piece_n && ret == 0; i++)
+    {
+        shares[i].x = (uint32_t)(i+1);
+        ippsGetOctString_BN(shares[i].y, sizeof(shares[i].y), piece[i]);
+    }
 
-    delete[] (Ipp8u*) keyPubA;
-    delete[] (Ipp8u*) keyPriA;
-    delete[] (Ipp8u*) bnmaxp;
+    for (int i = 0; i < piece_n; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, piece[i]);
+    for (int i = 0; i < piece_k; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[i]);
+    deleteBNArray(poly);
+    deleteBNArray(piece);
+
+    return ret;
+}
+
+/*
+ * batch_sharing:
+ *   Generate 'batch' keys for bulk provisioning and split each k-of-n;
+ *   key b's shares go to shares[b*n .. b*n+n). All shares are committed
+ *   to one Merkle tree (merkle.h), returned whole in tree along with its
+ *   root. Returns -1 when the batch or (k, n) is out of range.
+ */
+int batch_sharing(int batch, int piece_k, int piece_n, keystore_record_t* recs, share_t* shares, size_t shares_len,
+                  uint8_t* root, uint8_t* tree, size_t tree_len)
+{
+    if (batch < 1 || batch > BATCH_MAX_KEYS || piece_k < SHARE_MIN_K || piece_k > piece_n ||
+        piece_n > SHARE_MAX_N || shares_len != (size_t)batch * piece_n * sizeof(share_t) ||
+        tree_len != MERKLE_HASH_SIZE * merkle_nodes((uint64_t)batch * piece_n))
+        return -1;
+    memset(recs, 0, (size_t)batch * sizeof(*recs));
+
+    Ipp8u* privs = new Ipp8u[32 * (size_t)batch];
+    Ipp8u* pubs = new Ipp8u[64 * (size_t)batch];
+    IppsBigNumState* priv = newBN(ORDER_WORDS);
+    int ret = make_shared_keys(batch, piece_k, piece_n, privs, pubs, shares);
+    for (int b = 0; b < batch && ret == 0; b++)
+    {
+        ippsSetOctString_BN(privs + 32*(size_t)b, 32, priv);
+        ret = store_sharing_key(priv, pubs + 64*(size_t)b, piece_k, piece_n, KEYSTORE_FLAG_SEEDED, &recs[b]);
+    }
+    //叶子带key_id,所以入库之后再建树
+    if (ret == 0)
+        ret = merkle_commit(recs, batch, shares, piece_n, tree, root);
+
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, priv);
+    memset(privs, 0, 32 * (size_t)batch);
+    if (ret != 0)
+    {
+        memset(recs, 0, (size_t)batch * sizeof(*recs));
+        memset(shares, 0, shares_len);
+    }
+    delete [] (Ipp8u*) priv;
+    delete [] privs;
+    delete [] pubs;
+    return ret;
+}
+
+/*
+ * make_shared_keys:
+ *   The work behind batch keygen without storing anything: 'batch' fresh
+ *   private keys (32 bytes each), their public keys x||y and, unless
+ *   shares is NULL, their seeded k-of-n shares, key b's at
+ *   shares[b*n .. b*n+n).
+ */
+int make_shared_keys(int batch, int piece_k, int piece_n, Ipp8u* privs, Ipp8u* pubs, share_t* shares)
+{
+    IppsBigNumState** keys = newBNArray(batch, ORDER_WORDS);
+    IppsBigNumState* bnmaxp = newOrderBN();
+    IppsPRNGState* pRandGen = newPRNG();
+    for (int b = 0; b < batch; b++)
+    {
+        ippsTRNGenRDSEED_BN(keys[b], 256, pRandGen);
+        ippsMod_BN(keys[b], bnmaxp, keys[b]);
+        ippsGetOctString_BN(privs + 32*(size_t)b, 32, keys[b]);
+    }
     deletePRNG(pRandGen);
 
-    for(int i = 1; i <= piece_n; i++)
-        delete[] (Ipp8u*) piece[i-1];
+    //整批公钥共用一次求逆
+    int ret = batch_public_keys(keys, batch, pubs);
 
-    return ;
+    for (int b = 0; b < batch && ret == 0 && shares; b++)
+        ret = seeded_shares(privs + 32*(size_t)b, piece_k, NULL, piece_n, shares + (size_t)b * piece_n,
+                            SHARE_CURVE_SECP256K1);
 
+    Ipp32u zero = 0;
+    for (int b = 0; b < batch; b++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, keys[b]);
+    deleteBNArray(keys);
+    delete [] (Ipp8u*) bnmaxp;
+    return ret;
+}
 
+/*
+ * regen_shares:
+ *   Recompute the shares at xs of a stored seeded key. Internal only:
+ *   plaintext shares never leave the enclave, deliver_wrap encrypts them
+ *   to the custodians first. These are the shares as issued; after a
+ *   refresh they no longer match what custodians hold.
+ */
+int regen_shares(uint64_t key_id, const uint32_t* xs, int count, share_t* out)
+{
+    if (count <= 0 || count > SHARE_MAX_N)
+        return -1;
+    memset(out, 0, (size_t)count * sizeof(share_t));
+
+    keystore_secret_t secret;
+    if (keystore_get(key_id, &secret, NULL) != 0)
+        return -1;
+    int ret = -1;
+    if ((secret.flags & KEYSTORE_FLAG_SEEDED) && !(secret.flags & KEYSTORE_FLAG_PACKED))
+    {
+        ret = 0;
+        for (int i = 0; i < count && ret == 0; i++)
+            if (xs[i] == 0)
+                ret = -1;
+        if (ret == 0)
+            ret = seeded_shares(secret.priv, secret.piece_k, xs, count, out,
+                                (secret.flags & KEYSTORE_FLAG_ED25519) ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1);
+    }
+    memset(&secret, 0, sizeof(secret));
+    return ret;
 }
@@ -35,6 +35,14 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "ippcp.h"
+#include "user_types.h"
+#include "Curve/Curve.h"
+
+//曲线阶q的字节数/字数; mod_add/mod_sub的结果需要ELEM_WORDS(多一个进位字), WIDE_WORDS容纳乘积
+#define ORDER_BYTES 32
+#define ORDER_WORDS 8
+#define ELEM_WORDS  (ORDER_WORDS+1)
+#define WIDE_WORDS  (2*ORDER_WORDS+2)
 
 #if defined(__cplusplus)
 extern "C" {
@@ -52,10 +60,65 @@ void Type_BN(const char *pMsg, const IppsBigNumState* pBN);
 IppsECCPState* newStd_256_ECP(void);
 IppsBigNumState* newBN(int len,const Ipp32u* pData=0);
 IppsECCPPointState* newECP_256_point(void);
-IppsBigNumState* calculate_Y(IppsBigNumState* x, IppsBigNumState** &poly, int polylen);
+IppsBigNumState* newOrderBN(int curve=SHARE_CURVE_SECP256K1);
+IppsECCPState* newSecp256k1_ECP(void);
+IppsBigNumState** newBNArray(int count, int len);
+void deleteBNArray(IppsBigNumState** pBN);
+/* scratch shared by every evaluation of one sharing run */
+typedef struct _share_ctx_t {
+    IppsBigNumState* q;
+    IppsBigNumState* x;
+    IppsBigNumState* wide;
+    const fe_modulus_t* m;  /* q for the PrimeField.h backend */
+} share_ctx_t;
+
+void share_ctx_init(share_ctx_t* ctx, int curve=SHARE_CURVE_SECP256K1);
+void share_ctx_free(share_ctx_t* ctx);
+void mod_add(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* b);
+void mod_sub(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* b);
+void mod_mul(share_ctx_t* ctx, IppsBigNumState* r, const IppsBigNumState* a, const IppsBigNumState* b);
+void eval_share(share_ctx_t* ctx, IppsBigNumState* const* poly, int k, Ipp32u x, IppsBigNumState* y);
+void share_eval_all(share_ctx_t* ctx, IppsBigNumState* const* poly, int piece_k, IppsBigNumState** piece, int piece_n);
+void share_eval_at(share_ctx_t* ctx, IppsBigNumState* const* poly, int piece_k, const Ipp32u* xs, IppsBigNumState** piece,
+                   int count);
+void lagrange_weights(share_ctx_t* ctx, const Ipp32u* xs, int piece_k, const IppsBigNumState* z, IppsBigNumState** w);
+
+void copy_hex(char *pDst, const Ipp8u* p, int len);
+int new_sharing_poly(IppsBigNumState** poly, int piece_k, Ipp8u pub[64], int curve=SHARE_CURVE_SECP256K1);
+int expand_coefs(IppsBigNumState** poly, int piece_k, int curve=SHARE_CURVE_SECP256K1);
+int seeded_shares(const Ipp8u* priv, int piece_k, const Ipp32u* xs, int count, share_t* out, int curve=SHARE_CURVE_SECP256K1);
+const ec_curve_t* key_curve(void);
+const fe_modulus_t* share_modulus(int curve=SHARE_CURVE_SECP256K1);
+int batch_public_keys(IppsBigNumState* const* privs, int count, Ipp8u* pubs, int curve=SHARE_CURVE_SECP256K1);
+int store_sharing_key(const IppsBigNumState* priv, const Ipp8u pub[64], int piece_k, int piece_n, uint32_t flags, keystore_record_t* rec);
+
+IppsBigNumState* interpolate(IppsBigNumState** piece, const Ipp32u* xs, int piece_k, const IppsBigNumState* z, int curve=SHARE_CURVE_SECP256K1);
+IppsBigNumState* verify(IppsBigNumState** piece, const Ipp32u* xs, int piece_k, int curve=SHARE_CURVE_SECP256K1);
+
+int secret_sharing(char *pDst, int piece_k, int piece_n, keystore_record_t *rec, share_t *shares, size_t shares_len);
+int secret_sharing_curve(char *pDst, int piece_k, int piece_n, int curve, keystore_record_t *rec, share_t *shares,
+                         size_t shares_len);
+int batch_sharing(int batch, int piece_k, int piece_n, keystore_record_t* recs, share_t* shares, size_t shares_len,
+                  uint8_t* root, uint8_t* tree, size_t tree_len);
+int make_shared_keys(int batch, int piece_k, int piece_n, Ipp8u* privs, Ipp8u* pubs, share_t* shares);
+int regen_shares(uint64_t key_id, const uint32_t* xs, int count, share_t* out);
+int deliver_seal(const uint8_t recipient[32], uint64_t first, const uint8_t* values, size_t count, wrapped_share_t* out);
+int merkle_commit(const keystore_record_t* recs, int keys, const share_t* shares, int piece_n, uint8_t* tree,
+                  uint8_t root[32]);
+
+/* AES-CTR keystream for GF(2^8) sharing coefficients */
+typedef struct _gf_rng_t {
+    uint8_t key[16];
+    uint8_t ctr[16];
+} gf_rng_t;
 
-//void secret_sharing(char *pubA, int piece_k, int piece_n);
-void secret_sharing(char *pDst, int piece_k, int piece_n);
+void gf_setup(void);
+int gf_rng_init(gf_rng_t* rng);
+void gf_rng_clear(gf_rng_t* rng);
+int gf_rng_fill(gf_rng_t* rng, uint8_t* buf, size_t len);
+int gf_split(gf_rng_t* rng, const uint8_t* secret, size_t len, int piece_k, int piece_n, uint8_t* const* out);
+int gf_weights(const uint8_t* xs, int piece_k, uint8_t* weights);
+void gf_combine(const uint8_t* weights, const uint8_t* const* in, int piece_k, size_t len, uint8_t* secret);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Sealed key store, split in two tiers so it never grows into EPC paging.
+ *
+ * Cold tier: every record lives outside the enclave, AES-GCM encrypted
+ * under a store key that is itself sealed to the enclave (recovery only
+ * unseals that one key). key_id, version and the public key are bound into
+ * the tag, so the host can index records but not forge or swap them; records
+ * are write-once, which is why no freshness counter is kept per record.
+ * That needs key_ids never to repeat: the snapshot header carries a
+ * CMAC'd high-water mark (the next id at the last compaction), the tail
+ * may only start there, and a fresh attach skips the whole tail window,
+ * since the WAL the host replayed may have lost its end.
+ *   - snapshot: the app's read-only mmap of keystore.snap, sorted by key_id.
+ *   - tail: an app-owned array indexed by (key_id - tail_first) holding the
+ *     records written since the last compaction (the WAL, in memory).
+ * Both are read in place through [user_check] pointers; one record at a
+ * time is copied in and verified.
+ *
+ * Hot tier: a fixed set-associative cache of decrypted entries with CLOCK
+ * replacement per set. It is static, so it does not eat into the 1 MB heap.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+#include "KeyStore.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_tseal.h"
+#include "sgx_tcrypto.h"
+#include "sgx_thread.h"
+
+#define HOT_SET_BITS 7
+#define HOT_SETS     (1 << HOT_SET_BITS)
+#define HOT_WAYS     8
+
+typedef struct _keystore_entry_t {
+    uint8_t pub[64];
+    keystore_secret_t secret;
+} keystore_entry_t;
+
+typedef struct _hot_slot_t {
+    uint64_t key_id;        /* 0: empty */
+    uint32_t ref;
+    keystore_entry_t entry;
+} hot_slot_t;
+
+typedef struct _hot_set_t {
+    hot_slot_t way[HOT_WAYS];
+    uint32_t hand;
+} hot_set_t;
+
+static sgx_aes_gcm_128bit_key_t store_key;
+static sgx_cmac_128bit_key_t coef_key;
+static sgx_cmac_128bit_key_t mark_key;
+static int store_ready = 0;
+static int attached = 0;
+
+static const uint8_t coef_label[] = "SGXCOEF1";
+static const uint8_t mark_label[] = "SGXMARK1";
+
+static const keystore_record_t* snapshot = NULL;
+static uint64_t snapshot_count = 0;
+
+static keystore_record_t* tail = NULL;
+static uint64_t tail_capacity = 0;
+static uint64_t tail_first = 1;
+
+static hot_set_t hot[HOT_SETS];
+static uint64_t next_key_id = 1;
+
+static sgx_thread_mutex_t store_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+typedef char keystore_secret_size_check[sizeof(keystore_secret_t) == KEYSTORE_SECRET_SIZE ? 1 : -1];
+typedef char keystore_aad_size_check[offsetof(keystore_record_t, iv) == KEYSTORE_AAD_SIZE ? 1 : -1];
+
+static hot_set_t* hot_set(uint64_t key_id)
+{
+    return &hot[(key_id * 0x9E3779B97F4A7C15ULL) >> (64 - HOT_SET_BITS)];
+}
+
+static const keystore_entry_t* hot_find(uint64_t key_id)
+{
+    hot_set_t* set = hot_set(key_id);
+    for (int i = 0; i < HOT_WAYS; i++)
+    {
+        if (set->way[i].key_id == key_id)
+        {
+            set->way[i].ref = 1;
+            return &set->way[i].entry;
+        }
+    }
+    return NULL;
+}
+
+static void hot_insert(uint64_t key_id, const keystore_entry_t* entry)
+{
+    hot_set_t* set = hot_set(key_id);
+    hot_slot_t* victim = NULL;
+
+    for (int i = 0; i < HOT_WAYS && !victim; i++)
+        if (set->way[i].key_id == key_id || set->way[i].key_id == 0)
+            victim = &set->way[i];
+
+    /* CLOCK: sweep, clearing reference bits, until an unreferenced way shows up */
+    while (!victim)
+    {
+        hot_slot_t* slot = &set->way[set->hand];
+        set->hand = (set->hand + 1) % HOT_WAYS;
+        if (slot->ref)
+            slot->ref = 0;
+        else
+            victim = slot;
+    }
+
+    victim->key_id = key_id;
+    victim->ref = 1;
+    victim->entry = *entry;
+}
+
+static int seal_record(uint64_t key_id, const keystore_entry_t* entry, keystore_record_t* rec)
+{
+    memset(rec, 0, sizeof(*rec));
+    rec->key_id = key_id;
+    rec->version = KEYSTORE_RECORD_VERSION;
+    memcpy(rec->pub, entry->pub, sizeof(rec->pub));
+    if (sgx_read_rand(rec->iv, sizeof(rec->iv)) != SGX_SUCCESS)
+        return -1;
+
+    sgx_status_t ret = sgx_rijndael128GCM_encrypt(&store_key,
+            (const uint8_t*)&entry->secret, sizeof(entry->secret), rec->secret,
+            rec->iv, sizeof(rec->iv),
+            (const uint8_t*)rec, KEYSTORE_AAD_SIZE,
+            (sgx_aes_gcm_128bit_tag_t*)rec->mac);
+    return ret == SGX_SUCCESS ? 0 : -1;
+}
+
+/* rec must already be a copy inside the enclave */
+static int open_record(const keystore_record_t* rec, keystore_entry_t* entry)
+{
+    if (rec->version != KEYSTORE_RECORD_VERSION)
+        return -1;
+
+    sgx_status_t ret = sgx_rijndael128GCM_decrypt(&store_key,
+            rec->secret, sizeof(rec->secret), (uint8_t*)&entry->secret,
+            rec->iv, sizeof(rec->iv),
+            (const uint8_t*)rec, KEYSTORE_AAD_SIZE,
+            (const sgx_aes_gcm_128bit_tag_t*)rec->mac);
+    if (ret != SGX_SUCCESS)
+        return -1;
+
+    memcpy(entry->pub, rec->pub, sizeof(entry->pub));
+    return 0;
+}
+
+/* copy one untrusted record in, then authenticate it */
+static int fetch_record(const keystore_record_t* src, uint64_t key_id, keystore_entry_t* entry)
+{
+    keystore_record_t rec;
+    memcpy(&rec, src, sizeof(rec));
+    if (rec.key_id != key_id)
+        return -1;
+    return open_record(&rec, entry);
+}
+
+static int tail_find(uint64_t key_id, keystore_entry_t* entry)
+{
+    if (tail == NULL || key_id < tail_first || key_id - tail_first >= tail_capacity)
+        return -1;
+    return fetch_record(&tail[key_id - tail_first], key_id, entry);
+}
+
+/* binary search over the plaintext key_ids, then verify the one hit */
+static int snapshot_find(uint64_t key_id, keystore_entry_t* entry)
+{
+    uint64_t lo = 0, hi = snapshot_count;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        uint64_t id = snapshot[mid].key_id;
+        if (id == key_id)
+            return fetch_record(&snapshot[mid], key_id, entry);
+        if (id < key_id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+static int check_untrusted_array(const keystore_record_t* records, uint64_t count)
+{
+    if (count == 0)
+        return 0;
+    if (records == NULL || count > SIZE_MAX / sizeof(keystore_record_t))
+        return -1;
+    if (sgx_is_outside_enclave(records, (size_t)count * sizeof(keystore_record_t)) != 1)
+        return -1;
+    sgx_lfence();
+    return 0;
+}
+
+/* keystore_put:
+ *   Assign the next key id, seal the record straight into its tail slot and
+ *   keep the plaintext hot. The caller gets a copy to append to the WAL file.
+ */
+int keystore_put(const keystore_secret_t* secret, const uint8_t pub[64], keystore_record_t* rec)
+{
+    keystore_entry_t entry;
+    memcpy(entry.pub, pub, sizeof(entry.pub));
+    entry.secret = *secret;
+
+    int ret = -1;
+    sgx_thread_mutex_lock(&store_mutex);
+    uint64_t key_id = next_key_id;
+    if (store_ready && tail && key_id - tail_first < tail_capacity &&
+        seal_record(key_id, &entry, rec) == 0)
+    {
+        memcpy(&tail[key_id - tail_first], rec, sizeof(*rec));
+        hot_insert(key_id, &entry);
+        next_key_id++;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+
+    memset(&entry, 0, sizeof(entry));
+    return ret;
+}
+
+int keystore_get(uint64_t key_id, keystore_secret_t* secret, uint8_t pub[64])
+{
+    keystore_entry_t entry;
+    int ret = -1;
+
+    sgx_thread_mutex_lock(&store_mutex);
+    if (store_ready && key_id != 0)
+    {
+        const keystore_entry_t* hit = hot_find(key_id);
+        if (hit)
+        {
+            entry = *hit;
+            ret = 0;
+        }
+        else if (tail_find(key_id, &entry) == 0 || snapshot_find(key_id, &entry) == 0)
+        {
+            hot_insert(key_id, &entry);
+            ret = 0;
+        }
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+
+    if (ret == 0)
+    {
+        *secret = entry.secret;
+        if (pub)
+            memcpy(pub, entry.pub, sizeof(entry.pub));
+    }
+    memset(&entry, 0, sizeof(entry));
+    return ret;
+}
+
+uint32_t ecall_keystore_sealed_size(void)
+{
+    return sgx_calc_sealed_data_size(0, sizeof(store_key));
+}
+
+//系数种子和高水位标记用的子密钥,与存储密钥分开
+static int derive_subkeys(void)
+{
+    if (sgx_rijndael128_cmac_msg((const sgx_cmac_128bit_key_t*)&store_key, coef_label, sizeof(coef_label) - 1,
+                                 (sgx_cmac_128bit_tag_t*)&coef_key) != SGX_SUCCESS)
+        return -1;
+    return sgx_rijndael128_cmac_msg((const sgx_cmac_128bit_key_t*)&store_key, mark_label, sizeof(mark_label) - 1,
+                                    (sgx_cmac_128bit_tag_t*)&mark_key) == SGX_SUCCESS ? 0 : -1;
+}
+
+static int mark_tag(uint64_t next_id, uint8_t mac[16])
+{
+    return sgx_rijndael128_cmac_msg(&mark_key, (const uint8_t*)&next_id, sizeof(next_id),
+                                    (sgx_cmac_128bit_tag_t*)mac) == SGX_SUCCESS ? 0 : -1;
+}
+
+//新库(还没有压缩过)的标记全为0
+static int mark_check(const keystore_mark_t* mark)
+{
+    uint8_t mac[16], diff = 0;
+    if (mark->next_id == 0)
+    {
+        for (size_t i = 0; i < sizeof(mark->mac); i++)
+            diff |= mark->mac[i];
+        return diff == 0 ? 0 : -1;
+    }
+    if (mark_tag(mark->next_id, mac) != 0)
+        return -1;
+    for (size_t i = 0; i < sizeof(mac); i++)
+        diff |= (uint8_t)(mac[i] ^ mark->mac[i]);
+    return diff == 0 ? 0 : -1;
+}
+
+/* keystore_coef_seed:
+ *   The 128-bit seed a key's sharing coefficients are expanded from:
+ *   CMAC of the private key under a key derived from the store key, so it
+ *   is recomputed from the record instead of being stored.
+ */
+int keystore_coef_seed(const uint8_t priv[32], uint8_t seed[16])
+{
+    if (!store_ready)
+        return -1;
+    return sgx_rijndael128_cmac_msg(&coef_key, priv, 32, (sgx_cmac_128bit_tag_t*)seed) == SGX_SUCCESS ? 0 : -1;
+}
+
+/* keystore_subkey:
+ *   A 128-bit key for some other purpose, CMAC(store key, label): stable
+ *   across restarts and never the store key itself.
+ */
+int keystore_subkey(const uint8_t* label, uint32_t len, uint8_t out[16])
+{
+    if (!store_ready)
+        return -1;
+    return sgx_rijndael128_cmac_msg((const sgx_cmac_128bit_key_t*)&store_key, label, len,
+                                    (sgx_cmac_128bit_tag_t*)out) == SGX_SUCCESS ? 0 : -1;
+}
+
+/* ecall_keystore_create:
+ *   First start: generate a fresh store key and return it sealed.
+ */
+int ecall_keystore_create(uint8_t* sealed, uint32_t len)
+{
+    if (len < ecall_keystore_sealed_size())
+        return -1;
+
+    sgx_thread_mutex_lock(&store_mutex);
+    int ret = -1;
+    if (sgx_read_rand(store_key, sizeof(store_key)) == SGX_SUCCESS &&
+        sgx_seal_data(0, NULL, sizeof(store_key), store_key, len, (sgx_sealed_data_t*)sealed) == SGX_SUCCESS &&
+        derive_subkeys() == 0)
+    {
+        store_ready = 1;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+    return ret;
+}
+
+/* ecall_keystore_open:
+ *   Restart: the only unseal operation recovery has to do.
+ */
+int ecall_keystore_open(const uint8_t* sealed, uint32_t len)
+{
+    if (len < ecall_keystore_sealed_size())
+        return -1;
+
+    uint32_t key_len = sizeof(store_key);
+    sgx_thread_mutex_lock(&store_mutex);
+    int ret = -1;
+    if (sgx_get_encrypt_txt_len((const sgx_sealed_data_t*)sealed) == key_len &&
+        sgx_unseal_data((const sgx_sealed_data_t*)sealed, NULL, NULL, store_key, &key_len) == SGX_SUCCESS &&
+        derive_subkeys() == 0)
+    {
+        store_ready = 1;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+    return ret;
+}
+
+/* ecall_keystore_mark:
+ *   The high-water mark for the next snapshot header: every key_id handed
+ *   out so far is below it. Compaction writes it before re-attaching.
+ */
+int ecall_keystore_mark(keystore_mark_t* mark)
+{
+    int ret = -1;
+    sgx_thread_mutex_lock(&store_mutex);
+    memset(mark, 0, sizeof(*mark));
+    if (store_ready && attached && mark_tag(next_key_id, mark->mac) == 0)
+    {
+        mark->next_id = next_key_id;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+    return ret;
+}
+
+/* ecall_keystore_attach:
+ *   Point the store at the (re)mapped snapshot and the app's tail array.
+ *   The tail starts at the header's high-water mark, which must verify and
+ *   be above every snapshot record. The first attach after a restart also
+ *   moves next_key_id past the whole tail window: ids the lost end of a
+ *   truncated WAL held are never handed out again, and the app compacts
+ *   right away to open a new window. Nothing is decrypted here.
+ */
+int ecall_keystore_attach(const keystore_record_t* records, uint64_t count, const keystore_mark_t* mark,
+        keystore_record_t* tail_records, uint64_t capacity)
+{
+    if (check_untrusted_array(records, count) != 0 ||
+        check_untrusted_array(tail_records, capacity) != 0 ||
+        tail_records == NULL || capacity != KEYSTORE_TAIL_SLOTS)
+        return -1;
+
+    int ret = -1;
+    sgx_thread_mutex_lock(&store_mutex);
+    uint64_t first = mark->next_id ? mark->next_id : 1;
+    uint64_t last_id = count > 0 ? records[count - 1].key_id : 0;
+    if (store_ready && mark_check(mark) == 0 && last_id < first && first <= UINT64_MAX - capacity)
+    {
+        snapshot = records;
+        snapshot_count = count;
+        tail = tail_records;
+        tail_capacity = capacity;
+        tail_first = first;
+        if (!attached)
+            next_key_id = first + capacity;
+        else if (next_key_id < first)
+            next_key_id = first;
+        attached = 1;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&store_mutex);
+    return ret;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _KEYSTORE_H_
+#define _KEYSTORE_H_
+
+#include <stdint.h>
+#include "user_types.h"
+
+/* Plaintext of keystore_record_t::secret, only ever materialized inside the enclave. */
+typedef struct _keystore_secret_t {
+    uint8_t  priv[32];
+    uint16_t piece_k;
+    uint16_t piece_n;
+    uint32_t flags;
+} keystore_secret_t;
+
+#define KEYSTORE_RECORD_VERSION 1
+
+/* keystore_secret_t::flags: a packed key is f(-slot) of a shared polynomial
+ * of degree piece_k-1, so piece_k shares recover it. */
+#define KEYSTORE_FLAG_PACKED         0x1
+#define KEYSTORE_FLAG_SECP256K1      0x2      /* pub is on secp256k1; older records are P-256 */
+#define KEYSTORE_FLAG_ED25519        0x4      /* priv is mod L, pub is Ed25519 || X25519 */
+#define KEYSTORE_FLAG_SEEDED         0x8      /* coefficients expand from keystore_coef_seed */
+#define KEYSTORE_FLAG_DERIVED        0x10     /* HD child: shares are the parent's plus a tweak */
+#define KEYSTORE_PACKED_SLOT(slot)   ((uint32_t)(slot) << 16)
+#define KEYSTORE_PACKED_SLOT_OF(f)   ((f) >> 16)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+int keystore_put(const keystore_secret_t* secret, const uint8_t pub[64], keystore_record_t* rec);
+int keystore_get(uint64_t key_id, keystore_secret_t* secret, uint8_t pub[64]);
+int keystore_coef_seed(const uint8_t priv[32], uint8_t seed[16]);
+int keystore_subkey(const uint8_t* label, uint32_t len, uint8_t out[16]);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* !_KEYSTORE_H_ */
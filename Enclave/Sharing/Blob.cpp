@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Streaming byte-wise sharing for blobs larger than the enclave heap.
+ *
+ * The app owns every byte buffer: the enclave is handed one chunk of input
+ * and n (or k) chunk pointers at a time through user_check, checks they lie
+ * outside the enclave and runs the gf_split/gf_combine kernels on them in
+ * place. Enclave memory use is one coefficient row, independent of blob
+ * size; the AES-CTR keystream state lives in the job so consecutive chunks
+ * never reuse coefficients.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_thread.h"
+
+#define BLOB_JOBS 4
+
+typedef struct _blob_job_t {
+    int active;
+    int ready;
+    int piece_k;
+    int piece_n;        /* 0 for a combine job */
+    gf_rng_t rng;
+    uint8_t weights[GF_MAX_N];
+} blob_job_t;
+
+static blob_job_t blob_jobs[BLOB_JOBS];
+static sgx_thread_mutex_t blob_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static blob_job_t* blob_claim(uint32_t* job)
+{
+    blob_job_t* j = NULL;
+    sgx_thread_mutex_lock(&blob_mutex);
+    for (uint32_t i = 0; i < BLOB_JOBS; i++)
+    {
+        if (!blob_jobs[i].active)
+        {
+            blob_jobs[i].active = 1;
+            *job = i;
+            j = &blob_jobs[i];
+            break;
+        }
+    }
+    sgx_thread_mutex_unlock(&blob_mutex);
+    return j;
+}
+
+static blob_job_t* blob_get(uint32_t job)
+{
+    if (job >= BLOB_JOBS)
+        return NULL;
+    sgx_lfence();
+    return blob_jobs[job].ready ? &blob_jobs[job] : NULL;
+}
+
+//指针数组里的每个缓冲区都必须完整位于enclave之外
+static int blob_outside(const uint64_t* ptrs, int count, size_t len)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (ptrs[i] == 0 || sgx_is_outside_enclave((const void*)(uintptr_t)ptrs[i], len) != 1)
+            return 0;
+    }
+    sgx_lfence();
+    return 1;
+}
+
+int blob_split_begin(int piece_k, int piece_n, uint32_t* job)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > GF_MAX_N)
+        return -1;
+
+    blob_job_t* j = blob_claim(job);
+    if (j == NULL)
+        return -1;
+    if (gf_rng_init(&j->rng) != 0)
+    {
+        j->active = 0;
+        return -1;
+    }
+    gf_setup();
+    j->piece_k = piece_k;
+    j->piece_n = piece_n;
+    j->ready = 1;
+    return 0;
+}
+
+int blob_combine_begin(const uint8_t* xs, int piece_k, uint32_t* job)
+{
+    if (piece_k < 1 || piece_k > GF_MAX_N)
+        return -1;
+
+    blob_job_t* j = blob_claim(job);
+    if (j == NULL)
+        return -1;
+    if (gf_weights(xs, piece_k, j->weights) != 0)
+    {
+        j->active = 0;
+        return -1;
+    }
+    gf_setup();
+    j->piece_k = piece_k;
+    j->piece_n = 0;
+    j->ready = 1;
+    return 0;
+}
+
+/*
+ * blob_split_chunk:
+ *   Share in[0..len) into out[i][0..len), x = i+1, for i < piece_n.
+ */
+int blob_split_chunk(uint32_t job, const uint8_t* in, size_t len, const uint64_t* out, int piece_n)
+{
+    blob_job_t* j = blob_get(job);
+    if (j == NULL || j->piece_n == 0 || piece_n != j->piece_n || len == 0 || len > BLOB_CHUNK_MAX)
+        return -1;
+    if (in == NULL || sgx_is_outside_enclave(in, len) != 1 || !blob_outside(out, piece_n, len))
+        return -1;
+
+    uint8_t* ptrs[GF_MAX_N];
+    for (int i = 0; i < piece_n; i++)
+        ptrs[i] = (uint8_t*)(uintptr_t)out[i];
+    return gf_split(&j->rng, in, len, j->piece_k, piece_n, ptrs);
+}
+
+/*
+ * blob_combine_chunk:
+ *   Recover out[0..len) from in[i][0..len), share i at the x given to begin.
+ */
+int blob_combine_chunk(uint32_t job, const uint64_t* in, int piece_k, size_t len, uint8_t* out)
+{
+    blob_job_t* j = blob_get(job);
+    if (j == NULL || j->piece_n != 0 || piece_k != j->piece_k || len == 0 || len > BLOB_CHUNK_MAX)
+        return -1;
+    if (out == NULL || sgx_is_outside_enclave(out, len) != 1 || !blob_outside(in, piece_k, len))
+        return -1;
+
+    const uint8_t* ptrs[GF_MAX_N];
+    for (int i = 0; i < piece_k; i++)
+        ptrs[i] = (const uint8_t*)(uintptr_t)in[i];
+    gf_combine(j->weights, ptrs, piece_k, len, out);
+    return 0;
+}
+
+int blob_end(uint32_t job)
+{
+    if (job >= BLOB_JOBS)
+        return -1;
+    sgx_lfence();
+
+    sgx_thread_mutex_lock(&blob_mutex);
+    blob_job_t* j = &blob_jobs[job];
+    int ret = j->active ? 0 : -1;
+    memset(j, 0, sizeof(*j));
+    sgx_thread_mutex_unlock(&blob_mutex);
+    return ret;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Byte-wise Shamir over GF(2^8) for blobs of any length.
+ *
+ * Every byte of the secret is the constant term of its own random
+ * polynomial; share i (x = i+1) is sum_j x^j * row_j where row_j holds the
+ * j-th coefficients of all bytes. That makes splitting k-1 region
+ * multiply-adds per share and combining k, all done by the SIMD kernels in
+ * gf256.h. Coefficient rows come from an AES-CTR keystream seeded by
+ * RDRAND, which runs at AES-NI speed instead of sgx_read_rand's. Work is
+ * done in blocks sized so the n output blocks stay in L2 while every row
+ * is applied.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include "gf256.h"
+#include "sgx_trts.h"
+#include "sgx_cpuid.h"
+#include "sgx_tcrypto.h"
+
+#define GF_BLOCK_MAX   4096
+#define GF_CACHE_BYTES (256 * 1024)
+
+static const uint8_t gf_zero[GF_BLOCK_MAX] = {0};
+
+/*
+ * gf_setup:
+ *   Pick the region kernels once. CPUID is answered by the host, so a lie
+ *   can at worst select a kernel that faults; XCR0 is read in-enclave and
+ *   reflects the enclave's XFRM.
+ */
+void gf_setup(void)
+{
+    static volatile int ready = 0;
+    if (ready)
+        return;
+
+    int leaf1[4] = {0}, leaf7[4] = {0};
+    if (sgx_cpuidex(leaf1, 1, 0) == SGX_SUCCESS && sgx_cpuidex(leaf7, 7, 0) == SGX_SUCCESS &&
+        (leaf1[2] & (1 << 27)))
+        gf256_select(gf256_features(leaf1, leaf7, gf256_xgetbv()));
+    ready = 1;
+}
+
+int gf_rng_init(gf_rng_t* rng)
+{
+    if (sgx_read_rand(rng->key, sizeof(rng->key)) != SGX_SUCCESS ||
+        sgx_read_rand(rng->ctr, sizeof(rng->ctr)) != SGX_SUCCESS)
+        return -1;
+    return 0;
+}
+
+void gf_rng_clear(gf_rng_t* rng)
+{
+    memset(rng, 0, sizeof(*rng));
+}
+
+//buf = 下len字节密钥流
+int gf_rng_fill(gf_rng_t* rng, uint8_t* buf, size_t len)
+{
+    for (size_t off = 0; off < len; off += GF_BLOCK_MAX)
+    {
+        size_t b = len - off < GF_BLOCK_MAX ? len - off : GF_BLOCK_MAX;
+        if (sgx_aes_ctr_encrypt((const sgx_aes_ctr_128bit_key_t*)rng->key, gf_zero, (uint32_t)b,
+                                rng->ctr, 128, buf + off) != SGX_SUCCESS)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * gf_split:
+ *   out[i][0..len) = share x = i+1 of secret[0..len), k-of-n.
+ */
+int gf_split(gf_rng_t* rng, const uint8_t* secret, size_t len, int piece_k, int piece_n, uint8_t* const* out)
+{
+    uint8_t row[GF_BLOCK_MAX];
+    uint8_t xp[GF_MAX_N];
+    int ret = 0;
+
+    size_t block = (GF_CACHE_BYTES / (size_t)(piece_n + 1)) & ~(size_t)63;
+    if (block < 64)
+        block = 64;
+    if (block > GF_BLOCK_MAX)
+        block = GF_BLOCK_MAX;
+
+    for (size_t off = 0; off < len && ret == 0; off += block)
+    {
+        size_t b = len - off < block ? len - off : block;
+        for (int i = 0; i < piece_n; i++)
+        {
+            memcpy(out[i] + off, secret + off, b);
+            xp[i] = 1;
+        }
+        for (int j = 1; j < piece_k; j++)
+        {
+            if (gf_rng_fill(rng, row, b) != 0)
+            {
+                ret = -1;
+                break;
+            }
+            for (int i = 0; i < piece_n; i++)
+            {
+                xp[i] = gf256_mul(xp[i], (uint8_t)(i + 1));
+                gf256_muladd_region(out[i] + off, row, xp[i], b);
+            }
+        }
+    }
+
+    memset(row, 0, sizeof(row));
+    return ret;
+}
+
+/*
+ * gf_weights:
+ *   Lagrange weights at 0 for abscissae xs, w_i = prod_{j!=i} x_j / (x_j ^ x_i).
+ *   Fails on a zero or repeated x.
+ */
+int gf_weights(const uint8_t* xs, int piece_k, uint8_t* weights)
+{
+    for (int i = 0; i < piece_k; i++)
+    {
+        if (xs[i] == 0)
+            return -1;
+        uint8_t num = 1, den = 1;
+        for (int j = 0; j < piece_k; j++)
+        {
+            if (j == i)
+                continue;
+            if (xs[j] == xs[i])
+                return -1;
+            num = gf256_mul(num, xs[j]);
+            den = gf256_mul(den, (uint8_t)(xs[j] ^ xs[i]));
+        }
+        weights[i] = gf256_div(num, den);
+    }
+    return 0;
+}
+
+void gf_combine(const uint8_t* weights, const uint8_t* const* in, int piece_k, size_t len, uint8_t* secret)
+{
+    //k个份额一次点积,secret每块只写一次
+    const uint8_t* src[GF_MAX_N];
+    for (size_t off = 0; off < len; off += GF_BLOCK_MAX)
+    {
+        size_t b = len - off < GF_BLOCK_MAX ? len - off : GF_BLOCK_MAX;
+        for (int i = 0; i < piece_k; i++)
+            src[i] = in[i] + off;
+        gf256_dot_region(secret + off, src, weights, piece_k, b);
+    }
+}
+
+/*
+ * gf_split_blob:
+ *   Split secret[0..len) k-of-n; shares holds n shares of len bytes, share
+ *   i (x = i+1) at shares + i*len.
+ */
+int gf_split_blob(const uint8_t* secret, size_t len, int piece_k, int piece_n, uint8_t* shares, size_t shares_len)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > GF_MAX_N || len == 0 ||
+        shares_len / (size_t)piece_n != len || shares_len % (size_t)piece_n != 0 ||
+        shares_len > GF_INLINE_MAX || len > GF_INLINE_MAX - shares_len)
+        return -1;
+
+    gf_setup();
+    uint8_t* out[GF_MAX_N];
+    for (int i = 0; i < piece_n; i++)
+        out[i] = shares + (size_t)i * len;
+
+    gf_rng_t rng;
+    int ret = gf_rng_init(&rng);
+    if (ret == 0)
+        ret = gf_split(&rng, secret, len, piece_k, piece_n, out);
+    gf_rng_clear(&rng);
+    if (ret != 0)
+        memset(shares, 0, shares_len);
+    return ret;
+}
+
+/*
+ * gf_combine_blob:
+ *   Recover secret[0..len) from k shares laid out like gf_split_blob's,
+ *   share i taken at x = xs[i].
+ */
+int gf_combine_blob(const uint8_t* shares, size_t shares_len, const uint8_t* xs, int piece_k, uint8_t* secret, size_t len)
+{
+    if (piece_k < 1 || piece_k > GF_MAX_N || len == 0 ||
+        shares_len / (size_t)piece_k != len || shares_len % (size_t)piece_k != 0 ||
+        shares_len > GF_INLINE_MAX || len > GF_INLINE_MAX - shares_len)
+        return -1;
+
+    uint8_t weights[GF_MAX_N];
+    if (gf_weights(xs, piece_k, weights) != 0)
+        return -1;
+
+    gf_setup();
+    const uint8_t* in[GF_MAX_N];
+    for (int i = 0; i < piece_k; i++)
+        in[i] = shares + (size_t)i * len;
+    gf_combine(weights, in, piece_k, len, secret);
+    return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Encrypted share delivery.
+ *
+ * The enclave has a long-term X25519 key derived from the store key, so
+ * custodians can pin its public half across restarts. A custodian's
+ * session key is SHA-256(label || X25519(enclave, custodian) || enclave
+ * pub || custodian pub), used as an AES-256-GCM key. Deriving it and
+ * expanding the AES key schedule and GHASH table is what costs; a share
+ * is then one 32-byte GCM message. Initialised GCM contexts are cached
+ * per custodian public key in a set-associative table with CLOCK
+ * replacement, like the key store's hot tier.
+ *
+ * deliver_wrap regenerates the shares of seeded keys inside the enclave,
+ * so no plaintext share crosses the boundary. It takes the keys in blocks
+ * of at most DLV_BLOCK_SHARES shares and walks each block custodian by
+ * custodian, so a session is looked up once per block and the call's heap
+ * use does not grow with the number of keys. IVs are random, drawn from
+ * one AES-CTR keystream per block. The session table holds DLV_SETS *
+ * DLV_WAYS contexts, a few KB each with their GHASH tables.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_tcrypto.h"
+#include "sgx_thread.h"
+
+#define DLV_SET_BITS 3
+#define DLV_SETS     (1 << DLV_SET_BITS)
+#define DLV_WAYS     4
+#define DLV_BLOCK_SHARES 2048   /* shares regenerated and wrapped per block */
+
+static const uint8_t dlv_label_lo[] = "SGXDLV-key-lo";
+static const uint8_t dlv_label_hi[] = "SGXDLV-key-hi";
+static const uint8_t session_label[] = "SGXDLV-session";
+static const uint8_t x25519_base[32] = {9};
+
+typedef struct _dlv_slot_t {
+    uint8_t pub[32];
+    uint32_t used;
+    uint32_t ref;
+    IppsAES_GCMState* gcm;
+} dlv_slot_t;
+
+typedef struct _dlv_set_t {
+    dlv_slot_t way[DLV_WAYS];
+    uint32_t hand;
+} dlv_set_t;
+
+static dlv_set_t sessions[DLV_SETS];
+static uint8_t dlv_priv[32];
+static uint8_t dlv_pub[32];
+static int dlv_ready = 0;
+static int gcm_size = 0;
+static sgx_thread_mutex_t dlv_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+//持有dlv_mutex时调用; key store打开后才能导出长期密钥
+static int dlv_setup(void)
+{
+    if (dlv_ready)
+        return 0;
+    if (keystore_subkey(dlv_label_lo, sizeof(dlv_label_lo) - 1, dlv_priv) != 0 ||
+        keystore_subkey(dlv_label_hi, sizeof(dlv_label_hi) - 1, dlv_priv + 16) != 0 ||
+        x25519(dlv_pub, dlv_priv, x25519_base) != 0)
+    {
+        memset(dlv_priv, 0, sizeof(dlv_priv));
+        return -1;
+    }
+    ippsAES_GCMGetSize(&gcm_size);
+    dlv_ready = 1;
+    return 0;
+}
+
+static dlv_set_t* dlv_set(const uint8_t pub[32])
+{
+    uint64_t h = 0;
+    for (int i = 0; i < 8; i++)
+        h |= (uint64_t)pub[i] << (8 * i);
+    return &sessions[(h * 0x9E3779B97F4A7C15ULL) >> (64 - DLV_SET_BITS)];
+}
+
+//custodian的会话密钥; 小阶点返回-1
+static int session_key(const uint8_t pub[32], uint8_t key[ENV_KEY_SIZE])
+{
+    uint8_t shared[32];
+    int ret = x25519(shared, dlv_priv, pub);
+
+    sgx_sha_state_handle_t sha;
+    if (ret == 0)
+        ret = sgx_sha256_init(&sha) == SGX_SUCCESS ? 0 : -1;
+    if (ret == 0)
+    {
+        if (sgx_sha256_update(session_label, sizeof(session_label) - 1, sha) != SGX_SUCCESS ||
+            sgx_sha256_update(shared, sizeof(shared), sha) != SGX_SUCCESS ||
+            sgx_sha256_update(dlv_pub, sizeof(dlv_pub), sha) != SGX_SUCCESS ||
+            sgx_sha256_update(pub, 32, sha) != SGX_SUCCESS ||
+            sgx_sha256_get_hash(sha, (sgx_sha256_hash_t*)key) != SGX_SUCCESS)
+            ret = -1;
+        sgx_sha256_close(sha);
+    }
+    memset(shared, 0, sizeof(shared));
+    return ret;
+}
+
+//查找或建立pub的GCM上下文,持有dlv_mutex时调用
+static IppsAES_GCMState* dlv_session(const uint8_t pub[32])
+{
+    dlv_set_t* set = dlv_set(pub);
+    dlv_slot_t* victim = NULL;
+    for (int i = 0; i < DLV_WAYS; i++)
+    {
+        if (set->way[i].used && memcmp(set->way[i].pub, pub, 32) == 0)
+        {
+            set->way[i].ref = 1;
+            return set->way[i].gcm;
+        }
+        if (!set->way[i].used && !victim)
+            victim = &set->way[i];
+    }
+
+    uint8_t key[ENV_KEY_SIZE];
+    if (session_key(pub, key) != 0)
+        return NULL;
+
+    while (!victim)
+    {
+        dlv_slot_t* slot = &set->way[set->hand];
+        set->hand = (set->hand + 1) % DLV_WAYS;
+        if (slot->ref)
+            slot->ref = 0;
+        else
+            victim = slot;
+    }
+    if (!victim->gcm)
+        victim->gcm = (IppsAES_GCMState*)(new Ipp8u[gcm_size]);
+
+    int ok = ippsAES_GCMInit(key, ENV_KEY_SIZE, victim->gcm, gcm_size) == ippStsNoErr;
+    memset(key, 0, sizeof(key));
+    memcpy(victim->pub, pub, 32);
+    victim->used = ok;
+    victim->ref = 1;
+    return ok ? victim->gcm : NULL;
+}
+
+//在enclave内组好密文再整体拷出,AAD取自可信副本
+static int wrap_share(IppsAES_GCMState* gcm, uint64_t key_id, const share_t* s, const uint8_t iv[ENV_IV_SIZE],
+                      wrapped_share_t* out)
+{
+    wrapped_share_t w;
+    memset(&w, 0, sizeof(w));
+    w.key_id = key_id;
+    w.x = s->x;
+    memcpy(w.iv, iv, ENV_IV_SIZE);
+
+    //GCMStart重置上下文,缓存的密钥扩展和GHASH表保留
+    int ret = ippsAES_GCMStart(w.iv, ENV_IV_SIZE, (const Ipp8u*)&w, (int)offsetof(wrapped_share_t, iv), gcm) == ippStsNoErr &&
+              ippsAES_GCMEncrypt(s->y, w.ct, sizeof(w.ct), gcm) == ippStsNoErr &&
+              ippsAES_GCMGetTag(w.tag, ENV_TAG_SIZE, gcm) == ippStsNoErr ? 0 : -1;
+    if (ret == 0)
+        memcpy(out, &w, sizeof(w));
+    return ret;
+}
+
+/*
+ * deliver_public_key:
+ *   The enclave's X25519 delivery key (little-endian u), for custodians.
+ */
+int deliver_public_key(uint8_t* pub)
+{
+    sgx_thread_mutex_lock(&dlv_mutex);
+    int ret = dlv_setup();
+    if (ret == 0)
+        memcpy(pub, dlv_pub, 32);
+    sgx_thread_mutex_unlock(&dlv_mutex);
+    return ret;
+}
+
+/*
+ * deliver_wrap:
+ *   Encrypt share x = i+1 of each seeded key to custodian i (X25519
+ *   public key i of 'custodians') into out[b*piece_n + i], out in app
+ *   memory. Keys that cannot regenerate their shares fail the call.
+ *   The shares are the issue-time ones: deliver before refreshing a
+ *   key's share file, not after.
+ */
+int deliver_wrap(int keys, const uint64_t* key_ids, int piece_n, const uint8_t* custodians, size_t custodians_len,
+                 wrapped_share_t* out)
+{
+    if (keys < 1 || piece_n < 1 || piece_n > SHARE_MAX_N || (size_t)keys * piece_n > DELIVER_MAX_SHARES ||
+        custodians_len != 32 * (size_t)piece_n)
+        return -1;
+    size_t total = (size_t)keys * piece_n;
+    if (!sgx_is_outside_enclave(out, total * sizeof(wrapped_share_t)))
+        return -1;
+    sgx_lfence();
+
+    //每块至少一个key, piece_n不超过SHARE_MAX_N
+    int block = DLV_BLOCK_SHARES / piece_n > 0 ? DLV_BLOCK_SHARES / piece_n : 1;
+    uint32_t* xs = new uint32_t[piece_n];
+    share_t* shares = new share_t[(size_t)block * piece_n];
+    uint8_t* ivs = new uint8_t[ENV_IV_SIZE * (size_t)block * piece_n];
+    for (int i = 0; i < piece_n; i++)
+        xs[i] = (uint32_t)(i + 1);
+
+    int ret = 0;
+    for (int b0 = 0; b0 < keys && ret == 0; b0 += block)
+    {
+        int nkeys = keys - b0 < block ? keys - b0 : block;
+        for (int b = 0; b < nkeys && ret == 0; b++)
+            ret = regen_shares(key_ids[b0 + b], xs, piece_n, shares + (size_t)b * piece_n);
+
+        gf_rng_t rng;
+        if (ret == 0)
+            ret = gf_rng_init(&rng);
+        if (ret == 0)
+        {
+            ret = gf_rng_fill(&rng, ivs, ENV_IV_SIZE * (size_t)nkeys * piece_n);
+            gf_rng_clear(&rng);
+        }
+
+        sgx_thread_mutex_lock(&dlv_mutex);
+        if (ret == 0)
+            ret = dlv_setup();
+        for (int i = 0; i < piece_n && ret == 0; i++)
+        {
+            IppsAES_GCMState* gcm = dlv_session(custodians + 32*(size_t)i);
+            if (gcm == NULL)
+                ret = -1;
+            for (int b = 0; b < nkeys && ret == 0; b++)
+            {
+                size_t at = (size_t)b * piece_n + i;
+                ret = wrap_share(gcm, key_ids[b0 + b], &shares[at], ivs + ENV_IV_SIZE * at,
+                                 &out[(size_t)b0 * piece_n + at]);
+            }
+        }
+        sgx_thread_mutex_unlock(&dlv_mutex);
+    }
+
+    memset(shares, 0, (size_t)block * piece_n * sizeof(share_t));
+    delete [] shares;
+    delete [] ivs;
+    delete [] xs;
+    return ret;
+}
+
+/*
+ * deliver_seal:
+ *   Encrypt count 32-byte values (enclave memory) to one recipient X25519
+ *   key, value j as a wrapped_share_t with key_id first+j and x 0, into
+ *   out in app memory (checked by the caller). For secrets recovered
+ *   inside the enclave that must only leave it encrypted.
+ */
+int deliver_seal(const uint8_t recipient[32], uint64_t first, const uint8_t* values, size_t count, wrapped_share_t* out)
+{
+    uint8_t* ivs = new uint8_t[ENV_IV_SIZE * count];
+    gf_rng_t rng;
+    int ret = gf_rng_init(&rng);
+    if (ret == 0)
+    {
+        ret = gf_rng_fill(&rng, ivs, ENV_IV_SIZE * count);
+        gf_rng_clear(&rng);
+    }
+
+    share_t s;
+    s.x = 0;
+    sgx_thread_mutex_lock(&dlv_mutex);
+    if (ret == 0)
+        ret = dlv_setup();
+    IppsAES_GCMState* gcm = ret == 0 ? dlv_session(recipient) : NULL;
+    if (gcm == NULL)
+        ret = -1;
+    for (size_t j = 0; j < count && ret == 0; j++)
+    {
+        memcpy(s.y, values + 32 * j, 32);
+        ret = wrap_share(gcm, first + j, &s, ivs + ENV_IV_SIZE * j, &out[j]);
+    }
+    sgx_thread_mutex_unlock(&dlv_mutex);
+
+    memset(&s, 0, sizeof(s));
+    delete [] ivs;
+    return ret;
+}
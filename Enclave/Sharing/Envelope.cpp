@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Envelope mode for large blobs (secret sharing made short).
+ *
+ * Instead of sharing every byte, the enclave encrypts the blob under a
+ * fresh AES-256-GCM key and shares only that 32-byte key k-of-n with the
+ * GF(2^8) kernels. The ciphertext is not secret, so the app disperses it
+ * with Reed-Solomon outside the enclave; every custodian then stores
+ * len/k ciphertext bytes plus a 32-byte key share instead of len bytes.
+ * Chunks stream through user_check buffers like the blob path; (k, n, len)
+ * are bound into the tag as AAD.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_thread.h"
+
+#define ENV_JOBS 4
+
+typedef struct _env_aad_t {
+    uint32_t piece_k;
+    uint32_t piece_n;
+    uint64_t len;
+} env_aad_t;
+
+typedef struct _env_job_t {
+    int active;
+    int ready;
+    int busy;
+    int sealing;
+    int piece_k;
+    int piece_n;
+    uint8_t key[ENV_KEY_SIZE];
+    IppsAES_GCMState* gcm;
+    int gcm_size;
+} env_job_t;
+
+static env_job_t env_jobs[ENV_JOBS];
+static sgx_thread_mutex_t env_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+//查找和占用在同一把锁下完成: 占用期间别的ecall(包括end)拿不到这个job
+static env_job_t* env_get(uint32_t job)
+{
+    if (job >= ENV_JOBS)
+        return NULL;
+    sgx_lfence();
+    env_job_t* j = NULL;
+    sgx_thread_mutex_lock(&env_mutex);
+    if (env_jobs[job].ready && !env_jobs[job].busy)
+    {
+        env_jobs[job].busy = 1;
+        j = &env_jobs[job];
+    }
+    sgx_thread_mutex_unlock(&env_mutex);
+    return j;
+}
+
+static void env_put(env_job_t* j)
+{
+    sgx_thread_mutex_lock(&env_mutex);
+    j->busy = 0;
+    sgx_thread_mutex_unlock(&env_mutex);
+}
+
+//调用方已占用j(或j还没ready),别的线程不会再碰它
+static void env_free(env_job_t* j)
+{
+    if (j->gcm)
+    {
+        memset(j->gcm, 0, j->gcm_size);
+        delete [] (Ipp8u*) j->gcm;
+    }
+    sgx_thread_mutex_lock(&env_mutex);
+    memset(j, 0, sizeof(*j));
+    sgx_thread_mutex_unlock(&env_mutex);
+}
+
+//占一个job并用key启动GCM,AAD绑定(k,n,len)
+static env_job_t* env_start(int sealing, int piece_k, int piece_n, uint64_t len, const uint8_t key[ENV_KEY_SIZE],
+                            const uint8_t iv[ENV_IV_SIZE], uint32_t* job)
+{
+    env_job_t* j = NULL;
+    sgx_thread_mutex_lock(&env_mutex);
+    for (uint32_t i = 0; i < ENV_JOBS; i++)
+    {
+        if (!env_jobs[i].active)
+        {
+            env_jobs[i].active = 1;
+            *job = i;
+            j = &env_jobs[i];
+            break;
+        }
+    }
+    sgx_thread_mutex_unlock(&env_mutex);
+    if (j == NULL)
+        return NULL;
+
+    env_aad_t aad;
+    memset(&aad, 0, sizeof(aad));
+    aad.piece_k = (uint32_t)piece_k;
+    aad.piece_n = (uint32_t)piece_n;
+    aad.len = len;
+
+    ippsAES_GCMGetSize(&j->gcm_size);
+    j->gcm = (IppsAES_GCMState*)(new Ipp8u[j->gcm_size]);
+    memcpy(j->key, key, ENV_KEY_SIZE);
+    if (ippsAES_GCMInit(j->key, ENV_KEY_SIZE, j->gcm, j->gcm_size) != ippStsNoErr ||
+        ippsAES_GCMStart(iv, ENV_IV_SIZE, (const Ipp8u*)&aad, sizeof(aad), j->gcm) != ippStsNoErr)
+    {
+        env_free(j);
+        return NULL;
+    }
+    j->sealing = sealing;
+    j->piece_k = piece_k;
+    j->piece_n = piece_n;
+    sgx_thread_mutex_lock(&env_mutex);
+    j->ready = 1;
+    sgx_thread_mutex_unlock(&env_mutex);
+    return j;
+}
+
+/*
+ * env_seal_begin:
+ *   Draw a key and IV for a len-byte blob to be dispersed k-of-n.
+ */
+int env_seal_begin(int piece_k, int piece_n, uint64_t len, uint8_t* iv, uint32_t* job)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > GF_MAX_N || len == 0)
+        return -1;
+
+    uint8_t key[ENV_KEY_SIZE];
+    int ret = -1;
+    if (sgx_read_rand(key, sizeof(key)) == SGX_SUCCESS && sgx_read_rand(iv, ENV_IV_SIZE) == SGX_SUCCESS &&
+        env_start(1, piece_k, piece_n, len, key, iv, job) != NULL)
+        ret = 0;
+    memset(key, 0, sizeof(key));
+    return ret;
+}
+
+//加解密都在app内存上原地进行,明文本来就在app手里
+static int env_chunk(uint32_t job, int sealing, const uint8_t* in, size_t len, uint8_t* out)
+{
+    if (len == 0 || len > BLOB_CHUNK_MAX)
+        return -1;
+    if (in == NULL || out == NULL || sgx_is_outside_enclave(in, len) != 1 || sgx_is_outside_enclave(out, len) != 1)
+        return -1;
+    sgx_lfence();
+    env_job_t* j = env_get(job);
+    if (j == NULL)
+        return -1;
+
+    int ret = -1;
+    if (j->sealing == sealing)
+    {
+        IppStatus st = sealing ? ippsAES_GCMEncrypt(in, out, (int)len, j->gcm)
+                               : ippsAES_GCMDecrypt(in, out, (int)len, j->gcm);
+        ret = st == ippStsNoErr ? 0 : -1;
+    }
+    env_put(j);
+    return ret;
+}
+
+int env_seal_chunk(uint32_t job, const uint8_t* in, size_t len, uint8_t* out)
+{
+    return env_chunk(job, 1, in, len, out);
+}
+
+/*
+ * env_seal_end:
+ *   Emit the tag and the n key shares (32 bytes each, x = i+1), free the job.
+ */
+int env_seal_end(uint32_t job, uint8_t* tag, uint8_t* key_shares, size_t shares_len)
+{
+    env_job_t* j = env_get(job);
+    if (j == NULL)
+        return -1;
+    if (!j->sealing)
+    {
+        env_put(j);
+        return -1;
+    }
+
+    int ret = -1;
+    gf_rng_t rng;
+    if (shares_len == (size_t)j->piece_n * ENV_KEY_SIZE &&
+        ippsAES_GCMGetTag(tag, ENV_TAG_SIZE, j->gcm) == ippStsNoErr &&
+        gf_rng_init(&rng) == 0)
+    {
+        uint8_t* out[GF_MAX_N];
+        for (int i = 0; i < j->piece_n; i++)
+            out[i] = key_shares + (size_t)i * ENV_KEY_SIZE;
+        gf_setup();
+        ret = gf_split(&rng, j->key, ENV_KEY_SIZE, j->piece_k, j->piece_n, out);
+    }
+    gf_rng_clear(&rng);
+    if (ret != 0)
+        memset(key_shares, 0, shares_len);
+    env_free(j);
+    return ret;
+}
+
+/*
+ * env_open_begin:
+ *   Rebuild the key from k key shares (share i at x = xs[i]) and start
+ *   decrypting. Plaintext chunks are unauthenticated until env_open_end.
+ */
+int env_open_begin(int piece_k, int piece_n, uint64_t len, const uint8_t* iv, const uint8_t* xs,
+                   const uint8_t* key_shares, size_t shares_len, uint32_t* job)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > GF_MAX_N || len == 0 ||
+        shares_len != (size_t)piece_k * ENV_KEY_SIZE)
+        return -1;
+
+    uint8_t weights[GF_MAX_N];
+    if (gf_weights(xs, piece_k, weights) != 0)
+        return -1;
+
+    const uint8_t* in[GF_MAX_N];
+    for (int i = 0; i < piece_k; i++)
+        in[i] = key_shares + (size_t)i * ENV_KEY_SIZE;
+    uint8_t key[ENV_KEY_SIZE];
+    gf_setup();
+    gf_combine(weights, in, piece_k, ENV_KEY_SIZE, key);
+
+    int ret = env_start(0, piece_k, piece_n, len, key, iv, job) != NULL ? 0 : -1;
+    memset(key, 0, sizeof(key));
+    return ret;
+}
+
+int env_open_chunk(uint32_t job, const uint8_t* in, size_t len, uint8_t* out)
+{
+    return env_chunk(job, 0, in, len, out);
+}
+
+/*
+ * env_open_end:
+ *   0 only if the whole ciphertext matched tag; frees the job either way.
+ */
+int env_open_end(uint32_t job, const uint8_t* tag)
+{
+    env_job_t* j = env_get(job);
+    if (j == NULL)
+        return -1;
+    if (j->sealing)
+    {
+        env_put(j);
+        return -1;
+    }
+
+    uint8_t calc[ENV_TAG_SIZE];
+    uint8_t diff = 0xff;
+    if (ippsAES_GCMGetTag(calc, ENV_TAG_SIZE, j->gcm) == ippStsNoErr)
+    {
+        //常数时间比较
+        diff = 0;
+        for (int i = 0; i < ENV_TAG_SIZE; i++)
+            diff |= (uint8_t)(calc[i] ^ tag[i]);
+    }
+    env_free(j);
+    return diff == 0 ? 0 : -1;
+}
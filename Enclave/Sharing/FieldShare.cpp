@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Shamir sharing of data over a prime field picked per call.
+ *
+ * The secret is cut into chunks of F::CHUNK bytes, each the constant term
+ * of its own polynomial of degree k-1; share i (x = i+1) holds one
+ * F::BYTES element per chunk. The splitting and combining loops are one
+ * template over the backends of PrimeField.h. Random coefficients come
+ * from an AES-CTR keystream, filled for FIELD_RAND_CHUNKS chunks at a
+ * time.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "PrimeField.h"
+#include "Enclave_t.h"
+
+#define FIELD_RAND_CHUNKS 64
+
+//一个元素承载的数据字节数,其余高位为0
+static size_t field_chunks(int field, size_t len, size_t* elem_bytes)
+{
+    size_t chunk = field == FIELD_P64 ? (size_t)pf_p64::CHUNK : field == FIELD_M127 ? (size_t)pf_m127::CHUNK
+                                                                                   : (size_t)pf_order::CHUNK;
+    *elem_bytes = chunk + 1;
+    return (len + chunk - 1) / chunk;
+}
+
+template <class F>
+static int split_data(const F& f, gf_rng_t* rng, const uint8_t* secret, size_t len, int piece_k, int piece_n,
+                      uint8_t* shares)
+{
+    size_t chunks = (len + F::CHUNK - 1) / F::CHUNK;
+    size_t row = chunks * F::BYTES;
+    size_t rand_len = (size_t)F::RAND_BYTES * (piece_k - 1) * FIELD_RAND_CHUNKS;
+    typename F::elem* coef = new typename F::elem[piece_k];
+    typename F::elem* y = new typename F::elem[piece_n];
+    uint8_t* rnd = new uint8_t[rand_len > 0 ? rand_len : 1];
+    uint8_t buf[F::BYTES];
+    int ret = 0;
+
+    for (size_t c = 0; c < chunks && ret == 0; c++)
+    {
+        size_t g = c % FIELD_RAND_CHUNKS;
+        if (g == 0 && rand_len > 0)
+            ret = gf_rng_fill(rng, rnd, rand_len);
+
+        size_t take = len - c * F::CHUNK < (size_t)F::CHUNK ? len - c * F::CHUNK : (size_t)F::CHUNK;
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf + F::BYTES - take, secret + c * F::CHUNK, take);
+        f.from_bytes(coef[0], buf);
+        for (int j = 1; j < piece_k; j++)
+            f.from_random(coef[j], rnd + (size_t)F::RAND_BYTES * ((piece_k - 1) * g + (j - 1)));
+
+        pf_eval_all(f, coef, piece_k, y, piece_n);
+        for (int i = 0; i < piece_n; i++)
+            f.to_bytes(shares + row * i + F::BYTES * c, y[i]);
+    }
+
+    memset(buf, 0, sizeof(buf));
+    memset(rnd, 0, rand_len > 0 ? rand_len : 1);
+    memset(coef, 0, sizeof(typename F::elem) * piece_k);
+    memset(y, 0, sizeof(typename F::elem) * piece_n);
+    delete [] rnd;
+    delete [] y;
+    delete [] coef;
+    return ret;
+}
+
+template <class F>
+static int combine_data(const F& f, const uint32_t* xs, int piece_k, const uint8_t* shares, size_t len, uint8_t* secret)
+{
+    size_t chunks = (len + F::CHUNK - 1) / F::CHUNK;
+    size_t row = chunks * F::BYTES;
+    typename F::elem* w = new typename F::elem[piece_k];
+    typename F::elem acc, v;
+    uint8_t buf[F::BYTES];
+
+    int ret = pf_weights_zero(f, xs, piece_k, w);
+    for (size_t c = 0; c < chunks && ret == 0; c++)
+    {
+        f.zero(acc);
+        for (int i = 0; i < piece_k && ret == 0; i++)
+        {
+            ret = f.from_bytes(v, shares + row * i + F::BYTES * c);
+            f.mul(v, v, w[i]);
+            f.add(acc, acc, v);
+        }
+        f.to_bytes(buf, acc);
+
+        //高位必须为0,否则份额不属于同一秘密
+        size_t take = len - c * F::CHUNK < (size_t)F::CHUNK ? len - c * F::CHUNK : (size_t)F::CHUNK;
+        uint8_t high = 0;
+        for (size_t b = 0; b < F::BYTES - take; b++)
+            high |= buf[b];
+        if (ret == 0 && high != 0)
+            ret = -1;
+        if (ret == 0)
+            memcpy(secret + c * F::CHUNK, buf + F::BYTES - take, take);
+    }
+
+    if (ret != 0)
+        memset(secret, 0, len);
+    memset(buf, 0, sizeof(buf));
+    memset(&acc, 0, sizeof(acc));
+    delete [] w;
+    return ret;
+}
+
+/*
+ * field_split:
+ *   Split secret[0..len) k-of-n over 'field'; shares holds the n shares
+ *   back to back, share i at x = i+1, each chunks * element bytes.
+ */
+int field_split(int field, const uint8_t* secret, size_t len, int piece_k, int piece_n, uint8_t* shares, size_t shares_len)
+{
+    size_t elem_bytes;
+    size_t chunks = field_chunks(field, len, &elem_bytes);
+    if (field < FIELD_ORDER || field > FIELD_P64 || len == 0 || len > FIELD_INLINE_MAX || piece_k < SHARE_MIN_K || piece_k > piece_n ||
+        piece_n > SHARE_MAX_N || shares_len != chunks * elem_bytes * piece_n || shares_len > FIELD_INLINE_MAX)
+        return -1;
+
+    gf_rng_t rng;
+    if (gf_rng_init(&rng) != 0)
+        return -1;
+    int ret;
+    if (field == FIELD_P64)
+        ret = split_data(pf_p64(), &rng, secret, len, piece_k, piece_n, shares);
+    else if (field == FIELD_M127)
+        ret = split_data(pf_m127(), &rng, secret, len, piece_k, piece_n, shares);
+    else
+        ret = split_data(pf_order(share_modulus()), &rng, secret, len, piece_k, piece_n, shares);
+    gf_rng_clear(&rng);
+    if (ret != 0)
+        memset(shares, 0, shares_len);
+    return ret;
+}
+
+/*
+ * field_combine:
+ *   Recover secret[0..len) from k shares (abscissae xs) laid out as
+ *   field_split writes them. Fails on a bad abscissa, an element out of
+ *   range, or a result that does not fit the chunk size.
+ */
+int field_combine(int field, const uint8_t* shares, size_t shares_len, const uint32_t* xs, int piece_k,
+                  uint8_t* secret, size_t len)
+{
+    size_t elem_bytes;
+    size_t chunks = field_chunks(field, len, &elem_bytes);
+    if (field < FIELD_ORDER || field > FIELD_P64 || len == 0 || len > FIELD_INLINE_MAX || piece_k < SHARE_MIN_K || piece_k > SHARE_MAX_N ||
+        shares_len != chunks * elem_bytes * piece_k || shares_len > FIELD_INLINE_MAX)
+        return -1;
+
+    if (field == FIELD_P64)
+        return combine_data(pf_p64(), xs, piece_k, shares, len, secret);
+    if (field == FIELD_M127)
+        return combine_data(pf_m127(), xs, piece_k, shares, len, secret);
+    return combine_data(pf_order(share_modulus()), xs, piece_k, shares, len, secret);
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Hierarchical deterministic child keys.
+ *
+ * A child is its parent plus a tweak, child = parent + t mod order, with
+ * t = HMAC-SHA256(chain, ser_P(parent) || ser32(i)) as for BIP32 normal
+ * indices. Hardened indices (i >= HD_HARDENED) are refused: the tweaks
+ * go to the custodians, and child - t gives back the parent, so a
+ * hardened child would protect nothing. Adding a constant
+ * to the sharing polynomial moves every share by the same constant, so a
+ * custodian holding y for the parent holds y + t for the child: a child
+ * of a k-of-n key is a k-of-n key with the same abscissae, and issuing
+ * it costs a few HMACs and one public key instead of a keygen run.
+ *
+ * Chain codes are not stored (the record format is fixed); each key's
+ * chain code is derived from its coefficient seed, so a path always
+ * leads to the same child. Children are stored as ordinary keys flagged
+ * KEYSTORE_FLAG_DERIVED and can be parents in turn. The app remembers
+ * which key_id each child got and passes it back; a child whose stored
+ * key matches is reused instead of being stored twice.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Enclave_t.h"
+
+#include "sgx_tcrypto.h"
+
+static const uint8_t chain_label[] = "SGXHD-chain";
+
+//HMAC-SHA256(key, parts...), key不超过一个块
+static int hmac_sha256(const uint8_t* key, uint32_t key_len, const uint8_t* const* parts, const uint32_t* lens, int n,
+                       uint8_t mac[32])
+{
+    uint8_t pad[64];
+    sgx_sha256_hash_t inner;
+    sgx_sha_state_handle_t sha;
+    int ret = -1;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        memset(pad, pass == 0 ? 0x36 : 0x5c, sizeof(pad));
+        for (uint32_t i = 0; i < key_len; i++)
+            pad[i] ^= key[i];
+        if (sgx_sha256_init(&sha) != SGX_SUCCESS)
+            break;
+        ret = sgx_sha256_update(pad, sizeof(pad), sha) == SGX_SUCCESS ? 0 : -1;
+        if (pass == 0)
+            for (int i = 0; i < n && ret == 0; i++)
+                ret = sgx_sha256_update(parts[i], lens[i], sha) == SGX_SUCCESS ? 0 : -1;
+        else if (ret == 0)
+            ret = sgx_sha256_update(inner, sizeof(inner), sha) == SGX_SUCCESS ? 0 : -1;
+        if (ret == 0)
+            ret = sgx_sha256_get_hash(sha, pass == 0 ? &inner : (sgx_sha256_hash_t*)mac) == SGX_SUCCESS ? 0 : -1;
+        sgx_sha256_close(sha);
+        if (ret != 0)
+            break;
+    }
+    memset(pad, 0, sizeof(pad));
+    memset(inner, 0, sizeof(inner));
+    return ret;
+}
+
+//key的chain code: 由系数种子导出,不单独存储
+static int chain_code(const uint8_t priv[32], uint8_t chain[32])
+{
+    uint8_t seed[16];
+    int ret = keystore_coef_seed(priv, seed);
+    if (ret == 0)
+    {
+        const uint8_t* parts[] = {chain_label};
+        const uint32_t lens[] = {sizeof(chain_label) - 1};
+        ret = hmac_sha256(seed, sizeof(seed), parts, lens, 1, chain);
+    }
+    memset(seed, 0, sizeof(seed));
+    return ret;
+}
+
+/* parent = (pub, chain) 的第index个(非hardened)子key的tweak; 落在[1, order)
+ * 之外时返回-1, 这个index不可用(概率约2^-128) */
+static int child_tweak(share_ctx_t* ctx, int curve, const uint8_t pub[64], const uint8_t chain[32], uint32_t index,
+                       IppsBigNumState* t)
+{
+    uint8_t data[33], idx[4], mac[32];
+    if (curve == SHARE_CURVE_ED25519)
+    {
+        //Ed25519公钥本身就是32字节压缩形式
+        data[0] = 0;
+        memcpy(data + 1, pub, 32);
+    }
+    else
+    {
+        data[0] = (pub[63] & 1) ? 0x03 : 0x02;
+        memcpy(data + 1, pub, 32);
+    }
+    idx[0] = (uint8_t)(index >> 24);
+    idx[1] = (uint8_t)(index >> 16);
+    idx[2] = (uint8_t)(index >> 8);
+    idx[3] = (uint8_t)index;
+
+    const uint8_t* parts[] = {data, idx};
+    const uint32_t lens[] = {sizeof(data), sizeof(idx)};
+    int ret = hmac_sha256(chain, 32, parts, lens, 2, mac);
+    memset(data, 0, sizeof(data));
+    if (ret == 0)
+    {
+        Ipp32u cmp, zero;
+        ippsSetOctString_BN(mac, sizeof(mac), t);
+        ippsCmp_BN(t, ctx->q, &cmp);
+        ippsCmpZero_BN(t, &zero);
+        ret = cmp == IPP_IS_LT && zero != IS_ZERO ? 0 : -1;
+    }
+    memset(mac, 0, sizeof(mac));
+    return ret;
+}
+
+static int nonzero(const IppsBigNumState* bn)
+{
+    Ipp32u zero;
+    ippsCmpZero_BN(bn, &zero);
+    return zero != IS_ZERO;
+}
+
+//key_id处存的是否正是这个子key(同一私钥、策略和标志)
+static int stored_child(uint64_t key_id, const IppsBigNumState* child, int piece_k, int piece_n, uint32_t flags)
+{
+    keystore_secret_t stored;
+    uint8_t priv[32];
+    if (keystore_get(key_id, &stored, NULL) != 0)
+        return 0;
+    ippsGetOctString_BN(priv, 32, child);
+    uint8_t diff = 0;
+    for (int i = 0; i < 32; i++)
+        diff |= (uint8_t)(priv[i] ^ stored.priv[i]);
+    int same = diff == 0 && stored.piece_k == piece_k && stored.piece_n == piece_n && stored.flags == flags;
+    memset(&stored, 0, sizeof(stored));
+    memset(priv, 0, sizeof(priv));
+    return same;
+}
+
+/*
+ * hd_derive:
+ *   Walk 'depth' path indices down from key parent_id, then derive the
+ *   'count' children first .. first+count-1 of that node with the
+ *   parent's (k, n). tweaks[i] (32 bytes, big-endian) is what every
+ *   parent share has to add to become a share of recs[i]. A child whose
+ *   known[i] already holds it comes back with only key_id and pub set
+ *   (version 0); the others are stored and their records go to the app's
+ *   WAL like any other keygen. Hardened indices, packed keys and old
+ *   P-256 records are refused.
+ */
+int hd_derive(uint64_t parent_id, const uint32_t* path, int depth, uint32_t first, int count, const uint64_t* known,
+              keystore_record_t* recs, uint8_t* tweaks, size_t tweaks_len)
+{
+    if (depth < 0 || depth > HD_MAX_DEPTH || count < 1 || count > HD_MAX_CHILDREN ||
+        (uint64_t)first + (uint64_t)count > HD_HARDENED || tweaks_len != 32 * (size_t)count)
+        return -1;
+    for (int l = 0; l < depth; l++)
+        if (path[l] & HD_HARDENED)
+            return -1;
+    memset(recs, 0, (size_t)count * sizeof(keystore_record_t));
+    memset(tweaks, 0, 32 * (size_t)count);
+
+    keystore_secret_t secret;
+    uint8_t pub[64], chain[32];
+    if (keystore_get(parent_id, &secret, pub) != 0)
+        return -1;
+    int curve = (secret.flags & KEYSTORE_FLAG_ED25519) ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1;
+    int ret = (secret.flags & KEYSTORE_FLAG_PACKED) ||
+              !(secret.flags & (KEYSTORE_FLAG_SECP256K1 | KEYSTORE_FLAG_ED25519)) ? -1 : 0;
+
+    Ipp32u zero = 0;
+    share_ctx_t ctx;
+    share_ctx_init(&ctx, curve);
+    IppsBigNumState* priv = newBN(ELEM_WORDS);
+    IppsBigNumState* total = newBN(ELEM_WORDS);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    IppsBigNumState** child = newBNArray(count, ELEM_WORDS);
+    IppsBigNumState** offset = newBNArray(count, ELEM_WORDS);
+    Ipp8u* pubs = new Ipp8u[64 * (size_t)count];
+    ippsSetOctString_BN(secret.priv, 32, priv);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, total);
+
+    //路径上的中间节点不入库,只累计tweak
+    for (int l = 0; l < depth && ret == 0; l++)
+    {
+        ret = chain_code(secret.priv, chain);
+        if (ret == 0)
+            ret = child_tweak(&ctx, curve, pub, chain, path[l], t);
+        if (ret == 0)
+        {
+            mod_add(&ctx, priv, t);
+            mod_add(&ctx, total, t);
+            ret = nonzero(priv) ? batch_public_keys(&priv, 1, pub, curve) : -1;
+            ippsGetOctString_BN(secret.priv, 32, priv);
+        }
+    }
+
+    if (ret == 0)
+        ret = chain_code(secret.priv, chain);
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        ret = child_tweak(&ctx, curve, pub, chain, first + (uint32_t)i, t);
+        if (ret == 0)
+        {
+            ippsSet_BN(IppsBigNumPOS, 1, &zero, child[i]);
+            mod_add(&ctx, child[i], priv);
+            mod_add(&ctx, child[i], t);
+            ippsSet_BN(IppsBigNumPOS, 1, &zero, offset[i]);
+            mod_add(&ctx, offset[i], total);
+            mod_add(&ctx, offset[i], t);
+            ret = nonzero(child[i]) ? 0 : -1;
+        }
+    }
+
+    //所有子公钥共用一次求逆
+    if (ret == 0)
+        ret = batch_public_keys(child, count, pubs, curve);
+    uint32_t flags = (secret.flags & KEYSTORE_FLAG_ED25519) | KEYSTORE_FLAG_DERIVED;
+    uint32_t stored_flags = (flags & KEYSTORE_FLAG_ED25519) ? flags : flags | KEYSTORE_FLAG_SECP256K1;
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        if (known[i] != 0 && stored_child(known[i], child[i], secret.piece_k, secret.piece_n, stored_flags))
+        {
+            recs[i].key_id = known[i];
+            memcpy(recs[i].pub, pubs + 64*(size_t)i, sizeof(recs[i].pub));
+        }
+        else
+        {
+            ret = store_sharing_key(child[i], pubs + 64*(size_t)i, secret.piece_k, secret.piece_n, flags, &recs[i]);
+        }
+        ippsGetOctString_BN(tweaks + 32*(size_t)i, 32, offset[i]);
+    }
+    if (ret != 0)
+    {
+        memset(recs, 0, (size_t)count * sizeof(keystore_record_t));
+        memset(tweaks, 0, 32 * (size_t)count);
+    }
+
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, priv);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, t);
+    for (int i = 0; i < count; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, child[i]);
+    memset(&secret, 0, sizeof(secret));
+    memset(chain, 0, sizeof(chain));
+    delete [] pubs;
+    deleteBNArray(offset);
+    deleteBNArray(child);
+    delete [] (Ipp8u*) t;
+    delete [] (Ipp8u*) total;
+    delete [] (Ipp8u*) priv;
+    share_ctx_free(&ctx);
+    return ret;
+}
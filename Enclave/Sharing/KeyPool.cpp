@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Pool of pre-generated k-of-n keys.
+ *
+ * Fresh keys and their public keys are made ahead of time for one
+ * configured policy and wait in enclave memory, 96 bytes each; a keygen
+ * request for that policy only pops one, seals it into the key store and
+ * expands its shares from the key's coefficient seed (n evaluations, no
+ * RNG, no scalar multiplication). Nothing in the pool is in the key store
+ * yet, so an unused key simply disappears with the enclave.
+ *
+ * The pool is refilled by a background host thread that calls
+ * keypool_refill in a loop: the ecall sleeps on a condition variable
+ * until pops bring the pool down to half its capacity, then makes one
+ * batch (batch keygen, one shared inversion) per call, and keeps doing
+ * so until the pool is full again. Between calls the host paces itself,
+ * which bounds how much CPU refilling takes away from requests.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Enclave_t.h"
+
+#include "sgx_thread.h"
+
+typedef struct {
+    int piece_k;
+    int piece_n;
+    int capacity;
+    int count;          /* ready keys, a stack */
+    int filling;        /* fell to the low mark, refill up to capacity */
+    int stopped;
+    uint32_t gen;       /* bumped by every reconfiguration */
+    Ipp8u* privs;
+    Ipp8u* pubs;
+    sgx_thread_mutex_t mutex;
+    sgx_thread_cond_t less;
+} keypool_t;
+
+static keypool_t keypool = {0, 0, 0, 0, 0, 0, 0, NULL, NULL,
+    SGX_THREAD_MUTEX_INITIALIZER, SGX_THREAD_COND_INITIALIZER};
+
+//抹掉并释放池内所有key
+static void keypool_release(keypool_t* p)
+{
+    if (p->privs)
+        memset(p->privs, 0, 32 * (size_t)p->capacity);
+    delete [] p->privs;
+    delete [] p->pubs;
+    p->privs = NULL;
+    p->pubs = NULL;
+    p->capacity = 0;
+    p->count = 0;
+}
+
+/*
+ * keypool_config:
+ *   Pool up to capacity keys of policy k-of-n, dropping whatever the pool
+ *   held; capacity 0 turns the pool off.
+ */
+int keypool_config(int piece_k, int piece_n, int capacity)
+{
+    if (capacity < 0 || capacity > KEYPOOL_MAX_KEYS ||
+        (capacity > 0 && (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N)))
+        return -1;
+
+    keypool_t* p = &keypool;
+    sgx_thread_mutex_lock(&p->mutex);
+    keypool_release(p);
+    if (capacity > 0)
+    {
+        p->privs = new Ipp8u[32 * (size_t)capacity];
+        p->pubs = new Ipp8u[64 * (size_t)capacity];
+    }
+    p->piece_k = piece_k;
+    p->piece_n = piece_n;
+    p->capacity = capacity;
+    p->filling = 1;
+    p->gen++;
+    sgx_thread_cond_signal(&p->less);
+    sgx_thread_mutex_unlock(&p->mutex);
+    return 0;
+}
+
+/*
+ * keypool_refill:
+ *   Wait until the pool needs keys, then add up to max_keys of them and
+ *   report the new level. Returns 1 once keypool_stop was called.
+ */
+int keypool_refill(int max_keys, int* level)
+{
+    keypool_t* p = &keypool;
+    if (max_keys <= 0 || max_keys > KEYPOOL_REFILL_MAX)
+        return -1;
+
+    sgx_thread_mutex_lock(&p->mutex);
+    while (!p->stopped && !(p->filling && p->count < p->capacity))
+        sgx_thread_cond_wait(&p->less, &p->mutex);
+    if (p->stopped)
+    {
+        sgx_thread_mutex_unlock(&p->mutex);
+        return 1;
+    }
+    int batch = p->capacity - p->count < max_keys ? p->capacity - p->count : max_keys;
+    uint32_t gen = p->gen;
+    sgx_thread_mutex_unlock(&p->mutex);
+
+    //在锁外生成,期间可以照常出池
+    Ipp8u* privs = new Ipp8u[32 * (size_t)batch];
+    Ipp8u* pubs = new Ipp8u[64 * (size_t)batch];
+    int ret = make_shared_keys(batch, 0, 0, privs, pubs, NULL);
+
+    sgx_thread_mutex_lock(&p->mutex);
+    //配置在生成期间变了就丢弃这批
+    for (int b = 0; b < batch && ret == 0 && gen == p->gen && p->count < p->capacity; b++)
+    {
+        int slot = p->count++;
+        memcpy(p->privs + 32*(size_t)slot, privs + 32*(size_t)b, 32);
+        memcpy(p->pubs + 64*(size_t)slot, pubs + 64*(size_t)b, 64);
+    }
+    if (p->count == p->capacity)
+        p->filling = 0;
+    *level = p->count;
+    sgx_thread_mutex_unlock(&p->mutex);
+
+    memset(privs, 0, 32 * (size_t)batch);
+    delete [] privs;
+    delete [] pubs;
+    return ret;
+}
+
+/*
+ * keypool_stop:
+ *   Make a waiting or later keypool_refill return 1.
+ */
+void keypool_stop(void)
+{
+    sgx_thread_mutex_lock(&keypool.mutex);
+    keypool.stopped = 1;
+    sgx_thread_cond_signal(&keypool.less);
+    sgx_thread_mutex_unlock(&keypool.mutex);
+}
+
+/*
+ * keypool_pop:
+ *   Serve a k-of-n keygen from the pool: store the key and return its
+ *   public key and n shares. Returns 1 (nothing stored) when the pool is
+ *   empty or holds another policy.
+ */
+int keypool_pop(int piece_k, int piece_n, char* pDst, keystore_record_t* rec, share_t* shares, size_t shares_len)
+{
+    memset(rec, 0, sizeof(*rec));
+    if (piece_n <= 0 || shares_len != (size_t)piece_n * sizeof(share_t))
+        return -1;
+
+    keypool_t* p = &keypool;
+    Ipp8u priv[32], pub[64];
+    sgx_thread_mutex_lock(&p->mutex);
+    if (p->count == 0 || p->piece_k != piece_k || p->piece_n != piece_n)
+    {
+        sgx_thread_mutex_unlock(&p->mutex);
+        return 1;
+    }
+    int slot = --p->count;
+    memcpy(priv, p->privs + 32*(size_t)slot, 32);
+    memcpy(pub, p->pubs + 64*(size_t)slot, 64);
+    memset(p->privs + 32*(size_t)slot, 0, 32);
+    //降到一半时唤醒补充线程
+    if (!p->filling && p->count <= p->capacity / 2)
+    {
+        p->filling = 1;
+        sgx_thread_cond_signal(&p->less);
+    }
+    sgx_thread_mutex_unlock(&p->mutex);
+
+    IppsBigNumState* bn = newBN(ORDER_WORDS);
+    ippsSetOctString_BN(priv, sizeof(priv), bn);
+    int ret = seeded_shares(priv, piece_k, NULL, piece_n, shares);
+    if (ret == 0)
+        ret = store_sharing_key(bn, pub, piece_k, piece_n, KEYSTORE_FLAG_SEEDED, rec);
+    copy_hex(pDst, pub, 32);
+
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, bn);
+    memset(priv, 0, sizeof(priv));
+    delete [] (Ipp8u*) bn;
+    if (ret != 0)
+        memset(shares, 0, shares_len);
+    return ret == 0 ? 0 : -1;
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Merkle commitment over a batch of shares (layout in merkle.h).
+ *
+ * Every message in the tree has a fixed size, a leaf fits one padded
+ * SHA-256 block and a node two, so hashing is done on pre-padded blocks
+ * rather than through the incremental API. With SHA-NI two independent
+ * messages are compressed in lockstep: one SHA-256 is a serial chain of
+ * sha256rnds2 instructions, and a second chain fills the latency gaps.
+ * Without SHA-NI (or if CPUID says so) each message goes through
+ * sgx_sha256_msg.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "merkle.h"
+
+#include "sgx_cpuid.h"
+#include "sgx_tcrypto.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MERKLE_X86 1
+#endif
+
+#define MERKLE_CHUNK 256    /* messages staged per pass */
+
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha_h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#ifdef MERKLE_X86
+/* st[l] = compress(st[l], data[l][0 .. 64*blocks)) for both lanes */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_x2_shani(uint32_t st[2][8], const uint8_t* const data[2], int blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i s0[2], s1[2];
+
+    //ABCD/EFGH -> sha256rnds2的ABEF/CDGH
+    for (int l = 0; l < 2; l++)
+    {
+        __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&st[l][0]), 0xB1);
+        s1[l] = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&st[l][4]), 0x1B);
+        s0[l] = _mm_alignr_epi8(t, s1[l], 8);
+        s1[l] = _mm_blend_epi16(s1[l], t, 0xF0);
+    }
+
+    for (int b = 0; b < blocks; b++)
+    {
+        __m128i w[2][4], save0[2], save1[2];
+        for (int l = 0; l < 2; l++)
+        {
+            save0[l] = s0[l];
+            save1[l] = s1[l];
+            for (int i = 0; i < 4; i++)
+                w[l][i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data[l] + 64*b + 16*i)), mask);
+        }
+
+        //每组4轮; w环形保存W[g..g+3], 用完W[g]就原地算出W[g+4]
+        for (int g = 0; g < 16; g++)
+        {
+            const __m128i k = _mm_loadu_si128((const __m128i*)&sha_k[4*g]);
+            for (int l = 0; l < 2; l++)
+            {
+                __m128i m = _mm_add_epi32(w[l][g & 3], k);
+                s1[l] = _mm_sha256rnds2_epu32(s1[l], s0[l], m);
+                m = _mm_shuffle_epi32(m, 0x0E);
+                s0[l] = _mm_sha256rnds2_epu32(s0[l], s1[l], m);
+                if (g < 12)
+                {
+                    __m128i t = _mm_sha256msg1_epu32(w[l][g & 3], w[l][(g + 1) & 3]);
+                    t = _mm_add_epi32(t, _mm_alignr_epi8(w[l][(g + 3) & 3], w[l][(g + 2) & 3], 4));
+                    w[l][g & 3] = _mm_sha256msg2_epu32(t, w[l][(g + 3) & 3]);
+                }
+            }
+        }
+
+        for (int l = 0; l < 2; l++)
+        {
+            s0[l] = _mm_add_epi32(s0[l], save0[l]);
+            s1[l] = _mm_add_epi32(s1[l], save1[l]);
+        }
+    }
+
+    for (int l = 0; l < 2; l++)
+    {
+        __m128i t = _mm_shuffle_epi32(s0[l], 0x1B);
+        s1[l] = _mm_shuffle_epi32(s1[l], 0xB1);
+        _mm_storeu_si128((__m128i*)&st[l][0], _mm_blend_epi16(t, s1[l], 0xF0));
+        _mm_storeu_si128((__m128i*)&st[l][4], _mm_alignr_epi8(s1[l], t, 8));
+    }
+}
+#endif /* MERKLE_X86 */
+
+/* CPUID is answered by the host; a lie can at worst select a kernel that faults */
+static int use_shani(void)
+{
+    static volatile int shani = -1;
+    if (shani < 0)
+    {
+        int found = 0;
+#ifdef MERKLE_X86
+        int leaf1[4] = {0}, leaf7[4] = {0};
+        found = sgx_cpuidex(leaf1, 1, 0) == SGX_SUCCESS && sgx_cpuidex(leaf7, 7, 0) == SGX_SUCCESS &&
+                (leaf1[2] & (1 << 9)) && (leaf1[2] & (1 << 19)) && (leaf7[1] & (1 << 29));
+#endif
+        shani = found;
+    }
+    return shani;
+}
+
+//len字节消息补成SHA-256块, 返回块数
+static int sha_pad(const uint8_t* msg, int len, uint8_t* blocks)
+{
+    int nb = (len + 9 + 63) / 64;
+    memset(blocks, 0, 64 * (size_t)nb);
+    memcpy(blocks, msg, len);
+    blocks[len] = 0x80;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++)
+        blocks[64*nb - 1 - i] = (uint8_t)(bits >> (8 * i));
+    return nb;
+}
+
+/* out[j] = SHA-256(msgs[j*len .. j*len+len)) for j < count; len <= 119 */
+static int hash_fixed(const uint8_t* msgs, int len, size_t count, uint8_t* out)
+{
+#ifdef MERKLE_X86
+    if (use_shani())
+    {
+        uint8_t pad[2][128];
+        uint32_t st[2][8];
+        const uint8_t* data[2] = {pad[0], pad[1]};
+        for (size_t j = 0; j < count; j += 2)
+        {
+            //奇数个时第二条lane重复第一条,结果丢弃
+            size_t j1 = j + 1 < count ? j + 1 : j;
+            int nb = sha_pad(msgs + (size_t)len * j, len, pad[0]);
+            sha_pad(msgs + (size_t)len * j1, len, pad[1]);
+            memcpy(st[0], sha_h0, sizeof(sha_h0));
+            memcpy(st[1], sha_h0, sizeof(sha_h0));
+            sha256_x2_shani(st, data, nb);
+            for (int l = 0; l < 2 && j + l < count; l++)
+                for (int i = 0; i < 8; i++)
+                {
+                    uint8_t* h = out + MERKLE_HASH_SIZE * (j + l) + 4*i;
+                    h[0] = (uint8_t)(st[l][i] >> 24);
+                    h[1] = (uint8_t)(st[l][i] >> 16);
+                    h[2] = (uint8_t)(st[l][i] >> 8);
+                    h[3] = (uint8_t)st[l][i];
+                }
+        }
+        return 0;
+    }
+#endif
+    for (size_t j = 0; j < count; j++)
+        if (sgx_sha256_msg(msgs + (size_t)len * j, (uint32_t)len, (sgx_sha256_hash_t*)(out + MERKLE_HASH_SIZE * j)) != SGX_SUCCESS)
+            return -1;
+    return 0;
+}
+
+/*
+ * merkle_commit:
+ *   Build the tree over piece_n shares of each of 'keys' keys (key b's
+ *   shares at shares[b*n ..), its id recs[b].key_id) into tree, which
+ *   holds merkle_nodes(keys*piece_n) hashes, and copy out the root.
+ */
+int merkle_commit(const keystore_record_t* recs, int keys, const share_t* shares, int piece_n, uint8_t* tree,
+                  uint8_t root[MERKLE_HASH_SIZE])
+{
+    uint64_t leaves = (uint64_t)keys * piece_n;
+    uint8_t* msg = new uint8_t[(size_t)MERKLE_CHUNK * MERKLE_NODE_SIZE];
+    int ret = 0;
+
+    for (uint64_t j0 = 0; j0 < leaves && ret == 0; j0 += MERKLE_CHUNK)
+    {
+        size_t count = leaves - j0 < MERKLE_CHUNK ? (size_t)(leaves - j0) : MERKLE_CHUNK;
+        for (size_t c = 0; c < count; c++)
+        {
+            uint64_t j = j0 + c;
+            const share_t* s = &shares[j];
+            uint64_t key_id = recs[j / piece_n].key_id;
+            uint8_t* m = msg + MERKLE_LEAF_SIZE * c;
+            m[0] = 0x00;
+            for (int i = 0; i < 8; i++)
+                m[1 + i] = (uint8_t)(key_id >> (56 - 8*i));
+            for (int i = 0; i < 4; i++)
+                m[9 + i] = (uint8_t)(s->x >> (24 - 8*i));
+            memcpy(m + 13, s->y, 32);
+        }
+        ret = hash_fixed(msg, MERKLE_LEAF_SIZE, count, tree + MERKLE_HASH_SIZE * j0);
+    }
+
+    //逐层向上, 奇数个时最后一个直接上提
+    uint64_t level = 0, width = leaves;
+    while (width > 1 && ret == 0)
+    {
+        const uint8_t* below = tree + MERKLE_HASH_SIZE * level;
+        uint8_t* above = tree + MERKLE_HASH_SIZE * (level + width);
+        uint64_t pairs = width / 2;
+        for (uint64_t p0 = 0; p0 < pairs && ret == 0; p0 += MERKLE_CHUNK)
+        {
+            size_t count = pairs - p0 < MERKLE_CHUNK ? (size_t)(pairs - p0) : MERKLE_CHUNK;
+            for (size_t c = 0; c < count; c++)
+            {
+                uint8_t* m = msg + MERKLE_NODE_SIZE * c;
+                m[0] = 0x01;
+                memcpy(m + 1, below + MERKLE_HASH_SIZE * 2 * (p0 + c), 2 * MERKLE_HASH_SIZE);
+            }
+            ret = hash_fixed(msg, MERKLE_NODE_SIZE, count, above + MERKLE_HASH_SIZE * p0);
+        }
+        if (width & 1)
+            memcpy(above + MERKLE_HASH_SIZE * pairs, below + MERKLE_HASH_SIZE * (width - 1), MERKLE_HASH_SIZE);
+        level += width;
+        width = (width + 1) / 2;
+    }
+
+    if (ret == 0)
+        memcpy(root, tree + MERKLE_HASH_SIZE * level, MERKLE_HASH_SIZE);
+    delete [] msg;
+    return ret;
+}
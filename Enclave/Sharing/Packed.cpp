@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Packed (Franklin-Yung) sharing for bulk key escrow.
+ *
+ * One polynomial of degree m-1, m = t + l, carries l keys at once: the keys
+ * sit at x = -1..-l, t random values at x = -l-1..-m mask them, and each
+ * custodian's single share f(x), x = 1..n, covers the whole batch. Any t
+ * shares reveal nothing, any m shares recover every key by interpolating at
+ * x = -j. Per key that is n/l share evaluations instead of n*k, and the
+ * escrow holds n shares instead of n*l.
+ *
+ * The m defining values sit at consecutive x, so the polynomial is never
+ * put into coefficient form: a forward-difference table built from them is
+ * stepped through x = 0 and then emits f(1..n) with m-1 additions each.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Enclave_t.h"
+
+/*
+ * packed_keygen:
+ *   Generate 'batch' keys packed behind 'threshold' random values, fill
+ *   shares[0..piece_n) and store each key with its slot in the flags.
+ *   Needs threshold + batch <= piece_n.
+ */
+int packed_keygen(int batch, int threshold, int piece_n, keystore_record_t* recs, share_t* shares)
+{
+    int m = threshold + batch;
+    if (batch < 1 || batch > PACKED_MAX_BATCH || threshold < 1 ||
+        m > SHARE_MAX_K || m > piece_n || piece_n > SHARE_MAX_N)
+        return -1;
+    memset(recs, 0, (size_t)batch * sizeof(*recs));
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+
+    //diff[i]初始为f(i-m): 下标m-j处放第j把私钥,前threshold个为随机掩码
+    IppsBigNumState** diff = newBNArray(m, ELEM_WORDS);
+    Ipp8u* pubs = new Ipp8u[64 * batch];
+    IppsPRNGState* pRandGen = newPRNG();
+    for (int i = 0; i < m; i++)
+    {
+        ippsTRNGenRDSEED_BN(diff[i], 256, pRandGen);
+        ippsMod_BN(diff[i], ctx.q, diff[i]);
+    }
+    deletePRNG(pRandGen);
+
+    //整批公钥共用一次求逆
+    IppsBigNumState** keys = new IppsBigNumState*[batch];
+    for (int j = 1; j <= batch; j++)
+        keys[j-1] = diff[m-j];
+    int ret = batch_public_keys(keys, batch, pubs);
+    delete [] keys;
+
+    //保留第一把私钥做自检
+    IppsBigNumState* first = newBN(ORDER_WORDS);
+    ippsMod_BN(diff[m-1], ctx.q, first);
+
+    //私钥先密封再变换差分表
+    for (int j = 1; j <= batch && ret == 0; j++)
+        ret = store_sharing_key(diff[m-j], pubs + 64*(j-1), m, piece_n,
+                                KEYSTORE_FLAG_PACKED | KEYSTORE_PACKED_SLOT(j), &recs[j-1]);
+
+    for (int level = 1; level < m; level++)
+        for (int i = m-1; i >= level; i--)
+            mod_sub(&ctx, diff[i], diff[i-1]);
+
+    //从x=-m走到x=0,之后每走一步输出一个份额
+    IppsBigNumState** check = newBNArray(m, ORDER_WORDS);
+    for (int x = -m; x <= piece_n; x++)
+    {
+        if (x > 0)
+        {
+            shares[x-1].x = (uint32_t)x;
+            ippsGetOctString_BN(shares[x-1].y, sizeof(shares[x-1].y), diff[0]);
+            if (x <= m)
+                ippsMod_BN(diff[0], ctx.q, check[x-1]);
+        }
+        for (int i = 0; i < m-1; i++)
+            mod_add(&ctx, diff[i], diff[i+1]);
+    }
+
+    //用前m个份额在x=-1(即q-1)处插值,应还原第一把私钥
+    if (ret == 0)
+    {
+        Ipp32u* xs = new Ipp32u[m];
+        for (int i = 0; i < m; i++)
+            xs[i] = (Ipp32u)(i + 1);
+        Ipp32u one = 1, cmp;
+        IppsBigNumState* z = newBN(ORDER_WORDS);
+        IppsBigNumState* bnOne = newBN(1);
+        ippsSet_BN(IppsBigNumPOS, 1, &one, bnOne);
+        ippsSub_BN(ctx.q, bnOne, z);
+        IppsBigNumState* secrete = interpolate(check, xs, m, z);
+        ippsCmp_BN(secrete, first, &cmp);
+        if (cmp != IPP_IS_EQ)
+            ret = -1;
+        delete [] (Ipp8u*) secrete;
+        delete [] (Ipp8u*) bnOne;
+        delete [] (Ipp8u*) z;
+        delete [] xs;
+    }
+
+    if (ret != 0)
+    {
+        memset(recs, 0, (size_t)batch * sizeof(*recs));
+        memset(shares, 0, (size_t)piece_n * sizeof(*shares));
+    }
+
+    Ipp32u zero = 0;
+    for (int i = 0; i < m; i++)
+    {
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, diff[i]);
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, check[i]);
+    }
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, first);
+    deleteBNArray(diff);
+    deleteBNArray(check);
+    delete [] (Ipp8u*) first;
+    delete [] pubs;
+    share_ctx_free(&ctx);
+    return ret;
+}
@@ -0,0 +1,500 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* PrimeField.h - prime fields for Shamir sharing, as interchangeable
+ * backends behind one set of templates.
+ *
+ * A backend is a small struct with an element type and const members
+ * zero/set_u32/add/sub/mul/inv, big-endian from_bytes (refusing values
+ * >= p)/to_bytes, and from_random, which maps RAND_BYTES random bytes to
+ * an element with negligible bias. BYTES is the encoded size and CHUNK
+ * the number of data bytes one element carries.
+ *
+ *   pf_order  256-bit group order, Montgomery form on Curve/Field.h
+ *   pf_m127   2^127 - 1: a product folds back with one shift and add
+ *   pf_p64    2^64 - 59: one 64x64 multiply, reduction by 59 * high half
+ *
+ * The common policies (2-of-3, 3-of-5, 3-of-11) have fixed-size kernels
+ * that walk a difference table with additions only.
+ *
+ * Keys have to live mod the group order; data sharing that never meets
+ * the curve can pick a smaller field and pay a fraction of the cost per
+ * byte. Operations are branch-free on element values.
+ */
+
+#ifndef _PRIME_FIELD_H_
+#define _PRIME_FIELD_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../Curve/Field.h"
+
+//mask全1时取b,全0时取a
+static inline uint64_t pf_sel64(uint64_t a, uint64_t b, uint64_t mask)
+{
+    return (a & ~mask) | (b & mask);
+}
+
+struct pf_p64
+{
+    typedef uint64_t elem;
+    enum { BYTES = 8, CHUNK = 7, RAND_BYTES = 16 };
+    static const uint64_t P = 0xFFFFFFFFFFFFFFC5ULL;
+
+    void zero(elem& r) const { r = 0; }
+    void set_u32(elem& r, uint32_t x) const { r = x; }
+    uint64_t is_zero(const elem& a) const { return a == 0; }
+
+    void add(elem& r, const elem& a, const elem& b) const
+    {
+        fe_u128 s = (fe_u128)a + b;
+        fe_u128 t = s - P;
+        r = (uint64_t)pf_sel64((uint64_t)t, (uint64_t)s, 0 - (uint64_t)(t >> 127));
+    }
+
+    void sub(elem& r, const elem& a, const elem& b) const
+    {
+        fe_u128 d = (fe_u128)a - b;
+        r = (uint64_t)d + (P & (0 - (uint64_t)(d >> 127)));
+    }
+
+    //2^64 = 59 mod p: hi*2^64 + lo = lo + 59*hi; 折三次后 < 2^64, 再减一次p
+    void reduce(elem& r, fe_u128 t) const
+    {
+        for (int i = 0; i < 3; i++)
+            t = (fe_u128)(uint64_t)t + (fe_u128)(uint64_t)(t >> 64) * 59;
+        add(r, (uint64_t)t, 0);
+    }
+
+    void mul(elem& r, const elem& a, const elem& b) const { reduce(r, (fe_u128)a * b); }
+
+    void inv(elem& r, const elem& a) const
+    {
+        elem acc = 1;
+        for (int bit = 63; bit >= 0; bit--)
+        {
+            mul(acc, acc, acc);
+            if (((P - 2) >> bit) & 1)
+                mul(acc, acc, a);
+        }
+        r = acc;
+    }
+
+    int from_bytes(elem& r, const uint8_t* in) const
+    {
+        uint64_t v = 0;
+        for (int i = 0; i < BYTES; i++)
+            v = (v << 8) | in[i];
+        r = v;
+        return v < P ? 0 : -1;
+    }
+
+    void to_bytes(uint8_t* out, const elem& a) const
+    {
+        for (int i = 0; i < BYTES; i++)
+            out[i] = (uint8_t)(a >> (8 * (BYTES - 1 - i)));
+    }
+
+    void from_random(elem& r, const uint8_t* in) const
+    {
+        fe_u128 v = 0;
+        for (int i = 0; i < RAND_BYTES; i++)
+            v = (v << 8) | in[i];
+        reduce(r, v);
+    }
+};
+
+struct pf_m127
+{
+    typedef fe_u128 elem;
+    enum { BYTES = 16, CHUNK = 15, RAND_BYTES = 16 };
+
+    static fe_u128 prime(void) { return ((fe_u128)1 << 127) - 1; }
+
+    void zero(elem& r) const { r = 0; }
+    void set_u32(elem& r, uint32_t x) const { r = x; }
+    uint64_t is_zero(const elem& a) const { return a == 0; }
+
+    //t < 2^128: 2^127 = 1 mod p, 折一次后最多再减一次p
+    static fe_u128 fold(fe_u128 t)
+    {
+        const fe_u128 P = prime();
+        t = (t & P) + (t >> 127);
+        fe_u128 s = t - P;
+        uint64_t keep = 0 - (uint64_t)(s >> 127);
+        return ((fe_u128)pf_sel64((uint64_t)(s >> 64), (uint64_t)(t >> 64), keep) << 64) |
+               pf_sel64((uint64_t)s, (uint64_t)t, keep);
+    }
+
+    void add(elem& r, const elem& a, const elem& b) const { r = fold(a + b); }
+
+    void sub(elem& r, const elem& a, const elem& b) const { r = fold(a + (prime() - b)); }
+
+    void mul(elem& r, const elem& a, const elem& b) const
+    {
+        uint64_t a0 = (uint64_t)a, a1 = (uint64_t)(a >> 64);
+        uint64_t b0 = (uint64_t)b, b1 = (uint64_t)(b >> 64);
+        fe_u128 p00 = (fe_u128)a0 * b0;
+        fe_u128 mid = (fe_u128)a0 * b1 + (fe_u128)a1 * b0;     //a1, b1 < 2^63, 不溢出
+        fe_u128 lo = p00 + (mid << 64);
+        fe_u128 hi = (fe_u128)a1 * b1 + (mid >> 64) + (lo < p00);
+        //hi*2^128 + lo = (lo mod 2^127) + lo>>127 + 2*hi, 2*hi < 2^127
+        r = fold((lo & prime()) + (lo >> 127) + (hi << 1));
+    }
+
+    void inv(elem& r, const elem& a) const
+    {
+        //p-2 = 2^127 - 3: 第1位为0,其余低127位全1
+        elem acc = 1;
+        for (int bit = 126; bit >= 0; bit--)
+        {
+            mul(acc, acc, acc);
+            if (bit != 1)
+                mul(acc, acc, a);
+        }
+        r = acc;
+    }
+
+    int from_bytes(elem& r, const uint8_t* in) const
+    {
+        fe_u128 v = 0;
+        for (int i = 0; i < BYTES; i++)
+            v = (v << 8) | in[i];
+        r = v;
+        return v < prime() ? 0 : -1;
+    }
+
+    void to_bytes(uint8_t* out, const elem& a) const
+    {
+        for (int i = 0; i < BYTES; i++)
+            out[i] = (uint8_t)(a >> (8 * (BYTES - 1 - i)));
+    }
+
+    void from_random(elem& r, const uint8_t* in) const
+    {
+        fe_u128 v = 0;
+        for (int i = 0; i < RAND_BYTES; i++)
+            v = (v << 8) | in[i];
+        r = fold(v & prime());
+    }
+};
+
+struct pf_order
+{
+    struct elem { fe_t v; };
+    enum { BYTES = 32, CHUNK = 31, RAND_BYTES = 32 };
+
+    const fe_modulus_t* m;
+    explicit pf_order(const fe_modulus_t* modulus) : m(modulus) {}
+
+    void zero(elem& r) const { memset(r.v, 0, sizeof(r.v)); }
+    uint64_t is_zero(const elem& a) const { return fe_is_zero(a.v) & 1; }
+
+    void set_u32(elem& r, uint32_t x) const
+    {
+        fe_t t = {x, 0, 0, 0};
+        fe_to_mont(m, r.v, t);
+    }
+
+    void add(elem& r, const elem& a, const elem& b) const { fe_add(m, r.v, a.v, b.v); }
+    void sub(elem& r, const elem& a, const elem& b) const { fe_sub(m, r.v, a.v, b.v); }
+    void mul(elem& r, const elem& a, const elem& b) const { fe_mul(m, r.v, a.v, b.v); }
+    void inv(elem& r, const elem& a) const { fe_inv(m, r.v, a.v); }
+
+    int from_bytes(elem& r, const uint8_t* in) const
+    {
+        fe_t t;
+        fe_from_bytes(t, in);
+        unsigned char b = 0;
+        for (int i = 0; i < 4; i++)
+            fe_sbb(t[i], m->p[i], &b);
+        fe_to_mont(m, r.v, t);
+        return b ? 0 : -1;
+    }
+
+    void to_bytes(uint8_t* out, const elem& a) const
+    {
+        fe_t t;
+        fe_from_mont(m, t, a.v);
+        fe_to_bytes(out, t);
+    }
+
+    //蒙哥马利乘法接受任意256位输入; p > 2^255 时偏差可忽略
+    void from_random(elem& r, const uint8_t* in) const
+    {
+        fe_t t;
+        fe_from_bytes(t, in);
+        fe_to_mont(m, r.v, t);
+    }
+};
+
+/* y[i] = f(i+1) for i < n, f(x) = coef[0] + ... + coef[k-1] x^(k-1) */
+template <class F>
+void pf_eval_all(const F& f, const typename F::elem* coef, int piece_k, typename F::elem* y, int piece_n)
+{
+    typename F::elem x, acc;
+    for (int i = 0; i < piece_n; i++)
+    {
+        f.set_u32(x, (uint32_t)(i + 1));
+        acc = coef[piece_k - 1];
+        for (int j = piece_k - 2; j >= 0; j--)
+        {
+            f.mul(acc, acc, x);
+            f.add(acc, acc, coef[j]);
+        }
+        y[i] = acc;
+    }
+}
+
+/* Forward differences of f at x = 1, for the fixed policies: d[0] = f(1),
+ * d[j] = delta^j f(1). Degree 1 and 2 need only additions. */
+template <class F, int K>
+struct pf_diff_init;
+
+template <class F>
+struct pf_diff_init<F, 2>
+{
+    static void run(const F& f, const typename F::elem* c, typename F::elem* d)
+    {
+        f.add(d[0], c[0], c[1]);
+        d[1] = c[1];
+    }
+};
+
+template <class F>
+struct pf_diff_init<F, 3>
+{
+    static void run(const F& f, const typename F::elem* c, typename F::elem* d)
+    {
+        //d0 = c0+c1+c2, d1 = c1+3c2, d2 = 2c2
+        f.add(d[2], c[2], c[2]);
+        f.add(d[1], c[1], c[2]);
+        f.add(d[0], c[0], d[1]);
+        f.add(d[1], d[1], d[2]);
+    }
+};
+
+/* y[i] = f(i+1) for i < N with K fixed: K-1 additions per share and no
+ * multiplication, the difference table stepping one x at a time. */
+template <int K, int N, class F>
+void pf_eval_fixed(const F& f, const typename F::elem* coef, typename F::elem* y)
+{
+    typename F::elem d[K];
+    pf_diff_init<F, K>::run(f, coef, d);
+    for (int i = 0; i < N; i++)
+    {
+        y[i] = d[0];
+        for (int j = 0; j < K - 1; j++)
+            f.add(d[j], d[j], d[j+1]);
+    }
+    memset(d, 0, sizeof(d));
+}
+
+/* The fixed kernels for the 2-of-3, 3-of-5 and 3-of-11 policies; -1 for
+ * any other (k, n), which goes to pf_eval_all. */
+template <class F>
+int pf_eval_policy(const F& f, const typename F::elem* coef, int piece_k, typename F::elem* y, int piece_n)
+{
+    if (piece_k == 2 && piece_n == 3)
+        pf_eval_fixed<2, 3>(f, coef, y);
+    else if (piece_k == 3 && piece_n == 5)
+        pf_eval_fixed<3, 5>(f, coef, y);
+    else if (piece_k == 3 && piece_n == 11)
+        pf_eval_fixed<3, 11>(f, coef, y);
+    else
+        return -1;
+    return 0;
+}
+
+/* Invert count nonzero elements in place with one inversion */
+template <class F>
+void pf_inv_batch(const F& f, typename F::elem* a, int count, typename F::elem* prefix)
+{
+    if (count <= 0)
+        return;
+    prefix[0] = a[0];
+    for (int i = 1; i < count; i++)
+        f.mul(prefix[i], prefix[i-1], a[i]);
+
+    typename F::elem inv, t;
+    f.inv(inv, prefix[count-1]);
+    for (int i = count-1; i > 0; i--)
+    {
+        f.mul(t, inv, prefix[i-1]);
+        f.mul(inv, inv, a[i]);
+        a[i] = t;
+    }
+    a[0] = inv;
+}
+
+/* Lagrange weights at 0 for abscissae xs: w_i = prod x_j / (x_i prod (x_j - x_i)),
+ * j != i, each denominator a product of k-1 differences. */
+template <class F>
+int pf_weights_generic(const F& f, const uint32_t* xs, int piece_k, typename F::elem* w)
+{
+    typename F::elem* prefix = new typename F::elem[piece_k];
+    typename F::elem num, xi, xj, t;
+    int ret = 0;
+
+    f.set_u32(num, 1);
+    for (int i = 0; i < piece_k; i++)
+    {
+        f.set_u32(xi, xs[i]);
+        f.mul(num, num, xi);
+        w[i] = xi;
+        for (int j = 0; j < piece_k; j++)
+        {
+            if (j == i)
+                continue;
+            f.set_u32(xj, xs[j]);
+            f.sub(t, xj, xi);
+            f.mul(w[i], w[i], t);
+        }
+        if (f.is_zero(w[i]))
+            ret = -1;
+    }
+    if (ret == 0)
+    {
+        pf_inv_batch(f, w, piece_k, prefix);
+        for (int i = 0; i < piece_k; i++)
+            f.mul(w[i], w[i], num);
+    }
+    delete [] prefix;
+    return ret;
+}
+
+/* The same weights when xs nearly fill lo..lo+span. With G the gaps of
+ * that range, prod (x_j - x_i) = (-1)^a a! b! / prod_{g in G} (g - x_i) for
+ * a = x_i - lo and b = lo + span - x_i, so the weights cost O(span + k|G|)
+ * multiplications from factorial tables instead of O(k^2); a contiguous
+ * run of custodians is O(k). */
+template <class F>
+int pf_weights_span(const F& f, const uint32_t* xs, int piece_k, uint32_t lo, uint32_t span, typename F::elem* w)
+{
+    uint8_t* seen = new uint8_t[span + 1];
+    uint32_t* gaps = new uint32_t[span + 1];
+    typename F::elem* fact = new typename F::elem[span + 1];
+    typename F::elem* inv_x = new typename F::elem[piece_k];
+    typename F::elem* prefix = new typename F::elem[piece_k];
+    typename F::elem num, t, d, zero;
+    int ret = 0, gap_n = 0;
+
+    memset(seen, 0, span + 1);
+    for (int i = 0; i < piece_k; i++)
+    {
+        if (seen[xs[i] - lo])
+            ret = -1;
+        seen[xs[i] - lo] = 1;
+    }
+    for (uint32_t m = 0; m <= span; m++)
+        if (!seen[m])
+            gaps[gap_n++] = lo + m;
+
+    if (ret == 0)
+    {
+        //fact[m] = m!, 再原地换成1/m!
+        f.set_u32(fact[0], 1);
+        for (uint32_t m = 1; m <= span; m++)
+        {
+            f.set_u32(t, m);
+            f.mul(fact[m], fact[m-1], t);
+        }
+        f.inv(num, fact[span]);
+        for (uint32_t m = span; m > 0; m--)
+        {
+            f.set_u32(t, m);
+            fact[m] = num;
+            f.mul(num, num, t);
+        }
+        fact[0] = num;
+
+        f.zero(zero);
+        f.set_u32(num, 1);
+        for (int i = 0; i < piece_k; i++)
+        {
+            uint32_t a = xs[i] - lo, b = span - a;
+            f.set_u32(inv_x[i], xs[i]);
+            f.mul(num, num, inv_x[i]);
+            f.mul(w[i], fact[a], fact[b]);
+            if (a & 1)
+                f.sub(w[i], zero, w[i]);
+            for (int g = 0; g < gap_n; g++)
+            {
+                if (gaps[g] > xs[i])
+                {
+                    f.set_u32(d, gaps[g] - xs[i]);
+                }
+                else
+                {
+                    f.set_u32(t, xs[i] - gaps[g]);
+                    f.sub(d, zero, t);
+                }
+                f.mul(w[i], w[i], d);
+            }
+        }
+        pf_inv_batch(f, inv_x, piece_k, prefix);
+        for (int i = 0; i < piece_k; i++)
+        {
+            f.mul(w[i], w[i], inv_x[i]);
+            f.mul(w[i], w[i], num);
+        }
+    }
+    delete [] prefix;
+    delete [] inv_x;
+    delete [] fact;
+    delete [] gaps;
+    delete [] seen;
+    return ret;
+}
+
+/* Lagrange weights at 0, through the span form when the abscissae leave
+ * fewer gaps than k-1. Returns -1 for a zero or repeated abscissa. */
+template <class F>
+int pf_weights_zero(const F& f, const uint32_t* xs, int piece_k, typename F::elem* w)
+{
+    if (piece_k <= 0)
+        return -1;
+    uint32_t lo = xs[0], hi = xs[0];
+    for (int i = 1; i < piece_k; i++)
+    {
+        lo = xs[i] < lo ? xs[i] : lo;
+        hi = xs[i] > hi ? xs[i] : hi;
+    }
+    if (lo == 0)
+        return -1;
+    uint64_t gap_n = (uint64_t)(hi - lo) + 1 - (uint64_t)piece_k;
+    if ((uint64_t)(hi - lo) + 1 >= (uint64_t)piece_k && gap_n + 1 < (uint64_t)piece_k)
+        return pf_weights_span(f, xs, piece_k, lo, hi - lo, w);
+    return pf_weights_generic(f, xs, piece_k, w);
+}
+
+#endif /* !_PRIME_FIELD_H_ */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Batch reconstruction of many secrets from the same custodian subset.
+ *
+ * The Lagrange weights at 0 depend only on the k abscissae, so they are
+ * computed once per call and every secret is then a k-term dot product
+ * mod the group order. The weights are kept in Montgomery form and the
+ * share values are not: a Montgomery product of the two is already the
+ * plain w*y, so no element is converted in or out. Rows are taken
+ * RECON_LANES at a time with independent accumulators, which lets the
+ * multiply chains of neighbouring secrets overlap. Share rows stay in app
+ * memory and are staged through enclave buffers block by block; each
+ * block of secrets leaves the enclave only encrypted to the requester's
+ * X25519 key (deliver_seal).
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "PrimeField.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+
+#define RECON_LANES 4
+#define RECON_BLOCK 256     /* rows staged per copy */
+#define RECON_STAGE 0x10000 /* staging bytes per copy, bounds wide rows */
+
+//rows行(每行k个32字节y)各自与w做点积; 任一y不小于p返回-1
+static int dot_rows(const fe_modulus_t* m, const fe_t* w, int piece_k, const uint8_t* ys, size_t rows, uint8_t* out)
+{
+    size_t row_len = 32 * (size_t)piece_k;
+    int ret = 0;
+    for (size_t r0 = 0; r0 < rows && ret == 0; r0 += RECON_LANES)
+    {
+        int lanes = rows - r0 < RECON_LANES ? (int)(rows - r0) : RECON_LANES;
+        fe_t acc[RECON_LANES], y, t;
+        for (int l = 0; l < lanes; l++)
+            memset(acc[l], 0, sizeof(fe_t));
+
+        for (int i = 0; i < piece_k; i++)
+        {
+            for (int l = 0; l < lanes; l++)
+            {
+                fe_from_bytes(y, ys + row_len * (r0 + l) + 32 * (size_t)i);
+                unsigned char b = 0;
+                for (int j = 0; j < 4; j++)
+                    fe_sbb(y[j], m->p[j], &b);
+                if (!b)
+                    ret = -1;
+                fe_mul(m, t, w[i], y);
+                fe_add(m, acc[l], acc[l], t);
+            }
+        }
+        for (int l = 0; l < lanes; l++)
+            fe_to_bytes(out + 32 * (r0 + l), acc[l]);
+        memset(acc, 0, sizeof(acc));
+        memset(y, 0, sizeof(y));
+        memset(t, 0, sizeof(t));
+    }
+    return ret;
+}
+
+/*
+ * batch_reconstruct:
+ *   out[j] = the secret at 0 of row j of ys, encrypted to recipient and
+ *   tagged key_id first+j; row j is the k share values (32 bytes each, in
+ *   the order of xs) of secret j, for 'count' secrets. Both buffers are in
+ *   app memory. Fails on a bad abscissa set, a value not below the order
+ *   or a bad recipient key.
+ */
+int batch_reconstruct(int curve, const uint32_t* xs, int piece_k, uint64_t first, uint64_t count, const uint8_t* recipient,
+                      const uint8_t* ys, wrapped_share_t* out)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > SHARE_MAX_N || count == 0 || count > RECON_MAX_SECRETS ||
+        ys == NULL || out == NULL ||
+        sgx_is_outside_enclave(ys, count * 32 * (size_t)piece_k) != 1 ||
+        sgx_is_outside_enclave(out, count * sizeof(wrapped_share_t)) != 1)
+        return -1;
+    sgx_lfence();
+
+    pf_order f(share_modulus(curve));
+    pf_order::elem* w = new pf_order::elem[piece_k];
+    size_t row_len = 32 * (size_t)piece_k;
+    //行很宽时每块少放几行,暂存区不超过RECON_STAGE
+    size_t block = RECON_STAGE / row_len;
+    if (block > RECON_BLOCK)
+        block = RECON_BLOCK;
+    if (block == 0)
+        block = 1;
+    uint8_t* in = new uint8_t[row_len * block];
+    uint8_t* res = new uint8_t[32 * block];
+    fe_t* wv = new fe_t[piece_k];
+
+    //权重只算一次
+    int ret = pf_weights_zero(f, xs, piece_k, w);
+    for (int i = 0; i < piece_k; i++)
+        fe_copy(wv[i], w[i].v);
+
+    for (uint64_t j = 0; j < count && ret == 0; j += block)
+    {
+        size_t rows = count - j < block ? (size_t)(count - j) : block;
+        memcpy(in, ys + row_len * j, row_len * rows);
+        ret = dot_rows(f.m, wv, piece_k, in, rows, res);
+        if (ret == 0)
+            ret = deliver_seal(recipient, first + j, res, rows, out + j);
+    }
+
+    memset(in, 0, row_len * block);
+    memset(res, 0, 32 * block);
+    delete [] wv;
+    delete [] res;
+    delete [] in;
+    delete [] w;
+    return ret;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Proactive refresh and resharing of many keys in one call.
+ *
+ * Refresh keeps the policy: every key gets a fresh random polynomial
+ * delta of degree k-1 with delta(0) = 0, and each of its shares becomes
+ * y + delta(x). The secret is untouched and never computed, while old
+ * and new shares no longer combine.
+ *
+ * Resharing moves a key from k-of-n to k'-of-n'. The new polynomial is
+ * sum_i lambda_i * y_i + a_1 x + ... + a_{k'-1} x^{k'-1} over k old
+ * shares, so the constant term exists only inside this loop and is wiped
+ * per key. The Lagrange weights depend only on the abscissae, and batches
+ * almost always use the same ones, so they are computed once and reused
+ * while the next key has the same xs.
+ *
+ * New shares at x = 1..n' go through share_eval_all, the same evaluation
+ * kernels keygen uses. Random coefficients come from an AES-CTR keystream
+ * seeded once per call, 48 bytes per coefficient reduced mod q.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+
+//count个随机系数写入coef[0..count)
+static int random_coefs(gf_rng_t* rng, share_ctx_t* ctx, IppsBigNumState** coef, int count, uint8_t* buf)
+{
+    if (count > 0 && gf_rng_fill(rng, buf, 48 * (size_t)count) != 0)
+        return -1;
+    for (int j = 0; j < count; j++)
+    {
+        ippsSetOctString_BN(buf + 48*(size_t)j, 48, ctx->wide);
+        ippsMod_BN(ctx->wide, ctx->q, coef[j]);
+    }
+    memset(buf, 0, 48 * (size_t)count);
+    return 0;
+}
+
+//y必须小于q
+static int load_share(share_ctx_t* ctx, const share_t* s, IppsBigNumState* y)
+{
+    Ipp32u cmp;
+    ippsSetOctString_BN(s->y, sizeof(s->y), y);
+    ippsCmp_BN(y, ctx->q, &cmp);
+    return s->x != 0 && cmp == IPP_IS_LT ? 0 : -1;
+}
+
+/*
+ * refresh_batch:
+ *   In place, for keys keys of piece_n shares each (any abscissae): add a
+ *   fresh k-of-n sharing of zero to every key. Shares stay in app memory.
+ */
+int refresh_batch(int keys, int piece_k, int piece_n, share_t* shares)
+{
+    if (keys <= 0 || keys > RESHARE_MAX_KEYS || piece_k < SHARE_MIN_K || piece_k > piece_n ||
+        piece_n > SHARE_MAX_N || shares == NULL ||
+        sgx_is_outside_enclave(shares, (size_t)keys * piece_n * sizeof(share_t)) != 1)
+        return -1;
+    sgx_lfence();
+
+    gf_rng_t rng;
+    if (gf_rng_init(&rng) != 0)
+        return -1;
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState** delta = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState** piece = newBNArray(piece_n, ORDER_WORDS);
+    IppsBigNumState* y = newBN(ELEM_WORDS);
+    share_t* local = new share_t[piece_n];
+    Ipp32u* xs = new Ipp32u[piece_n];
+    uint8_t* buf = new uint8_t[48 * (size_t)piece_k];
+    int ret = 0;
+
+    for (int b = 0; b < keys && ret == 0; b++)
+    {
+        share_t* io = shares + (size_t)b * piece_n;
+        memcpy(local, io, (size_t)piece_n * sizeof(share_t));
+
+        //delta(0)=0,只随机高次系数
+        ret = random_coefs(&rng, &ctx, delta + 1, piece_k - 1, buf);
+
+        //份额是x=1..n的标准布局时走批量求值
+        int standard = 1;
+        for (int i = 0; i < piece_n && standard; i++)
+            standard = local[i].x == (uint32_t)(i+1);
+        if (ret == 0 && standard)
+            share_eval_all(&ctx, delta, piece_k, piece, piece_n);
+        else if (ret == 0)
+        {
+            for (int i = 0; i < piece_n; i++)
+                xs[i] = local[i].x;
+            share_eval_at(&ctx, delta, piece_k, xs, piece, piece_n);
+        }
+
+        for (int i = 0; i < piece_n && ret == 0; i++)
+        {
+            ret = load_share(&ctx, &local[i], y);
+            if (ret == 0)
+            {
+                mod_add(&ctx, y, piece[i]);
+                ippsGetOctString_BN(local[i].y, sizeof(local[i].y), y);
+            }
+        }
+        if (ret == 0)
+            memcpy(io, local, (size_t)piece_n * sizeof(share_t));
+    }
+
+    Ipp32u zero = 0;
+    for (int j = 0; j < piece_k; j++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, delta[j]);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, y);
+    memset(local, 0, (size_t)piece_n * sizeof(share_t));
+    gf_rng_clear(&rng);
+    deleteBNArray(delta);
+    deleteBNArray(piece);
+    delete [] (Ipp8u*) y;
+    delete [] local;
+    delete [] xs;
+    delete [] buf;
+    share_ctx_free(&ctx);
+    return ret;
+}
+
+/*
+ * reshare_batch:
+ *   Move keys keys from k-of-n to new_k-of-new_n: key b's input is the
+ *   piece_k shares at in[b*in_stride ..], its new_n shares (x = 1..new_n)
+ *   go to out[b*new_n ..]. out must not overlap in.
+ */
+int reshare_batch(int keys, int piece_k, int in_stride, const share_t* in, int new_k, int new_n, share_t* out)
+{
+    if (keys <= 0 || keys > RESHARE_MAX_KEYS || piece_k < SHARE_MIN_K || piece_k > SHARE_MAX_K ||
+        in_stride < piece_k || new_k < SHARE_MIN_K || new_k > new_n || new_n > SHARE_MAX_N ||
+        in == NULL || out == NULL ||
+        sgx_is_outside_enclave(in, ((size_t)(keys - 1) * in_stride + piece_k) * sizeof(share_t)) != 1 ||
+        sgx_is_outside_enclave(out, (size_t)keys * new_n * sizeof(share_t)) != 1)
+        return -1;
+    sgx_lfence();
+
+    gf_rng_t rng;
+    if (gf_rng_init(&rng) != 0)
+        return -1;
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState** w = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState** poly = newBNArray(new_k, ELEM_WORDS);
+    IppsBigNumState** piece = newBNArray(new_n, ORDER_WORDS);
+    IppsBigNumState* y = newBN(ELEM_WORDS);
+    IppsBigNumState* zero_bn = newBN(1);
+    Ipp32u* xs = new Ipp32u[piece_k];
+    share_t* local = new share_t[piece_k > new_n ? piece_k : new_n];
+    uint8_t* buf = new uint8_t[48 * (size_t)new_k];
+    int have_weights = 0, ret = 0;
+    Ipp32u zero = 0;
+
+    for (int b = 0; b < keys && ret == 0; b++)
+    {
+        memcpy(local, in + (size_t)b * in_stride, (size_t)piece_k * sizeof(share_t));
+
+        //横坐标与上一个key相同就沿用拉格朗日权重
+        int same = have_weights;
+        for (int i = 0; i < piece_k; i++)
+        {
+            same = same && xs[i] == local[i].x;
+            xs[i] = local[i].x;
+            for (int j = 0; j < i && ret == 0; j++)
+                if (xs[j] == xs[i])
+                    ret = -1;
+        }
+        if (ret != 0)
+            break;
+        if (!same)
+        {
+            lagrange_weights(&ctx, xs, piece_k, zero_bn, w);
+            have_weights = 1;
+        }
+
+        //常数项 = sum w_i*y_i
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[0]);
+        for (int i = 0; i < piece_k && ret == 0; i++)
+        {
+            ret = load_share(&ctx, &local[i], y);
+            mod_mul(&ctx, y, y, w[i]);
+            mod_add(&ctx, poly[0], y);
+        }
+        if (ret == 0)
+            ret = random_coefs(&rng, &ctx, poly + 1, new_k - 1, buf);
+        if (ret != 0)
+            break;
+
+        share_eval_all(&ctx, poly, new_k, piece, new_n);
+        for (int i = 0; i < new_n; i++)
+        {
+            local[i].x = (uint32_t)(i+1);
+            ippsGetOctString_BN(local[i].y, sizeof(local[i].y), piece[i]);
+        }
+        memcpy(out + (size_t)b * new_n, local, (size_t)new_n * sizeof(share_t));
+    }
+
+    for (int j = 0; j < new_k; j++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[j]);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, y);
+    memset(local, 0, (size_t)(piece_k > new_n ? piece_k : new_n) * sizeof(share_t));
+    gf_rng_clear(&rng);
+    deleteBNArray(w);
+    deleteBNArray(poly);
+    deleteBNArray(piece);
+    delete [] (Ipp8u*) y;
+    delete [] (Ipp8u*) zero_bn;
+    delete [] xs;
+    delete [] local;
+    delete [] buf;
+    share_ctx_free(&ctx);
+    return ret;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Streaming share generation for large custodian sets.
+ *
+ * Shares sit at x = 1..n, consecutive integers, so a degree k-1 polynomial
+ * is walked with a forward-difference table: k Horner evaluations seed
+ * p(x0), dp(x0), ..., d^(k-1)p(x0), after which every further share costs
+ * k-1 modular additions and no multiplications. The x range is split into
+ * parts that the app runs on separate TCS threads; each part writes its
+ * shares straight into the app's output mapping, so no share array is ever
+ * held in the enclave heap. A job keeps only the 32-byte key; each part
+ * expands the coefficients from the key's seed again (see expand_coefs),
+ * which is one AES-CTR pass against k BigNums per job.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_thread.h"
+
+#define SHARE_JOBS 4
+
+typedef struct _share_job_t {
+    int active;
+    int piece_k;
+    int piece_n;
+    int ready;
+    Ipp8u priv[32];
+} share_job_t;
+
+static share_job_t jobs[SHARE_JOBS];
+static sgx_thread_mutex_t jobs_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+//在锁内拷出作业, share_job_end随后清掉它也不影响正在运行的part
+static int get_job(uint32_t job, share_job_t* copy)
+{
+    if (job >= SHARE_JOBS)
+        return -1;
+    sgx_lfence();
+    int ret = -1;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    if (jobs[job].ready)
+    {
+        *copy = jobs[job];
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    return ret;
+}
+
+static void emit_share(share_t* out, Ipp32u x, const IppsBigNumState* y)
+{
+    share_t share;
+    share.x = x;
+    ippsGetOctString_BN(share.y, sizeof(share.y), y);
+    memcpy(&out[x-1], &share, sizeof(share));
+}
+
+/*
+ * share_job_begin:
+ *   Generate and store a key, keep its polynomial for the run ecalls.
+ */
+int share_job_begin(char* pDst, int piece_k, int piece_n, keystore_record_t* rec, uint32_t* job)
+{
+    memset(rec, 0, sizeof(*rec));
+    if (piece_k < SHARE_MIN_K || piece_k > SHARE_MAX_K || piece_k > piece_n || piece_n > SHARE_STREAM_MAX_N)
+        return -1;
+
+    uint32_t slot = SHARE_JOBS;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    for (uint32_t i = 0; i < SHARE_JOBS; i++)
+    {
+        if (!jobs[i].active)
+        {
+            jobs[i].active = 1;
+            slot = i;
+            break;
+        }
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    if (slot == SHARE_JOBS)
+        return -1;
+
+    IppsBigNumState** poly = newBNArray(piece_k, ORDER_WORDS);
+    Ipp8u pub[64], priv[32];
+    int ret = new_sharing_poly(poly, piece_k, pub);
+    if (ret == 0)
+    {
+        copy_hex(pDst, pub, 32);
+        ret = store_sharing_key(poly[0], pub, piece_k, piece_n, KEYSTORE_FLAG_SEEDED, rec);
+    }
+    ippsGetOctString_BN(priv, 32, poly[0]);
+
+    Ipp32u zero = 0;
+    for (int i = 0; i < piece_k; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[i]);
+    deleteBNArray(poly);
+
+    sgx_thread_mutex_lock(&jobs_mutex);
+    if (ret == 0)
+    {
+        memcpy(jobs[slot].priv, priv, 32);
+        jobs[slot].piece_k = piece_k;
+        jobs[slot].piece_n = piece_n;
+        jobs[slot].ready = 1;
+        *job = slot;
+    }
+    else
+    {
+        jobs[slot].active = 0;
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    memset(priv, 0, sizeof(priv));
+    return ret == 0 ? 0 : -1;
+}
+
+/*
+ * share_job_run:
+ *   Compute shares for x in part 'part' of 'parts' and write them to
+ *   out[x-1]. Parts are independent and may run concurrently.
+ */
+int share_job_run(uint32_t job, int part, int parts, share_t* out)
+{
+    share_job_t j;
+    if (parts <= 0 || part < 0 || part >= parts || get_job(job, &j) != 0)
+        return -1;
+
+    int k = j.piece_k;
+    int n = j.piece_n;
+    if (out == NULL || sgx_is_outside_enclave(out, (size_t)n * sizeof(share_t)) != 1)
+    {
+        memset(&j, 0, sizeof(j));
+        return -1;
+    }
+    sgx_lfence();
+
+    Ipp32u lo = (Ipp32u)(1 + (int64_t)n * part / parts);
+    Ipp32u hi = (Ipp32u)(1 + (int64_t)n * (part + 1) / parts);
+
+    IppsBigNumState** poly = newBNArray(k, ORDER_WORDS);
+    ippsSetOctString_BN(j.priv, 32, poly[0]);
+    memset(&j, 0, sizeof(j));
+    if (expand_coefs(poly, k) != 0)
+    {
+        deleteBNArray(poly);
+        return -1;
+    }
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+
+    //区间太短时差分表的k次Horner初始化不划算,直接逐点求值
+    if (hi - lo <= (Ipp32u)(2*k))
+    {
+        IppsBigNumState* y = newBN(ORDER_WORDS);
+        for (Ipp32u x = lo; x < hi; x++)
+        {
+            eval_share(&ctx, poly, k, x, y);
+            emit_share(out, x, y);
+        }
+        delete[] (Ipp8u*) y;
+    }
+    else
+    {
+        //diff[i] = d^i p(lo)
+        IppsBigNumState** diff = newBNArray(k, ELEM_WORDS);
+        for (int i = 0; i < k; i++)
+            eval_share(&ctx, poly, k, lo + (Ipp32u)i, diff[i]);
+        for (int level = 1; level < k; level++)
+            for (int i = k-1; i >= level; i--)
+                mod_sub(&ctx, diff[i], diff[i-1]);
+
+        for (Ipp32u x = lo; x < hi; x++)
+        {
+            emit_share(out, x, diff[0]);
+            for (int i = 0; i < k-1; i++)
+                mod_add(&ctx, diff[i], diff[i+1]);
+        }
+        deleteBNArray(diff);
+    }
+
+    Ipp32u zero = 0;
+    for (int i = 0; i < k; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[i]);
+    deleteBNArray(poly);
+    share_ctx_free(&ctx);
+    return 0;
+}
+
+int share_job_end(uint32_t job)
+{
+    if (job >= SHARE_JOBS)
+        return -1;
+    sgx_lfence();
+
+    int ret = -1;
+    sgx_thread_mutex_lock(&jobs_mutex);
+    if (jobs[job].ready)
+    {
+        memset(jobs[job].priv, 0, sizeof(jobs[job].priv));
+        jobs[job].ready = 0;
+        jobs[job].active = 0;
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&jobs_mutex);
+    return ret;
+}
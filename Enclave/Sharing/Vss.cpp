@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Feldman verifiable secret sharing.
+ *
+ * Next to the shares the enclave publishes C_j = a_j * G for every
+ * coefficient a_j, on secp256k1 whose group order is the share field q, so
+ * a custodian holding (x, y) can check y * G == sum_j x^j * C_j without
+ * learning anything about the other shares.
+ *
+ * Checking a batch one share at a time costs one scalar multiplication per
+ * share plus k per commitment row. Instead every share gets a random
+ * 128-bit weight r_i and the whole batch is one equation,
+ *     (sum r_i y_i) * G == sum_keys sum_j (sum_{i of key} r_i x_i^j) * C_j,
+ * evaluated as a single multi-scalar multiplication over all commitments
+ * and G. A bad share makes it fail except with probability 2^-128; only
+ * then are shares checked one by one to find the culprits.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "../Curve/Curve.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+
+/*
+ * vss_keygen:
+ *   k-of-n sharing of a fresh key with the n shares and k Feldman
+ *   commitments handed out; C_0 is the key's secp256k1 public key.
+ */
+int vss_keygen(char* pDst, int piece_k, int piece_n, keystore_record_t* rec, share_t* shares,
+               uint8_t* commits, size_t commits_len)
+{
+    memset(rec, 0, sizeof(*rec));
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N ||
+        commits_len != (size_t)piece_k * VSS_COMMIT_SIZE)
+        return -1;
+
+    IppsBigNumState** poly = newBNArray(piece_k, ORDER_WORDS);
+    Ipp8u pub[64];
+    if (new_sharing_poly(poly, piece_k, pub) != 0)
+    {
+        deleteBNArray(poly);
+        return -1;
+    }
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState** y = newBNArray(piece_n, ORDER_WORDS);
+    share_eval_all(&ctx, poly, piece_k, y, piece_n);
+    for (int i = 0; i < piece_n; i++)
+    {
+        shares[i].x = (uint32_t)(i+1);
+        ippsGetOctString_BN(shares[i].y, sizeof(shares[i].y), y[i]);
+    }
+    share_ctx_free(&ctx);
+
+    //k个承诺与公钥同一曲线,一起归一化; C_0即pub
+    int ret = batch_public_keys(poly, piece_k, commits);
+
+    copy_hex(pDst, pub, 32);
+    if (ret == 0)
+        ret = store_sharing_key(poly[0], pub, piece_k, piece_n, KEYSTORE_FLAG_SEEDED, rec);
+
+    Ipp32u zero = 0;
+    for (int j = 0; j < piece_k; j++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, poly[j]);
+    deleteBNArray(poly);
+    deleteBNArray(y);
+    return ret;
+}
+
+//单个份额: y*G 与 sum x^j*C_j 比较
+static int verify_one(IppsECCPState* ec, share_ctx_t* ctx, IppsECCPPointState* const* commits, int piece_k,
+                      const share_t* share, Ipp8u* scalars, IppsECCPPointState* lhs, IppsECCPPointState* rhs)
+{
+    IppsBigNumState* y = newBN(ORDER_WORDS);
+    IppsBigNumState* pw = newBN(ORDER_WORDS);
+    IppsBigNumState* bx = newBN(1);
+    Ipp32u one = 1, x = share->x;
+    ippsSet_BN(IppsBigNumPOS, 1, &one, pw);
+    ippsSet_BN(IppsBigNumPOS, 1, &x, bx);
+    for (int j = 0; j < piece_k; j++)
+    {
+        ippsGetOctString_BN(scalars + 32*j, 32, pw);
+        mod_mul(ctx, pw, pw, bx);
+    }
+    ec_msm(ec, commits, scalars, piece_k, rhs);
+
+    ippsSetOctString_BN(share->y, sizeof(share->y), y);
+    ippsECCPPublicKey(y, lhs, ec);
+    IppECResult res;
+    ippsECCPComparePoint(lhs, rhs, &res, ec);
+
+    delete [] (Ipp8u*) y;
+    delete [] (Ipp8u*) pw;
+    delete [] (Ipp8u*) bx;
+    return res == ippECPointIsEqual ? 0 : -1;
+}
+
+/*
+ * vss_verify_batch:
+ *   Check share_count shares against the commitments of key_count keys
+ *   (key i has key_k[i] commitments, stored back to back). Returns 0 when
+ *   all are valid, 1 when ok[] marks some invalid, -1 on bad input.
+ */
+int vss_verify_batch(int key_count, const uint32_t* key_k, const uint8_t* commits, size_t commits_len,
+                     int share_count, const vss_share_t* shares, uint8_t* ok)
+{
+    if (key_count <= 0 || share_count <= 0 || share_count > VSS_MAX_SHARES)
+        return -1;
+    memset(ok, 0, (size_t)share_count);
+
+    //每个key的承诺在数组中的起点
+    uint32_t* first = new uint32_t[key_count];
+    uint64_t total = 0;
+    for (int i = 0; i < key_count; i++)
+    {
+        first[i] = (uint32_t)total;
+        total += key_k[i];
+        if (key_k[i] < 1 || total > VSS_MAX_COMMITS)
+        {
+            delete [] first;
+            return -1;
+        }
+    }
+    if (commits_len != total * VSS_COMMIT_SIZE)
+    {
+        delete [] first;
+        return -1;
+    }
+
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsBigNumState* bnq = newOrderBN();
+    IppsECCPPointState** points = newPointArray((int)total + 3);
+    int ret = 0;
+    for (uint64_t i = 0; i < total && ret == 0; i++)
+        ret = ec_set_point(ec, commits + i * VSS_COMMIT_SIZE, points[i]);
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState** e = newBNArray((int)total + 1, ELEM_WORDS);
+    IppsBigNumState* r = newBN(ORDER_WORDS);
+    IppsBigNumState* y = newBN(ORDER_WORDS);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    IppsBigNumState* bx = newBN(1);
+    Ipp32u cmp;
+    for (int i = 0; i < share_count && ret == 0; i++)
+    {
+        const vss_share_t* s = &shares[i];
+        ippsSetOctString_BN(s->share.y, sizeof(s->share.y), y);
+        ippsCmp_BN(y, bnq, &cmp);
+        if (s->key >= (uint32_t)key_count || s->share.x == 0 || cmp != IPP_IS_LT)
+        {
+            ret = -1;
+            break;
+        }
+
+        //r_i取128位随机数
+        Ipp8u rb[16];
+        if (sgx_read_rand(rb, sizeof(rb)) != SGX_SUCCESS)
+        {
+            ret = -1;
+            break;
+        }
+        ippsSetOctString_BN(rb, sizeof(rb), r);
+
+        //e[total] += r*y; e[first+j] += r*x^j
+        mod_mul(&ctx, t, r, y);
+        mod_add(&ctx, e[total], t);
+        Ipp32u x = s->share.x;
+        ippsSet_BN(IppsBigNumPOS, 1, &x, bx);
+        for (uint32_t j = 0; j < key_k[s->key]; j++)
+        {
+            mod_add(&ctx, e[first[s->key] + j], r);
+            mod_mul(&ctx, r, r, bx);
+        }
+    }
+
+    if (ret == 0)
+    {
+        //点集为全部承诺加上-G,标量为e与sum r*y
+        IppsECCPPointState* G = points[total+1];
+        IppsECCPPointState* acc = points[total+2];
+        Ipp32u one = 1;
+        ippsSet_BN(IppsBigNumPOS, 1, &one, t);
+        ippsECCPPublicKey(t, G, ec);
+        ippsECCPNegativePoint(G, points[total], ec);
+
+        Ipp8u* scalars = new Ipp8u[32 * (total + 1)];
+        for (uint64_t i = 0; i <= total; i++)
+            ippsGetOctString_BN(scalars + 32*i, 32, e[i]);
+        ec_msm(ec, points, scalars, (int)total + 1, acc);
+
+        IppECResult res;
+        ippsECCPCheckPoint(acc, &res, ec);
+        if (res == ippECPointIsAtInfinite)
+        {
+            memset(ok, 1, (size_t)share_count);
+        }
+        else
+        {
+            //批量校验失败才逐个定位
+            ret = 1;
+            for (int i = 0; i < share_count; i++)
+            {
+                const vss_share_t* s = &shares[i];
+                ok[i] = verify_one(ec, &ctx, points + first[s->key], (int)key_k[s->key], &s->share,
+                                   scalars, G, acc) == 0;
+            }
+        }
+        delete [] scalars;
+    }
+
+    share_ctx_free(&ctx);
+    deleteBNArray(e);
+    deletePointArray(points);
+    delete [] (Ipp8u*) r;
+    delete [] (Ipp8u*) y;
+    delete [] (Ipp8u*) t;
+    delete [] (Ipp8u*) bx;
+    delete [] (Ipp8u*) bnq;
+    delete [] (Ipp8u*) ec;
+    delete [] first;
+    return ret;
+}
@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* FROST threshold Schnorr signing on secp256k1 over k-of-n shares.
+ *
+ * The key is never rebuilt. Each signer i contributes
+ *     z_i = d_i + e_i * rho_i + lambda_i * y_i * c
+ * where (d_i, e_i) is a one-time nonce pair with public commitments
+ * (D_i, E_i), rho_i = H(x_i, m, commitment list) binds the nonce to this
+ * round, R = sum D_i + rho_i * E_i, c = H(R, Y, m) and lambda_i is the
+ * Lagrange weight of x_i at 0. Then z = sum z_i satisfies z*G == R + c*Y.
+ *
+ * All the group arithmetic is moved out of the latency path: nonce pairs
+ * are drawn ahead of time in batches from the enclave's precomputed
+ * (k, k*G) pool (see Schnorr.cpp), begin computes R once per
+ * round as a 2k-point multi-scalar multiplication, and each partial
+ * signature is a few multiplications mod q. A nonce is wiped as soon as
+ * it is used, so no pair can sign twice.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Signing.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+#include "sgx_tcrypto.h"
+#include "sgx_thread.h"
+
+#define FROST_SESSIONS 8
+
+static const uint8_t tag_rho[]  = "FROST-secp256k1-rho";
+
+/* secret half of a frost_commit_t; id 0 marks a free or spent slot */
+typedef struct _frost_nonce_t {
+    uint32_t id;
+    uint32_t x;
+    uint8_t  d[32];
+    uint8_t  e[32];
+    uint8_t  D[64];
+    uint8_t  E[64];
+} frost_nonce_t;
+
+typedef struct _frost_session_t {
+    int            active;
+    int            count;
+    uint8_t        c[32];
+    uint8_t        R[64];
+    uint8_t        Y[64];
+    frost_commit_t commits[FROST_MAX_SIGNERS];
+    uint8_t        rho[FROST_MAX_SIGNERS][32];
+    uint8_t        lambda[FROST_MAX_SIGNERS][32];
+} frost_session_t;
+
+static frost_nonce_t pool[FROST_NONCE_POOL];
+static uint32_t next_id = 1;
+static sgx_thread_mutex_t pool_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static frost_session_t sessions[FROST_SESSIONS];
+static sgx_thread_mutex_t sessions_mutex = SGX_THREAD_MUTEX_INITIALIZER;
+
+static void put_be32(uint8_t out[4], uint32_t v)
+{
+    out[0] = (uint8_t)(v >> 24);
+    out[1] = (uint8_t)(v >> 16);
+    out[2] = (uint8_t)(v >> 8);
+    out[3] = (uint8_t)v;
+}
+
+/*
+ * frost_preprocess:
+ *   Draw count nonce pairs for custodian x, keep them in the pool and
+ *   return their commitments. Ids are handed out round-robin over the
+ *   pool, so a pair left unused for FROST_NONCE_POOL further pairs is
+ *   overwritten and its commitment simply stops being accepted.
+ */
+int frost_preprocess(uint32_t x, int count, frost_commit_t* commits)
+{
+    if (x == 0 || count <= 0 || count > FROST_NONCE_BATCH)
+        return -1;
+
+    //d,e及其承诺直接从预计算池取
+    uint8_t* ks = new uint8_t[2 * 32 * (size_t)count];
+    Ipp8u* pubs = new Ipp8u[2 * (size_t)count * EC_POINT_SIZE];
+    int ret = nonce_take(ks, pubs, 2 * count);
+
+    if (ret == 0)
+    {
+        sgx_thread_mutex_lock(&pool_mutex);
+        if (next_id > 0xFFFFFFFFu - (uint32_t)count)
+            next_id = 1;
+        uint32_t first = next_id;
+        next_id += (uint32_t)count;
+        sgx_thread_mutex_unlock(&pool_mutex);
+
+        for (int i = 0; i < count; i++)
+        {
+            frost_commit_t* c = &commits[i];
+            c->id = first + (uint32_t)i;
+            c->x = x;
+            memcpy(c->D, pubs + (size_t)(2*i) * EC_POINT_SIZE, EC_POINT_SIZE);
+            memcpy(c->E, pubs + (size_t)(2*i+1) * EC_POINT_SIZE, EC_POINT_SIZE);
+
+            sgx_thread_mutex_lock(&pool_mutex);
+            frost_nonce_t* p = &pool[c->id % FROST_NONCE_POOL];
+            p->id = c->id;
+            p->x = x;
+            memcpy(p->d, ks + 64*(size_t)i, 32);
+            memcpy(p->e, ks + 64*(size_t)i + 32, 32);
+            memcpy(p->D, c->D, EC_POINT_SIZE);
+            memcpy(p->E, c->E, EC_POINT_SIZE);
+            sgx_thread_mutex_unlock(&pool_mutex);
+        }
+    }
+
+    memset(ks, 0, 2 * 32 * (size_t)count);
+    delete [] ks;
+    delete [] pubs;
+    return ret;
+}
+
+//承诺是否仍在池中且未用过
+static int nonce_live(const frost_commit_t* c)
+{
+    sgx_thread_mutex_lock(&pool_mutex);
+    const frost_nonce_t* p = &pool[c->id % FROST_NONCE_POOL];
+    int ok = c->id != 0 && p->id == c->id && p->x == c->x &&
+             memcmp(p->D, c->D, EC_POINT_SIZE) == 0 && memcmp(p->E, c->E, EC_POINT_SIZE) == 0;
+    sgx_thread_mutex_unlock(&pool_mutex);
+    return ok;
+}
+
+//取出并抹掉一对nonce,之后同一承诺不再可用
+static int take_nonce(const frost_commit_t* c, uint8_t d[32], uint8_t e[32])
+{
+    int ret = -1;
+    sgx_thread_mutex_lock(&pool_mutex);
+    frost_nonce_t* p = &pool[c->id % FROST_NONCE_POOL];
+    if (c->id != 0 && p->id == c->id && p->x == c->x)
+    {
+        memcpy(d, p->d, 32);
+        memcpy(e, p->e, 32);
+        memset(p, 0, sizeof(*p));
+        ret = 0;
+    }
+    sgx_thread_mutex_unlock(&pool_mutex);
+    return ret;
+}
+
+static frost_session_t* get_session(uint32_t session)
+{
+    if (session >= FROST_SESSIONS)
+        return NULL;
+    sgx_lfence();
+    return sessions[session].active == 2 ? &sessions[session] : NULL;
+}
+
+static void free_session(frost_session_t* s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+//R = sum D_i + rho_i*E_i,一次2k点的多标量乘
+static int group_commitment(frost_session_t* s)
+{
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsECCPPointState** pts = newPointArray(2 * s->count + 1);
+    Ipp8u* scalars = new Ipp8u[2 * 32 * (size_t)s->count];
+    int ret = 0;
+    for (int i = 0; i < s->count && ret == 0; i++)
+    {
+        ret = ec_set_point(ec, s->commits[i].D, pts[2*i]);
+        if (ret == 0)
+            ret = ec_set_point(ec, s->commits[i].E, pts[2*i+1]);
+        memset(scalars + 64*(size_t)i, 0, 31);
+        scalars[64*(size_t)i + 31] = 1;
+        memcpy(scalars + 64*(size_t)i + 32, s->rho[i], 32);
+    }
+    if (ret == 0)
+    {
+        IppsECCPPointState* R = pts[2 * s->count];
+        ec_msm(ec, pts, scalars, 2 * s->count, R);
+        IppECResult res;
+        ippsECCPCheckPoint(R, &res, ec);
+        if (res == ippECPointIsAtInfinite)
+            ret = -1;
+        else
+            ec_get_point(ec, R, s->R);
+    }
+    delete [] scalars;
+    deletePointArray(pts);
+    delete [] (Ipp8u*) ec;
+    return ret;
+}
+
+/*
+ * frost_sign_begin:
+ *   Open a signing round of key_id over the 32-byte message digest msg with
+ *   one live commitment per signer (distinct x in 1..n, at least k of
+ *   them). Computes the binding factors, R, the challenge and the Lagrange
+ *   weights, and returns R.
+ */
+int frost_sign_begin(uint64_t key_id, const uint8_t* msg, const frost_commit_t* commits, int count,
+                     uint8_t* R, uint32_t* session)
+{
+    if (count < SHARE_MIN_K || count > FROST_MAX_SIGNERS)
+        return -1;
+
+    keystore_secret_t secret;
+    uint8_t Y[64];
+    if (keystore_get(key_id, &secret, Y) != 0)
+        return -1;
+    memset(secret.priv, 0, sizeof(secret.priv));
+    if (!(secret.flags & KEYSTORE_FLAG_SECP256K1) || (secret.flags & KEYSTORE_FLAG_PACKED) ||
+        count < secret.piece_k || count > secret.piece_n)
+        return -1;
+
+    Ipp32u xs[FROST_MAX_SIGNERS];
+    for (int i = 0; i < count; i++)
+    {
+        xs[i] = commits[i].x;
+        if (xs[i] == 0 || xs[i] > secret.piece_n || !nonce_live(&commits[i]))
+            return -1;
+        for (int j = 0; j < i; j++)
+            if (xs[j] == xs[i])
+                return -1;
+    }
+
+    uint32_t slot = FROST_SESSIONS;
+    sgx_thread_mutex_lock(&sessions_mutex);
+    for (uint32_t i = 0; i < FROST_SESSIONS; i++)
+    {
+        if (!sessions[i].active)
+        {
+            sessions[i].active = 1;
+            slot = i;
+            break;
+        }
+    }
+    sgx_thread_mutex_unlock(&sessions_mutex);
+    if (slot == FROST_SESSIONS)
+        return -1;
+
+    frost_session_t* s = &sessions[slot];
+    s->count = count;
+    memcpy(s->Y, Y, sizeof(Y));
+    memcpy(s->commits, commits, (size_t)count * sizeof(frost_commit_t));
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    int ret = 0;
+
+    //承诺列表先整体哈希, rho_i = H(tag, x_i, m, H(B))
+    sgx_sha256_hash_t hb;
+    ret = sgx_sha256_msg((const uint8_t*)commits, (uint32_t)(count * sizeof(frost_commit_t)), &hb) == SGX_SUCCESS ? 0 : -1;
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        uint8_t xb[4];
+        put_be32(xb, xs[i]);
+        const uint8_t* parts[] = {tag_rho, xb, msg, hb};
+        const uint32_t lens[] = {sizeof(tag_rho) - 1, 4, 32, sizeof(hb)};
+        ret = hash_scalar(ctx.q, parts, lens, 4, t);
+        ippsGetOctString_BN(s->rho[i], 32, t);
+    }
+
+    if (ret == 0)
+        ret = group_commitment(s);
+
+    if (ret == 0)
+    {
+        ret = schnorr_challenge(ctx.q, s->R, s->Y, msg, t);
+        ippsGetOctString_BN(s->c, 32, t);
+    }
+
+    if (ret == 0)
+    {
+        IppsBigNumState** w = newBNArray(count, ORDER_WORDS);
+        IppsBigNumState* zero = newBN(1);
+        lagrange_weights(&ctx, xs, count, zero, w);
+        for (int i = 0; i < count; i++)
+            ippsGetOctString_BN(s->lambda[i], 32, w[i]);
+        deleteBNArray(w);
+        delete [] (Ipp8u*) zero;
+    }
+
+    delete [] (Ipp8u*) t;
+    share_ctx_free(&ctx);
+    if (ret != 0)
+    {
+        free_session(s);
+        return -1;
+    }
+    memcpy(R, s->R, 64);
+    s->active = 2;
+    *session = slot;
+    return 0;
+}
+
+/*
+ * frost_sign_share:
+ *   Partial signature of the signer holding share in an open round:
+ *   z_i = d_i + e_i * rho_i + lambda_i * y_i * c mod q. Consumes the
+ *   signer's nonce, so a second call for the same signer fails.
+ */
+int frost_sign_share(uint32_t session, const share_t* share, uint8_t* z)
+{
+    frost_session_t* s = get_session(session);
+    if (s == NULL)
+        return -1;
+
+    int i = 0;
+    while (i < s->count && s->commits[i].x != share->x)
+        i++;
+    uint8_t d[32], e[32];
+    if (i == s->count || take_nonce(&s->commits[i], d, e) != 0)
+        return -1;
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState* acc = newBN(ELEM_WORDS);
+    IppsBigNumState* a = newBN(ORDER_WORDS);
+    IppsBigNumState* b = newBN(ORDER_WORDS);
+    Ipp32u cmp;
+    int ret = 0;
+
+    ippsSetOctString_BN(share->y, sizeof(share->y), a);
+    ippsCmp_BN(a, ctx.q, &cmp);
+    if (cmp != IPP_IS_LT)
+        ret = -1;
+
+    if (ret == 0)
+    {
+        //lambda*y*c
+        ippsSetOctString_BN(s->lambda[i], 32, b);
+        mod_mul(&ctx, acc, a, b);
+        ippsSetOctString_BN(s->c, 32, b);
+        mod_mul(&ctx, acc, acc, b);
+        //+ e*rho + d
+        ippsSetOctString_BN(e, 32, a);
+        ippsSetOctString_BN(s->rho[i], 32, b);
+        mod_mul(&ctx, a, a, b);
+        mod_add(&ctx, acc, a);
+        ippsSetOctString_BN(d, 32, a);
+        mod_add(&ctx, acc, a);
+        ippsGetOctString_BN(z, 32, acc);
+    }
+
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, a);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, acc);
+    memset(d, 0, sizeof(d));
+    memset(e, 0, sizeof(e));
+    delete [] (Ipp8u*) acc;
+    delete [] (Ipp8u*) a;
+    delete [] (Ipp8u*) b;
+    share_ctx_free(&ctx);
+    return ret;
+}
+
+/*
+ * frost_sign_end:
+ *   Add the partial signatures (32 bytes each, in commitment order), check
+ *   z*G - c*Y == R and write R || z. The round is closed either way;
+ *   returns -1 when the signature does not verify.
+ */
+int frost_sign_end(uint32_t session, const uint8_t* zs, size_t zs_len, uint8_t* sig)
+{
+    frost_session_t* s = get_session(session);
+    if (s == NULL)
+        return -1;
+    if (zs_len != (size_t)s->count * 32)
+    {
+        free_session(s);
+        return -1;
+    }
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState* z = newBN(ELEM_WORDS);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    for (int i = 0; i < s->count; i++)
+    {
+        ippsSetOctString_BN(zs + 32*(size_t)i, 32, t);
+        ippsMod_BN(t, ctx.q, t);
+        mod_add(&ctx, z, t);
+    }
+
+    //z*G + (q-c)*Y 与R比较
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsECCPPointState** pts = newPointArray(4);
+    Ipp8u scalars[64];
+    Ipp32u one = 1;
+    ippsSet_BN(IppsBigNumPOS, 1, &one, t);
+    ippsECCPPublicKey(t, pts[0], ec);
+    int ret = ec_set_point(ec, s->Y, pts[1]);
+    if (ret == 0)
+        ret = ec_set_point(ec, s->R, pts[2]);
+    if (ret == 0)
+    {
+        ippsGetOctString_BN(scalars, 32, z);
+        ippsSetOctString_BN(s->c, 32, t);
+        ippsSub_BN(ctx.q, t, t);
+        ippsGetOctString_BN(scalars + 32, 32, t);
+        ec_msm(ec, pts, scalars, 2, pts[3]);
+        IppECResult res;
+        ippsECCPComparePoint(pts[2], pts[3], &res, ec);
+        ret = res == ippECPointIsEqual ? 0 : -1;
+    }
+    if (ret == 0)
+    {
+        memcpy(sig, s->R, 64);
+        ippsGetOctString_BN(sig + 64, 32, z);
+    }
+
+    deletePointArray(pts);
+    delete [] (Ipp8u*) ec;
+    delete [] (Ipp8u*) z;
+    delete [] (Ipp8u*) t;
+    share_ctx_free(&ctx);
+    free_session(s);
+    return ret;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Single-key Schnorr signing on secp256k1 and the nonce pool behind it.
+ *
+ * The cost of a Schnorr signature is almost all in the nonce point k*G.
+ * The enclave keeps a ring of precomputed (k, k*G) pairs. A background
+ * ecall (nonce_pool_run, on its own host thread and TCS) refills the ring
+ * in batches of NONCE_REFILL_BATCH through the comb with one shared
+ * inversion per batch, then sleeps on a condition variable until
+ * consumers drain it to NONCE_POOL_LOW. A signature then takes one pair
+ * out of the ring, one hash and a multiply-add mod q. If the pool runs
+ * dry, the nonce is computed inline, so signing never blocks on the
+ * producer.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Signing.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_tcrypto.h"
+#include "sgx_thread.h"
+
+#define NONCE_POOL_SIZE    2048
+#define NONCE_POOL_LOW     512
+#define NONCE_REFILL_BATCH 128
+
+static const uint8_t tag_chal[] = "FROST-secp256k1-chal";
+
+typedef struct _nonce_t {
+    uint8_t k[32];
+    uint8_t R[64];
+} nonce_t;
+
+/* ring of ready nonces; state 0: no producer, 1: running, 2: stopped */
+typedef struct {
+    nonce_t slot[NONCE_POOL_SIZE];
+    int occupied;
+    int nextin;
+    int nextout;
+    int state;
+    sgx_thread_mutex_t mutex;
+    sgx_thread_cond_t less;
+} nonce_pool_t;
+
+static nonce_pool_t pool = {{{{0}, {0}}}, 0, 0, 0, 0, SGX_THREAD_MUTEX_INITIALIZER, SGX_THREAD_COND_INITIALIZER};
+
+//384位随机数模q,偏差可忽略
+int random_scalar(const IppsBigNumState* q, IppsBigNumState* r)
+{
+    Ipp8u rb[48];
+    if (sgx_read_rand(rb, sizeof(rb)) != SGX_SUCCESS)
+        return -1;
+    ippsSetOctString_BN(rb, sizeof(rb), r);
+    ippsMod_BN(r, q, r);
+    memset(rb, 0, sizeof(rb));
+    return 0;
+}
+
+//SHA-256(parts...) mod q
+int hash_scalar(const IppsBigNumState* q, const uint8_t* const* parts, const uint32_t* lens, int n,
+                IppsBigNumState* r)
+{
+    sgx_sha_state_handle_t sha;
+    sgx_sha256_hash_t h;
+    if (sgx_sha256_init(&sha) != SGX_SUCCESS)
+        return -1;
+    int ret = 0;
+    for (int i = 0; i < n && ret == 0; i++)
+        ret = sgx_sha256_update(parts[i], lens[i], sha) == SGX_SUCCESS ? 0 : -1;
+    if (ret == 0)
+        ret = sgx_sha256_get_hash(sha, &h) == SGX_SUCCESS ? 0 : -1;
+    sgx_sha256_close(sha);
+    if (ret == 0)
+    {
+        ippsSetOctString_BN(h, sizeof(h), r);
+        ippsMod_BN(r, q, r);
+    }
+    return ret;
+}
+
+int schnorr_challenge(const IppsBigNumState* q, const uint8_t R[64], const uint8_t Y[64], const uint8_t msg[32],
+                      IppsBigNumState* c)
+{
+    const uint8_t* parts[] = {tag_chal, R, Y, msg};
+    const uint32_t lens[] = {sizeof(tag_chal) - 1, 64, 64, 32};
+    return hash_scalar(q, parts, lens, 4, c);
+}
+
+//生成count个(k, k*G),定基点乘共用一次求逆
+static int make_nonces(nonce_t* out, int count)
+{
+    IppsBigNumState* bnq = newOrderBN();
+    IppsBigNumState** k = newBNArray(count, ORDER_WORDS);
+    Ipp8u* pubs = new Ipp8u[(size_t)count * EC_POINT_SIZE];
+    int ret = 0;
+    for (int i = 0; i < count && ret == 0; i++)
+        ret = random_scalar(bnq, k[i]);
+    if (ret == 0)
+        ret = batch_public_keys(k, count, pubs);
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        ippsGetOctString_BN(out[i].k, 32, k[i]);
+        memcpy(out[i].R, pubs + (size_t)i * EC_POINT_SIZE, EC_POINT_SIZE);
+    }
+
+    Ipp32u zero = 0;
+    for (int i = 0; i < count; i++)
+        ippsSet_BN(IppsBigNumPOS, 1, &zero, k[i]);
+    deleteBNArray(k);
+    delete [] pubs;
+    delete [] (Ipp8u*) bnq;
+    return ret;
+}
+
+/*
+ * nonce_pool_run:
+ *   Body of the background refill thread: keep the pool topped up until
+ *   nonce_pool_stop. Only one producer may run; returns -1 for a second
+ *   one or when the random source fails.
+ */
+int nonce_pool_run(void)
+{
+    nonce_pool_t* p = &pool;
+    sgx_thread_mutex_lock(&p->mutex);
+    if (p->state != 0)
+    {
+        sgx_thread_mutex_unlock(&p->mutex);
+        return -1;
+    }
+    p->state = 1;
+
+    nonce_t* batch = new nonce_t[NONCE_REFILL_BATCH];
+    int ret = 0;
+    while (p->state == 1 && ret == 0)
+    {
+        //高于低水位时睡眠,等消费者唤醒
+        if (p->occupied > NONCE_POOL_LOW)
+        {
+            sgx_thread_cond_wait(&p->less, &p->mutex);
+            continue;
+        }
+        while (p->state == 1 && ret == 0 && p->occupied <= NONCE_POOL_SIZE - NONCE_REFILL_BATCH)
+        {
+            sgx_thread_mutex_unlock(&p->mutex);
+            ret = make_nonces(batch, NONCE_REFILL_BATCH);
+            sgx_thread_mutex_lock(&p->mutex);
+            for (int i = 0; i < NONCE_REFILL_BATCH && ret == 0; i++)
+            {
+                p->slot[p->nextin] = batch[i];
+                p->nextin = (p->nextin + 1) % NONCE_POOL_SIZE;
+                p->occupied++;
+            }
+        }
+    }
+    p->state = 2;
+    sgx_thread_mutex_unlock(&p->mutex);
+
+    memset(batch, 0, NONCE_REFILL_BATCH * sizeof(nonce_t));
+    delete [] batch;
+    return ret;
+}
+
+/*
+ * nonce_pool_stop:
+ *   Wake the producer and make it return; the pool keeps serving what it
+ *   holds and falls back to inline nonces afterwards.
+ */
+void nonce_pool_stop(void)
+{
+    sgx_thread_mutex_lock(&pool.mutex);
+    pool.state = 2;
+    sgx_thread_cond_signal(&pool.less);
+    sgx_thread_mutex_unlock(&pool.mutex);
+}
+
+int nonce_take(uint8_t* ks, uint8_t* Rs, int count)
+{
+    nonce_pool_t* p = &pool;
+    int got = 0;
+    sgx_thread_mutex_lock(&p->mutex);
+    while (got < count && p->occupied > 0)
+    {
+        nonce_t* n = &p->slot[p->nextout];
+        memcpy(ks + 32*(size_t)got, n->k, 32);
+        memcpy(Rs + 64*(size_t)got, n->R, 64);
+        memset(n, 0, sizeof(*n));
+        p->nextout = (p->nextout + 1) % NONCE_POOL_SIZE;
+        p->occupied--;
+        got++;
+    }
+    //降到低水位时唤醒补充线程;它在忙时signal不出enclave
+    if (got > 0 && p->state == 1 && p->occupied <= NONCE_POOL_LOW)
+        sgx_thread_cond_signal(&p->less);
+    sgx_thread_mutex_unlock(&p->mutex);
+
+    if (got == count)
+        return 0;
+
+    //池空时当场计算
+    nonce_t* extra = new nonce_t[count - got];
+    int ret = make_nonces(extra, count - got);
+    for (int i = 0; ret == 0 && got + i < count; i++)
+    {
+        memcpy(ks + 32*(size_t)(got + i), extra[i].k, 32);
+        memcpy(Rs + 64*(size_t)(got + i), extra[i].R, 64);
+    }
+    memset(extra, 0, (size_t)(count - got) * sizeof(nonce_t));
+    delete [] extra;
+    return ret;
+}
+
+/*
+ * schnorr_sign:
+ *   Sign the 32-byte digest msg with stored secp256k1 key key_id:
+ *   sig = R || z with z = k + H(R||Y||m) * x mod q, the same form a FROST
+ *   round produces.
+ */
+int schnorr_sign(uint64_t key_id, const uint8_t* msg, uint8_t* sig)
+{
+    keystore_secret_t secret;
+    uint8_t Y[64];
+    if (keystore_get(key_id, &secret, Y) != 0)
+        return -1;
+    if (!(secret.flags & KEYSTORE_FLAG_SECP256K1))
+    {
+        memset(&secret, 0, sizeof(secret));
+        return -1;
+    }
+
+    uint8_t k[32], R[64];
+    int ret = nonce_take(k, R, 1);
+
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState* z = newBN(ELEM_WORDS);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    if (ret == 0)
+        ret = schnorr_challenge(ctx.q, R, Y, msg, t);
+    if (ret == 0)
+    {
+        ippsSetOctString_BN(secret.priv, sizeof(secret.priv), z);
+        mod_mul(&ctx, z, z, t);
+        ippsSetOctString_BN(k, sizeof(k), t);
+        mod_add(&ctx, z, t);
+        memcpy(sig, R, 64);
+        ippsGetOctString_BN(sig + 64, 32, z);
+    }
+
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, z);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, t);
+    memset(&secret, 0, sizeof(secret));
+    memset(k, 0, sizeof(k));
+    delete [] (Ipp8u*) z;
+    delete [] (Ipp8u*) t;
+    share_ctx_free(&ctx);
+    return ret;
+}
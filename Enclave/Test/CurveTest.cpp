@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Curve checks from inside the enclave: inputs for the MSM engine with a
+ * result computed the slow way, by fixed-base multiplication, the native
+ * comb and batch normalisation against IPP's own P-256, the secp256k1
+ * GLV comb against known multiples of G and the Jacobian addition, and
+ * Curve25519 (Ed25519 comb, X25519 ladder) against RFC 7748 and against
+ * each other.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../Curve/Curve.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+#include "sgx_lfence.h"
+
+/*
+ * test_msm_inputs:
+ *   Fill app buffers with P_i = (i+1)*G on secp256k1 and random scalars
+ *   (every seventh one zero), and return sum s_i * (i+1) * G computed as
+ *   a single multiplication of G.
+ */
+int test_msm_inputs(uint8_t* points, uint8_t* scalars, int count, uint8_t* expect)
+{
+    if (count <= 0 || count > MSM_MAX_POINTS || points == NULL || scalars == NULL ||
+        sgx_is_outside_enclave(points, (size_t)count * EC_POINT_SIZE) != 1 ||
+        sgx_is_outside_enclave(scalars, (size_t)count * 32) != 1)
+        return -1;
+    sgx_lfence();
+
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsECCPPointState** pts = newPointArray(2);
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    IppsBigNumState* s = newBN(ORDER_WORDS);
+    IppsBigNumState* a = newBN(ORDER_WORDS);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    IppsBigNumState* sum = newBN(ELEM_WORDS);
+    Ipp32u one = 1, zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, sum);
+    ippsSet_BN(IppsBigNumPOS, 1, &one, a);
+    ippsECCPPublicKey(a, pts[0], ec);
+    ippsECCPPublicKey(a, pts[1], ec);
+
+    //P_i由P_{i-1}加G得到, 期望值在模n下累加s_i*(i+1)
+    int ret = 0;
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        uint8_t sb[32];
+        ret = sgx_read_rand(sb, sizeof(sb)) == SGX_SUCCESS ? 0 : -1;
+        if (i % 7 == 6)
+            memset(sb, 0, sizeof(sb));
+        ippsSetOctString_BN(sb, sizeof(sb), s);
+        ippsMod_BN(s, ctx.q, s);
+        ippsGetOctString_BN(sb, sizeof(sb), s);
+        memcpy(scalars + 32 * (size_t)i, sb, sizeof(sb));
+
+        Ipp32u x = (Ipp32u)(i + 1);
+        ippsSet_BN(IppsBigNumPOS, 1, &x, a);
+        mod_mul(&ctx, t, s, a);
+        mod_add(&ctx, sum, t);
+
+        if (i > 0)
+            ippsECCPAddPoint(pts[0], pts[1], pts[0], ec);
+        uint8_t pt[EC_POINT_SIZE];
+        ec_get_point(ec, pts[0], pt);
+        memcpy(points + EC_POINT_SIZE * (size_t)i, pt, sizeof(pt));
+    }
+
+    if (ret == 0)
+    {
+        ippsECCPPublicKey(sum, pts[0], ec);
+        ec_get_point(ec, pts[0], expect);
+    }
+
+    share_ctx_free(&ctx);
+    delete [] (Ipp8u*) sum;
+    delete [] (Ipp8u*) t;
+    delete [] (Ipp8u*) a;
+    delete [] (Ipp8u*) s;
+    deletePointArray(pts);
+    delete [] (Ipp8u*) ec;
+    return ret;
+}
+
+//P-256的阶n
+static const uint8_t p256_n[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xBC, 0xE6, 0xFA, 0xAD, 0xA7, 0x17, 0x9E, 0x84, 0xF3, 0xB9, 0xCA, 0xC2, 0xFC, 0x63, 0x25, 0x51,
+};
+
+#define COMB_TEST_KEYS 16
+
+/*
+ * test_p256_public_keys:
+ *   ec_public_keys on small scalars around the comb's 4-bit digits, n - 1
+ *   and random scalars, as one batch and one by one, against
+ *   ippsECCPPublicKey.
+ */
+int test_p256_public_keys(void)
+{
+    uint8_t privs[32 * COMB_TEST_KEYS], pubs[64 * COMB_TEST_KEYS], one[64], expect[64];
+    static const uint8_t small[] = {1, 2, 3, 15, 16, 17, 255};
+    const int nsmall = (int)sizeof(small);
+    memset(privs, 0, sizeof(privs));
+    for (int i = 0; i < nsmall; i++)
+        privs[32 * i + 31] = small[i];
+    privs[32 * nsmall + 30] = 1;
+    memcpy(privs + 32 * (nsmall + 1), p256_n, 32);
+    privs[32 * (nsmall + 1) + 31] -= 1;
+    int failed = 0;
+    TEST_EXPECT(failed, 1, sgx_read_rand(privs + 32 * (nsmall + 2), 32 * (COMB_TEST_KEYS - nsmall - 2)) == SGX_SUCCESS);
+    //随机标量清掉最高位, 保证小于n
+    for (int i = nsmall + 2; i < COMB_TEST_KEYS; i++)
+        privs[32 * i] &= 0x7F;
+
+    TEST_EXPECT(failed, 2, ec_public_keys(ec_curve_p256(), privs, COMB_TEST_KEYS, pubs) == 0);
+
+    IppsECCPState* ec = newStd_256_ECP();
+    IppsBigNumState* k = newBN(ORDER_WORDS);
+    IppsECCPPointState* pt = newECP_256_point();
+    for (int i = 0; i < COMB_TEST_KEYS && failed == 0; i++)
+    {
+        ippsSetOctString_BN(privs + 32 * i, 32, k);
+        ippsECCPPublicKey(k, pt, ec);
+        ec_get_point(ec, pt, expect);
+        TEST_EXPECT(failed, 3, memcmp(pubs + 64 * i, expect, 64) == 0);
+        TEST_EXPECT(failed, 4, ec_public_keys(ec_curve_p256(), privs + 32 * i, 1, one) == 0 && memcmp(one, expect, 64) == 0);
+    }
+
+    memset(privs, 0, sizeof(privs));
+    delete [] (Ipp8u*) pt;
+    delete [] (Ipp8u*) k;
+    delete [] (Ipp8u*) ec;
+    return failed;
+}
+
+static const uint8_t k1_2gx[] = "\xC6\x04\x7F\x94\x41\xED\x7D\x6D\x30\x45\x40\x6E\x95\xC0\x7C\xD8\x5C\x77\x8E\x4B\x8C\xEF\x3C\xA7\xAB\xAC\x09\xB9\x5C\x70\x9E\xE5";
+static const uint8_t k1_2gy[] = "\x1A\xE1\x68\xFE\xA6\x3D\xC3\x39\xA3\xC5\x84\x19\x46\x6C\xEA\xEE\xF7\xF6\x32\x65\x32\x66\xD0\xE1\x23\x64\x31\xA9\x50\xCF\xE5\x2A";
+static const uint8_t k1_3gx[] = "\xF9\x30\x8A\x01\x92\x58\xC3\x10\x49\x34\x4F\x85\xF8\x9D\x52\x29\xB5\x31\xC8\x45\x83\x6F\x99\xB0\x86\x01\xF1\x13\xBC\xE0\x36\xF9";
+static const uint8_t k1_3gy[] = "\x38\x8F\x7B\x0F\x63\x2D\xE8\x14\x0F\xE3\x37\xE6\x2A\x37\xF3\x56\x65\x00\xA9\x99\x34\xC2\x23\x1B\x6C\xB9\xFD\x75\x84\xB8\xE6\x72";
+
+//k*G经comb算出, 与(k-1)*G + G(雅可比混合加法)比较; k-1不能为0或±1
+static int comb_matches_add(const ec_curve_t* curve, const uint8_t k[32])
+{
+    uint8_t km1[32], a[64], b[64];
+    memcpy(km1, k, 32);
+    for (int i = 31; i >= 0 && km1[i]-- == 0; i--)
+        ;
+
+    ec_jacobian_t r;
+    ec_affine_t aff;
+    fe_t t;
+    ec_mul_base(curve, &r, km1);
+    ec_jacobian_madd(curve, &r, &r, &curve->g);
+    ec_normalize_batch(curve, &r, &aff, 1);
+    fe_from_mont(&curve->fp, t, aff.x);
+    fe_to_bytes(a, t);
+    fe_from_mont(&curve->fp, t, aff.y);
+    fe_to_bytes(a + 32, t);
+    return ec_public_keys(curve, k, 1, b) == 0 && memcmp(a, b, 64) == 0;
+}
+
+/*
+ * test_secp256k1:
+ *   1G, 2G and 3G as a batch and alone, (n - 1)G = -G, 0 and n refused,
+ *   and the comb on full-width scalars against one Jacobian addition.
+ */
+int test_secp256k1(void)
+{
+    const ec_curve_t* k1 = ec_curve_secp256k1();
+    int failed = 0;
+    uint8_t k[3 * 32], pub[3 * 64], one[64];
+
+    memset(k, 0, sizeof(k));
+    for (int i = 0; i < 3; i++)
+        k[32 * i + 31] = (uint8_t)(i + 1);
+    TEST_EXPECT(failed, 1, ec_public_keys(k1, k, 3, pub) == 0);
+    TEST_EXPECT(failed, 2, memcmp(pub, secp256k1_gx, 32) == 0 && memcmp(pub + 32, secp256k1_gy, 32) == 0);
+    TEST_EXPECT(failed, 3, memcmp(pub + 64, k1_2gx, 32) == 0 && memcmp(pub + 96, k1_2gy, 32) == 0);
+    TEST_EXPECT(failed, 4, memcmp(pub + 128, k1_3gx, 32) == 0 && memcmp(pub + 160, k1_3gy, 32) == 0);
+    TEST_EXPECT(failed, 5, ec_public_keys(k1, k + 64, 1, one) == 0 && memcmp(one, pub + 128, 64) == 0);
+
+    //(n-1)G = -G = (Gx, p - Gy)
+    fe_t n, y, zero = {0, 0, 0, 0};
+    fe_from_bytes(n, secp256k1_n);
+    n[0] -= 1;
+    fe_to_bytes(k, n);
+    fe_from_bytes(y, secp256k1_gy);
+    fe_sub(&k1->fp, y, zero, y);
+    uint8_t neg_gy[32];
+    fe_to_bytes(neg_gy, y);
+    TEST_EXPECT(failed, 6, ec_public_keys(k1, k, 1, one) == 0 &&
+                memcmp(one, secp256k1_gx, 32) == 0 && memcmp(one + 32, neg_gy, 32) == 0);
+
+    //0和n都是无穷远点
+    memset(k, 0, 32);
+    TEST_EXPECT(failed, 7, ec_public_keys(k1, k, 1, one) != 0);
+    TEST_EXPECT(failed, 8, ec_public_keys(k1, secp256k1_n, 1, one) != 0);
+
+    //满宽标量: GLV分解后的comb与逐次加法一致
+    for (int i = 0; i < 32; i++)
+        k[i] = (uint8_t)(0xA5 ^ (i * 29));
+    TEST_EXPECT(failed, 9, comb_matches_add(k1, k));
+    n[0] -= 1;
+    fe_to_bytes(k, n);
+    TEST_EXPECT(failed, 10, comb_matches_add(k1, k));
+    return failed;
+}
+
+/* RFC 7748 section 5.2, first vector, and the section 6.1 key exchange */
+static const uint8_t rfc_scalar[] = "\xa5\x46\xe3\x6b\xf0\x52\x7c\x9d\x3b\x16\x15\x4b\x82\x46\x5e\xdd\x62\x14\x4c\x0a\xc1\xfc\x5a\x18\x50\x6a\x22\x44\xba\x44\x9a\xc4";
+static const uint8_t rfc_u[]      = "\xe6\xdb\x68\x67\x58\x30\x30\xdb\x35\x94\xc1\xa4\x24\xb1\x5f\x7c\x72\x66\x24\xec\x26\xb3\x35\x3b\x10\xa9\x03\xa6\xd0\xab\x1c\x4c";
+static const uint8_t rfc_out[]    = "\xc3\xda\x55\x37\x9d\xe9\xc6\x90\x8e\x94\xea\x4d\xf2\x8d\x08\x4f\x32\xec\xcf\x03\x49\x1c\x71\xf7\x54\xb4\x07\x55\x77\xa2\x85\x52";
+static const uint8_t alice_priv[] = "\x77\x07\x6d\x0a\x73\x18\xa5\x7d\x3c\x16\xc1\x72\x51\xb2\x66\x45\xdf\x4c\x2f\x87\xeb\xc0\x99\x2a\xb1\x77\xfb\xa5\x1d\xb9\x2c\x2a";
+static const uint8_t alice_pub[]  = "\x85\x20\xf0\x09\x89\x30\xa7\x54\x74\x8b\x7d\xdc\xb4\x3e\xf7\x5a\x0d\xbf\x3a\x0d\x26\x38\x1a\xf4\xeb\xa4\xa9\x8e\xaa\x9b\x4e\x6a";
+static const uint8_t bob_priv[]   = "\x5d\xab\x08\x7e\x62\x4a\x8a\x4b\x79\xe1\x7f\x8b\x83\x80\x0e\xe6\x6f\x3b\xb1\x29\x26\x18\xb6\xfd\x1c\x2f\x8b\x27\xff\x88\xe0\xeb";
+static const uint8_t bob_pub[]    = "\xde\x9e\xdb\x7d\x7b\x7d\xc1\xb4\xd3\x5b\x61\xc2\xec\xe4\x35\x37\x3f\x83\x43\xc8\x5b\x78\x67\x4d\xad\xfc\x7e\x14\x6f\x88\x2b\x4f";
+static const uint8_t shared_key[] = "\x4a\x5d\x9d\x5b\xa4\xce\x2d\xe1\x72\x8e\x3b\xf4\x80\x35\x0f\x25\xe0\x7e\x21\xc9\x47\xd1\x9e\x33\x76\xf0\x9b\x3c\x1e\x16\x17\x42";
+
+/*
+ * test_curve25519:
+ *   X25519 against RFC 7748 (one vector and the Alice/Bob exchange), the
+ *   all-zero output refused, 1*B encoded as Ed25519 and as X25519 u = 9,
+ *   and the Ed25519 comb against the ladder on clamped scalars.
+ */
+int test_curve25519(void)
+{
+    int failed = 0;
+    uint8_t k[32], out[32], out2[32], ed[64];
+    const uint8_t base[32] = {9};
+    TEST_EXPECT(failed, 1, x25519(out, rfc_scalar, rfc_u) == 0 && memcmp(out, rfc_out, 32) == 0);
+    TEST_EXPECT(failed, 2, x25519(out, alice_priv, base) == 0 && memcmp(out, alice_pub, 32) == 0);
+    TEST_EXPECT(failed, 3, x25519(out, bob_priv, base) == 0 && memcmp(out, bob_pub, 32) == 0);
+    TEST_EXPECT(failed, 4, x25519(out, alice_priv, bob_pub) == 0 && x25519(out2, bob_priv, alice_pub) == 0 &&
+                memcmp(out, shared_key, 32) == 0 && memcmp(out2, shared_key, 32) == 0);
+    memset(out2, 0, 32);
+    TEST_EXPECT(failed, 5, x25519(out, alice_priv, out2) != 0);
+
+    //1*B编码为0x58 66..66, 其X25519 u为9
+    memset(k, 0, 32);
+    k[31] = 1;
+    TEST_EXPECT(failed, 6, ed25519_public_keys(k, 1, ed) == 0 && ed[0] == 0x58 && ed[32] == 9);
+    for (int i = 1; i < 32; i++)
+        TEST_EXPECT(failed, 7, ed[i] == 0x66 && ed[32 + i] == 0);
+
+    //comb与阶梯互验: c = 2^254 + 8v经X25519钳位不变, 而c*B = (c mod L)*B
+    fe_t c, l;
+    fe_from_bytes(l, ed25519_l);
+    for (uint32_t v = 0; v < 3; v++)
+    {
+        uint8_t le[32];
+        fe_t r = {8 * (uint64_t)v * 0x9E3779B9u, 0, 0, (uint64_t)1 << 62};
+        fe_copy(c, r);
+        for (;;)
+        {
+            fe_t d;
+            unsigned char b = 0;
+            for (int j = 0; j < 4; j++)
+                d[j] = fe_sbb(r[j], l[j], &b);
+            if (b)
+                break;
+            fe_copy(r, d);
+        }
+        fe_to_bytes(k, r);
+        fe_to_bytes(le, c);
+        for (int j = 0; j < 16; j++)
+        {
+            uint8_t t = le[j];
+            le[j] = le[31 - j];
+            le[31 - j] = t;
+        }
+        TEST_EXPECT(failed, 8, ed25519_public_keys(k, 1, ed) == 0 && x25519(out, le, base) == 0 &&
+                    memcmp(ed + 32, out, 32) == 0);
+    }
+    return failed;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* The custodian's side of encrypted delivery: with a test custodian's
+ * X25519 private key this derives the session key Deliver.cpp uses and
+ * opens wrapped shares, or secrets recovered by batch_reconstruct. Only a
+ * verdict comes back; what was opened stays in the enclave.
+ */
+
+#include <string.h>
+#include <stddef.h>
+
+#include "../Enclave.h"
+#include "../Curve/Curve.h"
+#include "../KeyStore/KeyStore.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#include "sgx_tcrypto.h"
+
+static const uint8_t session_label[] = "SGXDLV-session";
+static const uint8_t x25519_base[32] = {9};
+
+//custodian一侧的会话密钥
+static int custodian_key(const uint8_t priv[32], uint8_t key[ENV_KEY_SIZE])
+{
+    uint8_t dlv_pub[32], pub[32], shared[32];
+    int ret = deliver_public_key(dlv_pub) == 0 && x25519(pub, priv, x25519_base) == 0 &&
+              x25519(shared, priv, dlv_pub) == 0 ? 0 : -1;
+
+    sgx_sha_state_handle_t sha;
+    if (ret == 0)
+        ret = sgx_sha256_init(&sha) == SGX_SUCCESS ? 0 : -1;
+    if (ret == 0)
+    {
+        if (sgx_sha256_update(session_label, sizeof(session_label) - 1, sha) != SGX_SUCCESS ||
+            sgx_sha256_update(shared, sizeof(shared), sha) != SGX_SUCCESS ||
+            sgx_sha256_update(dlv_pub, sizeof(dlv_pub), sha) != SGX_SUCCESS ||
+            sgx_sha256_update(pub, sizeof(pub), sha) != SGX_SUCCESS ||
+            sgx_sha256_get_hash(sha, (sgx_sha256_hash_t*)key) != SGX_SUCCESS)
+            ret = -1;
+        sgx_sha256_close(sha);
+    }
+    memset(shared, 0, sizeof(shared));
+    return ret;
+}
+
+//解开一份, tag不符返回-1
+static int unwrap(const uint8_t priv[32], const wrapped_share_t* in, share_t* out)
+{
+    uint8_t key[ENV_KEY_SIZE], tag[ENV_TAG_SIZE];
+    int size = 0;
+    ippsAES_GCMGetSize(&size);
+    IppsAES_GCMState* gcm = (IppsAES_GCMState*)(new Ipp8u[size]);
+
+    out->x = in->x;
+    int ret = custodian_key(priv, key);
+    if (ret == 0)
+        ret = ippsAES_GCMInit(key, ENV_KEY_SIZE, gcm, size) == ippStsNoErr &&
+              ippsAES_GCMStart(in->iv, ENV_IV_SIZE, (const Ipp8u*)in, (int)offsetof(wrapped_share_t, iv), gcm) == ippStsNoErr &&
+              ippsAES_GCMDecrypt(in->ct, out->y, sizeof(in->ct), gcm) == ippStsNoErr &&
+              ippsAES_GCMGetTag(tag, ENV_TAG_SIZE, gcm) == ippStsNoErr &&
+              memcmp(tag, in->tag, ENV_TAG_SIZE) == 0 ? 0 : -1;
+
+    memset(key, 0, sizeof(key));
+    memset(gcm, 0, (size_t)size);
+    delete [] (Ipp8u*)gcm;
+    return ret;
+}
+
+/*
+ * test_custodian:
+ *   The X25519 public key of a test custodian's private key.
+ */
+int test_custodian(const uint8_t* priv, uint8_t* pub)
+{
+    return x25519(pub, priv, x25519_base);
+}
+
+/*
+ * test_open:
+ *   Open count shares of one key, wrapped to the custodians privs[i]
+ *   (32 bytes each), and rebuild the key from them: 0 when it matches,
+ *   1 when not, -1 when a tag fails or the records name other keys.
+ */
+int test_open(const uint8_t* privs, size_t privs_len, const wrapped_share_t* in, int count)
+{
+    if (count < 1 || count > SHARE_MAX_K || privs_len != 32 * (size_t)count)
+        return -1;
+    share_t* shares = new share_t[count];
+    int ret = 0;
+    for (int i = 0; i < count && ret == 0; i++)
+        ret = in[i].key_id == in[0].key_id ? unwrap(privs + 32 * (size_t)i, &in[i], &shares[i]) : -1;
+    if (ret == 0)
+        ret = test_share_secret(in[0].key_id, shares, count);
+    memset(shares, 0, count * sizeof(share_t));
+    delete [] shares;
+    return ret;
+}
+
+/*
+ * test_recovered:
+ *   Open count recovered secrets sealed to priv's key (record j tagged j,
+ *   x 0) and compare each with the stored secret of key_ids[j]: 0 when
+ *   all match, 1 when one differs, -1 when a tag or a record fails.
+ */
+int test_recovered(const uint8_t* priv, const wrapped_share_t* in, int count, const uint64_t* key_ids)
+{
+    if (count < 1 || count > RECON_MAX_SECRETS)
+        return -1;
+    share_t s;
+    keystore_secret_t secret;
+    uint8_t pub[64];
+    int ret = 0;
+    for (int j = 0; j < count && ret == 0; j++)
+    {
+        if (in[j].key_id != (uint64_t)j || in[j].x != 0 || unwrap(priv, &in[j], &s) != 0 ||
+            keystore_get(key_ids[j], &secret, pub) != 0)
+            ret = -1;
+        else
+            ret = memcmp(s.y, secret.priv, sizeof(s.y)) == 0 ? 0 : 1;
+    }
+    memset(&s, 0, sizeof(s));
+    memset(&secret, 0, sizeof(secret));
+    return ret;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Known answers and round trips for the share fields: every PrimeField.h
+ * backend (the 256-bit orders in Montgomery form, secp256k1's p in the
+ * folding form, 2^127 - 1 and 2^64 - 59) on one product with a published
+ * residue, inversion, encoding bounds, Lagrange reconstruction through
+ * both the span and the generic weight paths, and the fixed-policy
+ * evaluation kernels against Horner.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../Curve/Curve.h"
+#include "../Sharing/PrimeField.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#define FIELD_TEST_K 5
+#define FIELD_TEST_N 9
+
+/* 2^256 mod n, 2^253 mod L */
+static const uint8_t k1_n_r[] = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01\x45\x51\x23\x19\x50\xB7\x5F\xC4\x40\x2D\xA1\x73\x2F\xC9\xBE\xBF";
+static const uint8_t ed_l_r[] = "\x0F\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xEB\x21\x06\x21\x5D\x08\x63\x29\xA7\xED\x9C\xE5\xA3\x0A\x2C\x13";
+static const uint8_t m127_p[] = "\x7F\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF";
+static const uint8_t p64_p[]  = "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xC5";
+
+/* one product per backend: a = 2^abit, b = 2^bbit, a*b mod p = expect */
+typedef struct _field_kat_t {
+    int abit;
+    int bbit;
+    const uint8_t* p;
+    const uint8_t* expect;
+} field_kat_t;
+
+//可复现的伪随机字节(xorshift64)
+static void fill_bytes(uint64_t* state, uint8_t* out, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        *state ^= *state << 13;
+        *state ^= *state >> 7;
+        *state ^= *state << 17;
+        out[i] = (uint8_t)*state;
+    }
+}
+
+//大端bytes字节的2^bit
+static void pow2(uint8_t* out, int bytes, int bit)
+{
+    memset(out, 0, (size_t)bytes);
+    out[bytes - 1 - bit / 8] = (uint8_t)(1 << (bit % 8));
+}
+
+template <class F>
+static int field_equal(const F& f, const typename F::elem& a, const typename F::elem& b)
+{
+    uint8_t ea[F::BYTES], eb[F::BYTES];
+    f.to_bytes(ea, a);
+    f.to_bytes(eb, b);
+    return memcmp(ea, eb, F::BYTES) == 0;
+}
+
+template <class F>
+static int field_from_random(const F& f, uint64_t* state, typename F::elem& r)
+{
+    uint8_t buf[F::RAND_BYTES];
+    fill_bytes(state, buf, sizeof(buf));
+    f.from_random(r, buf);
+    return 0;
+}
+
+//sum w_i y(xs_i) == coef[0]
+template <class F>
+static int reconstructs(const F& f, const typename F::elem* w, const typename F::elem* y, const uint32_t* xs,
+                        const typename F::elem& secret)
+{
+    typename F::elem acc, t;
+    f.zero(acc);
+    for (int i = 0; i < FIELD_TEST_K; i++)
+    {
+        f.mul(t, w[i], y[xs[i] - 1]);
+        f.add(acc, acc, t);
+    }
+    return field_equal(f, acc, secret);
+}
+
+/* checks base+1 .. base+11 of one backend */
+template <class F>
+static int field_checks(const F& f, const field_kat_t* kat, int base)
+{
+    int failed = 0;
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)base;
+    uint8_t bytes[F::BYTES];
+    typename F::elem a, b, r, one;
+    f.set_u32(one, 1);
+
+    pow2(bytes, F::BYTES, kat->abit);
+    TEST_EXPECT(failed, base + 1, f.from_bytes(a, bytes) == 0);
+    pow2(bytes, F::BYTES, kat->bbit);
+    TEST_EXPECT(failed, base + 1, f.from_bytes(b, bytes) == 0);
+    f.mul(r, a, b);
+    f.to_bytes(bytes, r);
+    TEST_EXPECT(failed, base + 2, memcmp(bytes, kat->expect, F::BYTES) == 0);
+
+    //p本身与全1都不是合法编码
+    TEST_EXPECT(failed, base + 3, f.from_bytes(r, kat->p) != 0);
+    memset(bytes, 0xff, sizeof(bytes));
+    TEST_EXPECT(failed, base + 3, f.from_bytes(r, bytes) != 0);
+
+    //a * a^-1 = 1, a - a + 1 = 1, 批量求逆与逐个一致
+    typename F::elem v[FIELD_TEST_N], inv[FIELD_TEST_N], prefix[FIELD_TEST_N];
+    for (int i = 0; i < FIELD_TEST_N; i++)
+    {
+        field_from_random(f, &state, v[i]);
+        f.inv(inv[i], v[i]);
+        f.mul(r, v[i], inv[i]);
+        TEST_EXPECT(failed, base + 4, field_equal(f, r, one));
+        f.sub(r, v[i], v[i]);
+        f.add(r, r, one);
+        TEST_EXPECT(failed, base + 4, field_equal(f, r, one));
+    }
+    pf_inv_batch(f, v, FIELD_TEST_N, prefix);
+    for (int i = 0; i < FIELD_TEST_N; i++)
+        TEST_EXPECT(failed, base + 5, field_equal(f, v[i], inv[i]));
+
+    //k-1次多项式在1..n求值, 三组横坐标各自恢复f(0)
+    typename F::elem coef[FIELD_TEST_K], y[FIELD_TEST_N], w[FIELD_TEST_K], w2[FIELD_TEST_K];
+    for (int i = 0; i < FIELD_TEST_K; i++)
+        field_from_random(f, &state, coef[i]);
+    pf_eval_all(f, coef, FIELD_TEST_K, y, FIELD_TEST_N);
+
+    static const uint32_t first[FIELD_TEST_K] = {1, 2, 3, 4, 5};
+    static const uint32_t gapped[FIELD_TEST_K] = {5, 3, 6, 7, 9};
+    static const uint32_t spread[FIELD_TEST_K] = {9, 1, 4, 2, 7};
+    TEST_EXPECT(failed, base + 6, pf_weights_zero(f, first, FIELD_TEST_K, w) == 0 && reconstructs(f, w, y, first, coef[0]));
+    TEST_EXPECT(failed, base + 6, pf_weights_zero(f, gapped, FIELD_TEST_K, w) == 0 && reconstructs(f, w, y, gapped, coef[0]));
+    TEST_EXPECT(failed, base + 6, pf_weights_zero(f, spread, FIELD_TEST_K, w) == 0 && reconstructs(f, w, y, spread, coef[0]));
+
+    //span与generic两条路径给出相同权重: 有空缺的和连续的
+    TEST_EXPECT(failed, base + 7, pf_weights_span(f, gapped, FIELD_TEST_K, 3, 6, w) == 0 &&
+                pf_weights_generic(f, gapped, FIELD_TEST_K, w2) == 0);
+    for (int i = 0; i < FIELD_TEST_K; i++)
+        TEST_EXPECT(failed, base + 7, field_equal(f, w[i], w2[i]));
+    TEST_EXPECT(failed, base + 7, pf_weights_span(f, first, FIELD_TEST_K, 1, FIELD_TEST_K - 1, w) == 0 &&
+                pf_weights_generic(f, first, FIELD_TEST_K, w2) == 0);
+    for (int i = 0; i < FIELD_TEST_K; i++)
+        TEST_EXPECT(failed, base + 7, field_equal(f, w[i], w2[i]));
+
+    //k-1个份额与f(0)无关: 少一个份额恢复不出来
+    TEST_EXPECT(failed, base + 8, pf_weights_zero(f, first, FIELD_TEST_K - 1, w) == 0);
+    typename F::elem acc, t;
+    f.zero(acc);
+    for (int i = 0; i < FIELD_TEST_K - 1; i++)
+    {
+        f.mul(t, w[i], y[first[i] - 1]);
+        f.add(acc, acc, t);
+    }
+    TEST_EXPECT(failed, base + 8, !field_equal(f, acc, coef[0]));
+
+    //横坐标为0或重复时拒绝
+    static const uint32_t zero_x[FIELD_TEST_K] = {1, 2, 0, 4, 5};
+    static const uint32_t twice[FIELD_TEST_K] = {1, 2, 3, 2, 5};
+    TEST_EXPECT(failed, base + 9, pf_weights_zero(f, zero_x, FIELD_TEST_K, w) != 0);
+    TEST_EXPECT(failed, base + 9, pf_weights_zero(f, twice, FIELD_TEST_K, w) != 0);
+
+    //固定策略的差分核与Horner一致, 其他策略不接
+    static const int policies[][2] = {{2, 3}, {3, 5}, {3, 11}};
+    typename F::elem fixed[11], horner[11];
+    for (size_t c = 0; c < sizeof(policies) / sizeof(policies[0]); c++)
+    {
+        int k = policies[c][0], n = policies[c][1];
+        TEST_EXPECT(failed, base + 10, pf_eval_policy(f, coef, k, fixed, n) == 0);
+        pf_eval_all(f, coef, k, horner, n);
+        for (int i = 0; i < n; i++)
+            TEST_EXPECT(failed, base + 10, field_equal(f, fixed[i], horner[i]));
+    }
+    TEST_EXPECT(failed, base + 11, pf_eval_policy(f, coef, 3, fixed, 4) != 0);
+    TEST_EXPECT(failed, base + 11, pf_eval_policy(f, coef, FIELD_TEST_K, y, FIELD_TEST_N) != 0);
+    return failed;
+}
+
+/*
+ * test_field:
+ *   Share field known answers; 0 or the first failed check, numbered
+ *   100 * backend + check.
+ */
+int test_field(void)
+{
+    static const uint8_t k1_p_r[] = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+                                    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x03\xD1";
+    static const uint8_t m127_r[] = "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x02";
+    static const uint8_t p64_r[]  = "\x00\x00\x00\x00\x00\x00\x00\x3B";
+
+    fe_modulus_t n, l, p;
+    fe_modulus_init(&n, secp256k1_n);
+    fe_modulus_init(&l, ed25519_l);
+    fe_modulus_init(&p, secp256k1_p);
+    const field_kat_t kats[] = {
+        {255, 1, secp256k1_n, k1_n_r},
+        {251, 2, ed25519_l, ed_l_r},
+        {255, 1, secp256k1_p, k1_p_r},
+        {126, 2, m127_p, m127_r},
+        {63, 1, p64_p, p64_r},
+    };
+
+    int failed = 0;
+    if (failed == 0)
+        failed = field_checks(pf_order(&n), &kats[0], 100);
+    if (failed == 0)
+        failed = field_checks(pf_order(&l), &kats[1], 200);
+    if (failed == 0)
+        failed = field_checks(pf_order(&p), &kats[2], 300);
+    if (failed == 0)
+        failed = field_checks(pf_m127(), &kats[3], 400);
+    if (failed == 0)
+        failed = field_checks(pf_p64(), &kats[4], 500);
+
+    //折叠约减的模数不做蒙哥马利变换
+    TEST_EXPECT(failed, 601, p.c == 0x1000003D1ULL && n.c == 0 && l.c == 0);
+    return failed;
+}
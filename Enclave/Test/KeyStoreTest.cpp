@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Key store checks from inside the enclave. Test records carry a fresh
+ * random secret and a "public key" derived from it byte by byte, so a
+ * record read back can be checked without remembering what was stored.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#include "sgx_trts.h"
+
+#define KEYSTORE_TEST_K 2
+#define KEYSTORE_TEST_N 3
+#define KEYSTORE_TEST_MAX 64
+
+//公钥由私钥逐字节导出
+static void test_pub(const uint8_t priv[32], uint8_t pub[64])
+{
+    for (int i = 0; i < 32; i++)
+    {
+        pub[i] = (uint8_t)(priv[i] ^ 0x5A);
+        pub[32 + i] = (uint8_t)(priv[31 - i] + 0x33);
+    }
+}
+
+//读回的记录与测试规则一致
+static int entry_ok(const keystore_secret_t* secret, const uint8_t pub[64])
+{
+    uint8_t expect[64];
+    test_pub(secret->priv, expect);
+    return secret->piece_k == KEYSTORE_TEST_K && secret->piece_n == KEYSTORE_TEST_N &&
+           memcmp(pub, expect, 64) == 0;
+}
+
+/*
+ * test_keystore_put:
+ *   Store count test records, returned in recs for the app to persist.
+ *   Ids must increase and every record must read back intact.
+ */
+int test_keystore_put(keystore_record_t* recs, int count)
+{
+    if (count < 1 || count > KEYSTORE_TEST_MAX)
+        return -1;
+    int failed = 0;
+    for (int i = 0; i < count && failed == 0; i++)
+    {
+        keystore_secret_t secret, back;
+        uint8_t pub[64], pub_back[64];
+        memset(&secret, 0, sizeof(secret));
+        secret.piece_k = KEYSTORE_TEST_K;
+        secret.piece_n = KEYSTORE_TEST_N;
+        TEST_EXPECT(failed, 1, sgx_read_rand(secret.priv, sizeof(secret.priv)) == SGX_SUCCESS);
+        test_pub(secret.priv, pub);
+        TEST_EXPECT(failed, 2, keystore_put(&secret, pub, &recs[i]) == 0 && memcmp(recs[i].pub, pub, 64) == 0);
+        TEST_EXPECT(failed, 3, i == 0 || recs[i].key_id > recs[i - 1].key_id);
+        TEST_EXPECT(failed, 4, keystore_get(recs[i].key_id, &back, pub_back) == 0 &&
+                    memcmp(&back, &secret, sizeof(secret)) == 0 && memcmp(pub_back, pub, 64) == 0);
+        memset(&secret, 0, sizeof(secret));
+        memset(&back, 0, sizeof(back));
+    }
+    return failed;
+}
+
+/*
+ * test_keystore_get:
+ *   Every key_id resolves to a well-formed test record.
+ */
+int test_keystore_get(const uint64_t* key_ids, int count)
+{
+    if (count < 1)
+        return -1;
+    int failed = 0;
+    for (int i = 0; i < count && failed == 0; i++)
+    {
+        keystore_secret_t secret;
+        uint8_t pub[64];
+        TEST_EXPECT(failed, 1, keystore_get(key_ids[i], &secret, pub) == 0 && entry_ok(&secret, pub));
+        memset(&secret, 0, sizeof(secret));
+    }
+    return failed;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* A plain Merkle reference for the batch commitment: one sgx_sha256_msg
+ * per hash, level by level, so it shares nothing with the two-lane kernel
+ * in Merkle.cpp but the layout of merkle.h.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "merkle.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#include "sgx_tcrypto.h"
+
+static int ref_leaf(uint64_t key_id, const share_t* s, uint8_t out[MERKLE_HASH_SIZE])
+{
+    uint8_t msg[MERKLE_LEAF_SIZE];
+    msg[0] = 0x00;
+    for (int i = 0; i < 8; i++)
+        msg[1 + i] = (uint8_t)(key_id >> (56 - 8*i));
+    for (int i = 0; i < 4; i++)
+        msg[9 + i] = (uint8_t)(s->x >> (24 - 8*i));
+    memcpy(msg + 13, s->y, 32);
+    int ret = sgx_sha256_msg(msg, sizeof(msg), (sgx_sha256_hash_t*)out) == SGX_SUCCESS ? 0 : -1;
+    memset(msg, 0, sizeof(msg));
+    return ret;
+}
+
+static int ref_node(const uint8_t* left, const uint8_t* right, uint8_t out[MERKLE_HASH_SIZE])
+{
+    uint8_t msg[MERKLE_NODE_SIZE];
+    msg[0] = 0x01;
+    memcpy(msg + 1, left, MERKLE_HASH_SIZE);
+    memcpy(msg + 1 + MERKLE_HASH_SIZE, right, MERKLE_HASH_SIZE);
+    return sgx_sha256_msg(msg, sizeof(msg), (sgx_sha256_hash_t*)out) == SGX_SUCCESS ? 0 : -1;
+}
+
+/*
+ * test_merkle_root:
+ *   Rebuild the root over count shares of keys (key_ids[i / (count /
+ *   keys)] owns share i) and compare: 0 when it is root, 1 when not.
+ */
+int test_merkle_root(const uint64_t* key_ids, int keys, const share_t* shares, int count, const uint8_t* root)
+{
+    if (keys < 1 || count < keys || count % keys != 0)
+        return -1;
+    int n = count / keys;
+    uint8_t* level = new uint8_t[MERKLE_HASH_SIZE * (size_t)count];
+    int ret = 0;
+    for (int i = 0; i < count && ret == 0; i++)
+        ret = ref_leaf(key_ids[i / n], &shares[i], level + MERKLE_HASH_SIZE * (size_t)i);
+
+    //奇数个时最后一个原样上提
+    int width = count;
+    while (width > 1 && ret == 0)
+    {
+        int half = 0;
+        for (int i = 0; i + 1 < width && ret == 0; i += 2)
+            ret = ref_node(level + MERKLE_HASH_SIZE * (size_t)i, level + MERKLE_HASH_SIZE * (size_t)(i + 1),
+                           level + MERKLE_HASH_SIZE * (size_t)half++);
+        if (width % 2 != 0)
+            memmove(level + MERKLE_HASH_SIZE * (size_t)half++, level + MERKLE_HASH_SIZE * (size_t)(width - 1),
+                    MERKLE_HASH_SIZE);
+        width = half;
+    }
+    if (ret == 0)
+        ret = memcmp(level, root, MERKLE_HASH_SIZE) == 0 ? 0 : 1;
+    delete [] level;
+    return ret;
+}
+
+/*
+ * test_merkle_proof:
+ *   Fold an inclusion proof for leaf 'index' of 'leaves' (key key_id's
+ *   share s) up to the root: 0 when it reaches root, 1 when not.
+ */
+int test_merkle_proof(uint64_t key_id, const share_t* s, uint64_t leaves, uint64_t index, const uint8_t* proof,
+                      size_t proof_len, const uint8_t* root)
+{
+    if (index >= leaves || proof_len % MERKLE_HASH_SIZE != 0 || proof_len > MERKLE_HASH_SIZE * MERKLE_MAX_DEPTH)
+        return -1;
+    uint8_t h[MERKLE_HASH_SIZE];
+    int ret = ref_leaf(key_id, s, h);
+    size_t used = 0;
+    while (leaves > 1 && ret == 0)
+    {
+        if ((index ^ 1) < leaves)
+        {
+            if (used == proof_len)
+                return 1;
+            const uint8_t* sib = proof + used;
+            ret = index % 2 == 0 ? ref_node(h, sib, h) : ref_node(sib, h, h);
+            used += MERKLE_HASH_SIZE;
+        }
+        leaves = (leaves + 1) / 2;
+        index /= 2;
+    }
+    if (ret == 0)
+        ret = used == proof_len && memcmp(h, root, MERKLE_HASH_SIZE) == 0 ? 0 : 1;
+    return ret;
+}
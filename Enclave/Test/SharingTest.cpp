@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Shamir sharing checks from inside the enclave: shares evaluated at
+ * x = 1..n reconstruct the secret from any k of them and not from k - 1,
+ * a key made by secret_sharing keeps its policy and a public key that
+ * matches its private key, shares handed out by the app rebuild the
+ * stored private key, and seeded keys re-derive the shares they issued.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+//两个大数相等
+static int bn_equal(const IppsBigNumState* a, const IppsBigNumState* b)
+{
+    Ipp32u cmp = 1;
+    ippsCmp_BN(a, b, &cmp);
+    return cmp == IPP_IS_EQ;
+}
+
+//用xs指定的k个份额恢复, 与poly[0]比较
+static int recovers(IppsBigNumState** piece, const Ipp32u* xs, int k, const IppsBigNumState* secret)
+{
+    IppsBigNumState** picked = new IppsBigNumState*[k];
+    for (int i = 0; i < k; i++)
+        picked[i] = piece[xs[i] - 1];
+    IppsBigNumState* got = verify(picked, xs, k);
+    int ok = bn_equal(got, secret);
+    delete [] (Ipp8u*) got;
+    delete [] picked;
+    return ok;
+}
+
+static int gcd(int a, int b)
+{
+    while (b != 0)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * test_sharing_math:
+ *   A random degree k-1 polynomial shared at x = 1..n: the batch and the
+ *   per-point evaluators agree, and the first, the last and a strided set
+ *   of k shares give back poly[0], k-1 do not.
+ */
+int test_sharing_math(int piece_k, int piece_n)
+{
+    if (piece_k < SHARE_MIN_K || piece_k > piece_n || piece_n > SHARE_MAX_N)
+        return -1;
+    int failed = 0;
+    IppsBigNumState* bnq = newOrderBN();
+    IppsPRNGState* pRandGen = newPRNG();
+    IppsBigNumState** poly = newBNArray(piece_k, ORDER_WORDS);
+    IppsBigNumState** piece = newBNArray(piece_n, ORDER_WORDS);
+    for (int i = 0; i < piece_k; i++)
+    {
+        ippsPRNGen_BN(poly[i], 256, pRandGen);
+        ippsMod_BN(poly[i], bnq, poly[i]);
+    }
+    share_ctx_t ctx;
+    share_ctx_init(&ctx);
+    share_eval_all(&ctx, poly, piece_k, piece, piece_n);
+
+    //逐点求值与批量求值一致, IPP上的插值也在x=0处给出poly[0]
+    IppsBigNumState* y = newBN(ORDER_WORDS);
+    for (int i = 0; i < piece_n; i++)
+    {
+        eval_share(&ctx, poly, piece_k, (Ipp32u)(i + 1), y);
+        TEST_EXPECT(failed, 1, bn_equal(y, piece[i]));
+    }
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, y);
+    Ipp32u* xs = new Ipp32u[piece_k];
+    for (int i = 0; i < piece_k; i++)
+        xs[i] = (Ipp32u)(piece_n - i);
+    IppsBigNumState** picked = new IppsBigNumState*[piece_k];
+    for (int i = 0; i < piece_k; i++)
+        picked[i] = piece[xs[i] - 1];
+    IppsBigNumState* got = interpolate(picked, xs, piece_k, y);
+    TEST_EXPECT(failed, 2, bn_equal(got, poly[0]));
+    delete [] (Ipp8u*) got;
+    delete [] picked;
+    delete [] (Ipp8u*) y;
+    share_ctx_free(&ctx);
+
+    for (int i = 0; i < piece_k; i++)
+        xs[i] = (Ipp32u)(i + 1);
+    TEST_EXPECT(failed, 3, recovers(piece, xs, piece_k, poly[0]));
+    for (int i = 0; i < piece_k; i++)
+        xs[i] = (Ipp32u)(piece_n - i);
+    TEST_EXPECT(failed, 4, recovers(piece, xs, piece_k, poly[0]));
+    //步长取与n互素的数, 覆盖不连续的横坐标
+    int stride = 2;
+    while (gcd(stride, piece_n) != 1)
+        stride++;
+    for (int i = 0; i < piece_k; i++)
+        xs[i] = (Ipp32u)((i * stride) % piece_n + 1);
+    TEST_EXPECT(failed, 5, recovers(piece, xs, piece_k, poly[0]));
+    TEST_EXPECT(failed, 6, !recovers(piece, xs, piece_k - 1, poly[0]));
+    delete [] xs;
+
+    deleteBNArray(piece);
+    deleteBNArray(poly);
+    deletePRNG(pRandGen);
+    delete [] (Ipp8u*) bnq;
+    return failed;
+}
+
+/*
+ * test_sharing_key:
+ *   key_id was stored by secret_sharing with policy (k, n), and its public
+ *   key is priv * G on the curve its flags name (P-256 for older records,
+ *   Ed25519 || X25519 for Curve25519 keys).
+ */
+int test_sharing_key(uint64_t key_id, int piece_k, int piece_n)
+{
+    keystore_secret_t secret;
+    uint8_t pub[64], expect[64];
+    int failed = 0;
+    if (keystore_get(key_id, &secret, pub) != 0)
+        return 1;
+    TEST_EXPECT(failed, 2, secret.piece_k == piece_k && secret.piece_n == piece_n);
+
+    //Ed25519的公钥由comb算出, 没有IPP参照
+    if (secret.flags & KEYSTORE_FLAG_ED25519)
+    {
+        TEST_EXPECT(failed, 3, ed25519_public_keys(secret.priv, 1, expect) == 0 && memcmp(pub, expect, 64) == 0);
+        TEST_EXPECT(failed, 4, memcmp(secret.priv, ed25519_l, 32) < 0);
+        memset(&secret, 0, sizeof(secret));
+        return failed;
+    }
+
+    IppsECCPState* pECP = (secret.flags & KEYSTORE_FLAG_SECP256K1) ? newSecp256k1_ECP() : newStd_256_ECP();
+    IppsBigNumState* priv = newBN(ORDER_WORDS);
+    IppsBigNumState* px = newBN(ORDER_WORDS);
+    IppsBigNumState* py = newBN(ORDER_WORDS);
+    IppsECCPPointState* point = newECP_256_point();
+    ippsSetOctString_BN(secret.priv, 32, priv);
+    ippsECCPPublicKey(priv, point, pECP);
+    ippsECCPGetPoint(px, py, point, pECP);
+    ippsGetOctString_BN(expect, 32, px);
+    ippsGetOctString_BN(expect + 32, 32, py);
+    TEST_EXPECT(failed, 3, memcmp(pub, expect, 64) == 0);
+
+    memset(&secret, 0, sizeof(secret));
+    Ipp32u zero = 0;
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, priv);
+    delete [] (Ipp8u*) point;
+    delete [] (Ipp8u*) py;
+    delete [] (Ipp8u*) px;
+    delete [] (Ipp8u*) priv;
+    delete [] (Ipp8u*) pECP;
+    return failed;
+}
+
+/*
+ * test_share_secret:
+ *   0 when the count shares rebuild key_id's stored private key (at
+ *   x = -slot for a packed key), 1 when they rebuild something else, -1
+ *   on bad input.
+ */
+int test_share_secret(uint64_t key_id, const share_t* shares, int count)
+{
+    if (count < 1 || count > SHARE_MAX_K)
+        return -1;
+    keystore_secret_t secret;
+    uint8_t pub[64];
+    if (keystore_get(key_id, &secret, pub) != 0)
+        return -1;
+
+    IppsBigNumState** piece = newBNArray(count, ORDER_WORDS);
+    Ipp32u* xs = new Ipp32u[count];
+    for (int i = 0; i < count; i++)
+    {
+        xs[i] = shares[i].x;
+        ippsSetOctString_BN(shares[i].y, sizeof(shares[i].y), piece[i]);
+    }
+    IppsBigNumState* priv = newBN(ORDER_WORDS);
+    ippsSetOctString_BN(secret.priv, sizeof(secret.priv), priv);
+    //打包的key在x=-slot处, 即q-slot
+    int curve = (secret.flags & KEYSTORE_FLAG_ED25519) ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1;
+    Ipp32u zero = 0, slot = KEYSTORE_PACKED_SLOT_OF(secret.flags);
+    IppsBigNumState* z = newBN(ORDER_WORDS);
+    IppsBigNumState* bnslot = newBN(1);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, z);
+    if (secret.flags & KEYSTORE_FLAG_PACKED)
+    {
+        IppsBigNumState* bnq = newOrderBN(curve);
+        ippsSet_BN(IppsBigNumPOS, 1, &slot, bnslot);
+        ippsSub_BN(bnq, bnslot, z);
+        delete [] (Ipp8u*) bnq;
+    }
+    IppsBigNumState* got = interpolate(piece, xs, count, z, curve);
+    int ret = bn_equal(got, priv) ? 0 : 1;
+
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, got);
+    ippsSet_BN(IppsBigNumPOS, 1, &zero, priv);
+    memset(&secret, 0, sizeof(secret));
+    delete [] (Ipp8u*) got;
+    delete [] (Ipp8u*) bnslot;
+    delete [] (Ipp8u*) z;
+    delete [] (Ipp8u*) priv;
+    delete [] xs;
+    deleteBNArray(piece);
+    return ret;
+}
+
+/*
+ * test_regen_shares:
+ *   0 when regen_shares re-derives exactly the count shares the app was
+ *   given (at their x), 1 when it derives others, -1 when it refuses.
+ *   Only the verdict leaves the enclave.
+ */
+int test_regen_shares(uint64_t key_id, const share_t* shares, int count)
+{
+    if (count < 1 || count > SHARE_MAX_N)
+        return -1;
+    uint32_t* xs = new uint32_t[count];
+    share_t* got = new share_t[count];
+    for (int i = 0; i < count; i++)
+        xs[i] = shares[i].x;
+    int ret = regen_shares(key_id, xs, count, got);
+    if (ret == 0)
+        ret = memcmp(got, shares, (size_t)count * sizeof(share_t)) == 0 ? 0 : 1;
+    memset(got, 0, (size_t)count * sizeof(share_t));
+    delete [] got;
+    delete [] xs;
+    return ret;
+}
+
+/*
+ * test_hd_shares:
+ *   test_share_secret for an HD child: the parent's shares plus tweak
+ *   (mod the child's order) must rebuild child key_id.
+ */
+int test_hd_shares(uint64_t key_id, const share_t* shares, int count, const uint8_t* tweak)
+{
+    if (count < 1 || count > SHARE_MAX_K)
+        return -1;
+    keystore_secret_t secret;
+    uint8_t pub[64];
+    if (keystore_get(key_id, &secret, pub) != 0)
+        return -1;
+    int curve = (secret.flags & KEYSTORE_FLAG_ED25519) ? SHARE_CURVE_ED25519 : SHARE_CURVE_SECP256K1;
+    memset(&secret, 0, sizeof(secret));
+
+    IppsBigNumState* bnq = newOrderBN(curve);
+    IppsBigNumState* t = newBN(ORDER_WORDS);
+    IppsBigNumState* y = newBN(ELEM_WORDS);
+    ippsSetOctString_BN(tweak, 32, t);
+    share_t* child = new share_t[count];
+    for (int i = 0; i < count; i++)
+    {
+        child[i].x = shares[i].x;
+        ippsSetOctString_BN(shares[i].y, sizeof(shares[i].y), y);
+        ippsAdd_BN(y, t, y);
+        ippsMod_BN(y, bnq, y);
+        ippsGetOctString_BN(child[i].y, sizeof(child[i].y), y);
+    }
+    int ret = test_share_secret(key_id, child, count);
+
+    memset(child, 0, (size_t)count * sizeof(share_t));
+    delete [] child;
+    delete [] (Ipp8u*) y;
+    delete [] (Ipp8u*) t;
+    delete [] (Ipp8u*) bnq;
+    return ret;
+}
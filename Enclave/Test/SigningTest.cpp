@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Signature checks from inside the enclave: a FROST signature verified
+ * from the stored public key alone, as any Schnorr verifier would, without
+ * the round state that produced it.
+ */
+
+#include <string.h>
+
+#include "../Enclave.h"
+#include "../KeyStore/KeyStore.h"
+#include "Test.h"
+#include "Enclave_t.h"
+
+#include "sgx_tcrypto.h"
+
+static const uint8_t tag_chal[] = "FROST-secp256k1-chal";
+
+/*
+ * test_frost_verify:
+ *   0 when sig = R || z is a Schnorr signature of msg under key_id's
+ *   public key Y, i.e. z*G == R + H(R||Y||m)*Y; 1 when it is not, -1 on
+ *   bad input.
+ */
+int test_frost_verify(uint64_t key_id, const uint8_t* msg, const uint8_t* sig)
+{
+    keystore_secret_t secret;
+    uint8_t Y[64];
+    if (keystore_get(key_id, &secret, Y) != 0)
+        return -1;
+    memset(&secret, 0, sizeof(secret));
+
+    sgx_sha_state_handle_t sha;
+    sgx_sha256_hash_t h;
+    if (sgx_sha256_init(&sha) != SGX_SUCCESS)
+        return -1;
+    int ok = sgx_sha256_update(tag_chal, sizeof(tag_chal) - 1, sha) == SGX_SUCCESS &&
+             sgx_sha256_update(sig, 64, sha) == SGX_SUCCESS &&
+             sgx_sha256_update(Y, sizeof(Y), sha) == SGX_SUCCESS &&
+             sgx_sha256_update(msg, 32, sha) == SGX_SUCCESS &&
+             sgx_sha256_get_hash(sha, &h) == SGX_SUCCESS;
+    sgx_sha256_close(sha);
+    if (!ok)
+        return -1;
+
+    IppsBigNumState* bnq = newOrderBN();
+    IppsBigNumState* c = newBN(ORDER_WORDS);
+    IppsBigNumState* z = newBN(ORDER_WORDS);
+    ippsSetOctString_BN(h, sizeof(h), c);
+    ippsMod_BN(c, bnq, c);
+    ippsSetOctString_BN(sig + 64, 32, z);
+
+    //R + c*Y 与 z*G 比较
+    IppsECCPState* ec = newSecp256k1_ECP();
+    IppsECCPPointState** pts = newPointArray(4);
+    Ipp8u scalars[64];
+    memset(scalars, 0, 32);
+    scalars[31] = 1;
+    ippsGetOctString_BN(scalars + 32, 32, c);
+    int ret = ec_set_point(ec, sig, pts[0]) == 0 && ec_set_point(ec, Y, pts[1]) == 0 ? 0 : -1;
+    if (ret == 0)
+    {
+        ec_msm(ec, pts, scalars, 2, pts[2]);
+        ippsECCPPublicKey(z, pts[3], ec);
+        IppECResult res;
+        ippsECCPComparePoint(pts[2], pts[3], &res, ec);
+        ret = res == ippECPointIsEqual ? 0 : 1;
+    }
+
+    deletePointArray(pts);
+    delete [] (Ipp8u*) ec;
+    delete [] (Ipp8u*) z;
+    delete [] (Ipp8u*) c;
+    delete [] (Ipp8u*) bnq;
+    return ret;
+}
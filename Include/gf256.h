@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* gf256.h - GF(2^8) arithmetic and region kernels, shared by the enclave
+ * and the untrusted side.
+ *
+ * The field is GF(2)[x]/(x^8+x^4+x^3+x+1), the AES polynomial, because that
+ * is the one GFNI's gf2p8mulb multiplies in. Scalar code uses log/exp
+ * tables; the region kernels (dst = c*src, dst ^= c*src) and the dot
+ * kernel matrix products are built on (dst = sum c_i * src_i) each have an
+ * AVX2 PSHUFB version (two 16-entry nibble tables per constant) and an
+ * AVX-512 GFNI version, compiled with per-function target attributes so
+ * the rest of the build keeps its baseline ISA. gf256_select() picks the
+ * kernels once from features the caller detected: CPUID must go through
+ * sgx_cpuidex inside the enclave, so detection is left to each side.
+ */
+
+#ifndef _GF256_H_
+#define _GF256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF256_X86 1
+#endif
+
+#define GF256_POLY 0x11b
+
+/* gf256_select() feature bits */
+#define GF256_AVX2 0x1
+#define GF256_GFNI 0x2  /* GFNI together with AVX512F/BW */
+
+static const uint8_t gf256_exp[512] = {
+    0x01, 0x03, 0x05, 0x0f, 0x11, 0x33, 0x55, 0xff, 0x1a, 0x2e, 0x72, 0x96, 0xa1, 0xf8, 0x13, 0x35,
+    0x5f, 0xe1, 0x38, 0x48, 0xd8, 0x73, 0x95, 0xa4, 0xf7, 0x02, 0x06, 0x0a, 0x1e, 0x22, 0x66, 0xaa,
+    0xe5, 0x34, 0x5c, 0xe4, 0x37, 0x59, 0xeb, 0x26, 0x6a, 0xbe, 0xd9, 0x70, 0x90, 0xab, 0xe6, 0x31,
+    0x53, 0xf5, 0x04, 0x0c, 0x14, 0x3c, 0x44, 0xcc, 0x4f, 0xd1, 0x68, 0xb8, 0xd3, 0x6e, 0xb2, 0xcd,
+    0x4c, 0xd4, 0x67, 0xa9, 0xe0, 0x3b, 0x4d, 0xd7, 0x62, 0xa6, 0xf1, 0x08, 0x18, 0x28, 0x78, 0x88,
+    0x83, 0x9e, 0xb9, 0xd0, 0x6b, 0xbd, 0xdc, 0x7f, 0x81, 0x98, 0xb3, 0xce, 0x49, 0xdb, 0x76, 0x9a,
+    0xb5, 0xc4, 0x57, 0xf9, 0x10, 0x30, 0x50, 0xf0, 0x0b, 0x1d, 0x27, 0x69, 0xbb, 0xd6, 0x61, 0xa3,
+    0xfe, 0x19, 0x2b, 0x7d, 0x87, 0x92, 0xad, 0xec, 0x2f, 0x71, 0x93, 0xae, 0xe9, 0x20, 0x60, 0xa0,
+    0xfb, 0x16, 0x3a, 0x4e, 0xd2, 0x6d, 0xb7, 0xc2, 0x5d, 0xe7, 0x32, 0x56, 0xfa, 0x15, 0x3f, 0x41,
+    0xc3, 0x5e, 0xe2, 0x3d, 0x47, 0xc9, 0x40, 0xc0, 0x5b, 0xed, 0x2c, 0x74, 0x9c, 0xbf, 0xda, 0x75,
+    0x9f, 0xba, 0xd5, 0x64, 0xac, 0xef, 0x2a, 0x7e, 0x82, 0x9d, 0xbc, 0xdf, 0x7a, 0x8e, 0x89, 0x80,
+    0x9b, 0xb6, 0xc1, 0x58, 0xe8, 0x23, 0x65, 0xaf, 0xea, 0x25, 0x6f, 0xb1, 0xc8, 0x43, 0xc5, 0x54,
+    0xfc, 0x1f, 0x21, 0x63, 0xa5, 0xf4, 0x07, 0x09, 0x1b, 0x2d, 0x77, 0x99, 0xb0, 0xcb, 0x46, 0xca,
+    0x45, 0xcf, 0x4a, 0xde, 0x79, 0x8b, 0x86, 0x91, 0xa8, 0xe3, 0x3e, 0x42, 0xc6, 0x51, 0xf3, 0x0e,
+    0x12, 0x36, 0x5a, 0xee, 0x29, 0x7b, 0x8d, 0x8c, 0x8f, 0x8a, 0x85, 0x94, 0xa7, 0xf2, 0x0d, 0x17,
+    0x39, 0x4b, 0xdd, 0x7c, 0x84, 0x97, 0xa2, 0xfd, 0x1c, 0x24, 0x6c, 0xb4, 0xc7, 0x52, 0xf6, 0x01,
+    0x03, 0x05, 0x0f, 0x11, 0x33, 0x55, 0xff, 0x1a, 0x2e, 0x72, 0x96, 0xa1, 0xf8, 0x13, 0x35, 0x5f,
+    0xe1, 0x38, 0x48, 0xd8, 0x73, 0x95, 0xa4, 0xf7, 0x02, 0x06, 0x0a, 0x1e, 0x22, 0x66, 0xaa, 0xe5,
+    0x34, 0x5c, 0xe4, 0x37, 0x59, 0xeb, 0x26, 0x6a, 0xbe, 0xd9, 0x70, 0x90, 0xab, 0xe6, 0x31, 0x53,
+    0xf5, 0x04, 0x0c, 0x14, 0x3c, 0x44, 0xcc, 0x4f, 0xd1, 0x68, 0xb8, 0xd3, 0x6e, 0xb2, 0xcd, 0x4c,
+    0xd4, 0x67, 0xa9, 0xe0, 0x3b, 0x4d, 0xd7, 0x62, 0xa6, 0xf1, 0x08, 0x18, 0x28, 0x78, 0x88, 0x83,
+    0x9e, 0xb9, 0xd0, 0x6b, 0xbd, 0xdc, 0x7f, 0x81, 0x98, 0xb3, 0xce, 0x49, 0xdb, 0x76, 0x9a, 0xb5,
+    0xc4, 0x57, 0xf9, 0x10, 0x30, 0x50, 0xf0, 0x0b, 0x1d, 0x27, 0x69, 0xbb, 0xd6, 0x61, 0xa3, 0xfe,
+    0x19, 0x2b, 0x7d, 0x87, 0x92, 0xad, 0xec, 0x2f, 0x71, 0x93, 0xae, 0xe9, 0x20, 0x60, 0xa0, 0xfb,
+    0x16, 0x3a, 0x4e, 0xd2, 0x6d, 0xb7, 0xc2, 0x5d, 0xe7, 0x32, 0x56, 0xfa, 0x15, 0x3f, 0x41, 0xc3,
+    0x5e, 0xe2, 0x3d, 0x47, 0xc9, 0x40, 0xc0, 0x5b, 0xed, 0x2c, 0x74, 0x9c, 0xbf, 0xda, 0x75, 0x9f,
+    0xba, 0xd5, 0x64, 0xac, 0xef, 0x2a, 0x7e, 0x82, 0x9d, 0xbc, 0xdf, 0x7a, 0x8e, 0x89, 0x80, 0x9b,
+    0xb6, 0xc1, 0x58, 0xe8, 0x23, 0x65, 0xaf, 0xea, 0x25, 0x6f, 0xb1, 0xc8, 0x43, 0xc5, 0x54, 0xfc,
+    0x1f, 0x21, 0x63, 0xa5, 0xf4, 0x07, 0x09, 0x1b, 0x2d, 0x77, 0x99, 0xb0, 0xcb, 0x46, 0xca, 0x45,
+    0xcf, 0x4a, 0xde, 0x79, 0x8b, 0x86, 0x91, 0xa8, 0xe3, 0x3e, 0x42, 0xc6, 0x51, 0xf3, 0x0e, 0x12,
+    0x36, 0x5a, 0xee, 0x29, 0x7b, 0x8d, 0x8c, 0x8f, 0x8a, 0x85, 0x94, 0xa7, 0xf2, 0x0d, 0x17, 0x39,
+    0x4b, 0xdd, 0x7c, 0x84, 0x97, 0xa2, 0xfd, 0x1c, 0x24, 0x6c, 0xb4, 0xc7, 0x52, 0xf6, 0x01, 0x03
+};
+
+static const uint8_t gf256_log[256] = {
+    0x00, 0x00, 0x19, 0x01, 0x32, 0x02, 0x1a, 0xc6, 0x4b, 0xc7, 0x1b, 0x68, 0x33, 0xee, 0xdf, 0x03,
+    0x64, 0x04, 0xe0, 0x0e, 0x34, 0x8d, 0x81, 0xef, 0x4c, 0x71, 0x08, 0xc8, 0xf8, 0x69, 0x1c, 0xc1,
+    0x7d, 0xc2, 0x1d, 0xb5, 0xf9, 0xb9, 0x27, 0x6a, 0x4d, 0xe4, 0xa6, 0x72, 0x9a, 0xc9, 0x09, 0x78,
+    0x65, 0x2f, 0x8a, 0x05, 0x21, 0x0f, 0xe1, 0x24, 0x12, 0xf0, 0x82, 0x45, 0x35, 0x93, 0xda, 0x8e,
+    0x96, 0x8f, 0xdb, 0xbd, 0x36, 0xd0, 0xce, 0x94, 0x13, 0x5c, 0xd2, 0xf1, 0x40, 0x46, 0x83, 0x38,
+    0x66, 0xdd, 0xfd, 0x30, 0xbf, 0x06, 0x8b, 0x62, 0xb3, 0x25, 0xe2, 0x98, 0x22, 0x88, 0x91, 0x10,
+    0x7e, 0x6e, 0x48, 0xc3, 0xa3, 0xb6, 0x1e, 0x42, 0x3a, 0x6b, 0x28, 0x54, 0xfa, 0x85, 0x3d, 0xba,
+    0x2b, 0x79, 0x0a, 0x15, 0x9b, 0x9f, 0x5e, 0xca, 0x4e, 0xd4, 0xac, 0xe5, 0xf3, 0x73, 0xa7, 0x57,
+    0xaf, 0x58, 0xa8, 0x50, 0xf4, 0xea, 0xd6, 0x74, 0x4f, 0xae, 0xe9, 0xd5, 0xe7, 0xe6, 0xad, 0xe8,
+    0x2c, 0xd7, 0x75, 0x7a, 0xeb, 0x16, 0x0b, 0xf5, 0x59, 0xcb, 0x5f, 0xb0, 0x9c, 0xa9, 0x51, 0xa0,
+    0x7f, 0x0c, 0xf6, 0x6f, 0x17, 0xc4, 0x49, 0xec, 0xd8, 0x43, 0x1f, 0x2d, 0xa4, 0x76, 0x7b, 0xb7,
+    0xcc, 0xbb, 0x3e, 0x5a, 0xfb, 0x60, 0xb1, 0x86, 0x3b, 0x52, 0xa1, 0x6c, 0xaa, 0x55, 0x29, 0x9d,
+    0x97, 0xb2, 0x87, 0x90, 0x61, 0xbe, 0xdc, 0xfc, 0xbc, 0x95, 0xcf, 0xcd, 0x37, 0x3f, 0x5b, 0xd1,
+    0x53, 0x39, 0x84, 0x3c, 0x41, 0xa2, 0x6d, 0x47, 0x14, 0x2a, 0x9e, 0x5d, 0x56, 0xf2, 0xd3, 0xab,
+    0x44, 0x11, 0x92, 0xd9, 0x23, 0x20, 0x2e, 0x89, 0xb4, 0x7c, 0xb8, 0x26, 0x77, 0x99, 0xe3, 0xa5,
+    0x67, 0x4a, 0xed, 0xde, 0xc5, 0x31, 0xfe, 0x18, 0x0d, 0x63, 0x8c, 0x80, 0xc0, 0xf7, 0x70, 0x07
+};
+
+static inline uint8_t gf256_mul(uint8_t a, uint8_t b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf256_exp[gf256_log[a] + gf256_log[b]];
+}
+
+/* a must be non-zero */
+static inline uint8_t gf256_inv(uint8_t a)
+{
+    return gf256_exp[255 - gf256_log[a]];
+}
+
+/* b must be non-zero */
+static inline uint8_t gf256_div(uint8_t a, uint8_t b)
+{
+    if (a == 0)
+        return 0;
+    return gf256_exp[gf256_log[a] + 255 - gf256_log[b]];
+}
+
+/* a^e, e >= 0 */
+static inline uint8_t gf256_pow(uint8_t a, unsigned e)
+{
+    if (e == 0)
+        return 1;
+    if (a == 0)
+        return 0;
+    return gf256_exp[(gf256_log[a] * e) % 255];
+}
+
+typedef void (*gf256_region_fn)(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len);
+typedef void (*gf256_dot_fn)(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len);
+
+/* sources folded per pass of a dot kernel */
+#define GF256_DOT_GROUP 16
+
+static inline void gf256_region_scalar(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len, int add)
+{
+    if (c == 0)
+    {
+        if (!add)
+            memset(dst, 0, len);
+        return;
+    }
+    unsigned lc = gf256_log[c];
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t p = src[i] ? gf256_exp[lc + gf256_log[src[i]]] : 0;
+        dst[i] = add ? (uint8_t)(dst[i] ^ p) : p;
+    }
+}
+
+static inline void gf256_mul_scalar(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_region_scalar(dst, src, c, len, 0);
+}
+
+static inline void gf256_muladd_scalar(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_region_scalar(dst, src, c, len, 1);
+}
+
+/* dst = sum c[i] * src[i], i < count */
+static inline void gf256_dot_scalar(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len)
+{
+    gf256_region_scalar(dst, src[0], c[0], len, 0);
+    for (int i = 1; i < count; i++)
+        gf256_region_scalar(dst, src[i], c[i], len, 1);
+}
+
+#ifdef GF256_X86
+
+//c*s = lo[s & 0xf] ^ hi[s >> 4],每32字节两次PSHUFB
+__attribute__((target("avx2")))
+static inline void gf256_region_avx2(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len, int add)
+{
+    uint8_t lo[16], hi[16];
+    for (int i = 0; i < 16; i++)
+    {
+        lo[i] = gf256_mul(c, (uint8_t)i);
+        hi[i] = gf256_mul(c, (uint8_t)(i << 4));
+    }
+    __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+    __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i p = _mm256_xor_si256(
+            _mm256_shuffle_epi8(tlo, _mm256_and_si256(s, mask)),
+            _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+        if (add)
+            p = _mm256_xor_si256(p, _mm256_loadu_si256((const __m256i*)(dst + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i), p);
+    }
+    gf256_region_scalar(dst + i, src + i, c, len - i, add);
+}
+
+__attribute__((target("avx2")))
+static inline void gf256_mul_avx2(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_region_avx2(dst, src, c, len, 0);
+}
+
+__attribute__((target("avx2")))
+static inline void gf256_muladd_avx2(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    if (c != 0)
+        gf256_region_avx2(dst, src, c, len, 1);
+}
+
+//一次读写dst累加一组源,RS矩阵乘时dst只落一次内存
+__attribute__((target("avx2")))
+static inline void gf256_dot_group_avx2(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len, int add)
+{
+    __m256i tlo[GF256_DOT_GROUP], thi[GF256_DOT_GROUP];
+    for (int s = 0; s < count; s++)
+    {
+        uint8_t lo[16], hi[16];
+        for (int i = 0; i < 16; i++)
+        {
+            lo[i] = gf256_mul(c[s], (uint8_t)i);
+            hi[i] = gf256_mul(c[s], (uint8_t)(i << 4));
+        }
+        tlo[s] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lo));
+        thi[s] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)hi));
+    }
+    __m256i mask = _mm256_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i acc = add ? _mm256_loadu_si256((const __m256i*)(dst + i)) : _mm256_setzero_si256();
+        for (int s = 0; s < count; s++)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(src[s] + i));
+            acc = _mm256_xor_si256(acc, _mm256_shuffle_epi8(tlo[s], _mm256_and_si256(x, mask)));
+            acc = _mm256_xor_si256(acc, _mm256_shuffle_epi8(thi[s], _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), acc);
+    }
+    for (; i < len; i++)
+    {
+        uint8_t acc = add ? dst[i] : 0;
+        for (int s = 0; s < count; s++)
+            acc ^= gf256_mul(c[s], src[s][i]);
+        dst[i] = acc;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline void gf256_dot_avx2(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len)
+{
+    for (int s = 0; s < count; s += GF256_DOT_GROUP)
+    {
+        int n = count - s < GF256_DOT_GROUP ? count - s : GF256_DOT_GROUP;
+        gf256_dot_group_avx2(dst, src + s, c + s, n, len, s > 0);
+    }
+}
+
+//vgf2p8mulb直接在AES多项式下逐字节相乘,尾部用掩码读写
+__attribute__((target("gfni,avx512f,avx512bw")))
+static inline void gf256_region_gfni(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len, int add)
+{
+    __m512i cv = _mm512_set1_epi8((char)c);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64)
+    {
+        __m512i p = _mm512_gf2p8mul_epi8(_mm512_loadu_si512((const void*)(src + i)), cv);
+        if (add)
+            p = _mm512_xor_si512(p, _mm512_loadu_si512((const void*)(dst + i)));
+        _mm512_storeu_si512((void*)(dst + i), p);
+    }
+    if (i < len)
+    {
+        __mmask64 m = (__mmask64)(~0ULL >> (64 - (len - i)));
+        __m512i p = _mm512_gf2p8mul_epi8(_mm512_maskz_loadu_epi8(m, src + i), cv);
+        if (add)
+            p = _mm512_xor_si512(p, _mm512_maskz_loadu_epi8(m, dst + i));
+        _mm512_mask_storeu_epi8(dst + i, m, p);
+    }
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+static inline void gf256_mul_gfni(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_region_gfni(dst, src, c, len, 0);
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+static inline void gf256_muladd_gfni(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    if (c != 0)
+        gf256_region_gfni(dst, src, c, len, 1);
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+static inline void gf256_dot_group_gfni(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len, int add)
+{
+    __m512i cv[GF256_DOT_GROUP];
+    for (int s = 0; s < count; s++)
+        cv[s] = _mm512_set1_epi8((char)c[s]);
+
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64)
+    {
+        __m512i acc = add ? _mm512_loadu_si512((const void*)(dst + i)) : _mm512_setzero_si512();
+        for (int s = 0; s < count; s++)
+            acc = _mm512_xor_si512(acc, _mm512_gf2p8mul_epi8(_mm512_loadu_si512((const void*)(src[s] + i)), cv[s]));
+        _mm512_storeu_si512((void*)(dst + i), acc);
+    }
+    if (i < len)
+    {
+        __mmask64 m = (__mmask64)(~0ULL >> (64 - (len - i)));
+        __m512i acc = add ? _mm512_maskz_loadu_epi8(m, dst + i) : _mm512_setzero_si512();
+        for (int s = 0; s < count; s++)
+            acc = _mm512_xor_si512(acc, _mm512_gf2p8mul_epi8(_mm512_maskz_loadu_epi8(m, src[s] + i), cv[s]));
+        _mm512_mask_storeu_epi8(dst + i, m, acc);
+    }
+}
+
+__attribute__((target("gfni,avx512f,avx512bw")))
+static inline void gf256_dot_gfni(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len)
+{
+    for (int s = 0; s < count; s += GF256_DOT_GROUP)
+    {
+        int n = count - s < GF256_DOT_GROUP ? count - s : GF256_DOT_GROUP;
+        gf256_dot_group_gfni(dst, src + s, c + s, n, len, s > 0);
+    }
+}
+
+/* Feature bits from CPUID leaves 1 and 7 (subleaf 0) and XCR0; the OS (or,
+ * inside an enclave, XFRM) must have enabled the matching register state. */
+static inline unsigned gf256_features(const int leaf1[4], const int leaf7[4], uint64_t xcr0)
+{
+    unsigned features = 0;
+    if (!(leaf1[2] & (1 << 27)) || (xcr0 & 0x6) != 0x6)
+        return 0;
+    if (leaf7[1] & (1 << 5))
+        features |= GF256_AVX2;
+    if ((leaf7[2] & (1 << 8)) && (leaf7[1] & (1 << 16)) && (leaf7[1] & (1 << 30)) && (xcr0 & 0xe0) == 0xe0)
+        features |= GF256_GFNI;
+    return features;
+}
+
+/* XGETBV, only valid once CPUID.1:ECX.OSXSAVE is set */
+static inline uint64_t gf256_xgetbv(void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif /* GF256_X86 */
+
+/* Active kernels, shared by every translation unit that includes this header */
+inline gf256_region_fn& gf256_mul_region_fn(void)
+{
+    static gf256_region_fn fn = gf256_mul_scalar;
+    return fn;
+}
+
+inline gf256_region_fn& gf256_muladd_region_fn(void)
+{
+    static gf256_region_fn fn = gf256_muladd_scalar;
+    return fn;
+}
+
+inline gf256_dot_fn& gf256_dot_region_fn(void)
+{
+    static gf256_dot_fn fn = gf256_dot_scalar;
+    return fn;
+}
+
+static inline void gf256_select(unsigned features)
+{
+    gf256_region_fn mul = gf256_mul_scalar;
+    gf256_region_fn muladd = gf256_muladd_scalar;
+    gf256_dot_fn dot = gf256_dot_scalar;
+#ifdef GF256_X86
+    if (features & GF256_GFNI)
+    {
+        mul = gf256_mul_gfni;
+        muladd = gf256_muladd_gfni;
+        dot = gf256_dot_gfni;
+    }
+    else if (features & GF256_AVX2)
+    {
+        mul = gf256_mul_avx2;
+        muladd = gf256_muladd_avx2;
+        dot = gf256_dot_avx2;
+    }
+#else
+    (void)features;
+#endif
+    gf256_mul_region_fn() = mul;
+    gf256_muladd_region_fn() = muladd;
+    gf256_dot_region_fn() = dot;
+}
+
+/* dst = c * src */
+static inline void gf256_mul_region(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_mul_region_fn()(dst, src, c, len);
+}
+
+/* dst ^= c * src */
+static inline void gf256_muladd_region(uint8_t* dst, const uint8_t* src, uint8_t c, size_t len)
+{
+    gf256_muladd_region_fn()(dst, src, c, len);
+}
+
+/* dst = sum c[i] * src[i] for i < count, count >= 1; dst is written once */
+static inline void gf256_dot_region(uint8_t* dst, const uint8_t* const* src, const uint8_t* c, int count, size_t len)
+{
+    gf256_dot_region_fn()(dst, src, c, count, len);
+}
+
+#endif /* !_GF256_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* merkle.h - layout of the Merkle commitment over a batch of shares,
+ * shared by the enclave (which hashes) and the untrusted side (which only
+ * cuts inclusion proofs out of the stored tree).
+ *
+ * Leaf j commits share j of the batch (key b's share i is leaf b*n + i):
+ *   SHA-256(0x00 || key_id (8 bytes BE) || x (4 bytes BE) || y)
+ * and an inner node is SHA-256(0x01 || left || right). A level with an
+ * odd count promotes its last node unchanged. The tree is stored level by
+ * level from the leaves up, the root being the last hash.
+ */
+
+#ifndef _MERKLE_H_
+#define _MERKLE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define MERKLE_HASH_SIZE 32
+#define MERKLE_LEAF_SIZE 45
+#define MERKLE_NODE_SIZE 65
+#define MERKLE_MAX_DEPTH 40
+
+/* hashes in a tree over 'leaves' leaves */
+static inline uint64_t merkle_nodes(uint64_t leaves)
+{
+    uint64_t total = 0;
+    while (leaves > 1)
+    {
+        total += leaves;
+        leaves = (leaves + 1) / 2;
+    }
+    return total + leaves;
+}
+
+/*
+ * merkle_proof:
+ *   Sibling hashes from leaf 'index' up to the root, skipping levels where
+ *   the node was promoted, into proof (MERKLE_MAX_DEPTH hashes at most).
+ *   The verifier knows 'leaves' and 'index', so it knows which levels have
+ *   no sibling and on which side each sibling sits. Returns the number of
+ *   hashes, -1 for a bad index.
+ */
+static inline int merkle_proof(const uint8_t* tree, uint64_t leaves, uint64_t index, uint8_t* proof)
+{
+    if (index >= leaves)
+        return -1;
+    uint64_t level = 0;
+    int len = 0;
+    while (leaves > 1)
+    {
+        uint64_t sibling = index ^ 1;
+        if (sibling < leaves)
+            memcpy(proof + MERKLE_HASH_SIZE * (size_t)len++, tree + MERKLE_HASH_SIZE * (size_t)(level + sibling),
+                   MERKLE_HASH_SIZE);
+        level += leaves;
+        leaves = (leaves + 1) / 2;
+        index /= 2;
+    }
+    return len;
+}
+
+#endif /* !_MERKLE_H_ */
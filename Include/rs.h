@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2011-2021 Intel Corporation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the
+ *     distribution.
+ *   * Neither the name of Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* rs.h - systematic Reed-Solomon erasure code over GF(2^8), header-only so
+ * the enclave, the server and the client can all disperse and rebuild.
+ *
+ * k data shards are stored as is; parity shard i is sum_j C[i][j] * data_j
+ * with the Cauchy matrix C[i][j] = 1 / ((k+i) ^ j). Every square submatrix
+ * of [I; C] is invertible, so any k of the k+m shards recover the data.
+ * k <= RS_MAX_K, k + m <= 256.
+ *
+ * Encoding and decoding are both a matrix times a set of shards. rs_apply
+ * walks the shards in blocks small enough that one block of every input
+ * stays in L2 while all output rows are produced from it, and each output
+ * block is written once by gf256_dot_region. Decoding needs the inverse
+ * of the k surviving rows; an rs_codec_t keeps the last RS_DECODE_CACHE
+ * inverses keyed by which shards survived, since a stream of stripes
+ * almost always loses the same shards.
+ */
+
+#ifndef _RS_H_
+#define _RS_H_
+
+#include <stdlib.h>
+
+#include "gf256.h"
+
+#define RS_MAX_SHARDS   256
+#define RS_MAX_K        128
+#define RS_CACHE_BYTES  (256 * 1024)
+#define RS_DECODE_CACHE 8
+
+typedef struct _rs_decode_entry_t {
+    uint32_t stamp;         /* 0: empty */
+    uint8_t  idx[RS_MAX_K];
+    uint8_t* matrix;        /* k x k */
+} rs_decode_entry_t;
+
+typedef struct _rs_codec_t {
+    int      k;
+    int      m;
+    uint32_t tick;
+    uint8_t* parity;        /* m x k Cauchy rows */
+    rs_decode_entry_t cache[RS_DECODE_CACHE];
+} rs_codec_t;
+
+static inline uint8_t rs_cauchy(int k, int i, int j)
+{
+    return gf256_inv((uint8_t)((k + i) ^ j));
+}
+
+static inline int rs_codec_init(rs_codec_t* rs, int k, int m)
+{
+    memset(rs, 0, sizeof(*rs));
+    if (k < 1 || k > RS_MAX_K || m < 0 || k + m > RS_MAX_SHARDS)
+        return -1;
+    rs->k = k;
+    rs->m = m;
+    if (m == 0)
+        return 0;
+    rs->parity = (uint8_t*)malloc((size_t)m * k);
+    if (rs->parity == NULL)
+        return -1;
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < k; j++)
+            rs->parity[i * k + j] = rs_cauchy(k, i, j);
+    return 0;
+}
+
+static inline void rs_codec_free(rs_codec_t* rs)
+{
+    free(rs->parity);
+    for (int i = 0; i < RS_DECODE_CACHE; i++)
+        free(rs->cache[i].matrix);
+    memset(rs, 0, sizeof(*rs));
+}
+
+/*
+ * rs_apply:
+ *   out[r] = sum_j matrix[r][j] * in[j] for r < rows, j < cols, skipping
+ *   rows whose out[r] is NULL. Cache-blocked over len.
+ */
+static inline void rs_apply(const uint8_t* matrix, int rows, int cols, const uint8_t* const* in,
+                            uint8_t* const* out, size_t len)
+{
+    size_t block = (RS_CACHE_BYTES / (size_t)(rows + cols)) & ~(size_t)63;
+    if (block < 1024)
+        block = 1024;
+
+    const uint8_t* src[RS_MAX_SHARDS];
+    for (size_t off = 0; off < len; off += block)
+    {
+        size_t b = len - off < block ? len - off : block;
+        for (int j = 0; j < cols; j++)
+            src[j] = in[j] + off;
+        for (int r = 0; r < rows; r++)
+            if (out[r])
+                gf256_dot_region(out[r] + off, src, matrix + (size_t)r * cols, cols, b);
+    }
+}
+
+/* parity[i][0..len) for i < m from data[j][0..len), j < k */
+static inline void rs_encode(const rs_codec_t* rs, const uint8_t* const* data, uint8_t* const* parity, size_t len)
+{
+    if (rs->m > 0)
+        rs_apply(rs->parity, rs->m, rs->k, data, parity, len);
+}
+
+/* Invert the k x k matrix a in place (row-major) by Gauss-Jordan; -1 if singular */
+static inline int rs_invert(int k, uint8_t* a, uint8_t* inv)
+{
+    memset(inv, 0, (size_t)k * k);
+    for (int i = 0; i < k; i++)
+        inv[i * k + i] = 1;
+
+    for (int c = 0; c < k; c++)
+    {
+        int p = c;
+        while (p < k && a[p * k + c] == 0)
+            p++;
+        if (p == k)
+            return -1;
+        if (p != c)
+        {
+            for (int j = 0; j < k; j++)
+            {
+                uint8_t t = a[c * k + j]; a[c * k + j] = a[p * k + j]; a[p * k + j] = t;
+                t = inv[c * k + j]; inv[c * k + j] = inv[p * k + j]; inv[p * k + j] = t;
+            }
+        }
+        uint8_t s = gf256_inv(a[c * k + c]);
+        for (int j = 0; j < k; j++)
+        {
+            a[c * k + j] = gf256_mul(a[c * k + j], s);
+            inv[c * k + j] = gf256_mul(inv[c * k + j], s);
+        }
+        for (int r = 0; r < k; r++)
+        {
+            uint8_t f = a[r * k + c];
+            if (r == c || f == 0)
+                continue;
+            for (int j = 0; j < k; j++)
+            {
+                a[r * k + j] ^= gf256_mul(f, a[c * k + j]);
+                inv[r * k + j] ^= gf256_mul(f, inv[c * k + j]);
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * rs_decode_matrix:
+ *   Row j of the k x k result rebuilds data shard j from the shards with
+ *   indices idx[0..k) (index < k is a data shard, k + i is parity i).
+ *   Served from the codec's cache when the same shards survived before.
+ */
+static inline const uint8_t* rs_decode_matrix(rs_codec_t* rs, const int* idx)
+{
+    int k = rs->k;
+    uint8_t key[RS_MAX_K];
+    for (int r = 0; r < k; r++)
+    {
+        if (idx[r] < 0 || idx[r] >= k + rs->m)
+            return NULL;
+        key[r] = (uint8_t)idx[r];
+    }
+
+    rs_decode_entry_t* victim = &rs->cache[0];
+    for (int i = 0; i < RS_DECODE_CACHE; i++)
+    {
+        rs_decode_entry_t* e = &rs->cache[i];
+        if (e->stamp && memcmp(e->idx, key, (size_t)k) == 0)
+        {
+            e->stamp = ++rs->tick;
+            return e->matrix;
+        }
+        if (e->stamp < victim->stamp)
+            victim = e;
+    }
+
+    //未命中: 取出幸存分片对应的k行求逆,替换最久未用的项
+    uint8_t* a = (uint8_t*)malloc((size_t)k * k);
+    if (a == NULL)
+        return NULL;
+    for (int r = 0; r < k; r++)
+        for (int j = 0; j < k; j++)
+            a[r * k + j] = idx[r] < k ? (uint8_t)(idx[r] == j) : rs->parity[(idx[r] - k) * k + j];
+    if (victim->matrix == NULL)
+        victim->matrix = (uint8_t*)malloc((size_t)k * k);
+    int ret = victim->matrix ? rs_invert(k, a, victim->matrix) : -1;
+    free(a);
+    if (ret != 0)
+    {
+        victim->stamp = 0;
+        return NULL;
+    }
+    memcpy(victim->idx, key, (size_t)k);
+    victim->stamp = ++rs->tick;
+    return victim->matrix;
+}
+
+/*
+ * rs_decode:
+ *   Rebuild every data[j] that is not NULL from the k shards in[r] with
+ *   indices idx[r]. Pass NULL for data shards that are already present.
+ */
+static inline int rs_decode(rs_codec_t* rs, const int* idx, const uint8_t* const* in, uint8_t* const* data, size_t len)
+{
+    const uint8_t* dec = rs_decode_matrix(rs, idx);
+    if (dec == NULL)
+        return -1;
+    rs_apply(dec, rs->k, rs->k, in, data, len);
+    return 0;
+}
+
+#endif /* !_RS_H_ */
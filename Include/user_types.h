@@ -32,9 +32,157 @@
 
 /* User defined types */
 
+#ifndef _USER_TYPES_H_
+#define _USER_TYPES_H_
+
 
 #define LOOPS_PER_THREAD 500
 
 typedef void *buffer_t;
 typedef int array_t[10];
 
+
+#include <stdint.h>
+
+/* Accepted (k, n) sharing policies: SHARE_MIN_K <= k <= n <= SHARE_MAX_N.
+ * Larger custodian sets go through the streaming path, up to
+ * SHARE_STREAM_MAX_N shares and SHARE_MAX_K coefficients. */
+#define SHARE_MIN_K        2
+#define SHARE_MAX_N        1024
+#define SHARE_MAX_K        1024
+#define SHARE_STREAM_MAX_N 65535
+
+/* Key curve of a sharing request; shares live mod that curve's group order */
+#define SHARE_CURVE_SECP256K1 0
+#define SHARE_CURVE_ED25519   1
+
+/* Packed sharing: up to PACKED_MAX_BATCH keys behind one polynomial */
+#define PACKED_MAX_BATCH   64
+
+/* Batch keygen: up to BATCH_MAX_KEYS independent k-of-n keys per call */
+#define BATCH_MAX_KEYS     256
+
+/* Pre-generated key pool: up to KEYPOOL_MAX_KEYS ready k-of-n keys,
+ * refilled KEYPOOL_REFILL_MAX keys per ecall */
+#define KEYPOOL_MAX_KEYS   1024
+#define KEYPOOL_REFILL_MAX 64
+
+/* Batch refresh/resharing: keys handled by one ecall */
+#define RESHARE_MAX_KEYS   0x10000
+
+/* Batch reconstruction: secrets recovered by one ecall from the same k
+ * abscissae */
+#define RECON_MAX_SECRETS  0x10000
+
+/* HD child keys: at most HD_MAX_DEPTH path levels and HD_MAX_CHILDREN
+ * siblings per ecall. Indices from HD_HARDENED up would be hardened and
+ * are refused: a child's tweak is handed out, and child - tweak = parent */
+#define HD_MAX_DEPTH       16
+#define HD_MAX_CHILDREN    1024
+#define HD_HARDENED        0x80000000u
+
+/* Byte-wise GF(2^8) sharing of blobs: x = 1..n, n <= GF_MAX_N. Inline
+ * split/combine marshal at most GF_INLINE_MAX bytes through the ecall. */
+#define GF_MAX_N           255
+#define GF_INLINE_MAX      0x40000
+
+/* Streaming blob split/combine: bytes per share handed to one ecall */
+#define BLOB_CHUNK_MAX     0x100000
+
+/* Envelope mode: AES-256-GCM over the blob, only the key is Shamir-shared */
+#define ENV_KEY_SIZE       32
+#define ENV_IV_SIZE        12
+#define ENV_TAG_SIZE       16
+
+/* One share as streamed out of the enclave: y = f(x) mod q, big-endian */
+typedef struct _share_t {
+    uint32_t x;
+    uint8_t  y[32];
+} share_t;
+
+/* Feldman VSS: commitments are 64-byte x||y secp256k1 points, one per
+ * coefficient. A batch check takes up to VSS_MAX_SHARES shares against up
+ * to VSS_MAX_COMMITS commitments in one call. */
+#define VSS_COMMIT_SIZE    64
+#define VSS_MAX_SHARES     2048
+#define VSS_MAX_COMMITS    1024
+
+/* Points in one multi-scalar multiplication job */
+#define MSM_MAX_POINTS     0x20000
+
+/* A share to verify and the key (index into the call's key list) it is of */
+typedef struct _vss_share_t {
+    uint32_t key;
+    share_t  share;
+} vss_share_t;
+
+/* FROST threshold Schnorr on secp256k1. A custodian's nonce commitment
+ * (D, E) = (d*G, e*G), 64-byte x||y each, is good for one signing round
+ * and named by id; preprocessing hands out up to FROST_NONCE_BATCH at a
+ * time and the enclave keeps FROST_NONCE_POOL secret nonce pairs. A
+ * signature is R (x||y) || z with z*G == R + H(R||Y||m)*Y. */
+#define FROST_NONCE_BATCH  64
+#define FROST_NONCE_POOL   1024
+#define FROST_MAX_SIGNERS  64
+#define FROST_SIG_SIZE     96
+
+typedef struct _frost_commit_t {
+    uint32_t id;
+    uint32_t x;
+    uint8_t  D[64];
+    uint8_t  E[64];
+} frost_commit_t;
+
+/* Prime-field sharing of data: FIELD_ORDER shares mod the secp256k1
+ * order (31 data bytes per 32-byte element), FIELD_M127 mod 2^127 - 1
+ * (15 per 16), FIELD_P64 mod 2^64 - 59 (7 per 8). A share is one element
+ * per chunk of the secret, at most FIELD_INLINE_MAX bytes per call. */
+#define FIELD_ORDER        0
+#define FIELD_M127         1
+#define FIELD_P64          2
+#define FIELD_INLINE_MAX   0x40000
+
+/* Share delivery: one share encrypted to one custodian's X25519 key with
+ * AES-256-GCM; key_id and x stay in the clear and are authenticated. One
+ * call wraps at most DELIVER_MAX_SHARES shares. */
+#define DELIVER_MAX_SHARES 0x10000
+
+typedef struct _wrapped_share_t {
+    uint64_t key_id;
+    uint32_t x;
+    uint8_t  iv[ENV_IV_SIZE];
+    uint8_t  ct[32];
+    uint8_t  tag[ENV_TAG_SIZE];
+} wrapped_share_t;
+
+/*
+ * Key store record as it lives in the WAL and snapshot files.
+ *   key_id, version and pub are kept in the clear (public key material is
+ *   not secret) and bound into the AES-GCM tag together with the sealed
+ *   secret part, so the untrusted side can index records but not forge them.
+ */
+#define KEYSTORE_SECRET_SIZE 40
+#define KEYSTORE_AAD_SIZE    76
+
+typedef struct _keystore_record_t {
+    uint64_t key_id;
+    uint32_t version;
+    uint8_t  pub[64];
+    uint8_t  iv[12];
+    uint8_t  mac[16];
+    uint8_t  secret[KEYSTORE_SECRET_SIZE];
+} keystore_record_t;
+
+/*
+ * Key id high-water mark kept in the snapshot header: next_id with a CMAC
+ * under a key derived from the store key. The tail of records written
+ * since the last compaction holds the KEYSTORE_TAIL_SLOTS ids from there.
+ */
+#define KEYSTORE_TAIL_SLOTS  1024
+
+typedef struct _keystore_mark_t {
+    uint64_t next_id;
+    uint8_t  mac[16];
+} keystore_mark_t;
+
+#endif /* !_USER_TYPES_H_ */
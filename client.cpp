@@ -66,7 +66,7 @@ int main(int argc, char* argv[])
 {
 	if (argc <= 2)
 	{
-        printf("Usage: %s ip_address port_number\n", argv[0]);
+        printf("Usage: %s ip_address port_number [keyid]\n", argv[0]);
         return 1;
 	}
 
@@ -96,7 +96,16 @@ int main(int argc, char* argv[])
     char read_buf[BUFFER_SIZE] = {0};
     memset(read_buf, 0, sizeof(read_buf));
     nlohmann::json jsdic;
-    jsdic["type"] = 1;
+    //带keyid时查询公钥,否则生成新密钥
+    if (argc > 3)
+    {
+        jsdic["type"] = 3;
+        jsdic["keyid"] = strtoull(argv[3], NULL, 10);
+    }
+    else
+    {
+        jsdic["type"] = 1;
+    }
     int64_t start_time = getTime();
     int64_t end_time;
     jsdic["starttime"] = start_time;
@@ -149,6 +158,7 @@ int main(int argc, char* argv[])
             switch(type)
             {
                 case 2:
+                case 4:
                     result = j["result"].get<int>();
                     if (result != 200){
                         printf("server result = %d\n", result);
@@ -157,11 +167,14 @@ int main(int argc, char* argv[])
                     peer_starttime = j["starttime"].get<int64_t>();
                     peer_endtime = j["endtime"].get<int64_t>();
                     printf("processtime is %ld\n", peer_endtime - peer_starttime);
+                    printf("key id is %lu\n", (unsigned long)j["keyid"].get<uint64_t>());
                     publicKey = j["publickey"].get<vector<char>>();
                     printf("public key is:");
                     for(vector<char>::iterator iter = publicKey.begin(); iter != publicKey.end(); iter++)
                         printf("%c",*iter);
                     printf("\n");
+                    if (j.contains("sharefile"))
+                        printf("share file is %s\n", j["sharefile"].get<string>().c_str());
                 break;
                 default:
                 break;